@@ -0,0 +1,172 @@
+/*******************************************************************************
+ * Copyright (C) 2018 Ahmed Ismail <aismail [at] protonmail.com>
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <open62541.h>
+#include <zk_payload.h>
+#include <zk_jsonStream.h>
+#include <zk_jsonScan.h>
+#include <zk_testValues.h>
+#include <zk_testCodec.h>
+#include <zk_bench.h>
+
+/* Round trips of a node through both JSON node codecs, one line per node class,
+ and per builtin type and array length for Variables:
+ tree:   zkUA_addNodeJsonPack, json_dumps, json_loadb and the decoder
+ stream: zkUA_jsonStream_encodeNode and zkUA_jsonScan_decodeNode (or the decoder
+ for the values the scanner leaves to it)
+ Usage: bench_jsonCodec [maxArrayLength] */
+
+#define ZKUA_BENCHJSONCODEC_SECONDS 0.2
+#define ZKUA_BENCHJSONCODEC_ITERATIONS 100000
+
+static const UA_NodeClass nodeClasses[] = { UA_NODECLASS_OBJECT,
+        UA_NODECLASS_VARIABLE, UA_NODECLASS_METHOD, UA_NODECLASS_OBJECTTYPE,
+        UA_NODECLASS_VARIABLETYPE, UA_NODECLASS_REFERENCETYPE,
+        UA_NODECLASS_DATATYPE, UA_NODECLASS_VIEW };
+
+static const size_t arrayLengths[] = { 0 /* scalar */, 1, 100, 10000, 1000000 };
+
+typedef struct zkUA_benchJsonCodec_case {
+    UA_NodeClass nodeClass;
+    const UA_DataType *attributesType;
+    UA_NodeId nodeId;
+    zkUA_jsonScanAttributes attr;
+    size_t payloadBytes;
+    UA_Boolean treeDecoded;
+    UA_Boolean failed;
+} zkUA_benchJsonCodec_case;
+
+static void zkUA_benchJsonCodec_tree(void *context) {
+    zkUA_benchJsonCodec_case *c = context;
+    zkUA_jsonScanAttributes decoded;
+    UA_NodeId nodeId;
+    size_t length = 0;
+    char *document = zkUA_testCodec_encodeTree(c->nodeClass, &c->nodeId,
+            &c->attr, &length);
+    if (!document) {
+        c->failed = true;
+        return;
+    }
+    if (zkUA_testCodec_decodeTree(document, length, c->nodeClass, &nodeId,
+            &decoded) != UA_STATUSCODE_GOOD)
+        c->failed = true;
+    c->payloadBytes = length;
+    free(document);
+    UA_NodeId_deleteMembers(&nodeId);
+    UA_deleteMembers(&decoded, c->attributesType);
+}
+
+static void zkUA_benchJsonCodec_stream(void *context) {
+    zkUA_benchJsonCodec_case *c = context;
+    UA_NodeId parent = ZKUA_TESTCODEC_PARENT;
+    UA_NodeId reference = ZKUA_TESTCODEC_REFERENCE;
+    zkUA_jsonScanAttributes decoded;
+    zkUA_NodeInfo info;
+    size_t length = 0;
+    char *document = zkUA_jsonStream_encodeNode(ZKUA_TESTCODEC_PATH,
+            c->nodeClass, &c->nodeId, &parent, &reference, &c->attr, 0,
+            &length);
+    if (!document) {
+        c->failed = true;
+        return;
+    }
+    /* the document is the thread's buffer, the scanned attributes point into it
+     and the scanner's scratch buffer */
+    UA_StatusCode sCode = zkUA_jsonScan_decodeNode(document, length, &info,
+            &decoded);
+    if (sCode == UA_STATUSCODE_BADNOTSUPPORTED) {
+        UA_NodeId nodeId;
+        c->treeDecoded = true;
+        sCode = zkUA_testCodec_decodeTree(document, length, c->nodeClass,
+                &nodeId, &decoded);
+        UA_NodeId_deleteMembers(&nodeId);
+        UA_deleteMembers(&decoded, c->attributesType);
+    }
+    if (sCode != UA_STATUSCODE_GOOD)
+        c->failed = true;
+    c->payloadBytes = length;
+}
+
+static int zkUA_benchJsonCodec_run(UA_NodeClass nodeClass,
+        const UA_DataType *type, size_t arrayLength, size_t i) {
+    zkUA_benchJsonCodec_case c;
+    memset(&c, 0, sizeof(c));
+    c.nodeClass = nodeClass;
+    c.attributesType = zkUA_testValues_attributesType(nodeClass);
+    if (!zkUA_testValues_attributes(nodeClass,
+            type ? type : &UA_TYPES[UA_TYPES_INT32], arrayLength, &c.attr)) {
+        fprintf(stderr, "bench_jsonCodec: no test values for %s\n",
+                zkUA_testValues_nodeClassName(nodeClass));
+        return -1;
+    }
+    zkUA_testValues_fill(&UA_TYPES[UA_TYPES_NODEID], i, &c.nodeId);
+
+    char typeName[64] = "null";
+    if (type)
+        snprintf(typeName, sizeof(typeName), "\"%s\"", type->typeName);
+    int failed = 0;
+    for (int pipeline = 0; pipeline < 2; pipeline++) {
+        zkUA_benchResult result;
+        c.treeDecoded = false;
+        c.failed = false;
+        zkUA_bench_run(pipeline ? zkUA_benchJsonCodec_stream :
+                zkUA_benchJsonCodec_tree, &c, ZKUA_BENCHJSONCODEC_SECONDS,
+                ZKUA_BENCHJSONCODEC_ITERATIONS, &result);
+        char parameters[256];
+        snprintf(parameters, sizeof(parameters),
+                "\"pipeline\":\"%s\",\"nodeClass\":\"%s\",\"type\":%s,"
+                        "\"arrayLength\":%zu,\"payloadBytes\":%zu,"
+                        "\"treeDecoded\":%s", pipeline ? "stream" : "tree",
+                zkUA_testValues_nodeClassName(nodeClass), typeName,
+                arrayLength, c.payloadBytes,
+                c.treeDecoded || !pipeline ? "true" : "false");
+        zkUA_bench_print("jsonCodec", parameters, &result);
+        if (c.failed) {
+            fprintf(stderr, "bench_jsonCodec: round trip failed: %s\n",
+                    parameters);
+            failed = -1;
+        }
+    }
+    UA_NodeId_deleteMembers(&c.nodeId);
+    UA_deleteMembers(&c.attr, c.attributesType);
+    return failed;
+}
+
+int main(int argc, char **argv) {
+    size_t maxArrayLength = argc > 1 ? strtoul(argv[1], NULL, 10) : 1000000;
+    int failed = 0;
+    size_t i = 0;
+    zkUA_initializePayloadVersion(ZKUA_PAYLOAD_VERSION);
+    for (size_t c = 0; c < sizeof(nodeClasses) / sizeof(nodeClasses[0]); c++) {
+        if (nodeClasses[c] != UA_NODECLASS_VARIABLE) {
+            /* VariableTypes hold an Int32 scalar */
+            failed |= zkUA_benchJsonCodec_run(nodeClasses[c],
+                    nodeClasses[c] == UA_NODECLASS_VARIABLETYPE ?
+                            &UA_TYPES[UA_TYPES_INT32] : NULL, 0, i++);
+            continue;
+        }
+        for (size_t t = 0; t < ZKUA_TESTVALUES_BUILTIN_TYPES; t++)
+            for (size_t l = 0;
+                    l < sizeof(arrayLengths) / sizeof(arrayLengths[0]); l++)
+                if (arrayLengths[l] <= maxArrayLength)
+                    failed |= zkUA_benchJsonCodec_run(nodeClasses[c],
+                            &UA_TYPES[t], arrayLengths[l], i++);
+    }
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
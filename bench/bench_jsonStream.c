@@ -0,0 +1,207 @@
+/*******************************************************************************
+ * Copyright (C) 2018 Ahmed Ismail <aismail [at] protonmail.com>
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <jansson.h>
+#include <open62541.h>
+#include <zk_payload.h>
+#include <zk_intercept.h>
+#include <zk_jsonScan.h>
+#include <zk_testValues.h>
+#include <zk_testCodec.h>
+#include <zk_bench.h>
+
+/* The payload encoding of a replicated write with the streaming writer
+ (zkUA_encodeNodePayload) against the jansson tree it replaced (zkUA_addNodeJsonPack
+ and json_dumps with JSON_INDENT(1)), for a few usual nodes:
+ unpaced: as many writes as possible, one line with nsPerOp, bytesPerOp, allocsPerOp
+ paced:   writesPerSecond writes (10000 by default) spread evenly over one second,
+          one line with the latency of the writes from their due time to the end of
+          their encoding (p50Ns, p99Ns, maxNs), the share of the second spent
+          encoding (cpuShare) and the writes that started a period late or more
+ Usage: bench_jsonStream [writesPerSecond] */
+
+#define ZKUA_BENCHJSONSTREAM_SECONDS 0.5
+#define ZKUA_BENCHJSONSTREAM_ITERATIONS 1000000
+#define ZKUA_BENCHJSONSTREAM_WRITES_PER_SECOND 10000
+
+typedef struct zkUA_benchJsonStream_node {
+    const char *name;
+    UA_NodeClass nodeClass;
+    UA_UInt16 type; /* of the Variable's value */
+    size_t arrayLength;
+} zkUA_benchJsonStream_node;
+
+static const zkUA_benchJsonStream_node nodes[] = {
+        { "Int32", UA_NODECLASS_VARIABLE, UA_TYPES_INT32, 0 },
+        { "Double", UA_NODECLASS_VARIABLE, UA_TYPES_DOUBLE, 0 },
+        { "String", UA_NODECLASS_VARIABLE, UA_TYPES_STRING, 0 },
+        { "Double[100]", UA_NODECLASS_VARIABLE, UA_TYPES_DOUBLE, 100 },
+        { "Object", UA_NODECLASS_OBJECT, UA_TYPES_INT32, 0 } };
+
+typedef struct zkUA_benchJsonStream_case {
+    UA_NodeClass nodeClass;
+    UA_NodeId nodeId;
+    zkUA_jsonScanAttributes attr;
+    int payloadBytes;
+    UA_Boolean failed;
+} zkUA_benchJsonStream_case;
+
+/* The JSON codec's encoder before it streamed, with the payload header */
+static void zkUA_benchJsonStream_tree(void *context) {
+    zkUA_benchJsonStream_case *c = context;
+    UA_NodeId parent = ZKUA_TESTCODEC_PARENT;
+    UA_NodeId reference = ZKUA_TESTCODEC_REFERENCE;
+    json_t *nodePack = json_object();
+    zkUA_addNodeJsonPack(ZKUA_TESTCODEC_PATH, c->nodeClass, c->nodeId, parent,
+            reference, &c->attr, nodePack);
+    char *s = json_dumps(nodePack, JSON_INDENT(1));
+    json_decref(nodePack);
+    if (s == NULL) {
+        c->failed = true;
+        return;
+    }
+    size_t sLength = strlen(s);
+    char *payload = malloc(ZKUA_PAYLOAD_HEADER_SIZE + sLength + 1);
+    if (payload) {
+        memcpy(payload + ZKUA_PAYLOAD_HEADER_SIZE, s, sLength + 1);
+        c->payloadBytes = (int) (ZKUA_PAYLOAD_HEADER_SIZE + sLength);
+    } else {
+        c->failed = true;
+    }
+    free(s);
+    free(payload);
+}
+
+static void zkUA_benchJsonStream_stream(void *context) {
+    zkUA_benchJsonStream_case *c = context;
+    UA_NodeId parent = ZKUA_TESTCODEC_PARENT;
+    UA_NodeId reference = ZKUA_TESTCODEC_REFERENCE;
+    char *payload = zkUA_encodeNodePayload(ZKUA_TESTCODEC_PATH, c->nodeClass,
+            c->nodeId, parent, reference, &c->attr, &c->payloadBytes);
+    if (payload == NULL)
+        c->failed = true;
+    free(payload);
+}
+
+static int zkUA_benchJsonStream_compareLatency(const void *a, const void *b) {
+    double x = *(const double *) a, y = *(const double *) b;
+    return x < y ? -1 : x > y;
+}
+
+/* Encodes writesPerSecond writes at their due times over one second */
+static int zkUA_benchJsonStream_paced(zkUA_benchOp op,
+        zkUA_benchJsonStream_case *c, size_t writesPerSecond,
+        const char *parameters) {
+    double *latencies = malloc(writesPerSecond * sizeof(double));
+    if (!latencies) {
+        fprintf(stderr, "bench_jsonStream: out of memory\n");
+        return -1;
+    }
+    double period = 1e9 / (double) writesPerSecond;
+    double busy = 0;
+    size_t late = 0, allocations, bytes, startAllocations, startBytes;
+    op(c);
+    zkUA_bench_allocations(&startAllocations, &startBytes);
+    zkUA_bench_countAllocations(1);
+    double start = zkUA_bench_now();
+    for (size_t i = 0; i < writesPerSecond; i++) {
+        double due = start + (double) i * period;
+        double now = zkUA_bench_now();
+        while (now < due)
+            now = zkUA_bench_now();
+        if (now - due >= period)
+            late++;
+        op(c);
+        double end = zkUA_bench_now();
+        busy += end - now;
+        latencies[i] = end - due;
+    }
+    double elapsed = zkUA_bench_now() - start;
+    zkUA_bench_countAllocations(0);
+    zkUA_bench_allocations(&allocations, &bytes);
+    qsort(latencies, writesPerSecond, sizeof(double),
+            zkUA_benchJsonStream_compareLatency);
+    printf("{\"benchmark\":\"jsonStream\",%s,\"writesPerSecond\":%zu,"
+            "\"late\":%zu,\"p50Ns\":%.1f,\"p99Ns\":%.1f,\"maxNs\":%.1f,"
+            "\"cpuShare\":%.4f,\"bytesPerOp\":%.1f,\"allocsPerOp\":%.2f}\n",
+            parameters, writesPerSecond, late,
+            latencies[writesPerSecond / 2],
+            latencies[writesPerSecond * 99 / 100],
+            latencies[writesPerSecond - 1], busy / elapsed,
+            (double) (bytes - startBytes) / (double) writesPerSecond,
+            (double) (allocations - startAllocations)
+                    / (double) writesPerSecond);
+    fflush(stdout);
+    free(latencies);
+    return 0;
+}
+
+static int zkUA_benchJsonStream_run(const zkUA_benchJsonStream_node *node,
+        size_t writesPerSecond, size_t i) {
+    zkUA_benchJsonStream_case c;
+    memset(&c, 0, sizeof(c));
+    c.nodeClass = node->nodeClass;
+    if (!zkUA_testValues_attributes(node->nodeClass, &UA_TYPES[node->type],
+            node->arrayLength, &c.attr)) {
+        fprintf(stderr, "bench_jsonStream: no test values for %s\n",
+                node->name);
+        return -1;
+    }
+    zkUA_testValues_fill(&UA_TYPES[UA_TYPES_NODEID], i, &c.nodeId);
+
+    int failed = 0;
+    for (int encoder = 0; encoder < 2; encoder++) {
+        zkUA_benchOp op = encoder ? zkUA_benchJsonStream_stream :
+                zkUA_benchJsonStream_tree;
+        zkUA_benchResult result;
+        char parameters[128];
+        c.failed = false;
+        zkUA_bench_run(op, &c, ZKUA_BENCHJSONSTREAM_SECONDS,
+                ZKUA_BENCHJSONSTREAM_ITERATIONS, &result);
+        snprintf(parameters, sizeof(parameters),
+                "\"encoder\":\"%s\",\"node\":\"%s\",\"payloadBytes\":%d",
+                encoder ? "stream" : "tree", node->name, c.payloadBytes);
+        zkUA_bench_print("jsonStream", parameters, &result);
+        if (writesPerSecond
+                && zkUA_benchJsonStream_paced(op, &c, writesPerSecond,
+                        parameters) != 0)
+            failed = -1;
+        if (c.failed) {
+            fprintf(stderr, "bench_jsonStream: encoding failed: %s\n",
+                    parameters);
+            failed = -1;
+        }
+    }
+    UA_NodeId_deleteMembers(&c.nodeId);
+    UA_deleteMembers(&c.attr, zkUA_testValues_attributesType(node->nodeClass));
+    return failed;
+}
+
+int main(int argc, char **argv) {
+    size_t writesPerSecond = argc > 1 ?
+            strtoul(argv[1], NULL, 10) : ZKUA_BENCHJSONSTREAM_WRITES_PER_SECOND;
+    int failed = 0;
+    zkUA_initializePayloadFormat(ZKUA_PAYLOAD_JSON);
+    zkUA_initializePayloadVersion(ZKUA_PAYLOAD_VERSION);
+    zkUA_initializePayloadCompression(ZKUA_COMPRESSION_NONE,
+            ZKUA_DEFAULT_COMPRESSION_THRESHOLD);
+    for (size_t i = 0; i < sizeof(nodes) / sizeof(nodes[0]); i++)
+        failed |= zkUA_benchJsonStream_run(&nodes[i], writesPerSecond, i);
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,279 @@
+/*******************************************************************************
+ * Copyright (C) 2018 Ahmed Ismail <aismail [at] protonmail.com>
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <open62541.h>
+#include <zk_mzxidTable.h>
+#include "src/hashtable/hashtable.h"
+#include <zk_bench.h>
+
+/* The mzxid table against the hashtable it replaced (keyed by strdup'd znode paths,
+ with the fixed strcmp key equality), both used the way zk_serverReplicate.c uses
+ them: every operation starts from the znode path of a node.
+ insert: fills an empty table with all nodes and frees it, per node
+ search: looks up a stored node, in random order
+ update: stores a new mzxid and version of a stored node, in random order
+ Usage: bench_mzxidTable [maxNodes] */
+
+#define ZKUA_BENCHMZXIDTABLE_SECONDS 0.2
+#define ZKUA_BENCHMZXIDTABLE_ITERATIONS 10000000
+/* longer than every path written below */
+#define ZKUA_BENCHMZXIDTABLE_PATH_MAX 96
+
+static const size_t nodeCounts[] = { 1000, 100000, 1000000 };
+
+/* Value stored for each znode in the old hashtable */
+typedef struct zkUA_benchMzxidTable_age {
+    long long mzxid;
+    int version;
+} zkUA_benchMzxidTable_age;
+
+typedef struct zkUA_benchMzxidTable_case {
+    size_t nodes;
+    char *paths; /* nodes paths of ZKUA_BENCHMZXIDTABLE_PATH_MAX bytes */
+    size_t *order; /* random permutation of the nodes */
+    size_t next;
+    struct hashtable *hashtable;
+    UA_Boolean failed;
+} zkUA_benchMzxidTable_case;
+
+static const char *zkUA_benchMzxidTable_path(zkUA_benchMzxidTable_case *c,
+        size_t node) {
+    return c->paths + node * ZKUA_BENCHMZXIDTABLE_PATH_MAX;
+}
+
+static size_t zkUA_benchMzxidTable_nextNode(zkUA_benchMzxidTable_case *c) {
+    size_t node = c->order[c->next];
+    c->next = c->next + 1 == c->nodes ? 0 : c->next + 1;
+    return node;
+}
+
+/***** The old hashtable *****/
+
+/* zkUA_hash, source: http://www.cse.yorku.ca/~oz/hash.html */
+static unsigned int zkUA_benchMzxidTable_hash(void *str) {
+    unsigned int hash = 5381;
+    int c;
+    char *string = (char *) str;
+    while ((c = *string++)) {
+        hash = ((hash << 5) + hash) + c; /* hash * 33 + c */
+    }
+    return hash;
+}
+
+static int zkUA_benchMzxidTable_equalKeys(void *k1, void *k2) {
+    return strcmp((char *) k1, (char *) k2) == 0;
+}
+
+/* zkUA_setZnodeMzxid */
+static UA_StatusCode zkUA_benchMzxidTable_hashtableSet(struct hashtable *h,
+        const char *nodeZkPath, long long mzxid, int version) {
+    zkUA_benchMzxidTable_age *val = hashtable_search(h, (void *) nodeZkPath);
+    if (val != NULL) { /* update the stored value in place */
+        val->mzxid = mzxid;
+        val->version = version;
+        return UA_STATUSCODE_GOOD;
+    }
+    char *hashNodeZkPath = strdup(nodeZkPath);
+    val = calloc(1, sizeof(zkUA_benchMzxidTable_age));
+    val->mzxid = mzxid;
+    val->version = version;
+    if (hashtable_insert(h, (void *) hashNodeZkPath, (void *) val) != 0)
+        return UA_STATUSCODE_GOOD;
+    free(hashNodeZkPath);
+    free(val);
+    return UA_STATUSCODE_BADUNEXPECTEDERROR;
+}
+
+static void zkUA_benchMzxidTable_hashtableInsert(void *context) {
+    zkUA_benchMzxidTable_case *c = context;
+    struct hashtable *h = create_hashtable(16, zkUA_benchMzxidTable_hash,
+            zkUA_benchMzxidTable_equalKeys);
+    for (size_t i = 0; i < c->nodes; i++)
+        if (zkUA_benchMzxidTable_hashtableSet(h,
+                zkUA_benchMzxidTable_path(c, i), (long long) i, 0)
+                != UA_STATUSCODE_GOOD)
+            c->failed = true;
+    hashtable_destroy(h, 1);
+}
+
+static void zkUA_benchMzxidTable_hashtableSearch(void *context) {
+    zkUA_benchMzxidTable_case *c = context;
+    size_t node = zkUA_benchMzxidTable_nextNode(c);
+    zkUA_benchMzxidTable_age *val = hashtable_search(c->hashtable,
+            (void *) zkUA_benchMzxidTable_path(c, node));
+    if (!val || val->mzxid != (long long) node)
+        c->failed = true;
+}
+
+static void zkUA_benchMzxidTable_hashtableUpdate(void *context) {
+    zkUA_benchMzxidTable_case *c = context;
+    size_t node = zkUA_benchMzxidTable_nextNode(c);
+    if (zkUA_benchMzxidTable_hashtableSet(c->hashtable,
+            zkUA_benchMzxidTable_path(c, node), (long long) node, 1)
+            != UA_STATUSCODE_GOOD)
+        c->failed = true;
+}
+
+/***** The mzxid table *****/
+
+/* zkUA_setZnodeMzxid */
+static UA_StatusCode zkUA_benchMzxidTable_tableSet(const char *nodeZkPath,
+        long long mzxid, int version) {
+    UA_UInt64 key;
+    if (!zkUA_mzxidTableKeyFromPath(nodeZkPath, &key))
+        return UA_STATUSCODE_BADINVALIDARGUMENT;
+    return zkUA_mzxidTableInsert(key, mzxid, version);
+}
+
+static void zkUA_benchMzxidTable_tableInsert(void *context) {
+    zkUA_benchMzxidTable_case *c = context;
+    zkUA_initializeMzxidTable(ZKUA_MZXIDTABLE_MIN_CAPACITY);
+    for (size_t i = 0; i < c->nodes; i++)
+        if (zkUA_benchMzxidTable_tableSet(zkUA_benchMzxidTable_path(c, i),
+                (long long) i, 0) != UA_STATUSCODE_GOOD)
+            c->failed = true;
+    zkUA_destroyMzxidTable();
+}
+
+static void zkUA_benchMzxidTable_tableSearch(void *context) {
+    zkUA_benchMzxidTable_case *c = context;
+    size_t node = zkUA_benchMzxidTable_nextNode(c);
+    UA_UInt64 key;
+    long long mzxid;
+    if (!zkUA_mzxidTableKeyFromPath(zkUA_benchMzxidTable_path(c, node), &key)
+            || !zkUA_mzxidTableSearch(key, &mzxid, NULL)
+            || mzxid != (long long) node)
+        c->failed = true;
+}
+
+static void zkUA_benchMzxidTable_tableUpdate(void *context) {
+    zkUA_benchMzxidTable_case *c = context;
+    size_t node = zkUA_benchMzxidTable_nextNode(c);
+    if (zkUA_benchMzxidTable_tableSet(zkUA_benchMzxidTable_path(c, node),
+            (long long) node, 1) != UA_STATUSCODE_GOOD)
+        c->failed = true;
+}
+
+/*****/
+
+static int zkUA_benchMzxidTable_print(zkUA_benchMzxidTable_case *c,
+        const char *table, const char *operation, zkUA_benchResult *result) {
+    char parameters[128];
+    snprintf(parameters, sizeof(parameters),
+            "\"table\":\"%s\",\"operation\":\"%s\",\"nodes\":%zu", table,
+            operation, c->nodes);
+    zkUA_bench_print("mzxidTable", parameters, result);
+    if (c->failed) {
+        fprintf(stderr, "bench_mzxidTable: wrong result: %s\n", parameters);
+        return -1;
+    }
+    return 0;
+}
+
+static int zkUA_benchMzxidTable_run(zkUA_benchMzxidTable_case *c) {
+    zkUA_benchResult result;
+    int failed = 0;
+
+    /* one insert run fills a table with all nodes */
+    zkUA_bench_run(zkUA_benchMzxidTable_hashtableInsert, c,
+            ZKUA_BENCHMZXIDTABLE_SECONDS, ZKUA_BENCHMZXIDTABLE_ITERATIONS,
+            &result);
+    result.nsPerOp /= c->nodes;
+    result.bytesPerOp /= c->nodes;
+    result.allocsPerOp /= c->nodes;
+    failed |= zkUA_benchMzxidTable_print(c, "hashtable", "insert", &result);
+    zkUA_bench_run(zkUA_benchMzxidTable_tableInsert, c,
+            ZKUA_BENCHMZXIDTABLE_SECONDS, ZKUA_BENCHMZXIDTABLE_ITERATIONS,
+            &result);
+    result.nsPerOp /= c->nodes;
+    result.bytesPerOp /= c->nodes;
+    result.allocsPerOp /= c->nodes;
+    failed |= zkUA_benchMzxidTable_print(c, "mzxidTable", "insert", &result);
+
+    c->hashtable = create_hashtable(16, zkUA_benchMzxidTable_hash,
+            zkUA_benchMzxidTable_equalKeys);
+    zkUA_initializeMzxidTable(ZKUA_MZXIDTABLE_MIN_CAPACITY);
+    for (size_t i = 0; i < c->nodes; i++) {
+        zkUA_benchMzxidTable_hashtableSet(c->hashtable,
+                zkUA_benchMzxidTable_path(c, i), (long long) i, 0);
+        zkUA_benchMzxidTable_tableSet(zkUA_benchMzxidTable_path(c, i),
+                (long long) i, 0);
+    }
+    zkUA_bench_run(zkUA_benchMzxidTable_hashtableSearch, c,
+            ZKUA_BENCHMZXIDTABLE_SECONDS, ZKUA_BENCHMZXIDTABLE_ITERATIONS,
+            &result);
+    failed |= zkUA_benchMzxidTable_print(c, "hashtable", "search", &result);
+    zkUA_bench_run(zkUA_benchMzxidTable_tableSearch, c,
+            ZKUA_BENCHMZXIDTABLE_SECONDS, ZKUA_BENCHMZXIDTABLE_ITERATIONS,
+            &result);
+    failed |= zkUA_benchMzxidTable_print(c, "mzxidTable", "search", &result);
+    zkUA_bench_run(zkUA_benchMzxidTable_hashtableUpdate, c,
+            ZKUA_BENCHMZXIDTABLE_SECONDS, ZKUA_BENCHMZXIDTABLE_ITERATIONS,
+            &result);
+    failed |= zkUA_benchMzxidTable_print(c, "hashtable", "update", &result);
+    zkUA_bench_run(zkUA_benchMzxidTable_tableUpdate, c,
+            ZKUA_BENCHMZXIDTABLE_SECONDS, ZKUA_BENCHMZXIDTABLE_ITERATIONS,
+            &result);
+    failed |= zkUA_benchMzxidTable_print(c, "mzxidTable", "update", &result);
+    hashtable_destroy(c->hashtable, 1);
+    zkUA_destroyMzxidTable();
+    return failed;
+}
+
+int main(int argc, char **argv) {
+    size_t maxNodes = argc > 1 ? strtoul(argv[1], NULL, 10) : 1000000;
+    int failed = 0;
+    for (size_t n = 0; n < sizeof(nodeCounts) / sizeof(nodeCounts[0]); n++) {
+        if (nodeCounts[n] > maxNodes)
+            continue;
+        zkUA_benchMzxidTable_case c;
+        memset(&c, 0, sizeof(c));
+        c.nodes = nodeCounts[n];
+        c.paths = malloc(c.nodes * ZKUA_BENCHMZXIDTABLE_PATH_MAX);
+        c.order = malloc(c.nodes * sizeof(size_t));
+        if (!c.paths || !c.order) {
+            fprintf(stderr, "bench_mzxidTable: out of memory\n");
+            return EXIT_FAILURE;
+        }
+        /* numeric NodeIds of two namespaces below the address space path of a
+         group, see zkUA_initializeZkServAddSpacePath */
+        for (size_t i = 0; i < c.nodes; i++) {
+            snprintf(c.paths + i * ZKUA_BENCHMZXIDTABLE_PATH_MAX,
+                    ZKUA_BENCHMZXIDTABLE_PATH_MAX,
+                    "/Servers/6f1c2a3e-8d4b-4e5f-9a7c-0b1d2e3f4a5b/AddressSpace/"
+                            "ns=%zu;i=%zu", 1 + i % 2, 1000 + i);
+            c.order[i] = i;
+        }
+        /* Fisher-Yates shuffle with a fixed xorshift generator */
+        UA_UInt64 random = 88172645463325252ULL;
+        for (size_t i = c.nodes - 1; i > 0; i--) {
+            random ^= random << 13;
+            random ^= random >> 7;
+            random ^= random << 17;
+            size_t j = (size_t) (random % (i + 1));
+            size_t tmp = c.order[i];
+            c.order[i] = c.order[j];
+            c.order[j] = tmp;
+        }
+        failed |= zkUA_benchMzxidTable_run(&c);
+        free(c.paths);
+        free(c.order);
+    }
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,103 @@
+/*******************************************************************************
+ * Copyright (C) 2018 Ahmed Ismail <aismail [at] protonmail.com>
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+#include <stdio.h>
+#include <time.h>
+#include <zk_bench.h>
+
+/* The allocator of glibc, the functions below interpose its malloc for the whole
+ process (jansson and open62541 included) */
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t count, size_t size);
+void *__libc_realloc(void *p, size_t size);
+void __libc_free(void *p);
+
+static int counting;
+static size_t allocationCount, allocationBytes;
+
+void *malloc(size_t size) {
+    if (counting) {
+        allocationCount++;
+        allocationBytes += size;
+    }
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t count, size_t size) {
+    if (counting) {
+        allocationCount++;
+        allocationBytes += count * size;
+    }
+    return __libc_calloc(count, size);
+}
+
+void *realloc(void *p, size_t size) {
+    if (counting) {
+        allocationCount++;
+        allocationBytes += size;
+    }
+    return __libc_realloc(p, size);
+}
+
+void free(void *p) {
+    __libc_free(p);
+}
+
+void zkUA_bench_countAllocations(int count) {
+    counting = count;
+}
+
+void zkUA_bench_allocations(size_t *allocations, size_t *bytes) {
+    *allocations = allocationCount;
+    *bytes = allocationBytes;
+}
+
+double zkUA_bench_now(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (double) t.tv_sec * 1e9 + (double) t.tv_nsec;
+}
+
+void zkUA_bench_run(zkUA_benchOp op, void *context, double minSeconds,
+        size_t maxIterations, zkUA_benchResult *result) {
+    size_t allocations, bytes, startAllocations, startBytes;
+    op(context);
+    zkUA_bench_allocations(&startAllocations, &startBytes);
+    zkUA_bench_countAllocations(1);
+    double start = zkUA_bench_now(), end = start;
+    size_t i = 0;
+    while (i < maxIterations && (i == 0 || end - start < minSeconds * 1e9)) {
+        op(context);
+        i++;
+        end = zkUA_bench_now();
+    }
+    zkUA_bench_countAllocations(0);
+    zkUA_bench_allocations(&allocations, &bytes);
+    result->iterations = i;
+    result->nsPerOp = (end - start) / (double) i;
+    result->bytesPerOp = (double) (bytes - startBytes) / (double) i;
+    result->allocsPerOp = (double) (allocations - startAllocations)
+            / (double) i;
+}
+
+void zkUA_bench_print(const char *benchmark, const char *parameters,
+        const zkUA_benchResult *result) {
+    printf("{\"benchmark\":\"%s\",%s,\"iterations\":%zu,\"nsPerOp\":%.1f,"
+            "\"bytesPerOp\":%.1f,\"allocsPerOp\":%.2f}\n", benchmark,
+            parameters, result->iterations, result->nsPerOp,
+            result->bytesPerOp, result->allocsPerOp);
+    fflush(stdout);
+}
@@ -0,0 +1,61 @@
+/*******************************************************************************
+ * Copyright (C) 2018 Ahmed Ismail <aismail [at] protonmail.com>
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+#include <stddef.h>
+
+/***** Benchmark harness *****/
+
+/* Benchmarks print one JSON object per line and case: the parameters of the case
+ followed by iterations, nsPerOp, bytesPerOp (allocated) and allocsPerOp */
+
+typedef struct zkUA_benchResult {
+    size_t iterations;
+    double nsPerOp;
+    double bytesPerOp;
+    double allocsPerOp;
+} zkUA_benchResult;
+
+typedef void (*zkUA_benchOp)(void *context);
+
+/**
+ * zkUA_bench_now:
+ * Returns the CLOCK_MONOTONIC time in nanoseconds.
+ */
+double zkUA_bench_now(void);
+
+/**
+ * zkUA_bench_run:
+ * Runs op once to warm up, then repeatedly until minSeconds have passed or
+ * maxIterations runs are done, and averages its time and allocations.
+ */
+void zkUA_bench_run(zkUA_benchOp op, void *context, double minSeconds,
+        size_t maxIterations, zkUA_benchResult *result);
+
+/**
+ * zkUA_bench_countAllocations:
+ * Starts (true) or stops counting the allocations of the calling process. Every
+ * malloc, calloc and realloc counts as one allocation of the requested size.
+ */
+void zkUA_bench_countAllocations(int count);
+void zkUA_bench_allocations(size_t *allocations, size_t *bytes);
+
+/**
+ * zkUA_bench_print:
+ * Prints the JSON line of a case, parameters are its members before the results,
+ * e.g. "\"pipeline\":\"tree\"".
+ */
+void zkUA_bench_print(const char *benchmark, const char *parameters,
+        const zkUA_benchResult *result);
@@ -34,6 +34,8 @@
 #include <zk_cli.h>
 #include <zk_global.h>
 #include <zk_clientReplicate.h>
+#include <zk_payload.h>
+#include <zk_payloadStore.h>
 
 /**
  * ZooKeeper libraries
@@ -121,8 +123,32 @@ static void init_UA_client(void* retval, zkUA_Config *zkUAConfigs) {
     char *groupGuid = calloc(65535, sizeof(char));
     snprintf(groupGuid, 65535, UA_PRINTF_GUID_FORMAT,
             UA_PRINTF_GUID_DATA(zkUAConfigs->guid));
+    /* Open the additional sessions of a parallel crawl */
+    UA_Client **clients = calloc(zkUAConfigs->crawlSessions,
+            sizeof(UA_Client *));
+    clients[0] = client;
+    size_t clientsSize = 1;
+    for (; clientsSize < zkUAConfigs->crawlSessions; clientsSize++) {
+        UA_Client *session = UA_Client_new(UA_ClientConfig_standard);
+        if (UA_Client_connect_username(session, serverDst,
+                zkUAConfigs->username, zkUAConfigs->password)
+                != UA_STATUSCODE_GOOD) {
+            fprintf(stderr,
+                    "init_UA_Client: Could only open %lu of %lu crawl sessions\n",
+                    clientsSize, zkUAConfigs->crawlSessions);
+            UA_Client_delete(session);
+            break;
+        }
+        clients[clientsSize] = session;
+    }
     /* Call function to browse full root folder and push it to zk */
-    zkUA_UAServerAddressSpace(zh, client, serverDst, groupGuid);
+    zkUA_UAServerAddressSpace_parallel(zh, clients, clientsSize, serverDst,
+            groupGuid);
+    for (size_t i = 1; i < clientsSize; i++) {
+        UA_Client_disconnect(clients[i]);
+        UA_Client_delete(clients[i]);
+    }
+    free(clients);
 
     UA_Client_disconnect(client);
     free(groupGuid);
@@ -136,6 +162,12 @@ int main() {
     /* Read the config file */
     zkUA_Config zkUAConfigs;
     zkUA_readConfFile("clientConf.txt", &zkUAConfigs);
+    /* the crawled nodes are pushed in the configured payload format */
+    zkUA_initializePayloadFormat(zkUAConfigs.payloadFormat);
+    zkUA_initializePayloadVersion(zkUAConfigs.payloadVersion);
+    zkUA_initializePayloadCompression(zkUAConfigs.payloadCompression,
+            zkUAConfigs.compressionThreshold);
+    zkUA_initializeChunkSize(zkUAConfigs.chunkSize);
 
     /* Initialize zk client */
     char buffer[4096];
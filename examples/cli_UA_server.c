@@ -35,6 +35,11 @@
 #include <zk_serverReplicate.h>
 #include <zk_global.h>
 #include <zk_intercept.h>
+#include <zk_payload.h>
+#include <zk_payloadStore.h>
+#include <zk_deltaReplicate.h>
+#include <zk_valueReplicate.h>
+#include <zk_znodePath.h>
 #include <pthread.h>
 
 /**
@@ -247,20 +252,28 @@ static void zkUA_addressSpaceWatcher(zhandle_t *zzh, int type, int state,
         char *termPath = calloc(65535, sizeof(char));
         snprintf(termPath, 65535, "%s", path);
 
-        if (type == ZOO_DELETED_EVENT) {
+        if (zkUA_isValueZnodePath(termPath) == true) {
+            /* A node's value was written - only the value is applied.
+             The value znode is only deleted together with its node. */
+            if (type == ZOO_CHANGED_EVENT || type == ZOO_CREATED_EVENT)
+                zkUA_applyNodeValue(termPath, server);
+        } else if (zkUA_isDeltaLogPath(termPath) == true) {
+            /* Deltas were logged for a node - write them into its local value.
+             The log is only deleted together with its node. */
+            if (type == ZOO_CHANGED_EVENT || type == ZOO_CREATED_EVENT)
+                zkUA_applyNodeDeltas(termPath, server);
+        } else if (type == ZOO_DELETED_EVENT) {
             /* A node was deleted */
-            /* Extract the nsIndex and nodeId */
-            char *storeNs = calloc(65535, sizeof(char));
-            char *storeId = calloc(65535, sizeof(char));
-            zkUA_extractNsIndexNodeId(&termPath, storeNs, storeId);
-            long long ns, id;
-            ns = strtoll(storeNs, NULL, 10);
-            id = strtoll(storeId, NULL, 10);
-            fprintf(stderr,
-                    "zkUA_addressSpaceWatcher: Deleting node ns=%lu id=%lu\n",
-                    ns, id);
-            sCode = zkUA_UA_Server_deleteNode_dontReplicate(server,
-                    UA_NODEID_NUMERIC(ns, id), true /* delete references */);
+            /* Parse the NodeId from the znode name */
+            UA_Byte identifier[ZKUA_ZNODE_NAME_MAX];
+            UA_NodeId nodeId;
+            if (zkUA_parseZnodeName(termPath, &nodeId, identifier,
+                    sizeof(identifier))) {
+                fprintf(stderr, "zkUA_addressSpaceWatcher: Deleting node %s\n",
+                        termPath);
+                sCode = zkUA_UA_Server_deleteNode_dontReplicate(server, nodeId,
+                        true /* delete references */);
+            }
         } else if (type == ZOO_CHANGED_EVENT) {
             /* A node was modified - get the node, decode and try to add it's values and */
             fprintf(stderr,
@@ -268,16 +281,17 @@ static void zkUA_addressSpaceWatcher(zhandle_t *zzh, int type, int state,
                     termPath);
             zkUA_jsonDecode_zkNode(termPath, server); /* gets the path's data and checks the hashtable */
         } else if (type == ZOO_CHILD_EVENT) {
-            /* A node was created/deleted */
+            /* A node was created/deleted - only the difference to the known children is replicated */
             zkUA_UA_Server_replicateZk(zzh, zkUA_zkServAddSpacePath(), server);
             fprintf(stderr,
-                    "zkUA_addressSpaceWatcher: A node was created or deleted under %s - replicating full addressSpace\n",
+                    "zkUA_addressSpaceWatcher: A node was created or deleted under %s - replicating added and removed nodes\n",
                     termPath);
         }
         free(termPath);
     }
     fprintf(stderr, "\n");
     if (type == ZOO_SESSION_EVENT) {
+        zkUA_updateSessionState(state);
         if (state == ZOO_CONNECTED_STATE) {
             const clientid_t *id = zoo_client_id(zzh);
             if (myid.client_id == 0 || myid.client_id != id->client_id) {
@@ -309,7 +323,26 @@ static void init_UA_Server(void *retval, zkUA_Config *zkUAConfigs) {
     free(groupGuid);
     /* Initialize the hashmap that holds nodes' mZxid's */
     zkUA_initializeHashmap();
+    /* Initialize the index of each node's parent */
+    zkUA_initializeParentIndex();
     zkUA_initializeAvailabilityPriority(zkUAConfigs->aPriority);
+    zkUA_initializeReadConsistency(zkUAConfigs->readConsistency);
+    zkUA_initializeTransactionalWrites(zkUAConfigs->transactionalWrites);
+    if (zkUAConfigs->replicationWindow > 0)
+        zkUA_initializeReplicationWindow(zkUAConfigs->replicationWindow);
+    zkUA_initializeBootstrapPipeline(zkUAConfigs->bootstrapPipelineDepth);
+    zkUA_initializePayloadFormat(zkUAConfigs->payloadFormat);
+    zkUA_initializePayloadVersion(zkUAConfigs->payloadVersion);
+    zkUA_initializePayloadCompression(zkUAConfigs->payloadCompression,
+            zkUAConfigs->compressionThreshold);
+    zkUA_initializeChunkSize(zkUAConfigs->chunkSize);
+    zkUA_initializeDeltaCompaction(zkUAConfigs->deltaCompaction);
+    zkUA_initializeValueZnodes(zkUAConfigs->valueZnodes);
+    for (size_t nsCnt = 0; nsCnt < zkUAConfigs->nsReadConsistencySize;
+            nsCnt++)
+        zkUA_setNamespaceReadConsistency(
+                zkUAConfigs->nsReadConsistency[nsCnt].nsIndex,
+                zkUAConfigs->nsReadConsistency[nsCnt].level);
     /* Check if the address space exists */
     struct String_vector strings;
     int rc = zoo_get_children(zh, zkUA_zkServAddSpacePath(), 0, &strings);
@@ -370,6 +403,7 @@ static void init_UA_Server(void *retval, zkUA_Config *zkUAConfigs) {
     UA_Server_delete(server);
     nl.deleteMembers(&nl);
     zkUA_destroyHashtable();
+    zkUA_destroyParentIndex();
     free_zkUAConfigs(zkUAConfigs);
     fprintf(stderr, "init_UA_Server: Exiting with code %d\n", statuscode);
 }
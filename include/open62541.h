@@ -9898,6 +9898,14 @@ extern void UA_EXPORT zkUA_Service_Write(UA_Server *server, UA_Session *session,
 void _Service_Write(UA_Server *server, UA_Session *session,
                    const UA_WriteRequest *request,
                    UA_WriteResponse *response);
+/* Intercepting Service_Read */
+extern void UA_EXPORT zkUA_Service_Read(UA_Server *server, UA_Session *session,
+                  const UA_ReadRequest *request,
+                  UA_ReadResponse *response);
+#define Service_Read zkUA_Service_Read
+void _Service_Read(UA_Server *server, UA_Session *session,
+                  const UA_ReadRequest *request,
+                  UA_ReadResponse *response);
 /* Intercepting Service_Read_single */
 extern void UA_EXPORT zkUA_Service_Read_single(UA_Server *server, UA_Session *session,
                          const UA_TimestampsToReturn timestamps,
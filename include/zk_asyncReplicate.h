@@ -0,0 +1,85 @@
+/*******************************************************************************
+ * Copyright (C) 2018 Ahmed Ismail <aismail [at] protonmail.com>
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+#include <pthread.h>
+#include <open62541.h>
+#include <zookeeper.h>
+
+/* Default number of replication requests that may be outstanding on zk at once */
+#define ZKUA_DEFAULT_REPLICATION_WINDOW 64
+/* Number of times a synchronous write is attempted if the znode changed concurrently */
+#define ZKUA_MAX_WRITE_ATTEMPTS 3
+
+/**
+ * zkUA_replicationDone:
+ * Called once the replication of a node has been acknowledged (rc == ZOK) or has
+ * failed. Runs on the zk completion thread unless the request could not be submitted.
+ */
+typedef void (*zkUA_replicationDone)(int rc, void *context);
+
+/**
+ * zkUA_ReplicationBatch:
+ * Tracks a group of asynchronous replication requests, e.g. all nodes of one
+ * WriteRequest, so that the caller can wait for all of their acknowledgements.
+ */
+typedef struct zkUA_ReplicationBatch {
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    size_t pending;
+    size_t failed;
+} zkUA_ReplicationBatch;
+
+/**
+ * zkUA_initializeReplicationWindow:
+ * Sets the maximum number of replication requests in flight on zk
+ * (ReplicationWindow config parameter).
+ */
+void zkUA_initializeReplicationWindow(size_t window);
+
+/**
+ * zkUA_ReplicationBatch_init:
+ * Initializes an empty batch.
+ */
+void zkUA_ReplicationBatch_init(zkUA_ReplicationBatch *batch);
+
+/**
+ * zkUA_ReplicationBatch_deleteMembers:
+ * Destroys the synchronization members of a batch that has no pending requests.
+ */
+void zkUA_ReplicationBatch_deleteMembers(zkUA_ReplicationBatch *batch);
+
+/**
+ * zkUA_ReplicationBatch_wait:
+ * Blocks until every request of the batch has completed.
+ * Returns the number of requests that failed.
+ * Must not be called from the zk completion thread.
+ */
+size_t zkUA_ReplicationBatch_wait(zkUA_ReplicationBatch *batch);
+
+/**
+ * zkUA_replicateAsync:
+ * Pushes an encoded node to its znode without waiting for zk: sets the znode's data
+ * expecting the version last seen for it and creates the znode if it does not exist,
+ * then updates the node's mzxid and version and calls done. If another server
+ * modified or created the znode in the meantime done is called with ZBADVERSION or
+ * ZNODEEXISTS: the payload can't be resent as it would overwrite that update, the
+ * caller has to merge it into the znode first (see zkUA_UA_Server_write).
+ * Blocks only while the replication window is full.
+ * Takes ownership of nodePath and payload (both are free'd once the request completes).
+ */
+UA_StatusCode zkUA_replicateAsync(zkUA_ReplicationBatch *batch, char *nodePath,
+        char *payload, int payloadLen, zkUA_replicationDone done,
+        void *context);
@@ -0,0 +1,96 @@
+/*******************************************************************************
+ * Copyright (C) 2018 Ahmed Ismail <aismail [at] protonmail.com>
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+#include <pthread.h>
+#include <open62541.h>
+#include <zookeeper.h>
+
+/* Most bytes of znode paths and data sent in one zoo_multi. Leaves room for the
+ request overhead below ZooKeeper's default 1 MB jute.maxbuffer. */
+#define ZKUA_BULK_BATCH_BYTES 1000000
+/* Estimated bytes a create op adds to a zoo_multi besides its path and data
+ (op header, ACL and flags) */
+#define ZKUA_BULK_OP_OVERHEAD 64
+/* Most create ops in one zoo_multi */
+#define ZKUA_BULK_BATCH_OPS 1000
+/* Default number of zoo_multi batches that may be outstanding on zk at once */
+#define ZKUA_DEFAULT_BULK_BATCHES_IN_FLIGHT 8
+/* Number of times a batch sent on its own may fail without an op error (e.g. on a
+ connection loss) before its znodes are given up */
+#define ZKUA_BULK_MAX_ATTEMPTS 5
+
+typedef struct zkUA_BulkBatch zkUA_BulkBatch;
+
+/**
+ * zkUA_BulkPublisher:
+ * Creates many znodes with few requests: the znodes are grouped into zoo_multi
+ * batches in the order they are added, and several batches are sent asynchronously
+ * at once. A znode must be added after its parent, so that the batch creating the
+ * parent reaches zk first (a batch sent later may still create the children).
+ * Since a zoo_multi is all or nothing, a batch that fails creates none of its znodes.
+ * Later batches are sent only once every batch in flight has completed and the
+ * failed ones have been repaired and sent again in order, i.e. the publisher
+ * resumes after the last committed batch. Znodes that exist already are left as they
+ * are, as with a single create.
+ * Nodes may be added from several threads, but not from the zk completion thread.
+ */
+typedef struct zkUA_BulkPublisher {
+    zhandle_t *zh;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    zkUA_BulkBatch *open; /* the batch being filled */
+    zkUA_BulkBatch *failed; /* completed batches that failed, in order */
+    size_t sequence; /* of the next batch */
+    size_t inFlight;
+    size_t maxInFlight;
+    UA_Boolean resuming; /* failed batches are being sent again */
+    size_t committed; /* znodes created */
+    size_t dropped; /* znodes that could not be created */
+} zkUA_BulkPublisher;
+
+/**
+ * zkUA_BulkPublisher_init:
+ * Initializes a publisher of znodes on zh with up to batchesInFlight outstanding
+ * batches (the default if 0).
+ */
+void zkUA_BulkPublisher_init(zkUA_BulkPublisher *publisher, zhandle_t *zh,
+        size_t batchesInFlight);
+
+/**
+ * zkUA_BulkPublisher_create:
+ * Adds the creation of a znode with the given data to the open batch and sends the
+ * batch once it is full. Blocks while the maximum number of batches is in flight.
+ * Data too large for a batch is written to chunk znodes first (see
+ * zkUA_storeNodePayload, which uses zkHandle) after draining the publisher, and only
+ * its manifest is set in the batch; if that fails the znode is given up.
+ * Takes ownership of data (free'd once the batch has completed), the path is copied.
+ */
+void zkUA_BulkPublisher_create(zkUA_BulkPublisher *publisher, const char *path,
+        char *data, int dataLength);
+
+/**
+ * zkUA_BulkPublisher_flush:
+ * Sends the open batch and blocks until every batch has been committed or given up.
+ * Returns the number of znodes that could not be created.
+ * Must not be called from the zk completion thread.
+ */
+size_t zkUA_BulkPublisher_flush(zkUA_BulkPublisher *publisher);
+
+/**
+ * zkUA_BulkPublisher_deleteMembers:
+ * Flushes a publisher and destroys its members.
+ */
+void zkUA_BulkPublisher_deleteMembers(zkUA_BulkPublisher *publisher);
@@ -18,11 +18,37 @@
 #include "src/hashtable/hashtable.h"
 #include <open62541.h>
 
+/* Read consistency levels for intercepted reads (ReadConsistency config parameter) */
+#define ZKUA_READ_LOCAL 0 /* always serve reads from the local cache */
+#define ZKUA_READ_SESSION 1 /* serve reads from the local cache while the zk session is connected */
+#define ZKUA_READ_LINEARIZABLE 2 /* sync with the zk leader before serving reads from the local cache */
+/* Maximum number of per-namespace read consistency overrides (ReadConsistencyNs config parameter) */
+#define ZKUA_MAX_NSREADCONSISTENCY 16
+
+typedef struct zkUA_NsReadConsistency {
+    UA_UInt16 nsIndex;
+    int level;
+} zkUA_NsReadConsistency;
+
 typedef struct zkUA_Config {
     long int uaPort;
     int rSupport;
     int state;
     UA_Boolean aPriority;
+    int readConsistency;
+    size_t nsReadConsistencySize;
+    zkUA_NsReadConsistency nsReadConsistency[ZKUA_MAX_NSREADCONSISTENCY];
+    size_t replicationWindow;
+    size_t bootstrapPipelineDepth;
+    int payloadFormat;
+    int payloadVersion;
+    int payloadCompression;
+    size_t compressionThreshold;
+    size_t chunkSize;
+    size_t deltaCompaction;
+    UA_Boolean valueZnodes;
+    UA_Boolean transactionalWrites;
+    size_t crawlSessions;
     char *hostname;
     char *username;
     char *password;
@@ -37,36 +63,45 @@ typedef struct zkUA_Config {
  */
 void zkUA_initializeUaServerGlobal(void *server);
 
-/** MZXID HASHTABLE FUNCTIONS: **/
+/** ZOOKEEPER SESSION STATE FUNCTIONS: **/
 
 /**
- * zkUA_destroyHashtable:
- * Deletes the mzxid hashtable while free'ing all remaining values in the hashtable.
+ * zkUA_updateSessionState:
+ * Records the session state delivered with a ZOO_SESSION_EVENT.
+ * Must be called by every watcher that receives session events.
  */
-void zkUA_destroyHashtable();
+void zkUA_updateSessionState(int state);
+/**
+ * zkUA_getSessionState:
+ * Returns the last session state recorded by zkUA_updateSessionState,
+ * or 0 if no session event has been received yet.
+ */
+int zkUA_getSessionState();
 /**
- * zkUA_returnHashtable:
- * A getter function for the mzxid hashtable.
+ * zkUA_sessionConnected:
+ * Returns true if the last recorded session state is ZOO_CONNECTED_STATE.
+ * Does not contact the ZooKeeper ensemble, so it is cheap enough for the read path.
  */
-void *zkUA_returnHashtable();
+UA_Boolean zkUA_sessionConnected();
 /**
- * zkUA_hash:
- * This function is sourced from: http://www.cse.yorku.ca/~oz/hash.html
- * Creates a hash from a string for use as the key in the mzxid hashtable.
- * The string supplied for the hashtable is the OPC UA node's path on zookeeper.
+ * zkUA_onCompletionThread:
+ * Returns true if called from the thread that the zk client library runs watchers and
+ * asynchronous completions on. Code on that thread must not wait for an asynchronous
+ * completion as it would never be delivered.
  */
-unsigned int zkUA_hash(void *str);
+UA_Boolean zkUA_onCompletionThread();
+
+/** MZXID TABLE FUNCTIONS: **/
+
 /**
- * zkUA_equalKeys
- * Function for determining if two keys are equal.
- * For use with the mzxid hashtable.
+ * zkUA_destroyHashtable:
+ * Deletes the mzxid table (see zk_mzxidTable.h).
  */
-int zkUA_equalKeys(void *k1, void *k2);
+void zkUA_destroyHashtable();
 /**
  * zkUA_initializeHashmap:
- * Creates the mzxid hashtable with a minimum initial size of 16.
- * The hashing function is zkUA_hash.
- * The function used to determine key equality is zkUA_equalKeys.
+ * Creates the mzxid table, which maps each node's packed (namespace index, identifier)
+ * to the mzxid and version of its znode.
  */
 void zkUA_initializeHashmap();
 
@@ -78,8 +113,8 @@ void zkUA_initializeHashmap();
 char *zkUA_zkServAddSpacePath();
 /**
  * zkUA_encodeZnodePath:
- * Creates a string with the path for an OPC UA node on ZooKeeper.
- * TODO: Support different identifier types. Currently only supports numeric identifiers.
+ * Creates a string with the path for an OPC UA node on ZooKeeper (see zk_znodePath.h
+ * for the znode names). The caller frees it; NULL if it can't be formatted.
  */
 char *zkUA_encodeZnodePath(const UA_NodeId *nodeId);
 /**
@@ -102,6 +137,12 @@ void free_zkUAConfigs(zkUA_Config *zkUAConfigs);
  * struct.
  */
 void zkUA_readConfFile(char *confFileName, zkUA_Config *zkUAConfigs);
+/**
+ * zkUA_readConsistencyFromString:
+ * Decodes a read consistency level (local, session or linearizable) from a
+ * config file value. Returns -1 if the value is not a known level.
+ */
+int zkUA_readConsistencyFromString(const char *level);
 /**
  * zkUA_cleanStdoutFromCommand:
  * Source: http://www.linuxquestions.org/questions/programming-9/c-c-popen-launch-process-in-specific-directory-620305/
@@ -22,6 +22,22 @@
 #include <jansson.h>
 #include <zk_jsonEncode.h>
 
+/* Most ReadValueIds sent in one ReadRequest if the server does not set a lower
+ MaxNodesPerRead */
+#define ZKUA_DEFAULT_MAX_NODES_PER_READ 1000
+/* Most nodes browsed in one BrowseRequest if the server does not set a lower
+ MaxNodesPerBrowse */
+#define ZKUA_DEFAULT_MAX_NODES_PER_BROWSE 1000
+/* References requested per node and BrowseRequest, the rest is fetched with BrowseNext */
+#define ZKUA_MAX_REFERENCES_PER_BROWSE 1000
+/* Nodes whose attributes are read and pushed to zk together */
+#define ZKUA_CRAWL_BATCH_NODES 512
+/* Nodes a session of a parallel crawl takes from its deque (or steals) at once */
+#define ZKUA_CRAWL_SESSION_BATCH 64
+/* A parallel crawl browses with one session until its frontier holds this many
+ nodes per session */
+#define ZKUA_CRAWL_SEED_NODES_PER_SESSION 4
+
 /* New struct to store the nodeID and browsePath (on zk) of a node */
 typedef struct zkUA_NodeId {
     UA_NodeId *node;
@@ -35,13 +51,12 @@ typedef struct zkUA_NodeId {
  */
 void zkUA_initRecursive(UA_Client *UAclient);
 
-/**
- * zkUA_checkduplicate:
- * Diagnostics function to ensure that the recursive browse function
- * (zkUA_BrowseFolder_recursive) does not browse a node in the address
- * space of an OPC UA Server more than once.
- */
-void zkUA_checkduplicate();
+/* A node whose attributes are read by zkUA_ReadAttributesBatch */
+typedef struct zkUA_AttributeRead {
+    const UA_NodeId *nodeId;
+    UA_NodeClass nodeClass;
+    void *attributes; /* the nodeClass's attributes struct, initialized */
+} zkUA_AttributeRead;
 
 /**
  * zkUA_ReadAttributes:
@@ -54,12 +69,20 @@ void zkUA_checkduplicate();
 void zkUA_ReadAttributes(UA_Client *UAclient, UA_ReferenceDescription *childRef,
         void *attributes);
 
+/**
+ * zkUA_ReadAttributesBatch:
+ * Reads all of the attributes of many nodes with as few ReadRequests as the
+ * server's MaxNodesPerRead allows and stores them in each node's attributes struct.
+ * Attributes the server can't return are left as initialized.
+ * Returns the status of the first request that failed.
+ */
+UA_StatusCode zkUA_ReadAttributesBatch(UA_Client *UAclient,
+        zkUA_AttributeRead *reads, size_t readsSize);
+
 /**
  * zkUA_BrowseFolder:
  * Uses open62541 code from examples/client.c as a starting point.
- * The code browses a node and prints out the results if it has children
- * If the node has no children it remains silent.
- * Returns the browse response.
+ * The code browses a node and returns the browse response.
  */
 void zkUA_BrowseFolder(UA_Client *client, UA_NodeId *browseNode,
         UA_BrowseResponse *bResp);
@@ -71,17 +94,30 @@ void zkUA_BrowseFolder(UA_Client *client, UA_NodeId *browseNode,
 int zkUA_hierarchicalReference(int identifierNumeric);
 
 /**
- * zkUA_BrowseFolder_recursive:
- * Recursively browses down a tree (forward direction only),
- * following hierarchical references only, until it exhausts the entire graph
- * (basically it's a depth first search algorithm for an OPC UA Server's
- * address space).
+ * zkUA_BrowseFolder_breadthFirst:
+ * Browses down a tree (forward direction only) level by level, until it exhausts
+ * the entire graph (basically it's a breadth first search algorithm for an OPC UA
+ * Server's address space). Each level is browsed with BrowseRequests of many nodes,
+ * followed by BrowseNext for references returned in parts, and the attributes of
+ * the new nodes are read in batches.
  * The function encodes every unique node browsed with its attributes into a JSON file.
- * The resulting JSON file is pushed to the ZooKeeper-stored address space.
+ * The resulting JSON file is pushed to the ZooKeeper-stored address space, where the
+ * nodes are created with batched zoo_multis (see zk_bulkPublish.h).
  */
-UA_StatusCode
-zkUA_BrowseFolder_recursive(UA_NodeId childId, UA_Boolean isInverse,
-        UA_NodeId referenceTypeId, void *handle);
+void zkUA_BrowseFolder_breadthFirst(UA_Client *UAclient, const zkUA_NodeId *root);
+
+/**
+ * zkUA_BrowseFolder_parallel:
+ * Browses a tree like zkUA_BrowseFolder_breadthFirst with several sessions to the
+ * same server, each on its own thread. The first levels are browsed with one session
+ * until the frontier can be dealt out to the sessions' work-stealing deques: each
+ * session browses nodes from the back of its deque, pushes the new children onto it,
+ * and steals from the front of the other deques once its own is empty.
+ * All sessions push to the same zk handle and share one set of visited nodes.
+ * With a single session this is zkUA_BrowseFolder_breadthFirst.
+ */
+void zkUA_BrowseFolder_parallel(UA_Client **UAclients, size_t UAclientsSize,
+        const zkUA_NodeId *root);
 
 /**
  * zkUA_UAServerAddressSpace:
@@ -89,3 +125,11 @@ zkUA_BrowseFolder_recursive(UA_NodeId childId, UA_Boolean isInverse,
  */
 void zkUA_UAServerAddressSpace(zhandle_t *zh, UA_Client *client,
         char *serverAddress, char *groupGuid);
+
+/**
+ * zkUA_UAServerAddressSpace_parallel:
+ * Like zkUA_UAServerAddressSpace, but browses the server with clientsSize
+ * connected sessions in parallel (see zkUA_BrowseFolder_parallel).
+ */
+void zkUA_UAServerAddressSpace_parallel(zhandle_t *zh, UA_Client **clients,
+        size_t clientsSize, char *serverAddress, char *groupGuid);
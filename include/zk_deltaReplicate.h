@@ -0,0 +1,82 @@
+/*******************************************************************************
+ * Copyright (C) 2018 Ahmed Ismail <aismail [at] protonmail.com>
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+#include <open62541.h>
+#include <zookeeper.h>
+
+/* Name of the znode below a node's znode that holds its delta log */
+#define ZKUA_DELTA_LOG_NAME "delta"
+/* Default number of deltas logged before the node is written in full
+ (DeltaCompaction config parameter) */
+#define ZKUA_DEFAULT_DELTA_COMPACTION 32
+
+/**
+ * Delta logs:
+ * A write of an IndexRange of a Variable's value is replicated as a delta record
+ * appended to the node's delta log znode instead of re-encoding the whole node. The
+ * log holds the payload header (binary format, ZKUA_PAYLOAD_DELTA flag), the NodeId,
+ * the version of the node's znode its records apply to and the UA Binary encoded
+ * (IndexRange, Variant) records since the node's znode was last written. Once the log
+ * holds DeltaCompaction records the next writer applies them to its copy of the node,
+ * writes the node in full and empties the log in one zoo_multi. Replicas watch the
+ * log and write its records into the local value in order once their copy of the node
+ * has that version. Applying a log again is harmless as its records overwrite their
+ * ranges in the same order.
+ */
+
+/**
+ * zkUA_initializeDeltaCompaction:
+ * Sets the number of deltas logged before a node is written in full. 0 disables delta
+ * replication.
+ */
+void zkUA_initializeDeltaCompaction(size_t records);
+
+/**
+ * zkUA_isDeltaWrite:
+ * Returns true if a write can be replicated as a delta (a write of an IndexRange of
+ * the Value attribute while delta replication is enabled).
+ */
+UA_Boolean zkUA_isDeltaWrite(const UA_WriteValue *value);
+
+/**
+ * zkUA_replicateDelta:
+ * Appends a write that was applied to the local cache to the delta log of its node,
+ * compacting the log if it is full. Returns UA_STATUSCODE_BADNOTSUPPORTED if the
+ * write has to be replicated in full instead, e.g. as the version of the node's znode
+ * is unknown.
+ */
+UA_StatusCode zkUA_replicateDelta(UA_Server *server,
+        const UA_WriteValue *value);
+
+/**
+ * zkUA_isDeltaLogPath:
+ * Returns true if a znode path is the delta log of a node.
+ */
+UA_Boolean zkUA_isDeltaLogPath(const char *path);
+
+/**
+ * zkUA_watchNodeDeltas:
+ * Sets a watch on the delta log of the node at nodePath and applies the log if it
+ * holds records. Does not wait for zk.
+ */
+void zkUA_watchNodeDeltas(const char *nodePath);
+
+/**
+ * zkUA_applyNodeDeltas:
+ * Reads a delta log (setting a watch on it) and writes its records into the local
+ * values of its node without replicating them.
+ */
+UA_StatusCode zkUA_applyNodeDeltas(const char *logPath, UA_Server *server);
@@ -20,5 +20,4 @@
 //extern char zkUA_zkServerAddressSpacePath[1024];
 extern UA_Boolean replicateNode;
 extern zhandle_t *zkHandle;
-extern struct hashtable *nodeMzxid;
 extern UA_Server *uaServerGlobal;
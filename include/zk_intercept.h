@@ -17,6 +17,7 @@
 #include <open62541.h>
 #include <zookeeper.h>
 #include <jansson.h>
+#include <zk_asyncReplicate.h>
 
 /***** INTERCEPTED FUNCTIONS *****/
 
@@ -48,17 +49,34 @@ UA_StatusCode zkUA_UA_Server_deleteNode_dontReplicate(UA_Server *server,
  * Interception is included to ensure that zk is the only source of truth in the redundancyGroup
  * unless the availabilityPriority global variable is set at startup via the config file.
  * If it is set and zk is unreachable the local cache is used for reads.
+ * The ReadConsistency level of the node's namespace decides how fresh the cache must be:
+ * local reads are always served, session reads require a connected zk session and
+ * linearizable reads wait for a (shared) zoo_async sync on the address space path,
+ * issued once per ReadRequest (see zkUA_Service_Read). A read that cannot be served
+ * returns BadTimeout if the sync timed out and BadCommunicationError otherwise.
  */
 void zkUA_Service_Read_single(UA_Server *server, UA_Session *session,
         const UA_TimestampsToReturn timestamps, const UA_ReadValueId *id,
         UA_DataValue *v);
 
+/**
+ * zkUA_Service_Read:
+ * Used to intercept all calls to Service_Read, i.e. ReadRequests of UA clients.
+ * The linearizable reads of a request share one sync, issued by the first of them.
+ */
+void zkUA_Service_Read(UA_Server *server, UA_Session *session,
+        const UA_ReadRequest *request, UA_ReadResponse *response);
+
 /***** Attribute Writing Functions *****/
 /**
  * zkUA_UA_Server_write:
  * Used to intercept all calls to UA_Server_write.
  * UA_Server_write is the open62541 library function called by a UA
  * Server application to edit (update/write) a node's attribute.
+ * If the node's znode was changed by another server since it was last seen, the
+ * znode is applied to the local node, the attribute is written again on top of it
+ * and the merged node is replicated. If that fails too the write is rolled back and
+ * its error returned.
  */
 UA_StatusCode zkUA_UA_Server_write(UA_Server *server,
         const UA_WriteValue *value);
@@ -73,6 +91,22 @@ UA_StatusCode zkUA_UA_Server_write(UA_Server *server,
 void zkUA_Service_Write(UA_Server *server, UA_Session *session,
         const UA_WriteRequest *request, UA_WriteResponse *response);
 
+/**
+ * zkUA_atomicWrite_prepareRollback:
+ * Reads a copy of the attribute a WriteValue is about to write into v, so that the
+ * write can be rolled back with zkUA_atomicWrite_initiateRollback.
+ */
+void zkUA_atomicWrite_prepareRollback(UA_Server *server, UA_DataValue *v,
+        const UA_WriteValue *value);
+
+/**
+ * zkUA_atomicWrite_initiateRollback:
+ * Writes the attribute read by zkUA_atomicWrite_prepareRollback back into the local
+ * node without replicating it.
+ */
+UA_StatusCode zkUA_atomicWrite_initiateRollback(UA_Server *server,
+        const UA_WriteValue *value, UA_DataValue *v);
+
 /***** Node Addition Functions *****/
 
 /**
@@ -109,13 +143,28 @@ void zkUA_addNodeJsonPack(char *nodePath, int nodeClassInt,
  * zkUA_UA_Server_replicateNode:
  * General function to encode a node into JSON and push it to zookeeper.
  * The encoding is done using zkUA_addNodeJSONPack.
- * Creates the path on zookeeper if the znode doesn't exist or simply sets the
- * data to the newly encoded info if it does exist.
+ * Sets the znode's data expecting the version last seen for it, or creates the
+ * znode if its version is unknown or it doesn't exist. If another server modified
+ * or created the znode in the meantime (ZBADVERSION, ZNODEEXISTS) the replication
+ * fails instead of overwriting its update. Writes of attributes are merged into the
+ * updated znode and retried up to ZKUA_MAX_WRITE_ATTEMPTS times, see zkUA_UA_Server_write.
  */
-void zkUA_UA_Server_replicateNode(int nodeClass,
+UA_StatusCode zkUA_UA_Server_replicateNode(int nodeClass,
         const UA_NodeId requestedNewNodeId, const UA_NodeId parentNodeId,
         const UA_NodeId referenceTypeId, void * attr);
 
+/**
+ * zkUA_UA_Server_replicateNodeAsync:
+ * Same as zkUA_UA_Server_replicateNode but does not wait for zookeeper.
+ * The request is added to the batch and done is called with the zk return code
+ * once it is acknowledged or has failed.
+ */
+UA_StatusCode zkUA_UA_Server_replicateNodeAsync(int nodeClass,
+        const UA_NodeId requestedNewNodeId, const UA_NodeId parentNodeId,
+        const UA_NodeId referenceTypeId, void * attr,
+        zkUA_ReplicationBatch *batch, zkUA_replicationDone done,
+        void *context);
+
 /**
  * zkUA_initReadAttributes_server:
  * Calls readAttribute functions for all of the attributes of a given node based on
@@ -163,3 +212,20 @@ void zkUA_freeAttributes(UA_NodeClass *nodeClass, void **attributes);
  */
 UA_StatusCode zkUA_UA_Server_writeAttribute_prepareReplication(
         UA_Server *server, UA_NodeId nodeId);
+
+/**
+ * zkUA_UA_Server_writeAttribute_preparePayload:
+ * Same as zkUA_UA_Server_writeAttribute_prepareReplication but only encodes the node
+ * into *payload (to be free'd by the caller) of *payloadLen bytes without replicating it.
+ */
+UA_StatusCode zkUA_UA_Server_writeAttribute_preparePayload(UA_Server *server,
+        UA_NodeId nodeId, char **payload, int *payloadLen);
+
+/**
+ * zkUA_UA_Server_writeAttribute_prepareReplicationAsync:
+ * Same as zkUA_UA_Server_writeAttribute_prepareReplication but replicates the node
+ * with zkUA_UA_Server_replicateNodeAsync as part of a batch.
+ */
+UA_StatusCode zkUA_UA_Server_writeAttribute_prepareReplicationAsync(
+        UA_Server *server, UA_NodeId nodeId, zkUA_ReplicationBatch *batch,
+        zkUA_replicationDone done, void *context);
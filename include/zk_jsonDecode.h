@@ -45,6 +45,15 @@ UA_StatusCode zkUA_jsonDecode_zkNodeToUa_commonAttributes(json_t *attributes,
 UA_StatusCode zkUA_jsonDecode_zkNodeToUa_commonAttributesVarVarType(
         json_t *attributes, void *opcuaAttributes);
 
+/**
+ * zkUA_jsonDecode_zkNodeToUa_attributes:
+ * Decodes the Attributes object of a node of the given nodeClass into its attributes
+ * struct (UA_ObjectAttributes, UA_VariableAttributes, ...) without adding the node
+ * to a UA server.
+ */
+UA_StatusCode zkUA_jsonDecode_zkNodeToUa_attributes(json_t *attributes,
+        int nodeClass, void *opcuaAttributes);
+
 /**
  * zkUA_jsonDecode_X:
  * Decodes a JSON object containing an OPC UA node structure.
@@ -54,6 +63,14 @@ UA_StatusCode zkUA_jsonDecode_UA_NodeId(json_t *nodeId, UA_NodeId *uaNodeId);
 UA_StatusCode zkUA_jsonDecode_UA_LocalizedText(json_t *localizedText,
         UA_LocalizedText *destination);
 char *zkUA_jsonDecode_UA_String(json_t *string);
+
+/**
+ * zkUA_jsonDecode_UA_ByteString:
+ * Decodes a ByteString encoded by zkUA_jsonEncode_UA_ByteString: a {"base64": "..."}
+ * object, or the text written before payload version 3.
+ */
+UA_StatusCode zkUA_jsonDecode_UA_ByteString(json_t *jsonObject,
+        UA_ByteString *byteString);
 UA_StatusCode zkUA_jsonDecode_UA_Guid(json_t *guid, UA_Guid *g);
 
 UA_StatusCode zkUA_jsonDecode_UA_ExpandedNodeId(json_t *jsonObject,
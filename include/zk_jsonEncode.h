@@ -24,8 +24,33 @@ void zkUA_jsonEncode_UA_DataTypeMember(UA_DataType *type, json_t *jsonObject);
 
 void zkUA_jsonEncode_UA_DataType(UA_DataType *type, json_t *jsonObject);
 
+/**
+ * zkUA_jsonEncode_setNativeArrays:
+ * Selects whether Variant arrays are encoded as JSON arrays (or base64 for overlayable
+ * types) or, as before payload version 2, as one "data[i]" member per element.
+ */
+void zkUA_jsonEncode_setNativeArrays(UA_Boolean native);
+UA_Boolean zkUA_jsonEncode_getNativeArrays(void);
+
+/**
+ * zkUA_jsonEncode_setBase64ByteStrings:
+ * Selects whether ByteStrings (values, NodeId identifiers and ExtensionObject bodies)
+ * are encoded as {"base64": "..."} objects or, as before payload version 3, as text,
+ * which loses the ByteStrings that are not valid UTF-8 or contain NUL bytes.
+ */
+void zkUA_jsonEncode_setBase64ByteStrings(UA_Boolean base64);
+UA_Boolean zkUA_jsonEncode_getBase64ByteStrings(void);
+
 void zkUA_jsonEncode_UA_Variant_setObjectDataAndType(json_t *jsonObject,
         json_t *data, int dataType, char *dataIndex);
+/**
+ * zkUA_jsonEncode_dataType:
+ * Returns the "type" a Variant value of the given type is encoded with: its UA_TYPES_
+ * index, or 999 if it is not one of the types a Variant value can be encoded as.
+ */
+int zkUA_jsonEncode_dataType(const UA_DataType *type);
+json_t *zkUA_jsonEncode_UA_Variant_value(const UA_DataType *type,
+        void *variantValue, int *dataType);
 void zkUA_jsonEncode_UA_Variant_setValue(const UA_DataType *type,
         void *variantValue, json_t *jsonObject, char *dataIndex);
 void zkUA_jsonEncode_UA_Variant(UA_Variant *variant, json_t *jsonObject);
@@ -59,6 +84,13 @@ void zkUA_jsonEncode_UA_DateTimeStruct(UA_DateTimeStruct *dtStruct,
  */
 json_t *zkUA_jsonEncode_UA_String(UA_String *uaString);
 
+/**
+ * zkUA_jsonEncode_UA_ByteString:
+ * Encodes a UA_ByteString as a {"base64": "..."} object or, if base64 ByteStrings
+ * are disabled, as zkUA_jsonEncode_UA_String does.
+ */
+json_t *zkUA_jsonEncode_UA_ByteString(UA_ByteString *byteString);
+
 /**
  * zkUA_jsonEncode_UA_LocalizedText:
  * Encodes a UA_LocalizedText into the provided JSON object
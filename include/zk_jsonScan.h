@@ -0,0 +1,49 @@
+/*******************************************************************************
+ * Copyright (C) 2018 Ahmed Ismail <aismail [at] protonmail.com>
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+#include <open62541.h>
+
+struct zkUA_NodeInfo;
+
+/**
+ * zkUA_jsonScanAttributes:
+ * Storage for the attributes struct of any node class.
+ */
+typedef union zkUA_jsonScanAttributes {
+    UA_NodeAttributes node;
+    UA_ObjectAttributes object;
+    UA_VariableAttributes variable;
+    UA_MethodAttributes method;
+    UA_ObjectTypeAttributes objectType;
+    UA_VariableTypeAttributes variableType;
+    UA_ReferenceTypeAttributes referenceType;
+    UA_DataTypeAttributes dataType;
+    UA_ViewAttributes view;
+} zkUA_jsonScanAttributes;
+
+/**
+ * zkUA_jsonScan_decodeNode:
+ * Decodes the JSON document of a node in a single pass, straight into info and, if
+ * attr is not NULL, the attributes struct of the node's class. Strings and arrays are
+ * not copied: they point into the document or into a scratch buffer of the calling
+ * thread, so the results are only valid until the thread's next call and while the
+ * document exists, and must not be free'd.
+ * Only documents with the members in the order the JSON encoders write them are
+ * decoded. Returns UA_STATUSCODE_BADNOTSUPPORTED for other documents and for values
+ * left to zkUA_jsonDecode_zkNodeToUa (ExtensionObject, DataValue, unknown types).
+ */
+UA_StatusCode zkUA_jsonScan_decodeNode(const char *document, size_t length,
+        struct zkUA_NodeInfo *info, zkUA_jsonScanAttributes *attr);
@@ -0,0 +1,30 @@
+/*******************************************************************************
+ * Copyright (C) 2018 Ahmed Ismail <aismail [at] protonmail.com>
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+#include <open62541.h>
+
+/**
+ * zkUA_jsonStream_encodeNode:
+ * Writes the JSON document of a node, byte-identical to zkUA_addNodeJsonPack dumped
+ * with JSON_COMPACT | JSON_PRESERVE_ORDER, without building the JSON tree. The
+ * document is appended to a buffer owned by the calling thread after headerSize
+ * reserved bytes. Returns the buffer (valid until the thread's next call) and sets
+ * *length to headerSize plus the document length, or returns NULL.
+ */
+char *zkUA_jsonStream_encodeNode(const char *nodePath, int nodeClass,
+        const UA_NodeId *nodeId, const UA_NodeId *parentNodeId,
+        const UA_NodeId *referenceTypeId, void *attr, size_t headerSize,
+        size_t *length);
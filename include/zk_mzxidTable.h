@@ -0,0 +1,77 @@
+/*******************************************************************************
+ * Copyright (C) 2018 Ahmed Ismail <aismail [at] protonmail.com>
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+#include <open62541.h>
+
+/* Minimum number of slots of the mzxid table (always a power of two) */
+#define ZKUA_MZXIDTABLE_MIN_CAPACITY 64
+/* Flipped in the key of a node to key the value znode below its znode (see
+ zk_valueReplicate.h). Keys of numeric NodeIds never have this bit set. */
+#define ZKUA_MZXIDTABLE_VALUE_KEY (1ULL << 62)
+
+/**
+ * zkUA_mzxidTableKey:
+ * Packs the namespace index and numeric identifier of a node into a table key.
+ */
+UA_UInt64 zkUA_mzxidTableKey(UA_UInt16 nsIndex, UA_UInt32 identifier);
+
+/**
+ * zkUA_mzxidTableKeyFromPath:
+ * Computes the table key of a node from its zk path (.../ns=<ns>;i=<id>) without
+ * allocating. Nodes with other identifier types are keyed by a hash of their znode
+ * name with bit 63 set. Returns false if the path does not end in a node's name.
+ */
+UA_Boolean zkUA_mzxidTableKeyFromPath(const char *nodeZkPath, UA_UInt64 *key);
+
+/**
+ * zkUA_initializeMzxidTable:
+ * Creates the mzxid table: an open-addressing (linear probing) table mapping each
+ * node to the mzxid and data version of its znode, stored inline in the slots.
+ * Lookups take a shared lock and updates an exclusive lock, so the table can be used
+ * from both the UA server thread and the zk completion thread.
+ */
+void zkUA_initializeMzxidTable(size_t capacity);
+
+/**
+ * zkUA_destroyMzxidTable:
+ * Frees the mzxid table.
+ */
+void zkUA_destroyMzxidTable();
+
+/**
+ * zkUA_mzxidTableSearch:
+ * Returns true and the stored mzxid and version of a node if it is in the table.
+ * Either output pointer may be NULL.
+ */
+UA_Boolean zkUA_mzxidTableSearch(UA_UInt64 key, long long *mzxid, int *version);
+
+/**
+ * zkUA_mzxidTableInsert:
+ * Stores the mzxid and version of a node, replacing any previous value.
+ */
+UA_StatusCode zkUA_mzxidTableInsert(UA_UInt64 key, long long mzxid, int version);
+
+/**
+ * zkUA_mzxidTableRemove:
+ * Removes a node from the table. Returns false if it was not stored.
+ */
+UA_Boolean zkUA_mzxidTableRemove(UA_UInt64 key);
+
+/**
+ * zkUA_mzxidTableCount:
+ * Returns the number of nodes stored in the table.
+ */
+size_t zkUA_mzxidTableCount();
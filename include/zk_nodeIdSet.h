@@ -0,0 +1,63 @@
+/*******************************************************************************
+ * Copyright (C) 2018 Ahmed Ismail <aismail [at] protonmail.com>
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+#include <open62541.h>
+
+/* Minimum number of slots of a NodeId set (always a power of two) */
+#define ZKUA_NODEIDSET_MIN_CAPACITY 64
+
+/* A slot of a NodeId set */
+typedef struct zkUA_NodeIdSetSlot {
+    UA_NodeId nodeId;
+    UA_UInt32 hash;
+    UA_Boolean used;
+} zkUA_NodeIdSetSlot;
+
+/* A set of NodeIds (namespace index, identifier type and identifier), e.g. the nodes
+ visited by one walk of an address space. Each walk owns its set, so walks are
+ re-entrant. */
+typedef struct zkUA_NodeIdSet {
+    zkUA_NodeIdSetSlot *slots;
+    size_t capacity; /* power of two */
+    size_t count;
+} zkUA_NodeIdSet;
+
+/**
+ * zkUA_NodeIdSet_init:
+ * Initializes an empty set. It does not allocate before the first insert.
+ */
+void zkUA_NodeIdSet_init(zkUA_NodeIdSet *set);
+
+/**
+ * zkUA_NodeIdSet_deleteMembers:
+ * Frees the NodeIds and slots of a set and leaves it empty.
+ */
+void zkUA_NodeIdSet_deleteMembers(zkUA_NodeIdSet *set);
+
+/**
+ * zkUA_NodeIdSet_contains:
+ * Returns true if the set holds nodeId.
+ */
+UA_Boolean zkUA_NodeIdSet_contains(const zkUA_NodeIdSet *set,
+        const UA_NodeId *nodeId);
+
+/**
+ * zkUA_NodeIdSet_insert:
+ * Adds a copy of nodeId to the set (an open-addressing table with linear probing).
+ * Returns true if it was added, false if it was in the set already or could not
+ * be added.
+ */
+UA_Boolean zkUA_NodeIdSet_insert(zkUA_NodeIdSet *set, const UA_NodeId *nodeId);
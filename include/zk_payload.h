@@ -0,0 +1,146 @@
+/*******************************************************************************
+ * Copyright (C) 2018 Ahmed Ismail <aismail [at] protonmail.com>
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+#include <open62541.h>
+#include <zookeeper.h>
+
+/* Payload header: two magic bytes, the header version and the payload format.
+ Znodes written before the header was introduced hold plain JSON and start with '{'. */
+#define ZKUA_PAYLOAD_MAGIC0 'z'
+#define ZKUA_PAYLOAD_MAGIC1 'U'
+/* Version 2: Variant arrays in JSON payloads are JSON arrays or base64, not data[i] keys.
+ Version 3: ByteStrings in JSON payloads are {"base64": "..."} objects, not text. */
+#define ZKUA_PAYLOAD_VERSION 3
+#define ZKUA_PAYLOAD_HEADER_SIZE 4
+
+/* Payload formats (PayloadFormat config parameter) */
+#define ZKUA_PAYLOAD_JSON 0
+#define ZKUA_PAYLOAD_BINARY 1
+#define ZKUA_PAYLOAD_FORMATS 2
+/* The format byte holds the payload format in its low bits and these flags */
+#define ZKUA_PAYLOAD_FORMAT_MASK 0x0F
+/* The body is the uncompressed body size (4 bytes, big endian) followed by an LZ4 block */
+#define ZKUA_PAYLOAD_LZ4 0x10
+/* The body is the manifest of a payload stored in chunk znodes (see zk_payloadStore.h) */
+#define ZKUA_PAYLOAD_CHUNKED 0x20
+/* The body is a delta log (see zk_deltaReplicate.h) */
+#define ZKUA_PAYLOAD_DELTA 0x40
+/* The body is the value of a Variable held in its own znode (see zk_valueReplicate.h) */
+#define ZKUA_PAYLOAD_VALUE 0x80
+
+/* Payload compression (PayloadCompression config parameter) */
+#define ZKUA_COMPRESSION_NONE 0
+#define ZKUA_COMPRESSION_LZ4 1
+/* Bodies up to this size are never compressed (CompressionThreshold config parameter) */
+#define ZKUA_DEFAULT_COMPRESSION_THRESHOLD 4096
+
+/**
+ * zkUA_NodeInfo:
+ * The identity of a replicated node and of its hierarchical parent.
+ */
+typedef struct zkUA_NodeInfo {
+    UA_NodeId nodeId;
+    UA_NodeClass nodeClass;
+    UA_NodeId parentNodeId;
+    UA_NodeId parentReferenceNodeId;
+} zkUA_NodeInfo;
+
+/**
+ * zkUA_PayloadCodec:
+ * Encoder and decoder of one payload format. Bodies exclude the payload header.
+ * encode: Returns the header size bytes reserved for the caller followed by the
+ *         encoded node (malloc'd) and its total length in *length.
+ * decode: Adds or updates the node held in a body in the UA server.
+ * decodeNodeInfo: Decodes only the identity of the node held in a body.
+ */
+typedef struct zkUA_PayloadCodec {
+    const char *name;
+    char *(*encode)(char *nodePath, int nodeClass, const UA_NodeId *nodeId,
+            const UA_NodeId *parentNodeId, const UA_NodeId *referenceTypeId,
+            void *attr, size_t headerSize, size_t *length);
+    void (*decode)(const char *body, size_t length, const struct Stat *stat,
+            UA_Server *server);
+    UA_StatusCode (*decodeNodeInfo)(const char *body, size_t length,
+            zkUA_NodeInfo *info);
+} zkUA_PayloadCodec;
+
+/**
+ * zkUA_initializePayloadFormat:
+ * Sets the format nodes are encoded in when they are pushed to zk. Payloads of every
+ * known format are decoded regardless of this setting.
+ */
+void zkUA_initializePayloadFormat(int format);
+
+/**
+ * zkUA_initializePayloadVersion:
+ * Sets the payload version nodes are encoded with (PayloadVersion config parameter).
+ * Keep the group at the version its oldest server decodes. Payloads of every
+ * version up to ZKUA_PAYLOAD_VERSION are decoded regardless of this setting.
+ */
+void zkUA_initializePayloadVersion(int version);
+
+/**
+ * zkUA_initializePayloadCompression:
+ * Sets the compression of the bodies of encoded nodes larger than threshold bytes.
+ * A body is only stored compressed if that makes it smaller. Keep the group at none
+ * until every server decodes compressed payloads. Compressed payloads are decoded
+ * regardless of this setting.
+ */
+void zkUA_initializePayloadCompression(int compression, size_t threshold);
+
+/**
+ * zkUA_payloadFormatFromString:
+ * Converts a PayloadFormat config value (json, binary) into a format, -1 if unknown.
+ */
+int zkUA_payloadFormatFromString(const char *format);
+
+/**
+ * zkUA_payloadCompressionFromString:
+ * Converts a PayloadCompression config value (none, lz4) into a compression, -1 if
+ * unknown.
+ */
+int zkUA_payloadCompressionFromString(const char *compression);
+
+/**
+ * zkUA_encodeNodePayload:
+ * Encodes a node, its parent and its attributes into a znode payload in the configured
+ * format. Returns the malloc'd payload and its length in *length, or NULL on error.
+ */
+char *zkUA_encodeNodePayload(char *nodePath, int nodeClass,
+        const UA_NodeId nodeId, const UA_NodeId parentNodeId,
+        const UA_NodeId referenceTypeId, void *attr, int *length);
+
+/**
+ * zkUA_decodeNodePayload:
+ * Decodes a znode payload of any known format and adds or updates its node in the
+ * UA server. Chunked payloads have to be loaded with zkUA_loadPayloadChunks first.
+ */
+void zkUA_decodeNodePayload(const char *value, int length,
+        const struct Stat *stat, UA_Server *server);
+
+/**
+ * zkUA_decodeNodePayloadInfo:
+ * Decodes the NodeId, NodeClass and parent of the node held in a znode payload.
+ * The members of info have to be free'd with zkUA_NodeInfo_deleteMembers.
+ */
+UA_StatusCode zkUA_decodeNodePayloadInfo(const char *value, int length,
+        zkUA_NodeInfo *info);
+
+/**
+ * zkUA_NodeInfo_deleteMembers:
+ * Frees the NodeIds of a decoded zkUA_NodeInfo.
+ */
+void zkUA_NodeInfo_deleteMembers(zkUA_NodeInfo *info);
@@ -0,0 +1,96 @@
+/*******************************************************************************
+ * Copyright (C) 2018 Ahmed Ismail <aismail [at] protonmail.com>
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+#include <open62541.h>
+#include <zookeeper.h>
+
+/* Payloads larger than this are split into chunk znodes (ChunkSize config parameter).
+ Leaves room for the request overhead below ZooKeeper's default 1 MB jute.maxbuffer. */
+#define ZKUA_DEFAULT_CHUNK_SIZE 1000000
+/* Size of the buffer a znode is first read into. It is grown to the znode's
+ Stat.dataLength if the data does not fit. */
+#define ZKUA_GET_BUFFER_SIZE 16384
+/* Prefix of the sequential znodes that hold one generation of a node's chunks */
+#define ZKUA_CHUNK_GENERATION_PREFIX "g-"
+/* Number of times a chunked payload is read if its chunks are replaced meanwhile */
+#define ZKUA_MAX_READ_ATTEMPTS 3
+
+/**
+ * Chunked payloads:
+ * A payload larger than the chunk size is split into the ordered chunk znodes
+ * <nodePath>/g-<sequence>/0, 1, ... of a new generation. The node's znode holds a
+ * manifest instead of the payload: the payload header with the ZKUA_PAYLOAD_CHUNKED
+ * flag, the payload length and the number of chunks (4 bytes each, big endian) and the
+ * name of the generation. The chunks are written before the manifest, so the new
+ * payload becomes visible with the single write of the manifest and the watches of the
+ * node's znode fire only then. The generation the previous manifest refers to is kept
+ * for readers that are still loading it, older ones are deleted.
+ */
+
+/**
+ * zkUA_initializeChunkSize:
+ * Sets the size above which payloads are split into chunk znodes.
+ */
+void zkUA_initializeChunkSize(size_t chunkSize);
+
+/**
+ * zkUA_storeNodePayload:
+ * Prepares an encoded payload for the znode at nodePath. Payloads up to the chunk
+ * size are left as they are. Larger payloads are written to the chunks of a new
+ * generation and *payload is replaced with their manifest (the payload is free'd).
+ * A znode that does not exist yet is created with a manifest without chunks, which
+ * readers skip, and its version is recorded so that the manifest is set on it.
+ */
+UA_StatusCode zkUA_storeNodePayload(char *nodePath, char **payload,
+        int *length);
+
+/**
+ * zkUA_isChunkManifest:
+ * Returns true if a znode's data is the manifest of a chunked payload.
+ */
+UA_Boolean zkUA_isChunkManifest(const char *value, int length);
+
+/**
+ * zkUA_getZnodeData:
+ * zoo_get with a buffer sized from the znode's Stat.dataLength. On ZOK *value holds the
+ * malloc'd data, NUL-terminated, and *length its length.
+ */
+int zkUA_getZnodeData(const char *path, int watch, char **value, int *length,
+        struct Stat *stat);
+
+/**
+ * zkUA_loadPayloadChunks:
+ * Reads the chunks a manifest refers to and returns the reassembled, NUL-terminated
+ * payload (malloc'd) in *payload. Returns ZNONODE if the chunks were replaced by a
+ * newer generation in the meantime or the manifest does not refer to any yet.
+ */
+int zkUA_loadPayloadChunks(const char *nodePath, const char *manifest,
+        int manifestLength, char **payload, int *length);
+
+/**
+ * zkUA_getNodePayload:
+ * Reads the payload of a node's znode like zkUA_getZnodeData and reassembles it if it
+ * is chunked. The manifest is read again if its chunks were replaced while they were
+ * read. stat is the Stat of the node's znode.
+ */
+int zkUA_getNodePayload(const char *nodePath, int watch, char **value,
+        int *length, struct Stat *stat);
+
+/**
+ * zkUA_deleteNodeZnode:
+ * Deletes a node's znode together with its children (payload chunks, value znode, delta log).
+ */
+int zkUA_deleteNodeZnode(const char *nodePath);
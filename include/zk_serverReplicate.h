@@ -30,6 +30,7 @@ typedef struct zkUA_locateParent {
     UA_NodeId *foundParent;
     UA_NodeId *referenceTypeId;
     UA_Boolean foundParentFlag;
+    struct zkUA_NodeIdSet *visited; /* nodes seen by this search */
 } zkUA_locateParent;
 
 typedef struct SetIfDifferentStruct {
@@ -40,16 +41,45 @@ typedef struct SetIfDifferentStruct {
 typedef struct zkUA_checkNs0 {
     UA_NodeId *searchedForNode;
     bool result;
+    struct zkUA_NodeIdSet *visited; /* nodes seen by this search */
 } zkUA_checkNs0;
 
 extern char zkServerAddressSpacePath[1024];
 extern UA_Boolean availabilityPriority;
+extern int readConsistency;
+extern UA_Boolean transactionalWrites;
 void zkUA_initializeAvailabilityPriority(UA_Boolean aPriority);
 /**
- * zkUA_extractNsIndexNodeId:
- * Extracts a node's namespace index and nodeId substrings from a zk path string.
+ * zkUA_initializeBootstrapPipeline:
+ * Sets how many znodes are requested from zk at once when the address space is
+ * replicated (BootstrapPipelineDepth config parameter). With 0 or 1 the znodes are
+ * fetched one at a time.
  */
-void zkUA_extractNsIndexNodeId(const void *nId, char *storeNs, char *storeId);
+void zkUA_initializeBootstrapPipeline(size_t depth);
+/**
+ * zkUA_initializeTransactionalWrites:
+ * If set, all nodes written by one WriteRequest are replicated in a single zoo_multi
+ * and all of the writes are rolled back if it fails (TransactionalWrites config parameter).
+ */
+void zkUA_initializeTransactionalWrites(UA_Boolean transactional);
+/**
+ * zkUA_initializeReadConsistency:
+ * Sets the server-wide read consistency level (ZKUA_READ_LOCAL, ZKUA_READ_SESSION
+ * or ZKUA_READ_LINEARIZABLE) used by the Service_Read_single interception.
+ */
+void zkUA_initializeReadConsistency(int level);
+/**
+ * zkUA_setNamespaceReadConsistency:
+ * Overrides the read consistency level for all nodes in a namespace, e.g. to make
+ * reads of safety-relevant tags linearizable while the rest are served locally.
+ */
+UA_StatusCode zkUA_setNamespaceReadConsistency(UA_UInt16 nsIndex, int level);
+/**
+ * zkUA_readConsistencyForNode:
+ * Returns the read consistency level that applies to a node: the namespace
+ * override if there is one, the server-wide level otherwise.
+ */
+int zkUA_readConsistencyForNode(const UA_NodeId *nodeId);
 
 /**
  * zkUA_UA_Server_replicateZk:
@@ -61,8 +91,11 @@ void zkUA_UA_Server_replicateZk(zhandle_t *zh, char *zkServerPath,
 
 /**
  * zkUA_UA_Server_replicateZk_getNodes:
- * Loops through a list of all the children znodes for a zk path
- * and calls zkUA_jsonDecode for each one
+ * Compares a list of all the children znodes for a zk path with the children seen
+ * with the previous list. Fetches the added children (in parallel if a bootstrap
+ * pipeline depth is set) and deletes the local node of each removed child, so unchanged
+ * children cost no zk requests. Nodes are added in the order given by the parentNodeId
+ * of their NodeInfo; a node whose parent is missing is held until the parent is added.
  */
 void zkUA_UA_Server_replicateZk_getNodes(int rc,
         const struct String_vector *strings, const void *data);
@@ -80,16 +113,64 @@ int zkUA_checkMzxidAge(char *nodeZkPath, long long *mzxid);
 /**
  * zkUA_insertMzxidAge:
  * Inserts the mzxid of a node just acquired from zk or just pushed to zk into the
- * local hashtable.
+ * local mzxid table.
  */
 UA_StatusCode zkUA_insertMzxidAge(char *nodeZkPath, long long *nodeMzxidLL);
 
+/**
+ * zkUA_insertZnodeStat:
+ * Inserts the mzxid and the data version of a znode from its stat into the local mzxid table.
+ * The version is used as the expected version of the next write to the znode.
+ */
+UA_StatusCode zkUA_insertZnodeStat(char *nodeZkPath, const struct Stat *stat);
+
+/**
+ * zkUA_lookupZnodeVersion:
+ * Returns true and the data version last seen for a znode if it is known.
+ */
+UA_Boolean zkUA_lookupZnodeVersion(char *nodeZkPath, int *version);
+
 /**
  * zkUA_deleteMzxidAge:
- * Deletes the mzxid for a specific znode from the local hashtable.
+ * Deletes the mzxid for a specific znode from the local mzxid table.
  */
 UA_StatusCode zkUA_deleteMzxidAge(char *nodeZkPath);
 
+/**
+ * zkUA_initializeParentIndex:
+ * Creates the parent index, a hashtable mapping each node's NodeId to the NodeId of its
+ * hierarchical parent and the referenceTypeId of the reference from that parent.
+ * It is kept up to date by the node addition/deletion interceptions.
+ */
+void zkUA_initializeParentIndex();
+
+/**
+ * zkUA_destroyParentIndex:
+ * Deletes the parent index and all of its entries.
+ */
+void zkUA_destroyParentIndex();
+
+/**
+ * zkUA_insertParent:
+ * Inserts (or replaces) the parent and referenceTypeId of a node in the parent index.
+ */
+UA_StatusCode zkUA_insertParent(const UA_NodeId *nodeId,
+        const UA_NodeId *parentNodeId, const UA_NodeId *referenceTypeId);
+
+/**
+ * zkUA_lookupParent:
+ * Copies the parent and referenceTypeId of a node from the parent index.
+ * Returns false if the node is not indexed. The copies must be deleted by the caller.
+ */
+UA_Boolean zkUA_lookupParent(const UA_NodeId *nodeId, UA_NodeId *parentNodeId,
+        UA_NodeId *referenceTypeId);
+
+/**
+ * zkUA_deleteParent:
+ * Removes a node from the parent index.
+ */
+void zkUA_deleteParent(const UA_NodeId *nodeId);
+
 /*
  * zkUA_jsonDecodeZkNode:
  * Gets the data of a single znode and calls a function to decode it back into OPC UA.
@@ -21,3 +21,11 @@
  */
 char *zkUA_url_encode(char *str);
 char *zkUA_url_decode(char *str);
+
+/**
+ *  Base64 encoding and decoding functions
+ */
+char *zkUA_base64_encode(const unsigned char *data, size_t length);
+/* Decodes into dst (at least length / 4 * 3 bytes). Returns the number of decoded
+ bytes or (size_t) -1 if str is not valid base64 */
+size_t zkUA_base64_decode(const char *str, size_t length, unsigned char *dst);
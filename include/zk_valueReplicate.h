@@ -0,0 +1,80 @@
+/*******************************************************************************
+ * Copyright (C) 2018 Ahmed Ismail <aismail [at] protonmail.com>
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+#include <open62541.h>
+#include <zookeeper.h>
+
+/* Name of the znode below a Variable's znode that holds its value */
+#define ZKUA_VALUE_ZNODE_NAME "value"
+
+/**
+ * Value znodes:
+ * With value znodes enabled a write of a Variable's Value attribute is replicated by
+ * writing the node's DataValue (value, status and source/server timestamps) to the
+ * value znode below the node's znode instead of re-encoding the whole node. The
+ * node's znode holds its metadata and is only rewritten when another attribute
+ * changes; the value it holds is the one at that time so that replicas can add the
+ * node in one step. The value znode holds the payload header (binary format,
+ * ZKUA_PAYLOAD_VALUE flag), the NodeId and the UA Binary encoded DataValue.
+ * Replicas watch the value znode separately and write the DataValue into the local
+ * node, also after the node's znode has been decoded again.
+ * The mzxid and version of the value znode are kept in the mzxid table under the key
+ * of its node with ZKUA_MZXIDTABLE_VALUE_KEY flipped. Values are written expecting
+ * that version, so concurrent value writes of several servers conflict like writes
+ * of the node's znode do.
+ */
+
+/**
+ * zkUA_initializeValueZnodes:
+ * Enables or disables value znodes (ValueZnodes config parameter).
+ */
+void zkUA_initializeValueZnodes(UA_Boolean enabled);
+
+/**
+ * zkUA_replicateValue:
+ * Writes the Value attribute of a node that was written in the local cache to its
+ * value znode. Returns UA_STATUSCODE_BADNOTSUPPORTED if the write has to be
+ * replicated otherwise, e.g. as value znodes are disabled, it is not a Value write
+ * or the node's znode is unknown.
+ * If another server wrote the value znode since its version was last seen, its value
+ * is applied, the write is applied again on top of it and the merged value is written
+ * (up to ZKUA_MAX_WRITE_ATTEMPTS times). v holds the value the write is rolled back
+ * to if it fails and is replaced with the applied value.
+ */
+UA_StatusCode zkUA_replicateValue(UA_Server *server,
+        const UA_WriteValue *value, UA_DataValue *v);
+
+/**
+ * zkUA_isValueZnodePath:
+ * Returns true if a znode path is the value znode of a node.
+ */
+UA_Boolean zkUA_isValueZnodePath(const char *path);
+
+/**
+ * zkUA_watchNodeValue:
+ * Sets a watch on the value znode of the node at nodePath and applies the value if
+ * the znode exists. Does not wait for zk.
+ */
+void zkUA_watchNodeValue(const char *nodePath);
+
+/**
+ * zkUA_applyNodeValue:
+ * Reads a value znode (setting a watch on it) and writes its DataValue into the
+ * local node without replicating it, unless the value znode's mzxid is not newer
+ * than the one written or applied last. Whoever decodes the node's znode again
+ * removes that mzxid first, as the document may hold an older value.
+ */
+UA_StatusCode zkUA_applyNodeValue(const char *valuePath, UA_Server *server);
@@ -0,0 +1,65 @@
+/*******************************************************************************
+ * Copyright (C) 2018 Ahmed Ismail <aismail [at] protonmail.com>
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+#include <open62541.h>
+
+/* Longest znode name of a node. Names of longer identifiers are replaced by a hash. */
+#define ZKUA_ZNODE_NAME_MAX 256
+/* Size of a buffer that holds the znode path of any node */
+#define ZKUA_ZNODE_PATH_MAX (1024 + ZKUA_ZNODE_NAME_MAX)
+
+/**
+ * Znode names:
+ * A node's znode below the address space path is named after its NodeId:
+ *   ns=<ns>;i=<numeric>
+ *   ns=<ns>;s=<string, '%', '/' and bytes outside of 0x21-0x7E as %XX>
+ *   ns=<ns>;g=<xxxxxxxx-xxxx-xxxx-xxxx-xxxxxxxxxxxx>
+ *   ns=<ns>;b=<unpadded base64url of the ByteString>
+ * A name that would be longer than ZKUA_ZNODE_NAME_MAX - 1 is replaced by
+ *   ns=<ns>;h=<64 bit FNV-1a hash of the identifier type and bytes, in hex>
+ * which can't be parsed back into a NodeId.
+ */
+
+/**
+ * zkUA_formatZnodeName:
+ * Writes the znode name of a NodeId to name (size bytes, including the terminating
+ * zero) without allocating. Returns its length, 0 if it does not fit.
+ */
+size_t zkUA_formatZnodeName(const UA_NodeId *nodeId, char *name, size_t size);
+
+/**
+ * zkUA_formatZnodePath:
+ * Writes the path of a node's znode (address space path and znode name) to path
+ * (size bytes, ZKUA_ZNODE_PATH_MAX always fits). Returns its length, 0 if it does not
+ * fit.
+ */
+size_t zkUA_formatZnodePath(const UA_NodeId *nodeId, char *path, size_t size);
+
+/**
+ * zkUA_parseZnodeName:
+ * Parses the NodeId from a znode name or path (its last component) in one pass
+ * without allocating: string and ByteString identifiers are decoded into identifier
+ * (identifierSize bytes, ZKUA_ZNODE_NAME_MAX always fits) and nodeId points into it.
+ * Returns false if the name is not a NodeId or is a hashed name.
+ */
+UA_Boolean zkUA_parseZnodeName(const char *path, UA_NodeId *nodeId,
+        UA_Byte *identifier, size_t identifierSize);
+
+/**
+ * zkUA_znodeNameHash:
+ * Returns the 64 bit FNV-1a hash of length bytes.
+ */
+UA_UInt64 zkUA_znodeNameHash(const void *data, size_t length);
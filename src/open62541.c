@@ -4540,9 +4540,9 @@ void Service_UnregisterNodes(UA_Server *server, UA_Session *session,
  * Attribute values whose elements are indexed, such as an array, this Service
  * allows Clients to read the entire set of indexed values as a composite, to
  * read individual elements or to read ranges of elements of the composite. */
-void Service_Read(UA_Server *server, UA_Session *session,
-                  const UA_ReadRequest *request,
-                  UA_ReadResponse *response);
+//void Service_Read(UA_Server *server, UA_Session *session,
+//                  const UA_ReadRequest *request,
+//                  UA_ReadResponse *response);
 
 /* Used to write one or more Attributes of one or more Nodes. For constructed
  * Attribute values whose elements are indexed, such as an array, this Service
@@ -20741,7 +20741,8 @@ void _Service_Read_single(UA_Server *server, UA_Session *session,
     }
 }
 
-void Service_Read(UA_Server *server, UA_Session *session,
+//void Service_Read(UA_Server *server, UA_Session *session,
+void _Service_Read(UA_Server *server, UA_Session *session,
                   const UA_ReadRequest *request, UA_ReadResponse *response) {
     UA_LOG_DEBUG_SESSION(server->config.logger, session, "Processing ReadRequest");
     if(request->nodesToReadSize <= 0) {
@@ -0,0 +1,199 @@
+/*******************************************************************************
+ * Copyright (C) 2018 Ahmed Ismail <aismail [at] protonmail.com>
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <zk_asyncReplicate.h>
+#include <zk_serverReplicate.h>
+#include <zk_cli.h>
+#include <zk_global.h>
+
+/* A single node replication request travelling through the zk completions */
+typedef struct zkUA_replicationOp {
+    zkUA_ReplicationBatch *batch;
+    char *nodePath;
+    char *payload;
+    int payloadLen;
+    int version;
+    zkUA_replicationDone done;
+    void *context;
+} zkUA_replicationOp;
+
+/* The replication window: requests in flight on zk across all batches */
+static pthread_mutex_t windowMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t windowCond = PTHREAD_COND_INITIALIZER;
+static size_t windowSize = ZKUA_DEFAULT_REPLICATION_WINDOW;
+static size_t windowInFlight = 0;
+
+void zkUA_initializeReplicationWindow(size_t window) {
+    pthread_mutex_lock(&windowMutex);
+    windowSize = (window > 0) ? window : 1;
+    pthread_cond_broadcast(&windowCond);
+    pthread_mutex_unlock(&windowMutex);
+}
+
+void zkUA_ReplicationBatch_init(zkUA_ReplicationBatch *batch) {
+    pthread_mutex_init(&batch->mutex, NULL);
+    pthread_cond_init(&batch->cond, NULL);
+    batch->pending = 0;
+    batch->failed = 0;
+}
+
+void zkUA_ReplicationBatch_deleteMembers(zkUA_ReplicationBatch *batch) {
+    pthread_cond_destroy(&batch->cond);
+    pthread_mutex_destroy(&batch->mutex);
+}
+
+size_t zkUA_ReplicationBatch_wait(zkUA_ReplicationBatch *batch) {
+    pthread_mutex_lock(&batch->mutex);
+    while (batch->pending > 0)
+        pthread_cond_wait(&batch->cond, &batch->mutex);
+    size_t failed = batch->failed;
+    pthread_mutex_unlock(&batch->mutex);
+    return failed;
+}
+
+/* Reports the result of a request, releases its window slot and frees it */
+static void zkUA_replicateAsync_finish(zkUA_replicationOp *op, int rc) {
+    if (rc != ZOK) {
+        fprintf(stderr,
+                "zkUA_replicateAsync: Could not add the node %s to zk or set its data - rc = %d\n",
+                op->nodePath, rc);
+    }
+    if (op->done)
+        op->done(rc, op->context);
+
+    pthread_mutex_lock(&windowMutex);
+    windowInFlight--;
+    pthread_cond_signal(&windowCond);
+    pthread_mutex_unlock(&windowMutex);
+
+    zkUA_ReplicationBatch *batch = op->batch;
+    free(op->nodePath);
+    free(op->payload);
+    free(op);
+    if (batch) {
+        pthread_mutex_lock(&batch->mutex);
+        batch->pending--;
+        if (rc != ZOK)
+            batch->failed++;
+        pthread_cond_broadcast(&batch->cond);
+        pthread_mutex_unlock(&batch->mutex);
+    }
+}
+
+static void zkUA_replicateAsync_create(zkUA_replicationOp *op);
+
+/* Stat of the znode after a create or set: record its mzxid and version */
+static void zkUA_replicateAsync_stat(int rc, const struct Stat *stat,
+        const void *data) {
+    zkUA_replicationOp *op = (zkUA_replicationOp *) data;
+    if (rc == ZOK)
+        zkUA_insertZnodeStat(op->nodePath, stat);
+    zkUA_replicateAsync_finish(op, rc);
+}
+
+/* Result of creating a znode */
+static void zkUA_replicateAsync_created(int rc, const char *value,
+        const void *data) {
+    zkUA_replicationOp *op = (zkUA_replicationOp *) data;
+    if (rc == ZOK) {
+        /* get the stat of the new znode to acquire the mzxid */
+        rc = zoo_aexists(zkHandle, op->nodePath, 0, zkUA_replicateAsync_stat,
+                op);
+        if (rc != ZOK)
+            zkUA_replicateAsync_finish(op, rc);
+    } else {
+        /* ZNODEEXISTS: someone else created the znode in the meantime */
+        zkUA_replicateAsync_finish(op, rc);
+    }
+}
+
+/* Result of setting the data of a znode */
+static void zkUA_replicateAsync_setDone(int rc, const struct Stat *stat,
+        const void *data) {
+    zkUA_replicationOp *op = (zkUA_replicationOp *) data;
+    if (rc == ZOK) {
+        /* Update the hashtable mzxid and version */
+        zkUA_insertZnodeStat(op->nodePath, stat);
+        zkUA_replicateAsync_finish(op, rc);
+    } else if (rc == ZNONODE) {
+        zkUA_replicateAsync_create(op);
+    } else {
+        /* ZBADVERSION: someone else modified the znode in the meantime */
+        zkUA_replicateAsync_finish(op, rc);
+    }
+}
+
+static void zkUA_replicateAsync_create(zkUA_replicationOp *op) {
+    /* create the path with the encoded data */
+    int rc = zoo_acreate(zkHandle, op->nodePath, op->payload, op->payloadLen,
+            &ZOO_OPEN_ACL_UNSAFE, 0, zkUA_replicateAsync_created, op);
+    if (rc != ZOK)
+        zkUA_replicateAsync_finish(op, rc);
+}
+
+static void zkUA_replicateAsync_set(zkUA_replicationOp *op) {
+    int rc = zoo_aset(zkHandle, op->nodePath, op->payload, op->payloadLen,
+            op->version, zkUA_replicateAsync_setDone, op);
+    if (rc != ZOK)
+        zkUA_replicateAsync_finish(op, rc);
+}
+
+UA_StatusCode zkUA_replicateAsync(zkUA_ReplicationBatch *batch, char *nodePath,
+        char *payload, int payloadLen, zkUA_replicationDone done,
+        void *context) {
+
+    zkUA_replicationOp *op = calloc(1, sizeof(zkUA_replicationOp));
+    if (!op) {
+        free(nodePath);
+        free(payload);
+        if (done)
+            done(ZSYSTEMERROR, context);
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    }
+    op->batch = batch;
+    op->nodePath = nodePath;
+    op->payload = payload;
+    op->payloadLen = payloadLen;
+    op->done = done;
+    op->context = context;
+
+    if (batch) {
+        pthread_mutex_lock(&batch->mutex);
+        batch->pending++;
+        pthread_mutex_unlock(&batch->mutex);
+    }
+    /* Wait for a free slot in the replication window. The completion thread frees
+     slots, so it must never wait here. */
+    pthread_mutex_lock(&windowMutex);
+    while (windowInFlight >= windowSize && zkUA_onCompletionThread() == false)
+        pthread_cond_wait(&windowCond, &windowMutex);
+    windowInFlight++;
+    pthread_mutex_unlock(&windowMutex);
+
+    if (!zkHandle) {
+        zkUA_replicateAsync_finish(op, ZINVALIDSTATE);
+        return UA_STATUSCODE_BADUNEXPECTEDERROR;
+    }
+    /* Write with the version we know of, or create the znode if we know none */
+    if (zkUA_lookupZnodeVersion(nodePath, &op->version))
+        zkUA_replicateAsync_set(op);
+    else
+        zkUA_replicateAsync_create(op);
+    return UA_STATUSCODE_GOOD;
+}
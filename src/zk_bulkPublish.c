@@ -0,0 +1,374 @@
+/*******************************************************************************
+ * Copyright (C) 2018 Ahmed Ismail <aismail [at] protonmail.com>
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <zk_bulkPublish.h>
+#include <zk_payloadStore.h>
+#include <zk_znodePath.h>
+
+/* A znode created by a batch, or the manifest set on a znode whose payload was
+ chunked (the znode is created when its chunks are stored) */
+typedef struct zkUA_BulkOp {
+    char *path;
+    char *data;
+    int dataLength;
+    UA_Boolean set;
+    struct Stat stat; /* receives the stat of a set, which is not used */
+} zkUA_BulkOp;
+
+/* Znode creates (and manifest sets) sent in one zoo_multi */
+struct zkUA_BulkBatch {
+    zkUA_BulkPublisher *publisher;
+    zkUA_BulkBatch *next; /* in the list of failed batches */
+    size_t sequence;
+    zkUA_BulkOp *ops; /* in the order they were added */
+    size_t opsSize;
+    size_t bytes;
+    zoo_op_t *zooOps;
+    zoo_op_result_t *results;
+    char pathBuffer[ZKUA_ZNODE_PATH_MAX]; /* receives the created paths, which are not used */
+    int rc;
+    int attempts;
+    UA_Boolean alone; /* no other batch was in flight while it was sent */
+};
+
+static zkUA_BulkBatch *zkUA_BulkBatch_new(zkUA_BulkPublisher *publisher) {
+    zkUA_BulkBatch *batch = calloc(1, sizeof(zkUA_BulkBatch));
+    batch->publisher = publisher;
+    batch->sequence = publisher->sequence++;
+    batch->ops = calloc(ZKUA_BULK_BATCH_OPS, sizeof(zkUA_BulkOp));
+    batch->zooOps = calloc(ZKUA_BULK_BATCH_OPS, sizeof(zoo_op_t));
+    batch->results = calloc(ZKUA_BULK_BATCH_OPS, sizeof(zoo_op_result_t));
+    return batch;
+}
+
+static void zkUA_BulkBatch_delete(zkUA_BulkBatch *batch) {
+    for (size_t i = 0; i < batch->opsSize; i++) {
+        free(batch->ops[i].path);
+        free(batch->ops[i].data);
+    }
+    free(batch->ops);
+    free(batch->zooOps);
+    free(batch->results);
+    free(batch);
+}
+
+/* Returns the bytes an op adds to a batch */
+static size_t zkUA_BulkOp_bytes(const char *path, int dataLength) {
+    return strlen(path) + (size_t) dataLength + ZKUA_BULK_OP_OVERHEAD;
+}
+
+/* Removes the i-th op from a batch, keeping the order of the others */
+static void zkUA_BulkBatch_drop(zkUA_BulkBatch *batch, size_t i) {
+    batch->bytes -= zkUA_BulkOp_bytes(batch->ops[i].path,
+            batch->ops[i].dataLength);
+    free(batch->ops[i].path);
+    free(batch->ops[i].data);
+    memmove(&batch->ops[i], &batch->ops[i + 1],
+            (batch->opsSize - i - 1) * sizeof(zkUA_BulkOp));
+    batch->opsSize--;
+}
+
+/* Records the result of a batch. Mutex must be held. */
+static void zkUA_BulkPublisher_complete(zkUA_BulkPublisher *publisher,
+        zkUA_BulkBatch *batch, int rc) {
+    publisher->inFlight--;
+    if (rc == ZOK) {
+        publisher->committed += batch->opsSize;
+        zkUA_BulkBatch_delete(batch);
+    } else {
+        /* keep the failed batches in the order they were filled */
+        batch->rc = rc;
+        zkUA_BulkBatch **pos = &publisher->failed;
+        while (*pos && (*pos)->sequence < batch->sequence)
+            pos = &(*pos)->next;
+        batch->next = *pos;
+        *pos = batch;
+    }
+    pthread_cond_broadcast(&publisher->cond);
+}
+
+/* Completion of the zoo_multi of a batch */
+static void zkUA_BulkBatch_completion(int rc, const void *data) {
+    zkUA_BulkBatch *batch = (zkUA_BulkBatch *) data;
+    zkUA_BulkPublisher *publisher = batch->publisher;
+    pthread_mutex_lock(&publisher->mutex);
+    zkUA_BulkPublisher_complete(publisher, batch, rc);
+    pthread_mutex_unlock(&publisher->mutex);
+}
+
+/* Sends a batch. Mutex must be held. It is kept until the request is queued, so
+ batches reach zk in the order they are sent. */
+static void zkUA_BulkPublisher_send(zkUA_BulkPublisher *publisher,
+        zkUA_BulkBatch *batch) {
+    for (size_t i = 0; i < batch->opsSize; i++) {
+        zkUA_BulkOp *op = &batch->ops[i];
+        if (op->set)
+            zoo_set_op_init(&batch->zooOps[i], op->path, op->data,
+                    op->dataLength, -1, &op->stat);
+        else
+            zoo_create_op_init(&batch->zooOps[i], op->path, op->data,
+                    op->dataLength, &ZOO_OPEN_ACL_UNSAFE, 0, batch->pathBuffer,
+                    sizeof(batch->pathBuffer));
+    }
+    memset(batch->results, 0, batch->opsSize * sizeof(zoo_op_result_t));
+    batch->alone = (publisher->inFlight == 0);
+    publisher->inFlight++;
+    int rc = zoo_amulti(publisher->zh, (int) batch->opsSize, batch->zooOps,
+            batch->results, zkUA_BulkBatch_completion, batch);
+    if (rc != ZOK)
+        zkUA_BulkPublisher_complete(publisher, batch, rc);
+}
+
+/* Returns the index of the op a failed batch failed on (the others report ZOK or
+ ZRUNTIMEINCONSISTENCY), or its number of ops if it failed without an op error, e.g.
+ on a connection loss */
+static size_t zkUA_BulkBatch_failedOp(const zkUA_BulkBatch *batch) {
+    size_t failed = 0;
+    while (failed < batch->opsSize
+            && (batch->results[failed].err == ZOK
+                    || batch->results[failed].err == ZRUNTIMEINCONSISTENCY))
+        failed++;
+    return failed;
+}
+
+/* Prepares a failed batch to be sent again by dropping the op that failed. If its
+ znode exists, the later creates whose znodes exist are dropped as well. If its
+ parent does not exist it is only dropped from the oldest failed batch: the parent
+ of a later one may be created by an earlier failed batch. A batch that failed
+ without an op error is sent again as it is. Only such failures of a batch sent on
+ its own count as attempts (see zkUA_BulkPublisher_resume), its znodes are given up
+ after ZKUA_BULK_MAX_ATTEMPTS of them.
+ Returns the number of znodes given up. */
+static size_t zkUA_BulkBatch_repair(zkUA_BulkPublisher *publisher,
+        zkUA_BulkBatch *batch, UA_Boolean oldest) {
+    size_t failed = zkUA_BulkBatch_failedOp(batch);
+    if (failed == batch->opsSize) {
+        if (!batch->alone || ++batch->attempts < ZKUA_BULK_MAX_ATTEMPTS)
+            return 0;
+        fprintf(stderr,
+                "zkUA_BulkBatch_repair: Giving up %lu znodes after %d attempts - rc = %d\n",
+                (unsigned long) batch->opsSize, batch->attempts, batch->rc);
+        size_t dropped = batch->opsSize;
+        while (batch->opsSize > 0)
+            zkUA_BulkBatch_drop(batch, batch->opsSize - 1);
+        return dropped;
+    }
+    int err = batch->results[failed].err;
+    if (err == ZNONODE && !oldest)
+        return 0;
+    size_t dropped = 0;
+    if (err == ZNODEEXISTS) {
+        /* the ops before it were applied, so their znodes did not exist */
+        for (size_t i = batch->opsSize - 1; i > failed; i--) {
+            struct Stat stat;
+            if (!batch->ops[i].set
+                    && zoo_exists(publisher->zh, batch->ops[i].path, 0, &stat)
+                            == ZOK)
+                zkUA_BulkBatch_drop(batch, i);
+        }
+    } else {
+        fprintf(stderr,
+                "zkUA_BulkBatch_repair: Could not publish %s - rc = %d\n",
+                batch->ops[failed].path, err);
+        dropped++;
+    }
+    zkUA_BulkBatch_drop(batch, failed);
+    return dropped;
+}
+
+/* Repairs the failed batches and sends them again in order. Called with the mutex
+ held once no batch is in flight, i.e. every batch after the last committed one has
+ completed. The mutex is released while batches are repaired (which may contact zk),
+ other threads don't send batches meanwhile.
+ A connection loss fails every batch in flight, although one of them may have caused
+ it (e.g. by exceeding jute.maxbuffer). A batch that failed without an op error is
+ therefore sent on its own, so that only its own failures count against it: the
+ batches before it are sent first, it and the batches after it are left failed for
+ a later round. */
+static void zkUA_BulkPublisher_resume(zkUA_BulkPublisher *publisher) {
+    zkUA_BulkBatch *batch = publisher->failed;
+    publisher->failed = NULL;
+    publisher->resuming = true;
+    pthread_mutex_unlock(&publisher->mutex);
+    zkUA_BulkBatch *resend = NULL, **tail = &resend;
+    size_t dropped = 0;
+    for (UA_Boolean oldest = true; batch; oldest = false) {
+        UA_Boolean opError = zkUA_BulkBatch_failedOp(batch) < batch->opsSize;
+        if (!opError && resend)
+            break;
+        zkUA_BulkBatch *next = batch->next;
+        batch->next = NULL;
+        dropped += zkUA_BulkBatch_repair(publisher, batch, oldest);
+        if (batch->opsSize > 0) {
+            *tail = batch;
+            tail = &batch->next;
+        } else
+            zkUA_BulkBatch_delete(batch);
+        batch = next;
+        if (!opError)
+            break;
+    }
+    pthread_mutex_lock(&publisher->mutex);
+    /* nothing was in flight, so the batches left are the only failed ones */
+    publisher->failed = batch;
+    publisher->dropped += dropped;
+    while (resend) {
+        zkUA_BulkBatch *next = resend->next;
+        resend->next = NULL;
+        while (publisher->inFlight >= publisher->maxInFlight)
+            pthread_cond_wait(&publisher->cond, &publisher->mutex);
+        zkUA_BulkPublisher_send(publisher, resend);
+        resend = next;
+    }
+    publisher->resuming = false;
+    pthread_cond_broadcast(&publisher->cond);
+}
+
+/* Blocks until a new batch may be sent, resuming after failed batches first.
+ Mutex must be held. */
+static void zkUA_BulkPublisher_waitToSend(zkUA_BulkPublisher *publisher) {
+    while (publisher->resuming || publisher->failed
+            || publisher->inFlight >= publisher->maxInFlight) {
+        if (!publisher->resuming && publisher->failed
+                && publisher->inFlight == 0)
+            zkUA_BulkPublisher_resume(publisher);
+        else
+            pthread_cond_wait(&publisher->cond, &publisher->mutex);
+    }
+}
+
+void zkUA_BulkPublisher_init(zkUA_BulkPublisher *publisher, zhandle_t *zh,
+        size_t batchesInFlight) {
+    memset(publisher, 0, sizeof(zkUA_BulkPublisher));
+    publisher->zh = zh;
+    pthread_mutex_init(&publisher->mutex, NULL);
+    pthread_cond_init(&publisher->cond, NULL);
+    publisher->maxInFlight =
+            (batchesInFlight > 0) ?
+                    batchesInFlight : ZKUA_DEFAULT_BULK_BATCHES_IN_FLIGHT;
+}
+
+/* Sends the open batch and blocks until every batch has been committed or given up.
+ Mutex must be held. */
+static void zkUA_BulkPublisher_drain(zkUA_BulkPublisher *publisher) {
+    if (publisher->open) {
+        zkUA_BulkPublisher_waitToSend(publisher);
+        if (publisher->open) {
+            zkUA_BulkPublisher_send(publisher, publisher->open);
+            publisher->open = NULL;
+        }
+    }
+    while (publisher->resuming || publisher->failed || publisher->inFlight > 0) {
+        if (!publisher->resuming && publisher->failed
+                && publisher->inFlight == 0)
+            zkUA_BulkPublisher_resume(publisher);
+        else
+            pthread_cond_wait(&publisher->cond, &publisher->mutex);
+    }
+}
+
+/* Writes the data of a znode too large for a batch to chunk znodes (see
+ zk_payloadStore.h), which creates the znode, so that only the manifest is set in a
+ batch. The parent may be created by a batch that is not committed yet, so the
+ publisher is drained first. A znode that exists already is left as it is. Returns
+ false (and frees the data) if there is nothing to publish. */
+static UA_Boolean zkUA_BulkPublisher_storeChunks(zkUA_BulkPublisher *publisher,
+        const char *path, char **data, int *dataLength) {
+    pthread_mutex_lock(&publisher->mutex);
+    zkUA_BulkPublisher_drain(publisher);
+    pthread_mutex_unlock(&publisher->mutex);
+    struct Stat stat;
+    int rc = zoo_exists(publisher->zh, path, 0, &stat);
+    if (rc == ZOK) {
+        free(*data);
+        return false;
+    }
+    char *nodePath = strdup(path);
+    UA_Boolean stored = (rc == ZNONODE
+            && zkUA_storeNodePayload(nodePath, data, dataLength)
+                    == UA_STATUSCODE_GOOD
+            && zkUA_BulkOp_bytes(path, *dataLength) <= ZKUA_BULK_BATCH_BYTES);
+    free(nodePath);
+    if (stored)
+        return true;
+    fprintf(stderr,
+            "zkUA_BulkPublisher_storeChunks: Could not publish %s of %d bytes - rc = %d\n",
+            path, *dataLength, rc);
+    free(*data);
+    pthread_mutex_lock(&publisher->mutex);
+    publisher->dropped++;
+    pthread_mutex_unlock(&publisher->mutex);
+    return false;
+}
+
+void zkUA_BulkPublisher_create(zkUA_BulkPublisher *publisher, const char *path,
+        char *data, int dataLength) {
+    size_t bytes = zkUA_BulkOp_bytes(path, dataLength);
+    UA_Boolean set = false;
+    if (bytes > ZKUA_BULK_BATCH_BYTES) {
+        if (!zkUA_BulkPublisher_storeChunks(publisher, path, &data,
+                &dataLength))
+            return;
+        bytes = zkUA_BulkOp_bytes(path, dataLength);
+        set = true;
+    }
+    pthread_mutex_lock(&publisher->mutex);
+    /* An op that does not fit sends the open batch (but always fits into an empty
+     one, larger ones were chunked above) */
+    while (publisher->open
+            && (publisher->open->opsSize == ZKUA_BULK_BATCH_OPS
+                    || publisher->open->bytes + bytes > ZKUA_BULK_BATCH_BYTES)) {
+        zkUA_BulkPublisher_waitToSend(publisher);
+        /* another thread may have sent it meanwhile */
+        if (publisher->open
+                && (publisher->open->opsSize == ZKUA_BULK_BATCH_OPS
+                        || publisher->open->bytes + bytes
+                                > ZKUA_BULK_BATCH_BYTES)) {
+            zkUA_BulkPublisher_send(publisher, publisher->open);
+            publisher->open = NULL;
+        }
+    }
+    if (!publisher->open)
+        publisher->open = zkUA_BulkBatch_new(publisher);
+    zkUA_BulkOp *op = &publisher->open->ops[publisher->open->opsSize++];
+    op->path = strdup(path);
+    op->data = data;
+    op->dataLength = dataLength;
+    op->set = set;
+    publisher->open->bytes += bytes;
+    pthread_mutex_unlock(&publisher->mutex);
+}
+
+size_t zkUA_BulkPublisher_flush(zkUA_BulkPublisher *publisher) {
+    pthread_mutex_lock(&publisher->mutex);
+    zkUA_BulkPublisher_drain(publisher);
+    size_t dropped = publisher->dropped;
+    fprintf(stderr,
+            "zkUA_BulkPublisher_flush: Created %lu znodes in %lu batches, %lu could not be created\n",
+            (unsigned long) publisher->committed,
+            (unsigned long) publisher->sequence, (unsigned long) dropped);
+    pthread_mutex_unlock(&publisher->mutex);
+    return dropped;
+}
+
+void zkUA_BulkPublisher_deleteMembers(zkUA_BulkPublisher *publisher) {
+    zkUA_BulkPublisher_flush(publisher);
+    pthread_cond_destroy(&publisher->cond);
+    pthread_mutex_destroy(&publisher->mutex);
+}
@@ -43,6 +43,7 @@ int write(int _Filehandle, const void * _Buf, unsigned int _MaxCharCount);
 #include <time.h>
 #include <errno.h>
 #include <assert.h>
+#include <pthread.h>
 
 #ifdef YCA
 #include <yca/yca.h>
@@ -50,6 +51,11 @@ int write(int _Filehandle, const void * _Buf, unsigned int _MaxCharCount);
 
 #include <zk_cli.h>
 #include <zk_global.h>
+#include <zk_mzxidTable.h>
+#include <zk_payload.h>
+#include <zk_payloadStore.h>
+#include <zk_deltaReplicate.h>
+#include <zk_znodePath.h>
 
 #define _LL_CAST_ (long long)
 
@@ -66,42 +72,51 @@ static int recvd = 0;
 static int shutdownThisThing = 0;
 
 char zkUA_zkServerAddressSpacePath[1024];
-struct hashtable *nodeMzxid;
 UA_Server *uaServerGlobal;
+/* Last ZooKeeper session state delivered to a watcher (0 until the first session event) */
+static int zkUA_sessionState = 0;
+/* Thread the zk client library dispatches watchers and completions on */
+static pthread_t zkUA_completionThread;
+static int zkUA_completionThreadSet = 0;
 
 /* Initializes the global UA_Server variable */
 void zkUA_initializeUaServerGlobal(void *server) {
     uaServerGlobal = (UA_Server *) server;
 }
 
-/* Functions for manipulating the mzxid hashtable */
-/* Free's the hashtable and any remaining values in it */
-void zkUA_destroyHashtable() {
-    hashtable_destroy(nodeMzxid, 1);
+/* Functions for tracking the ZooKeeper session state */
+/* Records the session state delivered with a ZOO_SESSION_EVENT */
+void zkUA_updateSessionState(int state) {
+    /* Session events are delivered on the completion thread, so remember it */
+    if (!__atomic_load_n(&zkUA_completionThreadSet, __ATOMIC_ACQUIRE)) {
+        zkUA_completionThread = pthread_self();
+        __atomic_store_n(&zkUA_completionThreadSet, 1, __ATOMIC_RELEASE);
+    }
+    __atomic_store_n(&zkUA_sessionState, state, __ATOMIC_RELEASE);
 }
-/* Mzxid hashtable getter function */
-void *zkUA_returnHashtable() {
-    return (void *) nodeMzxid;
+/* Returns the last recorded session state */
+int zkUA_getSessionState() {
+    return __atomic_load_n(&zkUA_sessionState, __ATOMIC_ACQUIRE);
 }
-/* Key generating (string hashing) function for mzxid hashtable */
-unsigned int zkUA_hash(void *str) { /* source: http://www.cse.yorku.ca/~oz/hash.html  */
-    unsigned int hash = 5381;
-    int c;
-    char *string = (char *) str;
-    while ((c = *string++)) {
-        hash = ((hash << 5) + hash) + c; /* hash * 33 + c */
-    }
-    return hash;
+/* Returns true if called from the thread that runs zk watchers and completions */
+UA_Boolean zkUA_onCompletionThread() {
+    if (!__atomic_load_n(&zkUA_completionThreadSet, __ATOMIC_ACQUIRE))
+        return false;
+    return pthread_equal(zkUA_completionThread, pthread_self()) ? true : false;
 }
-/* Function to determine key equality */
-int zkUA_equalKeys(void *k1, void *k2) {
-    return (0 == memcmp(k1, k2, sizeof(unsigned long)));
+/* Returns true if the last session event reported a connected session */
+UA_Boolean zkUA_sessionConnected() {
+    return (zkUA_getSessionState() == ZOO_CONNECTED_STATE) ? true : false;
+}
+
+/* Functions for manipulating the mzxid table */
+/* Free's the mzxid table */
+void zkUA_destroyHashtable() {
+    zkUA_destroyMzxidTable();
 }
-/* Function to initialize mzxid hashtable */
+/* Function to initialize the mzxid table */
 void zkUA_initializeHashmap() {
-    nodeMzxid = create_hashtable(16, zkUA_hash, zkUA_equalKeys);
-    if (NULL == nodeMzxid)
-        exit(-1);
+    zkUA_initializeMzxidTable(ZKUA_MZXIDTABLE_MIN_CAPACITY);
 }
 
 /* Functions for manipulating the ZooKeeper address space path */
@@ -111,14 +126,10 @@ char *zkUA_zkServAddSpacePath() {
 }
 /* Creates a string with the path for an OPC UA node on ZooKeeper. */
 char *zkUA_encodeZnodePath(const UA_NodeId *nodeId) {
-    /* TODO: support encoding of different identifier types: string, guid, etc. */
-    char *nodeZkPath = calloc(65535, sizeof(char));
-    char *nodeValue = calloc(65535, sizeof(char));
-    snprintf(nodeValue, 65535, "ns=%d;i=%d", nodeId->namespaceIndex,
-            nodeId->identifier.numeric);
-    snprintf(nodeZkPath, 65535, "%s/%s", zkUA_zkServAddSpacePath(), nodeValue);
-    free(nodeValue);
-    return nodeZkPath;
+    char nodeZkPath[ZKUA_ZNODE_PATH_MAX];
+    if (!zkUA_formatZnodePath(nodeId, nodeZkPath, sizeof(nodeZkPath)))
+        return NULL;
+    return strdup(nodeZkPath);
 }
 /* Initialize zkServerAddressSpacePath string and the path on zookeeper */
 void zkUA_initializeZkServAddSpacePath(char *groupGuid, zhandle_t *zh) {
@@ -174,6 +185,17 @@ void free_zkUAConfigs(zkUA_Config *zkUAConfigs) {
     free(zkUAConfigs->zooKeeperQuorum);
 }
 
+/* Decodes a read consistency level from a config file value */
+int zkUA_readConsistencyFromString(const char *level) {
+    if (zkUA_startsWith(level, "local"))
+        return ZKUA_READ_LOCAL;
+    else if (zkUA_startsWith(level, "session"))
+        return ZKUA_READ_SESSION;
+    else if (zkUA_startsWith(level, "linearizable"))
+        return ZKUA_READ_LINEARIZABLE;
+    return -1;
+}
+
 /* Function to read the user-supplied config file */
 void zkUA_readConfFile(char *confFileName, zkUA_Config *zkUAConfigs) {
     /* Read conf file */
@@ -202,6 +224,24 @@ void zkUA_readConfFile(char *confFileName, zkUA_Config *zkUAConfigs) {
     /* Buffer for decoded availabilityPriority parameter */
     UA_Boolean *aPriority = &zkUAConfigs->aPriority;
     *aPriority = false;
+    /* Default read consistency keeps reads gated on the zk session */
+    zkUAConfigs->readConsistency = ZKUA_READ_SESSION;
+    zkUAConfigs->nsReadConsistencySize = 0;
+    /* 0 keeps the default replication window */
+    zkUAConfigs->replicationWindow = 0;
+    /* 0 fetches the znodes of the address space one at a time */
+    zkUAConfigs->bootstrapPipelineDepth = 0;
+    /* New znodes are written as JSON unless configured otherwise */
+    zkUAConfigs->payloadFormat = ZKUA_PAYLOAD_JSON;
+    zkUAConfigs->payloadVersion = ZKUA_PAYLOAD_VERSION;
+    zkUAConfigs->payloadCompression = ZKUA_COMPRESSION_NONE;
+    zkUAConfigs->compressionThreshold = ZKUA_DEFAULT_COMPRESSION_THRESHOLD;
+    zkUAConfigs->chunkSize = ZKUA_DEFAULT_CHUNK_SIZE;
+    zkUAConfigs->deltaCompaction = ZKUA_DEFAULT_DELTA_COMPACTION;
+    zkUAConfigs->valueZnodes = false;
+    zkUAConfigs->transactionalWrites = false;
+    /* A client crawls the address space with a single session */
+    zkUAConfigs->crawlSessions = 1;
     zkUAConfigs->hostname = calloc(65535, sizeof(char));
     zkUAConfigs->username = calloc(65535, sizeof(char));
     zkUAConfigs->password = calloc(65535, sizeof(char));
@@ -301,6 +341,126 @@ void zkUA_readConfFile(char *confFileName, zkUA_Config *zkUAConfigs) {
                 *aPriority = true;
             } else
                 *aPriority = false;
+        } else if (zkUA_startsWith(argument, "ReadConsistencyNs")) {
+            /* Per-namespace override in the form <nsIndex>:<level> */
+            char *sep = strchr(argValue, ':');
+            int level = sep ? zkUA_readConsistencyFromString(sep + 1) : -1;
+            if (level < 0
+                    || zkUAConfigs->nsReadConsistencySize
+                            >= ZKUA_MAX_NSREADCONSISTENCY) {
+                fprintf(stderr,
+                        "zkUA_readServerConfFile: Ignoring ReadConsistencyNs %s\n",
+                        argValue);
+            } else {
+                zkUA_NsReadConsistency *nsLevel =
+                        &zkUAConfigs->nsReadConsistency[zkUAConfigs->nsReadConsistencySize++];
+                nsLevel->nsIndex = (UA_UInt16) strtoul(argValue, NULL, 10);
+                nsLevel->level = level;
+                fprintf(stderr,
+                        "zkUA_readServerConfFile: confFile ReadConsistencyNs ns=%d level %d\n",
+                        nsLevel->nsIndex, nsLevel->level);
+            }
+        } else if (zkUA_startsWith(argument, "ReadConsistency")) {
+            int level = zkUA_readConsistencyFromString(argValue);
+            if (level < 0) {
+                fprintf(stderr,
+                        "zkUA_readServerConfFile: Unknown ReadConsistency %s - using session\n",
+                        argValue);
+                level = ZKUA_READ_SESSION;
+            }
+            zkUAConfigs->readConsistency = level;
+            fprintf(stderr,
+                    "zkUA_readServerConfFile: confFile ReadConsistency %d\n",
+                    level);
+        } else if (zkUA_startsWith(argument, "ReplicationWindow")) {
+            zkUAConfigs->replicationWindow = strtoul(argValue, NULL, 10);
+            fprintf(stderr,
+                    "zkUA_readServerConfFile: confFile ReplicationWindow %lu\n",
+                    zkUAConfigs->replicationWindow);
+        } else if (zkUA_startsWith(argument, "BootstrapPipelineDepth")) {
+            zkUAConfigs->bootstrapPipelineDepth = strtoul(argValue, NULL, 10);
+            fprintf(stderr,
+                    "zkUA_readServerConfFile: confFile BootstrapPipelineDepth %lu\n",
+                    zkUAConfigs->bootstrapPipelineDepth);
+        } else if (zkUA_startsWith(argument, "PayloadVersion")) {
+            zkUAConfigs->payloadVersion = atoi(argValue);
+            if (zkUAConfigs->payloadVersion < 1
+                    || zkUAConfigs->payloadVersion > ZKUA_PAYLOAD_VERSION) {
+                fprintf(stderr,
+                        "zkUA_readServerConfFile: Unsupported PayloadVersion %s - using %d\n",
+                        argValue, ZKUA_PAYLOAD_VERSION);
+                zkUAConfigs->payloadVersion = ZKUA_PAYLOAD_VERSION;
+            }
+            fprintf(stderr,
+                    "zkUA_readServerConfFile: confFile PayloadVersion %d\n",
+                    zkUAConfigs->payloadVersion);
+        } else if (zkUA_startsWith(argument, "PayloadFormat")) {
+            int format = zkUA_payloadFormatFromString(argValue);
+            if (format < 0) {
+                fprintf(stderr,
+                        "zkUA_readServerConfFile: Unknown PayloadFormat %s - using json\n",
+                        argValue);
+                format = ZKUA_PAYLOAD_JSON;
+            }
+            zkUAConfigs->payloadFormat = format;
+            fprintf(stderr,
+                    "zkUA_readServerConfFile: confFile PayloadFormat %d\n",
+                    format);
+        } else if (zkUA_startsWith(argument, "PayloadCompression")) {
+            int compression = zkUA_payloadCompressionFromString(argValue);
+            if (compression < 0) {
+                fprintf(stderr,
+                        "zkUA_readServerConfFile: Unknown PayloadCompression %s - using none\n",
+                        argValue);
+                compression = ZKUA_COMPRESSION_NONE;
+            }
+            zkUAConfigs->payloadCompression = compression;
+            fprintf(stderr,
+                    "zkUA_readServerConfFile: confFile PayloadCompression %d\n",
+                    compression);
+        } else if (zkUA_startsWith(argument, "CompressionThreshold")) {
+            zkUAConfigs->compressionThreshold = strtoul(argValue, NULL, 10);
+            fprintf(stderr,
+                    "zkUA_readServerConfFile: confFile CompressionThreshold %lu\n",
+                    zkUAConfigs->compressionThreshold);
+        } else if (zkUA_startsWith(argument, "ChunkSize")) {
+            zkUAConfigs->chunkSize = strtoul(argValue, NULL, 10);
+            if (zkUAConfigs->chunkSize == 0) {
+                fprintf(stderr,
+                        "zkUA_readServerConfFile: Invalid ChunkSize %s - using %d\n",
+                        argValue, ZKUA_DEFAULT_CHUNK_SIZE);
+                zkUAConfigs->chunkSize = ZKUA_DEFAULT_CHUNK_SIZE;
+            }
+            fprintf(stderr,
+                    "zkUA_readServerConfFile: confFile ChunkSize %lu\n",
+                    zkUAConfigs->chunkSize);
+        } else if (zkUA_startsWith(argument, "DeltaCompaction")) {
+            /* 0 replicates every write in full */
+            zkUAConfigs->deltaCompaction = strtoul(argValue, NULL, 10);
+            fprintf(stderr,
+                    "zkUA_readServerConfFile: confFile DeltaCompaction %lu\n",
+                    zkUAConfigs->deltaCompaction);
+        } else if (zkUA_startsWith(argument, "ValueZnodes")) {
+            if (zkUA_startsWith(argValue, "true")) {
+                zkUAConfigs->valueZnodes = true;
+            } else
+                zkUAConfigs->valueZnodes = false;
+        } else if (zkUA_startsWith(argument, "TransactionalWrites")) {
+            if (zkUA_startsWith(argValue, "true")) {
+                zkUAConfigs->transactionalWrites = true;
+            } else
+                zkUAConfigs->transactionalWrites = false;
+        } else if (zkUA_startsWith(argument, "CrawlSessions")) {
+            zkUAConfigs->crawlSessions = strtoul(argValue, NULL, 10);
+            if (zkUAConfigs->crawlSessions == 0) {
+                fprintf(stderr,
+                        "zkUA_readServerConfFile: Invalid CrawlSessions %s - using 1\n",
+                        argValue);
+                zkUAConfigs->crawlSessions = 1;
+            }
+            fprintf(stderr,
+                    "zkUA_readServerConfFile: confFile CrawlSessions %lu\n",
+                    zkUAConfigs->crawlSessions);
         } else if (zkUA_startsWith(argument, "Username")) {
             memcpy(username, argValue, 65535);
             fprintf(stderr, "zkUA_readServerConfFile: confFile username %s\n",
@@ -449,6 +609,7 @@ void zkUA_watcher(zhandle_t *zzh, int type, int state, const char *path,
     fprintf(stderr, "\n");
 
     if (type == ZOO_SESSION_EVENT) {
+        zkUA_updateSessionState(state);
         if (state == ZOO_CONNECTED_STATE) {
             const clientid_t *id = zoo_client_id(zzh);
             if (myid.client_id == 0 || myid.client_id != id->client_id) {
@@ -16,266 +16,281 @@
  ******************************************************************************/
 #include <zk_clientReplicate.h>
 #include <stdio.h>
+#include <stddef.h>
 #include <assert.h>
 #include <simple_parse.h>
 #include <stdlib.h>
+#include <pthread.h>
 #include <zk_cli.h>
 #include <zk_global.h>
-#include <jansson.h>
-/* currently limiting the number of nodes that can be recursively browsed to 10000 */
-int visitedCntr = 0, n = 300, visitedNodeID[300];
+#include <zk_znodePath.h>
+#include <zk_nodeIdSet.h>
+#include <zk_bulkPublish.h>
+#include <zk_payload.h>
 UA_Client *client = NULL;
-/* The server path on zk */
-char *zkServerPath;
 zhandle_t *zkHandle; // The zk server's handle;
 size_t id = 70000;
+/* Most ReadValueIds sent in one ReadRequest - the server's MaxNodesPerRead */
+static size_t maxNodesPerRead = ZKUA_DEFAULT_MAX_NODES_PER_READ;
+/* Most nodes browsed in one BrowseRequest - the server's MaxNodesPerBrowse */
+static size_t maxNodesPerBrowse = ZKUA_DEFAULT_MAX_NODES_PER_BROWSE;
+/* Guards maxNodesPerRead, which the sessions of a parallel crawl may lower */
+static pthread_mutex_t readLimitLock = PTHREAD_MUTEX_INITIALIZER;
+
+/* Returns the server's operation limit (a UInt32 variable of its
+ OperationLimits object) if it is set and lower than limit, limit otherwise */
+static size_t zkUA_readOperationLimit(UA_Client *UAclient, UA_UInt32 limitId,
+        size_t limit) {
+    UA_Variant value;
+    UA_Variant_init(&value);
+    if (UA_Client_readValueAttribute(UAclient, UA_NODEID_NUMERIC(0, limitId),
+            &value) == UA_STATUSCODE_GOOD && UA_Variant_isScalar(&value)
+            && value.type == &UA_TYPES[UA_TYPES_UINT32]
+            && *(UA_UInt32 *) value.data > 0
+            && *(UA_UInt32 *) value.data < limit)
+        limit = *(UA_UInt32 *) value.data;
+    UA_Variant_deleteMembers(&value);
+    return limit;
+}
 
 /* Initializes variables needed for a client to recursively browse an OPC UA Server */
 void zkUA_initRecursive(UA_Client *UAclient) {
-    /* TODO: malloc/realloc instead of having a static array for node IDs */
-    /* initialize visitedNodeID */
-    int j;
-    for (j = 0; j < n; j++)
-        visitedNodeID[j] = 0;
     /* initialize client var */
     client = UAclient;
+    /* Batched reads and browses send up to as many operations as the server allows */
+    maxNodesPerRead = zkUA_readOperationLimit(client,
+            UA_NS0ID_SERVER_SERVERCAPABILITIES_OPERATIONLIMITS_MAXNODESPERREAD,
+            ZKUA_DEFAULT_MAX_NODES_PER_READ);
+    maxNodesPerBrowse = zkUA_readOperationLimit(client,
+            UA_NS0ID_SERVER_SERVERCAPABILITIES_OPERATIONLIMITS_MAXNODESPERBROWSE,
+            ZKUA_DEFAULT_MAX_NODES_PER_BROWSE);
+}
+
+/* An attribute read for a nodeClass and where its value is stored in the
+ nodeClass's attributes struct */
+typedef struct zkUA_AttributeField {
+    UA_AttributeId attributeId;
+    size_t offset; /* of the member in the attributes struct */
+    size_t arraySizeOffset; /* of the array size member of array attributes, 0 otherwise */
+    const UA_DataType *type; /* of a scalar member, NULL for the value */
+} zkUA_AttributeField;
+
+#define ZKUA_ATTRIBUTE(STRUCT, ATTRIBUTE, MEMBER, TYPE) \
+    { UA_ATTRIBUTEID_##ATTRIBUTE, offsetof(STRUCT, MEMBER), 0, \
+            &UA_TYPES[UA_TYPES_##TYPE] }
+#define ZKUA_COMMON_ATTRIBUTES(STRUCT) \
+    ZKUA_ATTRIBUTE(STRUCT, DISPLAYNAME, displayName, LOCALIZEDTEXT), \
+    ZKUA_ATTRIBUTE(STRUCT, DESCRIPTION, description, LOCALIZEDTEXT), \
+    ZKUA_ATTRIBUTE(STRUCT, WRITEMASK, writeMask, UINT32), \
+    ZKUA_ATTRIBUTE(STRUCT, USERWRITEMASK, userWriteMask, UINT32)
+#define ZKUA_VALUE_ATTRIBUTES(STRUCT) \
+    { UA_ATTRIBUTEID_VALUE, offsetof(STRUCT, value), 0, NULL }, \
+    ZKUA_ATTRIBUTE(STRUCT, DATATYPE, dataType, NODEID), \
+    ZKUA_ATTRIBUTE(STRUCT, VALUERANK, valueRank, INT32), \
+    { UA_ATTRIBUTEID_ARRAYDIMENSIONS, offsetof(STRUCT, arrayDimensions), \
+            offsetof(STRUCT, arrayDimensionsSize), &UA_TYPES[UA_TYPES_UINT32] }
+
+static const zkUA_AttributeField viewFields[] = {
+    ZKUA_COMMON_ATTRIBUTES(UA_ViewAttributes),
+    ZKUA_ATTRIBUTE(UA_ViewAttributes, CONTAINSNOLOOPS, containsNoLoops, BOOLEAN),
+    ZKUA_ATTRIBUTE(UA_ViewAttributes, EVENTNOTIFIER, eventNotifier, BYTE) };
+static const zkUA_AttributeField variableFields[] = {
+    ZKUA_COMMON_ATTRIBUTES(UA_VariableAttributes),
+    ZKUA_VALUE_ATTRIBUTES(UA_VariableAttributes),
+    ZKUA_ATTRIBUTE(UA_VariableAttributes, ACCESSLEVEL, accessLevel, BYTE),
+    ZKUA_ATTRIBUTE(UA_VariableAttributes, USERACCESSLEVEL, userAccessLevel, BYTE),
+    ZKUA_ATTRIBUTE(UA_VariableAttributes, MINIMUMSAMPLINGINTERVAL,
+            minimumSamplingInterval, DOUBLE),
+    ZKUA_ATTRIBUTE(UA_VariableAttributes, HISTORIZING, historizing, BOOLEAN) };
+static const zkUA_AttributeField variableTypeFields[] = {
+    ZKUA_COMMON_ATTRIBUTES(UA_VariableTypeAttributes),
+    ZKUA_VALUE_ATTRIBUTES(UA_VariableTypeAttributes),
+    ZKUA_ATTRIBUTE(UA_VariableTypeAttributes, ISABSTRACT, isAbstract, BOOLEAN) };
+static const zkUA_AttributeField referenceTypeFields[] = {
+    ZKUA_COMMON_ATTRIBUTES(UA_ReferenceTypeAttributes),
+    ZKUA_ATTRIBUTE(UA_ReferenceTypeAttributes, ISABSTRACT, isAbstract, BOOLEAN),
+    ZKUA_ATTRIBUTE(UA_ReferenceTypeAttributes, SYMMETRIC, symmetric, BOOLEAN),
+    ZKUA_ATTRIBUTE(UA_ReferenceTypeAttributes, INVERSENAME, inverseName,
+            LOCALIZEDTEXT) };
+static const zkUA_AttributeField objectTypeFields[] = {
+    ZKUA_COMMON_ATTRIBUTES(UA_ObjectTypeAttributes),
+    ZKUA_ATTRIBUTE(UA_ObjectTypeAttributes, ISABSTRACT, isAbstract, BOOLEAN) };
+static const zkUA_AttributeField dataTypeFields[] = {
+    ZKUA_COMMON_ATTRIBUTES(UA_DataTypeAttributes),
+    ZKUA_ATTRIBUTE(UA_DataTypeAttributes, ISABSTRACT, isAbstract, BOOLEAN) };
+static const zkUA_AttributeField methodFields[] = {
+    ZKUA_COMMON_ATTRIBUTES(UA_MethodAttributes),
+    ZKUA_ATTRIBUTE(UA_MethodAttributes, EXECUTABLE, executable, BOOLEAN),
+    ZKUA_ATTRIBUTE(UA_MethodAttributes, USEREXECUTABLE, userExecutable, BOOLEAN) };
+static const zkUA_AttributeField objectFields[] = {
+    ZKUA_COMMON_ATTRIBUTES(UA_ObjectAttributes),
+    ZKUA_ATTRIBUTE(UA_ObjectAttributes, EVENTNOTIFIER, eventNotifier, BYTE) };
+
+/* Returns the attributes read for a nodeClass, NULL for an unknown nodeClass */
+static const zkUA_AttributeField *zkUA_attributeFields(UA_NodeClass nodeClass,
+        size_t *fieldsSize) {
+#define ZKUA_FIELDS(FIELDS) \
+    *fieldsSize = sizeof(FIELDS) / sizeof(FIELDS[0]); \
+    return FIELDS
+    switch (nodeClass) {
+    case UA_NODECLASS_VIEW:
+        ZKUA_FIELDS(viewFields);
+    case UA_NODECLASS_VARIABLE:
+        ZKUA_FIELDS(variableFields);
+    case UA_NODECLASS_VARIABLETYPE:
+        ZKUA_FIELDS(variableTypeFields);
+    case UA_NODECLASS_REFERENCETYPE:
+        ZKUA_FIELDS(referenceTypeFields);
+    case UA_NODECLASS_OBJECTTYPE:
+        ZKUA_FIELDS(objectTypeFields);
+    case UA_NODECLASS_DATATYPE:
+        ZKUA_FIELDS(dataTypeFields);
+    case UA_NODECLASS_METHOD:
+        ZKUA_FIELDS(methodFields);
+    case UA_NODECLASS_OBJECT:
+        ZKUA_FIELDS(objectFields);
+    case UA_NODECLASS_UNSPECIFIED:
+    default:
+        *fieldsSize = 0;
+        return NULL;
+    }
+#undef ZKUA_FIELDS
 }
 
-/* Checks to see if we've browsed the same node ID twice */
-void zkUA_checkduplicate() {
-    int j, k;
-    for (j = 0; j < visitedCntr; j++) {
-        for (k = 0; k < visitedCntr; k++) {
-            if (j != k) {
-                if ((visitedNodeID[j] == visitedNodeID[k])
-                        && (visitedNodeID[j] != 0))
-                    fprintf(stderr,
-                            "This Node ID has been visited twice: %d <-> %d\n",
-                            visitedNodeID[j], visitedNodeID[k]);
+/* Moves a read attribute into its member of the attributes struct. Attributes that
+ could not be read or have an unexpected type leave the member untouched. */
+static void zkUA_scatterAttribute(const zkUA_AttributeField *field,
+        void *attributes, UA_DataValue *res) {
+    if ((res->hasStatus && res->status != UA_STATUSCODE_GOOD) || !res->hasValue)
+        return;
+    char *member = (char *) attributes + field->offset;
+    if (field->type == NULL) { /* the value is the variant itself */
+        memcpy(member, &res->value, sizeof(UA_Variant));
+        UA_Variant_init(&res->value);
+    } else if (field->arraySizeOffset) {
+        /* array dimensions are sent as UInt32 or (by older servers) Int32 */
+        if (UA_Variant_isScalar(&res->value)
+                || (res->value.type != field->type
+                        && res->value.type != &UA_TYPES[UA_TYPES_INT32]))
+            return;
+        *(void **) member = res->value.data;
+        *(size_t *) ((char *) attributes + field->arraySizeOffset) =
+                res->value.arrayLength;
+        res->value.data = NULL;
+        res->value.arrayLength = 0;
+    } else if (UA_Variant_isScalar(&res->value)
+            && res->value.type == field->type) {
+        memcpy(member, res->value.data, field->type->memSize);
+        UA_free(res->value.data);
+        res->value.data = NULL;
+    }
+}
+
+/* Sends one ReadRequest and scatters its results. A server that refuses the
+ number of operations gets them in halves. */
+static UA_StatusCode zkUA_readAttributeBatch(UA_Client *UAclient,
+        UA_ReadValueId *items, const zkUA_AttributeField **fields,
+        void **targets, size_t itemsSize) {
+    UA_ReadRequest request;
+    UA_ReadRequest_init(&request);
+    request.nodesToRead = items;
+    request.nodesToReadSize = itemsSize;
+    request.timestampsToReturn = UA_TIMESTAMPSTORETURN_NEITHER;
+    UA_ReadResponse response = UA_Client_Service_read(UAclient, request);
+    UA_StatusCode retval = response.responseHeader.serviceResult;
+    if (retval == UA_STATUSCODE_BADTOOMANYOPERATIONS && itemsSize > 1) {
+        UA_ReadResponse_deleteMembers(&response);
+        size_t half = itemsSize / 2;
+        pthread_mutex_lock(&readLimitLock);
+        if (half < maxNodesPerRead)
+            maxNodesPerRead = half;
+        pthread_mutex_unlock(&readLimitLock);
+        retval = zkUA_readAttributeBatch(UAclient, items, fields, targets,
+                half);
+        if (retval == UA_STATUSCODE_GOOD)
+            retval = zkUA_readAttributeBatch(UAclient, items + half,
+                    fields + half, targets + half, itemsSize - half);
+        return retval;
+    }
+    if (retval == UA_STATUSCODE_GOOD && response.resultsSize != itemsSize)
+        retval = UA_STATUSCODE_BADUNEXPECTEDERROR;
+    if (retval == UA_STATUSCODE_GOOD) {
+        for (size_t i = 0; i < itemsSize; i++)
+            zkUA_scatterAttribute(fields[i], targets[i], &response.results[i]);
+    } else
+        fprintf(stderr, "zkUA_readAttributeBatch: Read of %lu attributes failed: 0x%08x\n",
+                (unsigned long) itemsSize, retval);
+    UA_ReadResponse_deleteMembers(&response);
+    return retval;
+}
+
+UA_StatusCode zkUA_ReadAttributesBatch(UA_Client *UAclient,
+        zkUA_AttributeRead *reads, size_t readsSize) {
+
+    pthread_mutex_lock(&readLimitLock);
+    size_t max = maxNodesPerRead;
+    pthread_mutex_unlock(&readLimitLock);
+    UA_ReadValueId *items = calloc(max, sizeof(UA_ReadValueId));
+    const zkUA_AttributeField **fields = calloc(max,
+            sizeof(zkUA_AttributeField *));
+    void **targets = calloc(max, sizeof(void *));
+    size_t itemsSize = 0;
+    UA_StatusCode retval = UA_STATUSCODE_GOOD;
+    /* A node's attributes may be split over two requests */
+    for (size_t i = 0; i < readsSize && retval == UA_STATUSCODE_GOOD; i++) {
+        size_t fieldsSize;
+        const zkUA_AttributeField *classFields = zkUA_attributeFields(
+                reads[i].nodeClass, &fieldsSize);
+        if (!classFields)
+            fprintf(stderr, "zkUA_ReadAttributesBatch: Bad nodeClass error!\n");
+        for (size_t f = 0; f < fieldsSize && retval == UA_STATUSCODE_GOOD;
+                f++) {
+            UA_ReadValueId_init(&items[itemsSize]);
+            items[itemsSize].nodeId = *reads[i].nodeId; /* not copied - the request is not deleted */
+            items[itemsSize].attributeId = classFields[f].attributeId;
+            fields[itemsSize] = &classFields[f];
+            targets[itemsSize] = reads[i].attributes;
+            if (++itemsSize == max) {
+                retval = zkUA_readAttributeBatch(UAclient, items, fields,
+                        targets, itemsSize);
+                itemsSize = 0;
             }
         }
     }
+    if (retval == UA_STATUSCODE_GOOD && itemsSize > 0)
+        retval = zkUA_readAttributeBatch(UAclient, items, fields, targets,
+                itemsSize);
+    free(items);
+    free(fields);
+    free(targets);
+    return retval;
 }
 
 /**
  * zkUA_ReadAttributes:
- * This function reads all of the attributes of a given node.
- * The functions called are dependent on the node's nodeClass.
+ * This function reads all of the attributes of a given node in one request.
+ * The attributes read are dependent on the node's nodeClass.
  * Retrieved attributes are stored in the nodeClass's attributes
  * struct, which is provided by the calling function.
  */
 void zkUA_ReadAttributes(UA_Client *UAclient, UA_ReferenceDescription *childRef,
         void *attributes) {
-
-    /* Based on UA_Client_NamespaceGetIndex function */
-    UA_ReadRequest request;
-    UA_ReadRequest_init(&request);
-    /* Create a UA_NodeId and fill it in from childRef */
-    UA_NodeId readNode = childRef->nodeId.nodeId;
-
-    /* Fill provided node based on the node class */
-    UA_NodeClass nodeClass = childRef->nodeClass;
-    switch (nodeClass) {
-    case UA_NODECLASS_VIEW: {
-        /* The attributes for a view node. */
-        UA_ViewAttributes *viewAttributes = (UA_ViewAttributes *) attributes;
-        UA_Client_readDisplayNameAttribute(UAclient, readNode,
-                &viewAttributes->displayName);
-        UA_Client_readDescriptionAttribute(UAclient, readNode,
-                &viewAttributes->description);
-        UA_Client_readWriteMaskAttribute(UAclient, readNode,
-                &viewAttributes->writeMask);
-        UA_Client_readUserWriteMaskAttribute(UAclient, readNode,
-                &viewAttributes->userWriteMask);
-        UA_Client_readContainsNoLoopsAttribute(UAclient, readNode,
-                &viewAttributes->containsNoLoops);
-        UA_Client_readEventNotifierAttribute(UAclient, readNode,
-                &viewAttributes->eventNotifier);
-        break;
-    }
-    case UA_NODECLASS_VARIABLE: {
-        /* Variable has a little more than VariableType
-         so if this matches, could just move along afterwards to the VariableType case */
-        UA_VariableAttributes *varAttributes =
-                (UA_VariableAttributes *) attributes;
-        UA_Client_readDisplayNameAttribute(UAclient, readNode,
-                &varAttributes->displayName);
-        UA_Client_readDescriptionAttribute(UAclient, readNode,
-                &varAttributes->description);
-        UA_Client_readWriteMaskAttribute(UAclient, readNode,
-                &varAttributes->writeMask);
-        UA_Client_readUserWriteMaskAttribute(UAclient, readNode,
-                &varAttributes->userWriteMask);
-        UA_Client_readValueAttribute(UAclient, readNode, &varAttributes->value);
-        UA_Client_readDataTypeAttribute(UAclient, readNode,
-                &varAttributes->dataType);
-        UA_Client_readValueRankAttribute(UAclient, readNode,
-                &varAttributes->valueRank);
-        UA_Client_readArrayDimensionsAttribute(UAclient, readNode,
-                (UA_Int32 **) &varAttributes->arrayDimensions,
-                &varAttributes->arrayDimensionsSize);
-        UA_Client_readAccessLevelAttribute(UAclient, readNode,
-                &varAttributes->accessLevel);
-        UA_Client_readUserAccessLevelAttribute(UAclient, readNode,
-                &varAttributes->userAccessLevel);
-        UA_Client_readMinimumSamplingIntervalAttribute(UAclient, readNode,
-                &varAttributes->minimumSamplingInterval);
-        UA_Client_readHistorizingAttribute(UAclient, readNode,
-                &varAttributes->historizing);
-        break;
-    }
-    case UA_NODECLASS_VARIABLETYPE: {
-        UA_VariableTypeAttributes *varTypeAttributes =
-                (UA_VariableTypeAttributes *) attributes;
-        UA_Client_readDisplayNameAttribute(UAclient, readNode,
-                &varTypeAttributes->displayName);
-        UA_Client_readDescriptionAttribute(UAclient, readNode,
-                &varTypeAttributes->description);
-        UA_Client_readWriteMaskAttribute(UAclient, readNode,
-                &varTypeAttributes->writeMask);
-        UA_Client_readUserWriteMaskAttribute(UAclient, readNode,
-                &varTypeAttributes->userWriteMask);
-        UA_Client_readValueAttribute(UAclient, readNode,
-                &varTypeAttributes->value);
-        UA_Client_readDataTypeAttribute(UAclient, readNode,
-                &varTypeAttributes->dataType);
-        UA_Client_readValueRankAttribute(UAclient, readNode,
-                &varTypeAttributes->valueRank);
-        UA_Client_readArrayDimensionsAttribute(UAclient, readNode,
-                (UA_Int32 **) &varTypeAttributes->arrayDimensions,
-                &varTypeAttributes->arrayDimensionsSize);
-        UA_Client_readIsAbstractAttribute(UAclient, readNode,
-                &varTypeAttributes->isAbstract);
-        break;
-    }
-    case UA_NODECLASS_REFERENCETYPE: {
-        UA_ReferenceTypeAttributes *refTypeAttributes =
-                (UA_ReferenceTypeAttributes *) attributes;
-        UA_Client_readDisplayNameAttribute(UAclient, readNode,
-                &refTypeAttributes->displayName);
-        UA_Client_readDescriptionAttribute(UAclient, readNode,
-                &refTypeAttributes->description);
-        UA_Client_readWriteMaskAttribute(UAclient, readNode,
-                &refTypeAttributes->writeMask);
-        UA_Client_readUserWriteMaskAttribute(UAclient, readNode,
-                &refTypeAttributes->userWriteMask);
-        UA_Client_readIsAbstractAttribute(UAclient, readNode,
-                &refTypeAttributes->isAbstract);
-        UA_Client_readSymmetricAttribute(UAclient, readNode,
-                &refTypeAttributes->symmetric);
-        UA_Client_readInverseNameAttribute(UAclient, readNode,
-                &refTypeAttributes->inverseName);
-        break;
-    }
-    case UA_NODECLASS_OBJECTTYPE:
-    case UA_NODECLASS_DATATYPE: {
-        /* ObjectType and DataType nodes have the same attributes - should use a struct union instead.*/
-        UA_DataTypeAttributes *dataTypeAttributes =
-                (UA_DataTypeAttributes *) attributes;
-        UA_Client_readDisplayNameAttribute(UAclient, readNode,
-                &dataTypeAttributes->displayName);
-        UA_Client_readDescriptionAttribute(UAclient, readNode,
-                &dataTypeAttributes->description);
-        UA_Client_readWriteMaskAttribute(UAclient, readNode,
-                &dataTypeAttributes->writeMask);
-        UA_Client_readUserWriteMaskAttribute(UAclient, readNode,
-                &dataTypeAttributes->userWriteMask);
-        UA_Client_readIsAbstractAttribute(UAclient, readNode,
-                &dataTypeAttributes->isAbstract);
-        break;
-    }
-    case UA_NODECLASS_METHOD: {
-        UA_MethodAttributes *methodAttributes =
-                (UA_MethodAttributes *) attributes;
-        UA_Client_readDisplayNameAttribute(UAclient, readNode,
-                &methodAttributes->displayName);
-        UA_Client_readDescriptionAttribute(UAclient, readNode,
-                &methodAttributes->description);
-        UA_Client_readWriteMaskAttribute(UAclient, readNode,
-                &methodAttributes->writeMask);
-        UA_Client_readUserWriteMaskAttribute(UAclient, readNode,
-                &methodAttributes->userWriteMask);
-        UA_Client_readExecutableAttribute(UAclient, readNode,
-                &methodAttributes->executable);
-        UA_Client_readUserExecutableAttribute(UAclient, readNode,
-                &methodAttributes->userExecutable);
-        break;
-    }
-    case UA_NODECLASS_OBJECT: {
-        UA_ObjectAttributes *objectAttributes =
-                (UA_ObjectAttributes *) attributes;
-        UA_Client_readDisplayNameAttribute(UAclient, readNode,
-                &objectAttributes->displayName);
-        UA_Client_readDescriptionAttribute(UAclient, readNode,
-                &objectAttributes->description);
-        UA_Client_readWriteMaskAttribute(UAclient, readNode,
-                &objectAttributes->writeMask);
-        UA_Client_readUserWriteMaskAttribute(UAclient, readNode,
-                &objectAttributes->userWriteMask);
-        UA_Client_readEventNotifierAttribute(UAclient, readNode,
-                &objectAttributes->eventNotifier);
-        break;
-    }
-    case UA_NODECLASS_UNSPECIFIED:
-    default:
-        fprintf(stderr, "zkUA_ReadAttributes: Bad nodeClass error!\n");
-        break;
-    }
+    zkUA_AttributeRead read = { &childRef->nodeId.nodeId, childRef->nodeClass,
+            attributes };
+    zkUA_ReadAttributesBatch(UAclient, &read, 1);
 }
 
-/* Browse a node and print out the results. */
+/* Browse a node (forward and inverse references). */
 void zkUA_BrowseFolder(UA_Client *UAclient, UA_NodeId *browseNode,
         UA_BrowseResponse *bResp) {
-    /* Browse some objects */
     UA_BrowseRequest bReq;
     UA_BrowseRequest_init(&bReq);
     bReq.requestedMaxReferencesPerNode = 0;
     bReq.nodesToBrowse = UA_BrowseDescription_new();
     bReq.nodesToBrowseSize = 1;
-    bReq.nodesToBrowse[0].nodeId = *browseNode; /* browse folder of 'browseNode' */
+    UA_NodeId_copy(browseNode, &bReq.nodesToBrowse[0].nodeId); /* browse folder of 'browseNode' */
     bReq.nodesToBrowse[0].resultMask = UA_BROWSERESULTMASK_ALL; /* return everything */
     *bResp = UA_Client_Service_browse(UAclient, bReq);
-
-    /* Proceed if the browse showed the node has children*/
-    if (bResp->results[0].referencesSize > 0) {
-        /* print out the results */
-        printf("%-9s %-16s %-16s %-16s\n", "NAMESPACE", "NODEID", "BROWSE NAME",
-                "DISPLAY NAME");
-        for (size_t k = 0; k < bResp->resultsSize; ++k) {
-            for (size_t j = 0; j < bResp->results[k].referencesSize; ++j) {
-                UA_ReferenceDescription *ref =
-                        &(bResp->results[k].references[j]);
-                if (ref->nodeId.nodeId.identifierType
-                        == UA_NODEIDTYPE_NUMERIC) {
-                    printf("%-9d %-16d %-16.*s %-16.*s\n",
-                            ref->browseName.namespaceIndex,
-                            ref->nodeId.nodeId.identifier.numeric,
-                            (int) ref->browseName.name.length,
-                            ref->browseName.name.data,
-                            (int) ref->displayName.text.length,
-                            ref->displayName.text.data);
-                } else if (ref->nodeId.nodeId.identifierType
-                        == UA_NODEIDTYPE_STRING) {
-                    printf("%-9d %-16.*s %-16.*s %-16.*s\n",
-                            ref->browseName.namespaceIndex,
-                            (int) ref->nodeId.nodeId.identifier.string.length,
-                            ref->nodeId.nodeId.identifier.string.data,
-                            (int) ref->browseName.name.length,
-                            ref->browseName.name.data,
-                            (int) ref->displayName.text.length,
-                            ref->displayName.text.data);
-                }
-                /* TODO: distinguish further types */
-                else if (ref->nodeId.nodeId.identifierType
-                        == UA_NODEIDTYPE_GUID) {
-                    printf("Node ID Type GUID\n");
-                } else if (ref->nodeId.nodeId.identifierType
-                        == UA_NODEIDTYPE_BYTESTRING) {
-                    printf("Node ID Type ByteString\n");
-                }
-            }
-        }
-    }
     UA_BrowseRequest_deleteMembers(&bReq);
 }
 
@@ -300,265 +315,505 @@ int zkUA_hierarchicalReference(int identifierNumeric) {
 
 }
 
-/* Recursively browse an OPC UA address space, encode unqiue nodes into JSON
- * and push to ZooKeeper.
- */
-UA_StatusCode zkUA_BrowseFolder_recursive(UA_NodeId childId,
-        UA_Boolean isInverse, UA_NodeId referenceTypeId, void *handle) {
-    /* Browse in the inverse direction */
-    if (isInverse) {
-        return UA_STATUSCODE_GOOD;
-    }
+/* A node found by browsing a level that is still to be read and pushed to zk */
+typedef struct zkUA_CrawlChild {
+    UA_ReferenceDescription ref; /* the reference to it from its parent */
+    size_t parent; /* index of the parent in the browsed level */
+} zkUA_CrawlChild;
 
-    zkUA_NodeId *zkparent = (zkUA_NodeId *) handle;
-    UA_NodeId *parent = zkparent->node;
-    printf("%d, %d --- %d ---> NodeId %d, %d\n", parent->namespaceIndex,
-            parent->identifier.numeric, referenceTypeId.identifier.numeric,
-            childId.namespaceIndex, childId.identifier.numeric);
+/* Returns the attributes struct of a nodeClass, NULL if there is none */
+static const UA_DataType *zkUA_attributesType(UA_NodeClass nodeClass) {
+    switch (nodeClass) {
+    case UA_NODECLASS_OBJECT:
+        return &UA_TYPES[UA_TYPES_OBJECTATTRIBUTES];
+    case UA_NODECLASS_METHOD:
+        return &UA_TYPES[UA_TYPES_METHODATTRIBUTES];
+    case UA_NODECLASS_VIEW:
+        return &UA_TYPES[UA_TYPES_VIEWATTRIBUTES];
+    case UA_NODECLASS_VARIABLE:
+        return &UA_TYPES[UA_TYPES_VARIABLEATTRIBUTES];
+    case UA_NODECLASS_VARIABLETYPE:
+        return &UA_TYPES[UA_TYPES_VARIABLETYPEATTRIBUTES];
+    case UA_NODECLASS_REFERENCETYPE:
+        return &UA_TYPES[UA_TYPES_REFERENCETYPEATTRIBUTES];
+    case UA_NODECLASS_OBJECTTYPE:
+        return &UA_TYPES[UA_TYPES_OBJECTTYPEATTRIBUTES];
+    case UA_NODECLASS_DATATYPE:
+        return &UA_TYPES[UA_TYPES_DATATYPEATTRIBUTES];
+    case UA_NODECLASS_UNSPECIFIED:
+    default:
+        return NULL;
+    }
+}
 
-    /* Browse/push its children only if we've never seen this node before */
-    for (size_t j = 0; j < n; j++) {
-        if (visitedNodeID[j] == childId.identifier.numeric) {
-            return UA_STATUSCODE_GOOD;
+/* Moves the forward references to unvisited nodes out of a browse result.
+ visitedLock guards visited if it is shared by the sessions of a parallel crawl. */
+static void zkUA_collectChildren(UA_BrowseResult *result, size_t parent,
+        zkUA_NodeIdSet *visited, pthread_mutex_t *visitedLock,
+        zkUA_CrawlChild **children, size_t *childrenSize, size_t *childrenCap) {
+    if (visitedLock)
+        pthread_mutex_lock(visitedLock);
+    for (size_t j = 0; j < result->referencesSize; ++j) {
+        UA_ReferenceDescription *ref = &result->references[j];
+        /* Only nodes that were never visited are crawled */
+        if (!ref->isForward
+                || !zkUA_NodeIdSet_insert(visited, &ref->nodeId.nodeId))
+            continue;
+        if (*childrenSize == *childrenCap) {
+            *childrenCap = *childrenCap ? 2 * *childrenCap : 64;
+            *children = realloc(*children,
+                    *childrenCap * sizeof(zkUA_CrawlChild));
         }
+        (*children)[*childrenSize].ref = *ref;
+        (*children)[*childrenSize].parent = parent;
+        (*childrenSize)++;
+        UA_ReferenceDescription_init(ref);
     }
-    /* Browse parent to get this child's name */
-    UA_BrowseResponse bResp_parent;
-    zkUA_BrowseFolder(client, parent, &bResp_parent);
-    if (bResp_parent.responseHeader.serviceResult != UA_STATUSCODE_GOOD)
-        printf("bResp_parent for Node Id %d was not GOOD\n",
-                parent->identifier.numeric);
-    else
-        printf("bResp_parent returned resultsSize = %lu\n",
-                bResp_parent.resultsSize);
-
-    /* Allocate space for the child's browse path and REST URI*/
-    char *zkChildBrowsePath = (char *) calloc(65535, sizeof(char));
-    char * zkChildRestPath = (char *) calloc(65535, sizeof(char));
-    /* Find the child's browse name in the response */
-    for (size_t k = 0; k < bResp_parent.resultsSize; ++k) {
-        for (size_t j = 0; j < bResp_parent.results[k].referencesSize; ++j) {
-            UA_ReferenceDescription *child_ref =
-                    &(bResp_parent.results[k].references[j]);
-            /* TODO: handle the various types of nodeID identifiers */
-            if (child_ref->nodeId.nodeId.identifierType
-                    == UA_NODEIDTYPE_NUMERIC) {
-                if (child_ref->nodeId.nodeId.identifier.numeric
-                        == childId.identifier.numeric) {
-                    /* create the browse path of the child
-                     fill it with the child's (not child's child's) browse path */
-                    snprintf(zkChildBrowsePath, 65535, "%s/%.*s",
-                            zkparent->browsePath,
-                            (int) child_ref->browseName.name.length,
-                            child_ref->browseName.name.data);
-                    fprintf(stderr, "The browse path is %s\n",
-                            zkChildBrowsePath);
-                    /* Not the best way around things but... correct the size of the browse path free'ing memory */
-                    zkChildBrowsePath = realloc(zkChildBrowsePath,
-                            (strlen(zkChildBrowsePath) + 1) * sizeof(char));
-                    /* Initialize path for the node in the form
-                     * serverAddress/ns=namespaceIndex;nodeIdType=nodeId
-                     * Inspired by Issue 99 of open62541 */
-                    char *RESTbuffer = (char *) calloc(65535, sizeof(char));
-                    snprintf(RESTbuffer, 65535, "ns=%d;i=%d",
-                            child_ref->nodeId.nodeId.namespaceIndex,
-                            child_ref->nodeId.nodeId.identifier.numeric);
-                    snprintf(zkChildRestPath, 65535, "%s/%s", zkServerPath,
-                            RESTbuffer);
-                    free(RESTbuffer);
-                    zkChildRestPath = realloc(zkChildRestPath,
-                            (strlen(zkChildRestPath) + 1) * sizeof(char));
-                    fprintf(stderr, "The RESTful path is %s\n",
-                            zkChildRestPath);
-                    /* Get the attributes of the node */
-                    /* Initialize the json object that will hold the encoded attributes */
-                    json_t *jsonAttributes = json_object();
-                    /* This should work as long as the nodeClass is not UA_NODECLASS_UNSPECIFIED */
-                    switch (child_ref->nodeClass) {
-                    case UA_NODECLASS_OBJECT: {
-                        UA_ObjectAttributes nodeAttributes;
-                        UA_ObjectAttributes_init(&nodeAttributes);
-                        zkUA_ReadAttributes(client, child_ref, &nodeAttributes);
-                        zkUA_jsonEncodeAttributes(child_ref, &nodeAttributes,
-                                jsonAttributes);
-                        UA_ObjectAttributes_deleteMembers(&nodeAttributes);
-                        break;
-                    }
-                    case UA_NODECLASS_METHOD: {
-                        UA_MethodAttributes nodeAttributes;
-                        UA_MethodAttributes_init(&nodeAttributes);
-                        zkUA_ReadAttributes(client, child_ref, &nodeAttributes);
-                        zkUA_jsonEncodeAttributes(child_ref, &nodeAttributes,
-                                jsonAttributes);
-                        UA_MethodAttributes_deleteMembers(&nodeAttributes);
-                        break;
-                    }
-                    case UA_NODECLASS_VIEW: {
-                        UA_ViewAttributes nodeAttributes;
-                        UA_ViewAttributes_init(&nodeAttributes);
-                        zkUA_ReadAttributes(client, child_ref, &nodeAttributes);
-                        zkUA_jsonEncodeAttributes(child_ref, &nodeAttributes,
-                                jsonAttributes);
-                        UA_ViewAttributes_deleteMembers(&nodeAttributes);
-                        break;
-                    }
-                    case UA_NODECLASS_VARIABLE: {
-                        UA_VariableAttributes nodeAttributes;
-                        UA_VariableAttributes_init(&nodeAttributes);
-                        zkUA_ReadAttributes(client, child_ref, &nodeAttributes);
-                        zkUA_jsonEncodeAttributes(child_ref, &nodeAttributes,
-                                jsonAttributes);
-                        UA_VariableAttributes_deleteMembers(&nodeAttributes);
-                        break;
-                    }
-                    case UA_NODECLASS_VARIABLETYPE: {
-                        UA_VariableTypeAttributes nodeAttributes;
-                        UA_VariableTypeAttributes_init(&nodeAttributes);
-                        zkUA_ReadAttributes(client, child_ref, &nodeAttributes);
-                        zkUA_jsonEncodeAttributes(child_ref, &nodeAttributes,
-                                jsonAttributes);
-                        UA_VariableTypeAttributes_deleteMembers(
-                                &nodeAttributes);
-                        break;
-                    }
-                    case UA_NODECLASS_REFERENCETYPE: {
-                        UA_ReferenceTypeAttributes nodeAttributes;
-                        UA_ReferenceTypeAttributes_init(&nodeAttributes);
-                        zkUA_ReadAttributes(client, child_ref, &nodeAttributes);
-                        zkUA_jsonEncodeAttributes(child_ref, &nodeAttributes,
-                                jsonAttributes);
-                        UA_ReferenceTypeAttributes_deleteMembers(
-                                &nodeAttributes);
-                        break;
-                    }
-                    case UA_NODECLASS_OBJECTTYPE: {
-                        UA_ObjectTypeAttributes nodeAttributes;
-                        UA_ObjectTypeAttributes_init(&nodeAttributes);
-                        zkUA_ReadAttributes(client, child_ref, &nodeAttributes);
-                        zkUA_jsonEncodeAttributes(child_ref, &nodeAttributes,
-                                jsonAttributes);
-                        UA_ObjectTypeAttributes_deleteMembers(&nodeAttributes);
-                        break;
-                    }
-                    case UA_NODECLASS_DATATYPE: {
-                        UA_DataTypeAttributes nodeAttributes;
-                        UA_DataTypeAttributes_init(&nodeAttributes);
-                        zkUA_ReadAttributes(client, child_ref, &nodeAttributes);
-                        zkUA_jsonEncodeAttributes(child_ref, &nodeAttributes,
-                                jsonAttributes);
-                        UA_DataTypeAttributes_deleteMembers(&nodeAttributes);
-                        break;
-                    }
-                    case UA_NODECLASS_UNSPECIFIED:
-                    default:
-                        printf("nodeAttributes not initialized");
-                        break;
-                    }
-                    /* Package all of the attributes and references for zookeeper */
-                    json_t *nodePack = json_object();
-                    json_t *nodeId = json_object();
-                    zkUA_jsonEncode_UA_NodeId(&childId, nodeId);
-                    json_t *nodeClass = json_integer(child_ref->nodeClass);
-                    json_t *browsePath = json_string(zkChildBrowsePath);
-                    json_t *restPath = json_string(zkChildRestPath);
-
-                    json_t *parentNodeId = json_object();
-                    zkUA_jsonEncode_UA_NodeId(parent, parentNodeId);
-                    json_t *parentReferenceNodeId = json_object();
-                    zkUA_jsonEncode_UA_NodeId(&referenceTypeId,
-                            parentReferenceNodeId);
-
-                    json_t *nodeInfo = json_object();
-
-                    json_object_set_new(nodeInfo, "NodeId", nodeId);
-                    json_object_set_new(nodeInfo, "NodeClass", nodeClass);
-                    json_object_set_new(nodeInfo, "parentNodeId", parentNodeId);
-                    json_object_set_new(nodeInfo, "parentReferenceNodeId",
-                            parentReferenceNodeId);
-                    json_object_set_new(nodeInfo, "BrowsePath", browsePath);
-                    json_object_set_new(nodeInfo, "restPath", restPath);
-
-                    json_object_set_new(nodePack, "NodeInfo", nodeInfo);
-                    json_object_set_new(nodePack, "Attributes", jsonAttributes);
-                    /* push the browse path to zk with its attributes and references*/
-                    char *s = json_dumps(nodePack, JSON_INDENT(1));
-                    if (!s) {
-                        fprintf(stderr, "json_dumps failed\n");
-                    } else {
-                        int flags = 0;
-                        int rc = zoo_acreate(zkHandle, zkChildRestPath, s,
-                                strlen(s), &ZOO_OPEN_ACL_UNSAFE, flags,
-                                zkUA_my_string_completion_free_data,
-                                strdup(zkChildRestPath));
-                        if (rc) {
-                            fprintf(stderr, "Error %d for %s\n", rc,
-                                    zkChildRestPath);
-                        } else {
-                        }
-                    }
-                    /* If push is successful -> this node has now been visited */
-                    /* TODO: visitedNodeId array should hold namespaceIndex and identifier (multiple types) */
-                    visitedNodeID[visitedCntr++] = childId.identifier.numeric;
-                    /* memory clean up */
-                    free(s);
-                    json_decref(nodePack);
+    if (visitedLock)
+        pthread_mutex_unlock(visitedLock);
+}
+
+/* Browses the nodes of a level with BrowseRequests of up to maxNodesPerBrowse nodes
+ and collects their unvisited children. References a server returns in parts are
+ fetched with BrowseNext. */
+static void zkUA_browseLevel(UA_Client *UAclient, const zkUA_NodeId *level,
+        size_t levelSize, zkUA_NodeIdSet *visited, pthread_mutex_t *visitedLock,
+        zkUA_CrawlChild **children, size_t *childrenSize) {
+    size_t childrenCap = 0;
+    UA_BrowseDescription *descr = calloc(maxNodesPerBrowse,
+            sizeof(UA_BrowseDescription));
+    UA_ByteString *points = calloc(maxNodesPerBrowse, sizeof(UA_ByteString));
+    size_t *owners = calloc(maxNodesPerBrowse, sizeof(size_t)); /* level index of each result */
+    *children = NULL;
+    *childrenSize = 0;
+    for (size_t first = 0; first < levelSize; first += maxNodesPerBrowse) {
+        size_t count = levelSize - first;
+        if (count > maxNodesPerBrowse)
+            count = maxNodesPerBrowse;
+        for (size_t i = 0; i < count; i++) {
+            UA_BrowseDescription_init(&descr[i]);
+            descr[i].nodeId = *level[first + i].node; /* not copied - the request is not deleted */
+            descr[i].browseDirection = UA_BROWSEDIRECTION_FORWARD;
+            descr[i].resultMask = UA_BROWSERESULTMASK_ALL;
+            owners[i] = first + i;
+        }
+        UA_BrowseRequest bReq;
+        UA_BrowseRequest_init(&bReq);
+        bReq.requestedMaxReferencesPerNode = ZKUA_MAX_REFERENCES_PER_BROWSE;
+        bReq.nodesToBrowse = descr;
+        bReq.nodesToBrowseSize = count;
+        UA_BrowseResponse bResp = UA_Client_Service_browse(UAclient, bReq);
+        UA_StatusCode retval = bResp.responseHeader.serviceResult;
+        UA_BrowseResult *results = bResp.results;
+        size_t resultsSize = bResp.resultsSize;
+        bResp.results = NULL;
+        bResp.resultsSize = 0;
+        UA_BrowseResponse_deleteMembers(&bResp);
+        if (retval == UA_STATUSCODE_GOOD && resultsSize != count)
+            retval = UA_STATUSCODE_BADUNEXPECTEDERROR;
+        while (retval == UA_STATUSCODE_GOOD) {
+            size_t pointsSize = 0;
+            for (size_t r = 0; r < resultsSize; r++) {
+                zkUA_collectChildren(&results[r], owners[r], visited,
+                        visitedLock, children, childrenSize, &childrenCap);
+                if (results[r].continuationPoint.length > 0) {
+                    points[pointsSize] = results[r].continuationPoint;
+                    owners[pointsSize++] = owners[r];
                 }
-            } else if (child_ref->nodeId.nodeId.identifierType
-                    == UA_NODEIDTYPE_STRING) {
-                printf(
-                        "The nodeId.identifierType for %s/%.*s is a string type\n",
-                        zkparent->browsePath,
-                        (int) child_ref->browseName.name.length,
-                        child_ref->browseName.name.data);
             }
+            if (pointsSize == 0)
+                break;
+            UA_BrowseNextRequest nReq;
+            UA_BrowseNextRequest_init(&nReq);
+            nReq.continuationPoints = points; /* not copied - the request is not deleted */
+            nReq.continuationPointsSize = pointsSize;
+            UA_BrowseNextResponse nResp = UA_Client_Service_browseNext(UAclient,
+                    nReq);
+            UA_Array_delete(results, resultsSize,
+                    &UA_TYPES[UA_TYPES_BROWSERESULT]);
+            retval = nResp.responseHeader.serviceResult;
+            results = nResp.results;
+            resultsSize = nResp.resultsSize;
+            nResp.results = NULL;
+            nResp.resultsSize = 0;
+            UA_BrowseNextResponse_deleteMembers(&nResp);
+            if (retval == UA_STATUSCODE_GOOD && resultsSize != pointsSize)
+                retval = UA_STATUSCODE_BADUNEXPECTEDERROR;
+        }
+        if (retval != UA_STATUSCODE_GOOD)
+            fprintf(stderr, "zkUA_browseLevel: Browse of %lu nodes failed: 0x%08x\n",
+                    (unsigned long) count, retval);
+        UA_Array_delete(results, resultsSize, &UA_TYPES[UA_TYPES_BROWSERESULT]);
+    }
+    free(descr);
+    free(points);
+    free(owners);
+}
+
+/* Returns the browse path of a child: its parent's browse path and its browse name */
+static char *zkUA_childBrowsePath(const char *parentPath, const UA_String *name) {
+    size_t length = strlen(parentPath) + name->length + 2;
+    char *browsePath = malloc(length);
+    snprintf(browsePath, length, "%s/%.*s", parentPath, (int) name->length,
+            name->data);
+    return browsePath;
+}
+
+/* Reads the attributes of children with batched reads, adds each child to the zk
+ publisher and stores it as a node of the next level */
+static void zkUA_publishChildren(UA_Client *UAclient,
+        zkUA_BulkPublisher *publisher, const zkUA_NodeId *level,
+        zkUA_CrawlChild *children, size_t childrenSize, zkUA_NodeId *next) {
+    zkUA_AttributeRead *reads = calloc(childrenSize, sizeof(zkUA_AttributeRead));
+    for (size_t i = 0; i < childrenSize; i++) {
+        const UA_DataType *type = zkUA_attributesType(children[i].ref.nodeClass);
+        reads[i].nodeId = &children[i].ref.nodeId.nodeId;
+        reads[i].nodeClass = children[i].ref.nodeClass;
+        reads[i].attributes = type ? UA_new(type) : NULL;
+    }
+    zkUA_ReadAttributesBatch(UAclient, reads, childrenSize);
+
+    for (size_t i = 0; i < childrenSize; i++) {
+        UA_ReferenceDescription *child_ref = &children[i].ref;
+        const zkUA_NodeId *zkparent = &level[children[i].parent];
+        /* create the browse path of the child */
+        char *zkChildBrowsePath = zkUA_childBrowsePath(zkparent->browsePath,
+                &child_ref->browseName.name);
+        /* Initialize path for the node in the form
+         * serverAddress/ns=namespaceIndex;nodeIdType=nodeId
+         * Inspired by Issue 99 of open62541 */
+        char zkChildRestPath[ZKUA_ZNODE_PATH_MAX];
+        zkUA_formatZnodePath(&child_ref->nodeId.nodeId, zkChildRestPath,
+                sizeof(zkChildRestPath));
+        /* push the node to zk in the configured payload format, the publisher
+         takes the payload */
+        int length;
+        char *payload = zkUA_encodeNodePayload(zkChildRestPath,
+                child_ref->nodeClass, child_ref->nodeId.nodeId, *zkparent->node,
+                child_ref->referenceTypeId, reads[i].attributes, &length);
+        if (payload)
+            zkUA_BulkPublisher_create(publisher, zkChildRestPath, payload,
+                    length);
+        if (reads[i].attributes)
+            UA_delete(reads[i].attributes,
+                    zkUA_attributesType(child_ref->nodeClass));
+        /* The child's children are browsed with the next level */
+        next[i].node = UA_NodeId_new();
+        UA_NodeId_copy(&child_ref->nodeId.nodeId, next[i].node);
+        next[i].browsePath = zkChildBrowsePath;
+    }
+    free(reads);
+}
+
+static void zkUA_freeLevel(zkUA_NodeId *level, size_t levelSize) {
+    for (size_t i = 0; i < levelSize; i++) {
+        UA_NodeId_delete(level[i].node);
+        free(level[i].browsePath);
+    }
+    free(level);
+}
+
+/* Browses the nodes of a level, pushes their unvisited children to zk and returns
+ the children as the next level of *nextSize nodes */
+static zkUA_NodeId *zkUA_crawlLevel(UA_Client *UAclient,
+        zkUA_BulkPublisher *publisher, const zkUA_NodeId *level,
+        size_t levelSize, zkUA_NodeIdSet *visited, pthread_mutex_t *visitedLock,
+        size_t *nextSize) {
+    zkUA_CrawlChild *children;
+    size_t childrenSize;
+    zkUA_browseLevel(UAclient, level, levelSize, visited, visitedLock,
+            &children, &childrenSize);
+    zkUA_NodeId *next = calloc(childrenSize, sizeof(zkUA_NodeId));
+    for (size_t first = 0; first < childrenSize;
+            first += ZKUA_CRAWL_BATCH_NODES) {
+        size_t count = childrenSize - first;
+        if (count > ZKUA_CRAWL_BATCH_NODES)
+            count = ZKUA_CRAWL_BATCH_NODES;
+        zkUA_publishChildren(UAclient, publisher, level, children + first,
+                count, next + first);
+    }
+    for (size_t i = 0; i < childrenSize; i++)
+        UA_ReferenceDescription_deleteMembers(&children[i].ref);
+    free(children);
+    *nextSize = childrenSize;
+    return next;
+}
+
+/* Returns a level holding a copy of root */
+static zkUA_NodeId *zkUA_rootLevel(const zkUA_NodeId *root) {
+    zkUA_NodeId *level = malloc(sizeof(zkUA_NodeId));
+    level[0].node = UA_NodeId_new();
+    UA_NodeId_copy(root->node, level[0].node);
+    level[0].browsePath = strdup(root->browsePath);
+    return level;
+}
+
+/* Browse an OPC UA address space level by level, encode unique nodes into node
+ * payloads and push to ZooKeeper.
+ */
+void zkUA_BrowseFolder_breadthFirst(UA_Client *UAclient, const zkUA_NodeId *root) {
+    zkUA_NodeId *level = zkUA_rootLevel(root);
+    size_t levelSize = 1;
+    /* The nodes seen by this crawl */
+    zkUA_NodeIdSet visited;
+    zkUA_NodeIdSet_init(&visited);
+    zkUA_NodeIdSet_insert(&visited, root->node);
+    /* The nodes are created on zk with batched zoo_multis */
+    zkUA_BulkPublisher publisher;
+    zkUA_BulkPublisher_init(&publisher, zkHandle, 0);
+    while (levelSize > 0) {
+        size_t nextSize;
+        zkUA_NodeId *next = zkUA_crawlLevel(UAclient, &publisher, level,
+                levelSize, &visited, NULL, &nextSize);
+        fprintf(stderr,
+                "zkUA_BrowseFolder_breadthFirst: Browsed %lu nodes - found %lu new nodes\n",
+                (unsigned long) levelSize, (unsigned long) nextSize);
+        zkUA_freeLevel(level, levelSize);
+        level = next;
+        levelSize = nextSize;
+    }
+    free(level);
+    zkUA_NodeIdSet_deleteMembers(&visited);
+    zkUA_BulkPublisher_deleteMembers(&publisher);
+}
+
+/* A deque of nodes still to be browsed by a session of a parallel crawl. The
+ session takes nodes from the back, idle sessions steal from the front. */
+typedef struct zkUA_CrawlDeque {
+    pthread_mutex_t lock;
+    zkUA_NodeId *nodes; /* nodes[head..tail) */
+    size_t head;
+    size_t tail;
+    size_t capacity;
+} zkUA_CrawlDeque;
+
+/* State shared by the sessions of a parallel crawl */
+typedef struct zkUA_ParallelCrawl {
+    zkUA_CrawlDeque *deques; /* one per session */
+    size_t dequesSize;
+    zkUA_NodeIdSet visited; /* the nodes seen by the crawl, guarded by visitedLock */
+    zkUA_BulkPublisher publisher; /* all sessions add their nodes to it */
+    pthread_mutex_t visitedLock;
+    pthread_mutex_t lock; /* guards pending and generation */
+    pthread_cond_t wake; /* signaled when nodes are pushed or the crawl is done */
+    size_t pending; /* nodes pushed to a deque that were not browsed yet */
+    size_t generation; /* incremented whenever nodes are pushed */
+} zkUA_ParallelCrawl;
+
+typedef struct zkUA_CrawlSession {
+    zkUA_ParallelCrawl *crawl;
+    UA_Client *client;
+    size_t index; /* of the session's deque */
+    pthread_t thread;
+} zkUA_CrawlSession;
+
+/* Moves nodes to the back of a deque */
+static void zkUA_CrawlDeque_push(zkUA_CrawlDeque *deque,
+        const zkUA_NodeId *nodes, size_t nodesSize) {
+    pthread_mutex_lock(&deque->lock);
+    if (deque->tail + nodesSize > deque->capacity) {
+        size_t size = deque->tail - deque->head;
+        memmove(deque->nodes, deque->nodes + deque->head,
+                size * sizeof(zkUA_NodeId));
+        deque->head = 0;
+        deque->tail = size;
+        if (size + nodesSize > deque->capacity) {
+            while (size + nodesSize > deque->capacity)
+                deque->capacity = deque->capacity ? 2 * deque->capacity : 64;
+            deque->nodes = realloc(deque->nodes,
+                    deque->capacity * sizeof(zkUA_NodeId));
+        }
+    }
+    memcpy(deque->nodes + deque->tail, nodes, nodesSize * sizeof(zkUA_NodeId));
+    deque->tail += nodesSize;
+    pthread_mutex_unlock(&deque->lock);
+}
+
+/* Moves up to max nodes from the back of a deque to nodes and returns their number */
+static size_t zkUA_CrawlDeque_pop(zkUA_CrawlDeque *deque, zkUA_NodeId *nodes,
+        size_t max) {
+    pthread_mutex_lock(&deque->lock);
+    size_t count = deque->tail - deque->head;
+    if (count > max)
+        count = max;
+    deque->tail -= count;
+    memcpy(nodes, deque->nodes + deque->tail, count * sizeof(zkUA_NodeId));
+    pthread_mutex_unlock(&deque->lock);
+    return count;
+}
+
+/* Moves half of the nodes (at most max) from the front of another session's deque
+ to nodes and returns their number */
+static size_t zkUA_CrawlDeque_steal(zkUA_CrawlDeque *deque, zkUA_NodeId *nodes,
+        size_t max) {
+    pthread_mutex_lock(&deque->lock);
+    size_t count = (deque->tail - deque->head + 1) / 2;
+    if (count > max)
+        count = max;
+    memcpy(nodes, deque->nodes + deque->head, count * sizeof(zkUA_NodeId));
+    deque->head += count;
+    pthread_mutex_unlock(&deque->lock);
+    return count;
+}
+
+/* Browses nodes of its own deque, or stolen from other deques, with one session
+ until no session has nodes left to browse */
+static void *zkUA_crawlSession(void *data) {
+    zkUA_CrawlSession *session = (zkUA_CrawlSession *) data;
+    zkUA_ParallelCrawl *crawl = session->crawl;
+    zkUA_CrawlDeque *own = &crawl->deques[session->index];
+    zkUA_NodeId *batch = malloc(ZKUA_CRAWL_SESSION_BATCH * sizeof(zkUA_NodeId));
+    size_t browsed = 0, stolen = 0;
+    for (;;) {
+        pthread_mutex_lock(&crawl->lock);
+        size_t generation = crawl->generation;
+        pthread_mutex_unlock(&crawl->lock);
+        size_t batchSize = zkUA_CrawlDeque_pop(own, batch,
+                ZKUA_CRAWL_SESSION_BATCH);
+        for (size_t i = 1; batchSize == 0 && i < crawl->dequesSize; i++) {
+            batchSize = zkUA_CrawlDeque_steal(
+                    &crawl->deques[(session->index + i) % crawl->dequesSize],
+                    batch, ZKUA_CRAWL_SESSION_BATCH);
+            stolen += batchSize;
+        }
+        if (batchSize == 0) {
+            /* Wait until nodes are pushed (unless that happened since the
+             deques were searched) or all nodes are browsed */
+            pthread_mutex_lock(&crawl->lock);
+            while (crawl->pending > 0 && crawl->generation == generation)
+                pthread_cond_wait(&crawl->wake, &crawl->lock);
+            UA_Boolean done = (crawl->pending == 0);
+            pthread_mutex_unlock(&crawl->lock);
+            if (done)
+                break;
+            continue;
+        }
+        size_t nextSize;
+        zkUA_NodeId *next = zkUA_crawlLevel(session->client,
+                &crawl->publisher, batch, batchSize, &crawl->visited,
+                &crawl->visitedLock, &nextSize);
+        zkUA_CrawlDeque_push(own, next, nextSize);
+        free(next);
+        for (size_t i = 0; i < batchSize; i++) {
+            UA_NodeId_delete(batch[i].node);
+            free(batch[i].browsePath);
+        }
+        browsed += batchSize;
+        pthread_mutex_lock(&crawl->lock);
+        crawl->pending = crawl->pending + nextSize - batchSize;
+        if (nextSize > 0)
+            crawl->generation++;
+        if (nextSize > 0 || crawl->pending == 0)
+            pthread_cond_broadcast(&crawl->wake);
+        pthread_mutex_unlock(&crawl->lock);
+    }
+    fprintf(stderr,
+            "zkUA_crawlSession: Session %lu browsed %lu nodes (%lu stolen)\n",
+            (unsigned long) session->index, (unsigned long) browsed,
+            (unsigned long) stolen);
+    free(batch);
+    return NULL;
+}
+
+/* Browse an OPC UA address space with several sessions, encode unique nodes into
+ * node payloads and push to ZooKeeper.
+ */
+void zkUA_BrowseFolder_parallel(UA_Client **UAclients, size_t UAclientsSize,
+        const zkUA_NodeId *root) {
+    if (UAclientsSize <= 1) {
+        zkUA_BrowseFolder_breadthFirst(UAclients[0], root);
+        return;
+    }
+    zkUA_ParallelCrawl crawl;
+    memset(&crawl, 0, sizeof(crawl));
+    zkUA_NodeIdSet_init(&crawl.visited);
+    zkUA_NodeIdSet_insert(&crawl.visited, root->node);
+    zkUA_BulkPublisher_init(&crawl.publisher, zkHandle, 0);
+    pthread_mutex_init(&crawl.visitedLock, NULL);
+    pthread_mutex_init(&crawl.lock, NULL);
+    pthread_cond_init(&crawl.wake, NULL);
+
+    /* Browse the first levels with one session until there are enough nodes to
+     keep all sessions busy */
+    zkUA_NodeId *level = zkUA_rootLevel(root);
+    size_t levelSize = 1;
+    while (levelSize > 0
+            && levelSize < UAclientsSize * ZKUA_CRAWL_SEED_NODES_PER_SESSION) {
+        size_t nextSize;
+        zkUA_NodeId *next = zkUA_crawlLevel(UAclients[0], &crawl.publisher,
+                level, levelSize, &crawl.visited, NULL, &nextSize);
+        fprintf(stderr,
+                "zkUA_BrowseFolder_parallel: Browsed %lu nodes - found %lu new nodes\n",
+                (unsigned long) levelSize, (unsigned long) nextSize);
+        zkUA_freeLevel(level, levelSize);
+        level = next;
+        levelSize = nextSize;
+    }
+
+    /* Deal the frontier out to the sessions' deques */
+    crawl.dequesSize = UAclientsSize;
+    crawl.deques = calloc(UAclientsSize, sizeof(zkUA_CrawlDeque));
+    for (size_t i = 0; i < UAclientsSize; i++) {
+        pthread_mutex_init(&crawl.deques[i].lock, NULL);
+        size_t first = i * levelSize / UAclientsSize;
+        size_t last = (i + 1) * levelSize / UAclientsSize;
+        zkUA_CrawlDeque_push(&crawl.deques[i], level + first, last - first);
+    }
+    free(level);
+    crawl.pending = levelSize;
+    fprintf(stderr,
+            "zkUA_BrowseFolder_parallel: Browsing %lu nodes with %lu sessions\n",
+            (unsigned long) levelSize, (unsigned long) UAclientsSize);
+
+    zkUA_CrawlSession *sessions = calloc(UAclientsSize,
+            sizeof(zkUA_CrawlSession));
+    size_t started = 0;
+    for (; started < UAclientsSize; started++) {
+        sessions[started].crawl = &crawl;
+        sessions[started].client = UAclients[started];
+        sessions[started].index = started;
+        if (pthread_create(&sessions[started].thread, NULL, zkUA_crawlSession,
+                &sessions[started]) != 0) {
+            fprintf(stderr,
+                    "zkUA_BrowseFolder_parallel: Could not start session %lu\n",
+                    (unsigned long) started);
+            break;
         }
     }
-    /* We're done, call the recursive function to browse this node's children */
-    UA_NodeId *parentNew = UA_NodeId_new();
-    /* Create a UA_NodeId struct for the child */
-    *parentNew = UA_NODEID_NUMERIC(childId.namespaceIndex,
-            childId.identifier.numeric);
-    /* Create a struct to hold the UA_NodeId and the browse path of the child */
-    zkUA_NodeId *parentNew_zk = (zkUA_NodeId *) calloc(1, sizeof(zkUA_NodeId));
-    parentNew_zk->node = parentNew;
-    parentNew_zk->browsePath = zkChildBrowsePath;
-    /* Call this function for each of the child's children */
-    UA_Client_forEachChildNodeCall(client, *parentNew,
-            zkUA_BrowseFolder_recursive, (void *) parentNew_zk);
-    /* Free the memory assigned to the child */
-    UA_BrowseResponse_deleteMembers(&bResp_parent);
-    UA_NodeId_delete(parentNew);
-    free(zkChildBrowsePath);
-    free(zkChildRestPath);
-    free(parentNew_zk);
-    return UA_STATUSCODE_GOOD;
+    if (started == 0) /* browse everything on this thread */
+        zkUA_crawlSession(&sessions[0]);
+    for (size_t i = 0; i < started; i++)
+        pthread_join(sessions[i].thread, NULL);
+    free(sessions);
+
+    for (size_t i = 0; i < UAclientsSize; i++) {
+        pthread_mutex_destroy(&crawl.deques[i].lock);
+        free(crawl.deques[i].nodes);
+    }
+    free(crawl.deques);
+    pthread_cond_destroy(&crawl.wake);
+    pthread_mutex_destroy(&crawl.lock);
+    pthread_mutex_destroy(&crawl.visitedLock);
+    zkUA_NodeIdSet_deleteMembers(&crawl.visited);
+    zkUA_BulkPublisher_deleteMembers(&crawl.publisher);
 }
 
 void zkUA_UAServerAddressSpace(zhandle_t *zh, UA_Client *client,
         char *serverAddress, char *groupGuid) {
+    zkUA_UAServerAddressSpace_parallel(zh, &client, 1, serverAddress,
+            groupGuid);
+}
+
+void zkUA_UAServerAddressSpace_parallel(zhandle_t *zh, UA_Client **clients,
+        size_t clientsSize, char *serverAddress, char *groupGuid) {
     zkHandle = zh;
     /* Initialize zkServerAddressSpacePath string and the path on zookeeper */
     zkUA_initializeZkServAddSpacePath(groupGuid, zh);
-    /* Call a recursive browse starting from the zkparent node */
-    /* Recursively browse the server's address space */
-    zkUA_initRecursive(client);
-
-    zkUA_NodeId *zkparent = (zkUA_NodeId *) malloc(sizeof(zkUA_NodeId));
-    UA_NodeId *parent = UA_NodeId_new();
-    /* If we are at the root then the parent ID is the root ID */
-    *parent = UA_NODEID_NUMERIC(0, UA_NS0ID_ROOTFOLDER);
-    /* Initialize the zk child path with the server's root path */
-    zkparent->node = parent;
-    zkparent->browsePath = strdup(zkUA_zkServAddSpacePath());
-    zkServerPath = strdup(zkUA_zkServAddSpacePath());
-    /* Call a recursive browse starting from the zkparent node */
-    UA_Client_forEachChildNodeCall(client,
-            UA_NODEID_NUMERIC(0, UA_NS0ID_ROOTFOLDER),
-            zkUA_BrowseFolder_recursive, (void *) zkparent);
-    /* free memory and return */
-    UA_NodeId_delete(parent);
-    free(zkparent->browsePath);
-    free(zkServerPath);
-    free(zkparent);
+    zkUA_initRecursive(clients[0]);
 
+    /* Browse the server's address space starting from the root node,
+     whose children are pushed to the server's root path on zk */
+    UA_NodeId rootId = UA_NODEID_NUMERIC(0, UA_NS0ID_ROOTFOLDER);
+    zkUA_NodeId root = { &rootId, zkUA_zkServAddSpacePath() };
+    zkUA_BrowseFolder_parallel(clients, clientsSize, &root);
 }
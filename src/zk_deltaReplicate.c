@@ -0,0 +1,335 @@
+/*******************************************************************************
+ * Copyright (C) 2018 Ahmed Ismail <aismail [at] protonmail.com>
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <zk_deltaReplicate.h>
+#include <zk_payload.h>
+#include <zk_payloadStore.h>
+#include <zk_intercept.h>
+#include <zk_serverReplicate.h>
+#include <zk_cli.h>
+#include <zk_global.h>
+#include <zk_znodePath.h>
+
+/* Binary encoding functions of the embedded open62541 (declared in its private headers) */
+typedef UA_StatusCode (*UA_exchangeEncodeBuffer)(void *handle,
+        UA_ByteString *buf, size_t offset);
+UA_StatusCode UA_encodeBinary(const void *src, const UA_DataType *type,
+        UA_exchangeEncodeBuffer exchangeCallback, void *exchangeHandle,
+        UA_ByteString *dst, size_t *offset);
+UA_StatusCode UA_decodeBinary(const UA_ByteString *src, size_t *offset,
+        void *dst, const UA_DataType *type);
+size_t UA_calcSizeBinary(void *p, const UA_DataType *type);
+
+static size_t deltaCompaction = ZKUA_DEFAULT_DELTA_COMPACTION;
+
+void zkUA_initializeDeltaCompaction(size_t records) {
+    deltaCompaction = records;
+}
+
+UA_Boolean zkUA_isDeltaWrite(const UA_WriteValue *value) {
+    return (deltaCompaction > 0 && value->attributeId == UA_ATTRIBUTEID_VALUE
+            && value->indexRange.length > 0 && value->value.hasValue) ?
+            true : false;
+}
+
+UA_Boolean zkUA_isDeltaLogPath(const char *path) {
+    size_t length = strlen(path);
+    size_t nameLength = strlen("/" ZKUA_DELTA_LOG_NAME);
+    return (length > nameLength
+            && strcmp(path + length - nameLength, "/" ZKUA_DELTA_LOG_NAME) == 0) ?
+            true : false;
+}
+
+static char *zkUA_delta_logPath(const char *nodePath) {
+    char *logPath = malloc(strlen(nodePath) + strlen(ZKUA_DELTA_LOG_NAME) + 2);
+    sprintf(logPath, "%s/" ZKUA_DELTA_LOG_NAME, nodePath);
+    return logPath;
+}
+
+/* Encodes the head of a log (payload header, NodeId and the version of the node's
+ znode its records apply to) if nodeId is given and a record if value is given.
+ Returns the encoding (malloc'd) and its length in *length, NULL on failure. */
+static char *zkUA_delta_encode(const UA_NodeId *nodeId, UA_Int32 baseVersion,
+        const UA_String *indexRange, const UA_Variant *value, int *length) {
+    size_t size = 0;
+    if (nodeId)
+        size += ZKUA_PAYLOAD_HEADER_SIZE
+                + UA_calcSizeBinary((void *) (uintptr_t) nodeId,
+                        &UA_TYPES[UA_TYPES_NODEID])
+                + UA_calcSizeBinary(&baseVersion, &UA_TYPES[UA_TYPES_INT32]);
+    if (value)
+        size += UA_calcSizeBinary((void *) (uintptr_t) indexRange,
+                &UA_TYPES[UA_TYPES_STRING])
+                + UA_calcSizeBinary((void *) (uintptr_t) value,
+                        &UA_TYPES[UA_TYPES_VARIANT]);
+    UA_ByteString log;
+    if (UA_ByteString_allocBuffer(&log, size) != UA_STATUSCODE_GOOD)
+        return NULL;
+    size_t offset = 0;
+    UA_StatusCode sCode = UA_STATUSCODE_GOOD;
+    if (nodeId) {
+        log.data[0] = ZKUA_PAYLOAD_MAGIC0;
+        log.data[1] = ZKUA_PAYLOAD_MAGIC1;
+        log.data[2] = ZKUA_PAYLOAD_VERSION;
+        log.data[3] = ZKUA_PAYLOAD_BINARY | ZKUA_PAYLOAD_DELTA;
+        offset = ZKUA_PAYLOAD_HEADER_SIZE;
+        sCode |= UA_encodeBinary(nodeId, &UA_TYPES[UA_TYPES_NODEID], NULL,
+                NULL, &log, &offset);
+        sCode |= UA_encodeBinary(&baseVersion, &UA_TYPES[UA_TYPES_INT32], NULL,
+                NULL, &log, &offset);
+    }
+    if (value) {
+        sCode |= UA_encodeBinary(indexRange, &UA_TYPES[UA_TYPES_STRING], NULL,
+                NULL, &log, &offset);
+        sCode |= UA_encodeBinary(value, &UA_TYPES[UA_TYPES_VARIANT], NULL,
+                NULL, &log, &offset);
+    }
+    if (sCode != UA_STATUSCODE_GOOD) {
+        UA_ByteString_deleteMembers(&log);
+        return NULL;
+    }
+    *length = (int) offset;
+    return (char *) log.data;
+}
+
+/* Decodes the records of a log and writes them into the local value of its node
+ (without replicating them) if server is given. Returns the number of records, -1 if
+ the log can't be decoded. The version its records apply to is set in *baseVersion. */
+static int zkUA_delta_decode(UA_Server *server, const char *log, int length,
+        UA_Int32 *baseVersion) {
+    if (length < ZKUA_PAYLOAD_HEADER_SIZE || log[0] != ZKUA_PAYLOAD_MAGIC0
+            || log[1] != ZKUA_PAYLOAD_MAGIC1
+            || (UA_Byte) log[2] > ZKUA_PAYLOAD_VERSION
+            || (UA_Byte) log[3] != (ZKUA_PAYLOAD_BINARY | ZKUA_PAYLOAD_DELTA)) {
+        fprintf(stderr, "zkUA_delta_decode: Unknown delta log header\n");
+        return -1;
+    }
+    UA_ByteString src = { (size_t) length, (UA_Byte *) log };
+    size_t offset = ZKUA_PAYLOAD_HEADER_SIZE;
+    UA_WriteValue value;
+    UA_WriteValue_init(&value);
+    value.attributeId = UA_ATTRIBUTEID_VALUE;
+    value.value.hasValue = true;
+    if (UA_decodeBinary(&src, &offset, &value.nodeId,
+            &UA_TYPES[UA_TYPES_NODEID]) != UA_STATUSCODE_GOOD)
+        return -1;
+    int records = 0;
+    if (UA_decodeBinary(&src, &offset, baseVersion, &UA_TYPES[UA_TYPES_INT32])
+            != UA_STATUSCODE_GOOD)
+        records = -1;
+    while (records >= 0 && offset < src.length) {
+        UA_StatusCode sCode = UA_decodeBinary(&src, &offset, &value.indexRange,
+                &UA_TYPES[UA_TYPES_STRING]);
+        if (sCode == UA_STATUSCODE_GOOD)
+            sCode = UA_decodeBinary(&src, &offset, &value.value.value,
+                    &UA_TYPES[UA_TYPES_VARIANT]);
+        if (sCode != UA_STATUSCODE_GOOD) {
+            records = -1;
+            break;
+        }
+        if (server) {
+            /* the range is copied into the node's variant in place */
+            sCode = _UA_Server_write(server, &value);
+            if (sCode != UA_STATUSCODE_GOOD)
+                fprintf(stderr,
+                        "zkUA_delta_decode: Could not write range %.*s of ns=%d;i=%d - %s\n",
+                        (int) value.indexRange.length, value.indexRange.data,
+                        value.nodeId.namespaceIndex,
+                        value.nodeId.identifier.numeric,
+                        UA_StatusCode_name(sCode));
+        }
+        UA_String_deleteMembers(&value.indexRange);
+        UA_Variant_deleteMembers(&value.value.value);
+        records++;
+    }
+    UA_WriteValue_deleteMembers(&value);
+    return records;
+}
+
+/* Writes the node in full and empties its log in one transaction. The log's records
+ (if they apply to the node's version) and then the write itself are applied to the
+ local node first: it may lack the deltas of other servers. */
+static int zkUA_delta_compact(UA_Server *server, const UA_WriteValue *value,
+        char *nodePath, int version, const char *logPath, const char *log,
+        int logLength, int logVersion) {
+
+    UA_Int32 baseVersion;
+    if (log && zkUA_delta_decode(NULL, log, logLength, &baseVersion) > 0
+            && baseVersion == version) {
+        zkUA_delta_decode(server, log, logLength, &baseVersion);
+        _UA_Server_write(server, value);
+    }
+    char *payload;
+    int payloadLength;
+    if (zkUA_UA_Server_writeAttribute_preparePayload(server, value->nodeId,
+            &payload, &payloadLength) != UA_STATUSCODE_GOOD)
+        return ZMARSHALLINGERROR;
+    /* a set of the node with its version gives the next version */
+    int emptyLength;
+    char *empty = zkUA_delta_encode(&value->nodeId, version + 1, NULL, NULL,
+            &emptyLength);
+    if (!empty) {
+        free(payload);
+        return ZMARSHALLINGERROR;
+    }
+    zoo_op_t ops[2];
+    zoo_op_result_t results[2];
+    struct Stat stat, logStat;
+    zoo_set_op_init(&ops[0], nodePath, payload, payloadLength, version, &stat);
+    zoo_set_op_init(&ops[1], logPath, empty, emptyLength, logVersion,
+            &logStat);
+    int rc = zoo_multi(zkHandle, 2, ops, results);
+    if (rc == ZOK) {
+        zkUA_insertZnodeStat(nodePath, &stat);
+        fprintf(stderr,
+                "zkUA_replicateDelta: Compacted the delta log of %s\n",
+                nodePath);
+    } else if (results[0].err == ZBADVERSION) {
+        /* the node was rewritten by another server: the write has to replicate it in full */
+        rc = ZINVALIDSTATE;
+    }
+    free(payload);
+    free(empty);
+    return rc;
+}
+
+UA_StatusCode zkUA_replicateDelta(UA_Server *server,
+        const UA_WriteValue *value) {
+
+    if (!zkUA_isDeltaWrite(value) || !zkHandle)
+        return UA_STATUSCODE_BADNOTSUPPORTED;
+    int version;
+    char nodePath[ZKUA_ZNODE_PATH_MAX];
+    if (!zkUA_formatZnodePath(&value->nodeId, nodePath, sizeof(nodePath))
+            || !zkUA_lookupZnodeVersion(nodePath, &version))
+        return UA_STATUSCODE_BADNOTSUPPORTED;
+    char *logPath = zkUA_delta_logPath(nodePath);
+    int recordLength;
+    char *record = zkUA_delta_encode(NULL, 0, &value->indexRange,
+            &value->value.value, &recordLength);
+    int rc = ZMARSHALLINGERROR;
+    for (int attempt = 0; record && attempt < ZKUA_MAX_WRITE_ATTEMPTS;
+            attempt++) {
+        char *log;
+        int logLength;
+        struct Stat logStat;
+        rc = zkUA_getZnodeData(logPath, 0, &log, &logLength, &logStat);
+        if (rc == ZNONODE) {
+            /* the first delta of the node creates its log */
+            int headLength;
+            char *head = zkUA_delta_encode(&value->nodeId, version, NULL, NULL,
+                    &headLength);
+            if (!head) {
+                rc = ZMARSHALLINGERROR;
+                break;
+            }
+            char *created = realloc(head, (size_t) (headLength + recordLength));
+            memcpy(created + headLength, record, (size_t) recordLength);
+            rc = zoo_create(zkHandle, logPath, created,
+                    headLength + recordLength, &ZOO_OPEN_ACL_UNSAFE, 0, NULL,
+                    0);
+            free(created);
+        } else if (rc == ZOK) {
+            UA_Int32 baseVersion = -1;
+            int records = zkUA_delta_decode(NULL, log, logLength, &baseVersion);
+            size_t appendedLength = (size_t) logLength + (size_t) recordLength;
+            /* the log is a single znode, it can't be chunked */
+            if (records < 0 || baseVersion != version
+                    || (size_t) records >= deltaCompaction
+                    || appendedLength > ZKUA_DEFAULT_CHUNK_SIZE) {
+                /* full, stale or unreadable: write the node in full */
+                rc = zkUA_delta_compact(server, value, nodePath, version,
+                        logPath, (records < 0) ? NULL : log, logLength,
+                        logStat.version);
+            } else {
+                char *appended = malloc(appendedLength);
+                memcpy(appended, log, (size_t) logLength);
+                memcpy(appended + logLength, record, (size_t) recordLength);
+                rc = zoo_set(zkHandle, logPath, appended, (int) appendedLength,
+                        logStat.version);
+                free(appended);
+            }
+            free(log);
+        }
+        /* retry if another server created or appended to the log in the meantime */
+        if (rc != ZBADVERSION && rc != ZNODEEXISTS && rc != ZNONODE)
+            break;
+    }
+    free(record);
+    free(logPath);
+    if (rc == ZINVALIDSTATE)
+        return UA_STATUSCODE_BADNOTSUPPORTED;
+    if (rc != ZOK) {
+        fprintf(stderr,
+                "zkUA_replicateDelta: Could not log the delta of ns=%d;i=%d - rc = %d\n",
+                value->nodeId.namespaceIndex, value->nodeId.identifier.numeric,
+                rc);
+        return UA_STATUSCODE_BADUNEXPECTEDERROR;
+    }
+    return UA_STATUSCODE_GOOD;
+}
+
+/* Result of the watch on a delta log: the log exists, apply it */
+static void zkUA_delta_watchCompletion(int rc, const struct Stat *stat,
+        const void *data) {
+    char *logPath = (char *) data;
+    if (rc == ZOK && uaServerGlobal)
+        zkUA_applyNodeDeltas(logPath, uaServerGlobal);
+    free(logPath);
+}
+
+void zkUA_watchNodeDeltas(const char *nodePath) {
+    if (deltaCompaction == 0 || !zkHandle)
+        return;
+    char *logPath = zkUA_delta_logPath(nodePath);
+    /* fires once the log is created if it does not exist yet */
+    if (zoo_aexists(zkHandle, logPath, 1 /* non-zero sets watch */,
+            zkUA_delta_watchCompletion, logPath) != ZOK)
+        free(logPath);
+}
+
+UA_StatusCode zkUA_applyNodeDeltas(const char *logPath, UA_Server *server) {
+    char *log;
+    int logLength;
+    struct Stat stat;
+    int rc = zkUA_getZnodeData(logPath, 1 /* non-zero sets watch */, &log,
+            &logLength, &stat);
+    if (rc != ZOK) {
+        if (rc != ZNONODE)
+            fprintf(stderr, "\t Error %d for %s\n", rc, logPath);
+        return UA_STATUSCODE_BADUNEXPECTEDERROR;
+    }
+    /* the records only apply to the version of the node they were logged against:
+     if the local node is older they are applied once it has been updated */
+    UA_Int32 baseVersion = -1;
+    int version = -1;
+    char *nodePath = strndup(logPath,
+            strlen(logPath) - strlen("/" ZKUA_DELTA_LOG_NAME));
+    int records = zkUA_delta_decode(NULL, log, logLength, &baseVersion);
+    if (records > 0 && zkUA_lookupZnodeVersion(nodePath, &version)
+            && version == baseVersion) {
+        zkUA_delta_decode(server, log, logLength, &baseVersion);
+        fprintf(stderr, "zkUA_applyNodeDeltas: Applied %d deltas of %s\n",
+                records, nodePath);
+    }
+    free(nodePath);
+    free(log);
+    return (records < 0) ?
+            UA_STATUSCODE_BADDECODINGERROR : UA_STATUSCODE_GOOD;
+}
@@ -14,16 +14,60 @@
  * You should have received a copy of the GNU General Public License
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  ******************************************************************************/
+#include <pthread.h>
+#include <errno.h>
+#include <sys/time.h>
 #include <open62541.h>
 #include <zk_serverReplicate.h>
 #include <zk_clientReplicate.h>
 #include <zk_cli.h>
+#include <zk_asyncReplicate.h>
+#include <zk_payload.h>
+#include <zk_payloadStore.h>
+#include <zk_deltaReplicate.h>
+#include <zk_valueReplicate.h>
+#include <zk_znodePath.h>
+#include <zk_nodeIdSet.h>
 #include <zk_global.h>
 /* Debugging */
 #include <simple_parse.h>
 
 UA_Server *uaServer;
-int visitedCntrServer = 0, nServer = 3000, visitedNodeIDServer[3000];
+/* Session used by the server for its own (internal) reads and writes */
+extern UA_Session adminSession;
+
+/* Coalesced sync barrier for linearizable reads.
+ * syncIssued/syncCompleted are generation counters: a reader waits for the first
+ * sync issued after it arrived, and every reader arriving while a sync is in flight
+ * shares the single follow-up sync issued when the in-flight one completes. */
+#define ZKUA_SYNC_TIMEOUT_MS 10000
+static pthread_mutex_t syncMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t syncCond = PTHREAD_COND_INITIALIZER;
+static unsigned long syncIssued = 0;
+static unsigned long syncCompleted = 0;
+static UA_Boolean syncInFlight = false;
+static UA_Boolean syncWaiting = false;
+static int syncRc = ZOK;
+/* The ReadRequest served on this thread shares one sync: its first linearizable
+ * read issues it, the others reuse its result */
+static __thread UA_Boolean readRequestActive = false;
+static __thread UA_Boolean readRequestSynced = false;
+static __thread int readRequestSyncRc = ZOK;
+
+/* Holds what is needed to roll a write back once its replication has failed, or to
+ merge it into the znode if its replication conflicted with another server's update */
+typedef struct zkUA_writeRollback {
+    UA_Server *server;
+    const UA_WriteValue *value;
+    UA_DataValue *v;
+    UA_StatusCode *result;
+    UA_Boolean conflict;
+} zkUA_writeRollback;
+
+static UA_StatusCode zkUA_atomicWrite_mergeConflict(UA_Server *server,
+        const UA_NodeId *nodeId, char *nodePath, const UA_WriteValue *values,
+        UA_DataValue *v, const UA_StatusCode *results, size_t count,
+        char **payload, int *payloadLen);
 
 /* Intercepts calls to UA_Server_deleteNode to check if the deletion should be replicated to ZooKeeper. */
 UA_StatusCode zkUA_Service_DeleteNodes_single(UA_Server *server,
@@ -37,17 +81,22 @@ UA_StatusCode zkUA_Service_DeleteNodes_single(UA_Server *server,
         /* TODO: atomically delete the node -
          * i.e. if one fails, roll back deletion*/
         /* delete the node on zookeeper */
-        char *fullNodePath = zkUA_encodeZnodePath(nodeId);
+        char fullNodePath[ZKUA_ZNODE_PATH_MAX];
+        if (!zkUA_formatZnodePath(nodeId, fullNodePath, sizeof(fullNodePath)))
+            return UA_STATUSCODE_BADUNEXPECTEDERROR;
         /* Doesn't matter - if it doesn't exist we won't be able to delete it */
-        rc = zoo_delete(zkHandle, fullNodePath, -1);
+        rc = zkUA_deleteNodeZnode(fullNodePath);
         if (rc) {
             fprintf(stderr, "Error %d for %s\n", rc, fullNodePath);
             return UA_STATUSCODE_BADUNEXPECTEDERROR;
         }
     }
     /* delete the node in the namespace */
-    return _Service_DeleteNodes_single(server, session, nodeId,
+    UA_StatusCode sCode = _Service_DeleteNodes_single(server, session, nodeId,
             deleteReferences);
+    if (sCode == UA_STATUSCODE_GOOD)
+        zkUA_deleteParent(nodeId);
+    return sCode;
 }
 /* Deletes an OPC UA node from the local cache only */
 UA_StatusCode zkUA_UA_Server_deleteNode_dontReplicate(UA_Server *server,
@@ -56,8 +105,9 @@ UA_StatusCode zkUA_UA_Server_deleteNode_dontReplicate(UA_Server *server,
             "zkUA_Server_deleteNode_dontReplicate: Deleting ns=%d;i=%d\n",
             nodeId.namespaceIndex, nodeId.identifier.numeric);
     replicateNode = false;
-    return UA_Server_deleteNode(server, nodeId, deleteReferences);
+    UA_StatusCode sCode = UA_Server_deleteNode(server, nodeId, deleteReferences);
     replicateNode = true;
+    return sCode;
 }
 
 /* Encodes a node being added/modified into JSON */
@@ -103,67 +153,124 @@ void zkUA_addNodeJsonPack(char *nodePath, int nodeClassInt,
     return;
 }
 
+/* Encodes a node into the payload stored in its znode (see zk_payload.h). Payloads too
+ large for one znode are written to chunk znodes and replaced with their manifest
+ (see zk_payloadStore.h). */
+static char *zkUA_UA_Server_encodeNode(char *nodePath, int nodeClass,
+        const UA_NodeId requestedNewNodeId, const UA_NodeId parentNodeId,
+        const UA_NodeId referenceTypeId, void * attr, int *length) {
+    char *payload = zkUA_encodeNodePayload(nodePath, nodeClass,
+            requestedNewNodeId, parentNodeId, referenceTypeId, attr, length);
+    if (payload
+            && zkUA_storeNodePayload(nodePath, &payload, length)
+                    != UA_STATUSCODE_GOOD) {
+        free(payload);
+        return NULL;
+    }
+    return payload;
+}
+
+/* Pushes an encoded node to its znode: sets the znode's data expecting the version last
+ seen for it, or creates the znode if its version is unknown or it was deleted.
+ If another server modified or created the znode in the meantime, the data encoded
+ from the local node would overwrite its update. The write (if any) is then merged into
+ the znode with zkUA_atomicWrite_mergeConflict and retried, anything else fails. */
+static int zkUA_writeNodeZnode(char *nodePath, char **payload, int *payloadLen,
+        zkUA_writeRollback *write) {
+
+    int rc = ZINVALIDSTATE;
+    int version = -1;
+    struct Stat stat;
+    UA_Boolean exists = zkUA_lookupZnodeVersion(nodePath, &version);
+    for (int attempt = 0; zkHandle && attempt < ZKUA_MAX_WRITE_ATTEMPTS;
+            attempt++) {
+        if (exists) {
+            rc = zoo_set2(zkHandle, nodePath, *payload, *payloadLen, version,
+                    &stat);
+        } else {
+            /* create the path with the encoded data */
+            fprintf(stderr,
+                    "zkUA_UA_Server_replicateNode: Creating nodePath %s and setting data\n",
+                    nodePath);
+            rc = zoo_create(zkHandle, nodePath, *payload, *payloadLen,
+                    &ZOO_OPEN_ACL_UNSAFE, 0, NULL, 0);
+            /* get the stat of the node to acquire the mzxid */
+            if (rc == ZOK)
+                rc = zoo_exists(zkHandle, nodePath, 0, &stat);
+        }
+        if (rc == ZNONODE) { /* the znode was deleted - create it */
+            exists = false;
+            continue;
+        }
+        if (rc != ZBADVERSION && rc != ZNODEEXISTS)
+            break;
+        fprintf(stderr,
+                "zkUA_UA_Server_replicateNode: Another server changed %s (rc = %d)\n",
+                nodePath, rc);
+        if (write == NULL
+                || zkUA_atomicWrite_mergeConflict(write->server,
+                        &write->value->nodeId, nodePath, write->value,
+                        write->v, NULL, 1, payload, payloadLen)
+                        != UA_STATUSCODE_GOOD)
+            break;
+        exists = zkUA_lookupZnodeVersion(nodePath, &version);
+    }
+    if (rc == ZOK) {
+        /* Update the hashtable mzxid and version */
+        zkUA_insertZnodeStat(nodePath, &stat);
+    } else {
+        fprintf(stderr,
+                "zkUA_UA_Server_replicateNode: Could not add the node to zk or set its data - rc = %d\n",
+                rc);
+    }
+    return rc;
+}
+
 /**
  * zkUA_UA_Server_replicateNode:
- * General function to encode a node into JSON and push it to zookeeper.
+ * General function to encode a node and push it to zookeeper.
  * Creates the path on zookeeper if the znode doesn't exist or simply sets the
  * data to the newly encoded info if it does exist.
  */
-void zkUA_UA_Server_replicateNode(int nodeClass,
+UA_StatusCode zkUA_UA_Server_replicateNode(int nodeClass,
         const UA_NodeId requestedNewNodeId, const UA_NodeId parentNodeId,
         const UA_NodeId referenceTypeId, void * attr) {
 
-    int rc = -1;
+    int sLength = 0;
     /* TODO: atomically delete the node - if one fails, rollback */
     /* initialize the zookeeper node path */
-    char *nodePath = zkUA_encodeZnodePath(&requestedNewNodeId);
-    /* Initialize the JSON root object */
-    json_t *nodePack = json_object();
-    zkUA_addNodeJsonPack(nodePath, nodeClass, requestedNewNodeId, parentNodeId,
-            referenceTypeId, (void *) attr, nodePack);
-    /* Encode the node attributes*/
-    char *s = json_dumps(nodePack, JSON_INDENT(1));
+    char nodePath[ZKUA_ZNODE_PATH_MAX];
+    if (!zkUA_formatZnodePath(&requestedNewNodeId, nodePath, sizeof(nodePath)))
+        return UA_STATUSCODE_BADUNEXPECTEDERROR;
+    char *s = zkUA_UA_Server_encodeNode(nodePath, nodeClass,
+            requestedNewNodeId, parentNodeId, referenceTypeId, attr, &sLength);
     if (s == NULL)
-        fprintf(stderr,
-                "zkUA_UA_Server_replicateNode: Could not dump nodePack\n");
-    json_decref(nodePack);
-    /* Check if the path exists on zookeeper */
-    struct Stat stat;
-    if (zkHandle) {
-        fprintf(stderr, "zkUA_UA_Server_replicateNode: Checking if %s exists\n",
-                nodePath);
-        rc = zoo_exists(zkHandle, nodePath, 0, &stat);
-    }
-    /* If it does, set the data for the same node */
-    if (rc == ZOK) {
-        fprintf(stderr,
-                "zkUA_UA_Server_replicateNode: Path %s exists. Setting nodePath data with new value\n",
-                nodePath);
-        rc = zoo_set2(zkHandle, nodePath, s, strlen(s), -1, &stat);
-        /* Update the hashtable mzxid */
-        zkUA_insertMzxidAge(nodePath, (long long *) &stat.mzxid);
-    } else if (rc == ZNONODE) { /* If it doesn't exist */
-        /* create the path with the encoded data */
-        fprintf(stderr,
-                "zkUA_UA_Server_replicateNode: Path %s doesn't exist. Creating nodePath and setting data\n",
-                nodePath);
-        int flags = 0;
-        char *path_buffer = calloc(65535, sizeof(char));
-        rc = zoo_create(zkHandle, nodePath, s, strlen(s), &ZOO_OPEN_ACL_UNSAFE,
-                flags, path_buffer, 65535);
-        /* get the node to acquire the stat & so acquire the mzxid */
-        int pathBufferLen;
-        rc = zoo_get(zkHandle, nodePath, 0, path_buffer, &pathBufferLen, &stat);
-        free(path_buffer);
-        /* Update the hashtable mzxid */
-        zkUA_insertMzxidAge(nodePath, (long long *) &stat.mzxid);
-    } else {
-        fprintf(stderr,
-                "zkUA_UA_Server_replicateNode: Could not add the node to zk or set its data - rc = %d\n",
-                rc);
-    }
-    free(nodePath);
+        return UA_STATUSCODE_BADUNEXPECTEDERROR;
+    /* there is no write to merge - a conflicting node fails */
+    int rc = zkUA_writeNodeZnode(nodePath, &s, &sLength, NULL);
     free(s);
+    return (rc == ZOK) ? UA_STATUSCODE_GOOD : UA_STATUSCODE_BADUNEXPECTEDERROR;
+}
+
+UA_StatusCode zkUA_UA_Server_replicateNodeAsync(int nodeClass,
+        const UA_NodeId requestedNewNodeId, const UA_NodeId parentNodeId,
+        const UA_NodeId referenceTypeId, void * attr,
+        zkUA_ReplicationBatch *batch, zkUA_replicationDone done,
+        void *context) {
+
+    int sLength = 0;
+    char *nodePath = zkUA_encodeZnodePath(&requestedNewNodeId);
+    char *s = nodePath ? zkUA_UA_Server_encodeNode(nodePath, nodeClass,
+            requestedNewNodeId, parentNodeId, referenceTypeId, attr, &sLength) :
+            NULL;
+    if (s == NULL) {
+        free(nodePath);
+        if (done)
+            done(ZMARSHALLINGERROR, context);
+        return UA_STATUSCODE_BADUNEXPECTEDERROR;
+    }
+    /* nodePath and s are free'd once zk acknowledges the request */
+    return zkUA_replicateAsync(batch, nodePath, s, sLength, done, context);
 }
 
 UA_StatusCode zkUA_initReadAttributes_server(UA_NodeClass *nodeClass,
@@ -376,53 +483,43 @@ UA_StatusCode zkUA_findParent_recursiveBrowse(UA_NodeId childId,
         return UA_STATUSCODE_GOOD;
     }
 
+    zkUA_locateParent *locateParent = (zkUA_locateParent *) handle;
     /* Browse down this path only if we've never seen this child before */
-    /* TODO: visitedNodeId array should hold namespaceIndex and identifier (multiple types) */
-    for (size_t j = 0; j < nServer; j++) {
-        if (visitedNodeIDServer[j] == childId.identifier.numeric) {
-            return UA_STATUSCODE_GOOD;
-        }
+    if (zkUA_NodeIdSet_contains(locateParent->visited, &childId)) {
+        return UA_STATUSCODE_GOOD;
     }
 
-    zkUA_locateParent *locateParent = (zkUA_locateParent *) handle;
     /* Only accept the parent node for this child if the child is pointed
      to by a hierarchicalReference */
     if (!zkUA_hierarchicalReference(referenceTypeId.identifier.numeric)) {
         return UA_STATUSCODE_BADUNEXPECTEDERROR;
     }
 
-    /* TODO: visitedNodeId array should hold namespaceIndex and identifier (multiple types) */
-    visitedNodeIDServer[visitedCntrServer++] = childId.identifier.numeric;
-
-    /* If the namespaceIndexes match */
-    if (childId.namespaceIndex
-            == locateParent->searchedForNode->namespaceIndex) {
-        /* TODO: handle other identifier types */
-        /* if the nodeIds match */
-        if (childId.identifier.numeric
-                == locateParent->searchedForNode->identifier.numeric) {
-            locateParent->foundParent->identifier.numeric =
-                    locateParent->parentNode->identifier.numeric;
-            locateParent->foundParent->namespaceIndex =
-                    locateParent->parentNode->namespaceIndex;
-            *locateParent->referenceTypeId = referenceTypeId;
-            locateParent->foundParentFlag = true;
-            fprintf(stderr,
-                    "zkUA_findParent_recursiveBrowse: Found parent! ns=%d id=%d\n",
-                    locateParent->parentNode->namespaceIndex,
-                    locateParent->parentNode->identifier.numeric);
-            return UA_STATUSCODE_GOOD;
-        }
+    zkUA_NodeIdSet_insert(locateParent->visited, &childId);
+
+    /* If the nodeIds match */
+    if (UA_NodeId_equal(&childId, locateParent->searchedForNode)) {
+        UA_NodeId_deleteMembers(locateParent->foundParent);
+        UA_NodeId_copy(locateParent->parentNode, locateParent->foundParent);
+        UA_NodeId_deleteMembers(locateParent->referenceTypeId);
+        UA_NodeId_copy(&referenceTypeId, locateParent->referenceTypeId);
+        locateParent->foundParentFlag = true;
+        fprintf(stderr,
+                "zkUA_findParent_recursiveBrowse: Found parent! ns=%d id=%d\n",
+                locateParent->parentNode->namespaceIndex,
+                locateParent->parentNode->identifier.numeric);
+        return UA_STATUSCODE_GOOD;
     }
     /* Well, we didn't find the parent yet, so initialize a new struct and go down another depth level */
     zkUA_locateParent *locateParentNew = (zkUA_locateParent *) calloc(1,
             sizeof(zkUA_locateParent));
     UA_NodeId *parent = UA_NodeId_new();
-    *parent = childId;
+    UA_NodeId_copy(&childId, parent);
     locateParentNew->parentNode = parent;
     locateParentNew->searchedForNode = locateParent->searchedForNode;
     locateParentNew->foundParent = locateParent->foundParent;
     locateParentNew->referenceTypeId = locateParent->referenceTypeId;
+    locateParentNew->visited = locateParent->visited;
     UA_Server_forEachChildNodeCall(uaServer, childId,
             zkUA_findParent_recursiveBrowse, (void *) locateParentNew);
     /* If we returned from the call, clean up */
@@ -492,9 +589,6 @@ void zkUA_freeAttributes(UA_NodeClass *nodeClass, void **attributes) {
 }
 
 void zkUA_UA_Server_locateParent(UA_NodeId nodeId, void **locateParent) {
-    for (int i = 0; i < nServer; i++) { /* initialize visited nodes array */
-        visitedNodeIDServer[i] = 0;
-    }
     zkUA_locateParent *locParent = (zkUA_locateParent *) *locateParent;
     UA_NodeId parent = UA_NODEID_NUMERIC(0, UA_NS0ID_ROOTFOLDER);
     locParent->parentNode = &parent;
@@ -513,25 +607,54 @@ void zkUA_UA_Server_locateParent(UA_NodeId nodeId, void **locateParent) {
             locParent->parentNode->identifier.numeric,
             locParent->searchedForNode->namespaceIndex,
             locParent->searchedForNode->identifier.numeric);
+    /* every search starts with an empty set of visited nodes */
+    zkUA_NodeIdSet visited;
+    zkUA_NodeIdSet_init(&visited);
+    zkUA_NodeIdSet_insert(&visited, &parent);
+    locParent->visited = &visited;
     UA_Server_forEachChildNodeCall(uaServer,
             UA_NODEID_NUMERIC(0, UA_NS0ID_ROOTFOLDER),
             zkUA_findParent_recursiveBrowse, (void *) *locateParent);
+    locParent->visited = NULL;
+    zkUA_NodeIdSet_deleteMembers(&visited);
 }
 
-UA_StatusCode zkUA_UA_Server_writeAttribute_prepareReplication(
-        UA_Server *server, UA_NodeId nodeId) {
+/* Reads a node and its parent and replicates it synchronously (batch == NULL) or
+ asynchronously as part of a batch. If payload is given, the node is only encoded
+ into *payload (to be free'd by the caller) of *payloadLen bytes and not replicated. */
+static UA_StatusCode zkUA_prepareReplication(UA_Server *server,
+        UA_NodeId nodeId, zkUA_ReplicationBatch *batch,
+        zkUA_replicationDone done, void *context, char **payload,
+        int *payloadLen) {
 
+    UA_StatusCode sCode = UA_STATUSCODE_GOOD;
     void *attributes = NULL;
     uaServer = server;
 
-    /* Create a struct to hold the currently browsed parent node, searched for node,
-     and, if located, the located correct parent node */
-    zkUA_locateParent *locateParent = (zkUA_locateParent *) calloc(1,
-            sizeof(zkUA_locateParent));
-    zkUA_UA_Server_locateParent(nodeId, (void **) &locateParent);
-    if (locateParent->foundParent->namespaceIndex == -1) {
-        fprintf(stderr,
-                "zkUA_UA_Server_writeAttribute_prepareReplication: Error! Could not find parent node!\n");
+    /* Look the parent up in the parent index */
+    UA_NodeId parentNodeId, referenceTypeId;
+    if (zkUA_lookupParent(&nodeId, &parentNodeId, &referenceTypeId) == false) {
+        /* Not indexed: browse the address space for the parent instead.
+         Create a struct to hold the currently browsed parent node, searched for node,
+         and, if located, the located correct parent node */
+        zkUA_locateParent *locateParent = (zkUA_locateParent *) calloc(1,
+                sizeof(zkUA_locateParent));
+        zkUA_UA_Server_locateParent(nodeId, (void **) &locateParent);
+        if (locateParent->foundParentFlag == false) {
+            fprintf(stderr,
+                    "zkUA_UA_Server_writeAttribute_prepareReplication: Error! Could not find parent node!\n");
+        }
+        UA_NodeId_copy(locateParent->foundParent, &parentNodeId);
+        UA_NodeId_copy(locateParent->referenceTypeId, &referenceTypeId);
+        if (locateParent->foundParentFlag == true)
+            zkUA_insertParent(&nodeId, &parentNodeId, &referenceTypeId);
+        UA_NodeId_deleteMembers(locateParent->searchedForNode);
+        free(locateParent->searchedForNode);
+        UA_NodeId_deleteMembers(locateParent->foundParent);
+        free(locateParent->foundParent);
+        UA_NodeId_deleteMembers(locateParent->referenceTypeId);
+        free(locateParent->referenceTypeId);
+        free(locateParent);
     }
     /* Find the nodeClass */
     UA_NodeClass *nodeClass = UA_NodeClass_new();
@@ -539,43 +662,180 @@ UA_StatusCode zkUA_UA_Server_writeAttribute_prepareReplication(
     /* Call function based on nodeClass to read all that nodeClass's attributes */
     zkUA_initReadAttributes_server(nodeClass, server, nodeId, &attributes); // Like zkUA_browsefolder_recursive, this function initializes attributes based on
     // the nodeClass and then calls zkUA_readAttributes_server to fill in attr
-    /* Encode into JSON and push to ZooKeeper */
-    zkUA_UA_Server_replicateNode(*nodeClass, nodeId, *locateParent->foundParent,
-            *locateParent->referenceTypeId, attributes);
+    /* Encode and push to ZooKeeper */
+    if (payload) {
+        char nodePath[ZKUA_ZNODE_PATH_MAX];
+        *payload = zkUA_formatZnodePath(&nodeId, nodePath, sizeof(nodePath)) ?
+                zkUA_UA_Server_encodeNode(nodePath, *nodeClass, nodeId,
+                        parentNodeId, referenceTypeId, attributes, payloadLen) :
+                NULL;
+        if (*payload == NULL)
+            sCode = UA_STATUSCODE_BADUNEXPECTEDERROR;
+    } else if (batch)
+        sCode = zkUA_UA_Server_replicateNodeAsync(*nodeClass, nodeId,
+                parentNodeId, referenceTypeId, attributes, batch, done,
+                context);
+    else
+        sCode = zkUA_UA_Server_replicateNode(*nodeClass, nodeId, parentNodeId,
+                referenceTypeId, attributes);
     zkUA_freeAttributes(nodeClass, &attributes);
     UA_NodeClass_deleteMembers(nodeClass);
     free(nodeClass);
-    UA_NodeId_deleteMembers(locateParent->searchedForNode);
-    free(locateParent->searchedForNode);
-    UA_NodeId_deleteMembers(locateParent->foundParent);
-    free(locateParent->foundParent);
-    UA_NodeId_deleteMembers(locateParent->referenceTypeId);
-    free(locateParent->referenceTypeId);
-    free(locateParent);
-    return UA_STATUSCODE_GOOD;
+    UA_NodeId_deleteMembers(&parentNodeId);
+    UA_NodeId_deleteMembers(&referenceTypeId);
+    return sCode;
+}
+
+UA_StatusCode zkUA_UA_Server_writeAttribute_prepareReplication(
+        UA_Server *server, UA_NodeId nodeId) {
+    return zkUA_prepareReplication(server, nodeId, NULL, NULL, NULL, NULL,
+            NULL);
+}
+
+UA_StatusCode zkUA_UA_Server_writeAttribute_prepareReplicationAsync(
+        UA_Server *server, UA_NodeId nodeId, zkUA_ReplicationBatch *batch,
+        zkUA_replicationDone done, void *context) {
+    return zkUA_prepareReplication(server, nodeId, batch, done, context,
+            NULL, NULL);
+}
+
+UA_StatusCode zkUA_UA_Server_writeAttribute_preparePayload(UA_Server *server,
+        UA_NodeId nodeId, char **payload, int *payloadLen) {
+    return zkUA_prepareReplication(server, nodeId, NULL, NULL, NULL, payload,
+            payloadLen);
 }
 
 /********** Interceptor functions for compilation purposes **********/
 
+/* Completion of a zoo_async sync: releases the readers waiting for this generation
+ * and issues one follow-up sync for the readers that arrived while it was in flight */
+static void zkUA_syncBarrier_completion(int rc, const char *value,
+        const void *data) {
+    unsigned long generation = (unsigned long) (uintptr_t) data;
+    unsigned long next = 0;
+    pthread_mutex_lock(&syncMutex);
+    if (generation > syncCompleted) {
+        syncCompleted = generation;
+        syncRc = rc;
+    }
+    syncInFlight = false;
+    if (syncWaiting) {
+        syncWaiting = false;
+        syncInFlight = true;
+        next = ++syncIssued;
+    }
+    pthread_cond_broadcast(&syncCond);
+    pthread_mutex_unlock(&syncMutex);
+    if (next) {
+        int arc = zoo_async(zkHandle, zkUA_zkServAddSpacePath(),
+                zkUA_syncBarrier_completion, (const void *) (uintptr_t) next);
+        if (arc != ZOK)
+            zkUA_syncBarrier_completion(arc, NULL, (const void *) (uintptr_t) next);
+    }
+}
+
+/* Blocks until a sync issued after the call has completed and returns its result */
+static int zkUA_syncBarrier() {
+    unsigned long target, issue = 0;
+    struct timeval now;
+    struct timespec deadline;
+    int rc = ZOK, wrc = 0;
+
+    pthread_mutex_lock(&syncMutex);
+    if (syncInFlight) {
+        /* the in-flight sync may predate this read - wait for the next one */
+        target = syncIssued + 1;
+        syncWaiting = true;
+    } else {
+        syncInFlight = true;
+        issue = target = ++syncIssued;
+    }
+    pthread_mutex_unlock(&syncMutex);
+
+    if (issue) {
+        rc = zoo_async(zkHandle, zkUA_zkServAddSpacePath(),
+                zkUA_syncBarrier_completion, (const void *) (uintptr_t) issue);
+        if (rc != ZOK)
+            zkUA_syncBarrier_completion(rc, NULL, (const void *) (uintptr_t) issue);
+    }
+
+    gettimeofday(&now, NULL);
+    deadline.tv_sec = now.tv_sec + ZKUA_SYNC_TIMEOUT_MS / 1000;
+    deadline.tv_nsec = now.tv_usec * 1000
+            + (ZKUA_SYNC_TIMEOUT_MS % 1000) * 1000000L;
+    if (deadline.tv_nsec >= 1000000000L) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000L;
+    }
+    pthread_mutex_lock(&syncMutex);
+    while (syncCompleted < target && wrc != ETIMEDOUT)
+        wrc = pthread_cond_timedwait(&syncCond, &syncMutex, &deadline);
+    rc = (syncCompleted < target) ? ZOPERATIONTIMEOUT : syncRc;
+    pthread_mutex_unlock(&syncMutex);
+    if (rc != ZOK) {
+        fprintf(stderr, "zkUA_syncBarrier: sync failed with error %d\n", rc);
+        zkUA_error2String(rc);
+    }
+    return rc;
+}
+
+/* Returns the result of the sync of the ReadRequest being served, issuing it on its
+ * first linearizable read. Reads outside of a ReadRequest sync on their own. */
+static int zkUA_readRequestSyncBarrier() {
+    if (readRequestActive == false)
+        return zkUA_syncBarrier();
+    if (readRequestSynced == false) {
+        readRequestSyncRc = zkUA_syncBarrier();
+        readRequestSynced = true;
+    }
+    return readRequestSyncRc;
+}
+
+/* Intercepting ReadRequests: the reads of a request are served after one sync */
+void zkUA_Service_Read(UA_Server *server, UA_Session *session,
+        const UA_ReadRequest *request, UA_ReadResponse *response) {
+    fprintf(stderr, "zkUA_Service_Read: Intercepted call to Service_Read\n");
+    readRequestActive = true;
+    readRequestSynced = false;
+    _Service_Read(server, session, request, response);
+    readRequestActive = false;
+}
+
 /* Intercepting all read requests initiated by the UA Server or UA Client connected to the UA Server */
 void zkUA_Service_Read_single(UA_Server *server, UA_Session *session,
         const UA_TimestampsToReturn timestamps, const UA_ReadValueId *id,
         UA_DataValue *v) {
 
-    /* TODO: Since we have watches set on all nodes, we can use the local cache directly
+    /* Since we have watches set on all nodes, we can use the local cache directly
      as the watch mechanism sends out a notification the moment anything changes. */
     fprintf(stderr,
             "zkUA_Service_Read_single: Intercepted call to Service_Read_single\n");
 
     uaServer = server;
-    /* Let's see if we have a running connection with zk ensemble */
-    struct Stat stat;
-    int rc = zoo_exists(zkHandle, "/", 0, &stat);
-    if ((rc == ZOK) || (rc < 0 && availabilityPriority == true)) {
-        /* a) If I successfully read from zk then I just updated the local cache with the newest copy
-         b) If I failed to read from zk but availability is more important than reliability
+    /* The server's own reads (e.g. while replicating) are always served locally.
+     * This also keeps the zk completion thread from waiting on its own sync. */
+    int level = ZKUA_READ_LOCAL;
+    if (session != &adminSession)
+        level = zkUA_readConsistencyForNode(&id->nodeId);
+
+    int rc = ZOK;
+    if (level != ZKUA_READ_LOCAL && zkUA_sessionConnected() == false) {
+        /* Check the session state recorded by the watcher instead of probing the zk ensemble */
+        rc = ZCONNECTIONLOSS;
+    } else if (level == ZKUA_READ_LINEARIZABLE) {
+        /* Sync with the leader once per ReadRequest; the watches fire before the sync completes */
+        rc = zkUA_readRequestSyncBarrier();
+    }
+    if (rc == ZOK || availabilityPriority == true) {
+        /* a) If the session is connected (and synced) then the watches keep the local cache up to date
+         b) If zk is unreachable but availability is more important than reliability
          then we read from the local cache */
         _Service_Read_single(server, session, timestamps, id, v);
+    } else {
+        /* the local cache may be stale */
+        v->hasStatus = true;
+        v->status = (rc == ZOPERATIONTIMEOUT) ?
+                UA_STATUSCODE_BADTIMEOUT : UA_STATUSCODE_BADCOMMUNICATIONERROR;
     }
 
 }
@@ -596,7 +856,12 @@ void zkUA_atomicWrite_prepareRollback(UA_Server *server, UA_DataValue *v,
     id.dataEncoding.namespaceIndex = 0;
     /* Use UA_Server_read to read the attribute instead of _Service_read_single and you don't
      have to worry about supplying the session info  */
-    *v = UA_Server_read(server, (const UA_ReadValueId *) &id, timestamps);
+    UA_DataValue read = UA_Server_read(server, (const UA_ReadValueId *) &id,
+            timestamps);
+    /* Attributes other than the value are returned pointing into the node, copy them
+     before the write modifies or replaces the node */
+    UA_DataValue_copy(&read, v);
+    UA_DataValue_deleteMembers(&read);
     fprintf(stderr, "zkUA_Service_Write: Read attribute is %d\n",
             id.attributeId);
 }
@@ -613,6 +878,259 @@ UA_StatusCode zkUA_atomicWrite_initiateRollback(UA_Server *server,
     return sCode;
 }
 
+/* Resolves a conflict between the replication of the written node nodeId and an update
+ another server made to its znode: applies the znode to the local cache, writes those
+ of the count values that target nodeId again on top of it (skipping the ones whose
+ result is not good) and encodes the merged node into *payload. As the local node now
+ holds the znode's attributes, v is re-read for the values so that a failed retry rolls
+ back to the znode's state. */
+static UA_StatusCode zkUA_atomicWrite_mergeConflict(UA_Server *server,
+        const UA_NodeId *nodeId, char *nodePath, const UA_WriteValue *values,
+        UA_DataValue *v, const UA_StatusCode *results, size_t count,
+        char **payload, int *payloadLen) {
+
+    fprintf(stderr,
+            "zkUA_atomicWrite_mergeConflict: Merging the write of ns=%d;i=%d into %s\n",
+            nodeId->namespaceIndex, nodeId->identifier.numeric, nodePath);
+    int version;
+    UA_StatusCode sCode = zkUA_jsonDecode_zkNode(nodePath, server);
+    if (sCode != UA_STATUSCODE_GOOD
+            || !zkUA_lookupZnodeVersion(nodePath, &version))
+        return UA_STATUSCODE_BADUNEXPECTEDERROR;
+    /* read all old values before writing any of them, a value may be written twice */
+    for (size_t cnt = 0; cnt < count; cnt++) {
+        if ((results && results[cnt] != UA_STATUSCODE_GOOD)
+                || !UA_NodeId_equal(&values[cnt].nodeId, nodeId))
+            continue;
+        UA_DataValue_deleteMembers(&v[cnt]);
+        zkUA_atomicWrite_prepareRollback(server, &v[cnt], &values[cnt]);
+    }
+    for (size_t cnt = 0; cnt < count && sCode == UA_STATUSCODE_GOOD; cnt++) {
+        if ((results && results[cnt] != UA_STATUSCODE_GOOD)
+                || !UA_NodeId_equal(&values[cnt].nodeId, nodeId))
+            continue;
+        sCode = _UA_Server_write(server, &values[cnt]);
+    }
+    if (sCode != UA_STATUSCODE_GOOD) {
+        fprintf(stderr,
+                "zkUA_atomicWrite_mergeConflict: Could not write ns=%d;i=%d again - %s\n",
+                nodeId->namespaceIndex, nodeId->identifier.numeric,
+                UA_StatusCode_name(sCode));
+        return sCode;
+    }
+    free(*payload);
+    *payload = NULL;
+    return zkUA_UA_Server_writeAttribute_preparePayload(server, *nodeId,
+            payload, payloadLen);
+}
+
+/* Replicates a written node synchronously and rolls the write back if that fails.
+ If its asynchronous replication conflicted, the write is merged into the znode first. */
+static void zkUA_atomicWrite_replicateNode(zkUA_writeRollback *write) {
+    char nodePath[ZKUA_ZNODE_PATH_MAX];
+    char *payload = NULL;
+    int payloadLen = 0;
+    int rc = ZMARSHALLINGERROR;
+    if (zkUA_formatZnodePath(&write->value->nodeId, nodePath,
+            sizeof(nodePath))) {
+        UA_StatusCode sCode =
+                write->conflict ?
+                        zkUA_atomicWrite_mergeConflict(write->server,
+                                &write->value->nodeId, nodePath, write->value,
+                                write->v, NULL, 1, &payload, &payloadLen) :
+                        zkUA_UA_Server_writeAttribute_preparePayload(
+                                write->server, write->value->nodeId, &payload,
+                                &payloadLen);
+        if (sCode == UA_STATUSCODE_GOOD)
+            rc = zkUA_writeNodeZnode(nodePath, &payload, &payloadLen, write);
+    }
+    free(payload);
+    write->conflict = false;
+    if (rc == ZOK)
+        return;
+    fprintf(stderr,
+            "zkUA_atomicWrite_replicateNode: Replication to zk failed - rolling back local cache change for ns=%d;i=%d\n",
+            write->value->nodeId.namespaceIndex,
+            write->value->nodeId.identifier.numeric);
+    zkUA_atomicWrite_initiateRollback(write->server, write->value, write->v);
+    *write->result = UA_STATUSCODE_BADUNEXPECTEDERROR;
+}
+
+/* Completion of the replication of a written node: rolls the local cache back if zk
+ did not acknowledge it. The writing thread waits for the batch, so it does not touch
+ the node while the completion thread rolls it back. A conflict with another server's
+ update is left to the writing thread, merging it needs synchronous zk requests. */
+static void zkUA_atomicWrite_rollbackCompletion(int rc, void *context) {
+    zkUA_writeRollback *rollback = (zkUA_writeRollback *) context;
+    if (rc == ZOK)
+        return;
+    if (rc == ZBADVERSION || rc == ZNODEEXISTS) {
+        rollback->conflict = true;
+        return;
+    }
+    fprintf(stderr,
+            "zkUA_atomicWrite_rollbackCompletion: Replication to zk failed - rolling back local cache change for ns=%d;i=%d\n",
+            rollback->value->nodeId.namespaceIndex,
+            rollback->value->nodeId.identifier.numeric);
+    zkUA_atomicWrite_initiateRollback(rollback->server, rollback->value,
+            rollback->v);
+    *rollback->result = UA_STATUSCODE_BADUNEXPECTEDERROR;
+}
+
+/* A znode update that is part of a transactional WriteRequest */
+typedef struct zkUA_transactionOp {
+    const UA_NodeId *nodeId;
+    char *nodePath;
+    char *payload;
+    int payloadLen;
+    char *pathBuffer;
+    UA_Boolean create;
+    int version;
+    struct Stat stat;
+} zkUA_transactionOp;
+
+static void zkUA_transactionOp_init(zkUA_transactionOp *tOp, zoo_op_t *op) {
+    if (tOp->create)
+        zoo_create_op_init(op, tOp->nodePath, tOp->payload, tOp->payloadLen,
+                &ZOO_OPEN_ACL_UNSAFE, 0, tOp->pathBuffer,
+                strlen(tOp->nodePath) + 1);
+    else
+        zoo_set_op_init(op, tOp->nodePath, tOp->payload, tOp->payloadLen,
+                tOp->version, &tOp->stat);
+}
+
+/* Replicates every successful local write of a WriteRequest in a single zoo_multi.
+ If the transaction fails all of the writes are rolled back. */
+static void zkUA_atomicWrite_replicateTransaction(UA_Server *server,
+        const UA_WriteRequest *request, UA_WriteResponse *response,
+        UA_DataValue *v) {
+
+    size_t ntwsCnt, opsCnt = 0;
+    int rc = ZOK;
+    zkUA_transactionOp *tOps = calloc(request->nodesToWriteSize + 1,
+            sizeof(zkUA_transactionOp));
+    zoo_op_t *ops = calloc(request->nodesToWriteSize + 1, sizeof(zoo_op_t));
+    zoo_op_result_t *results = calloc(request->nodesToWriteSize + 1,
+            sizeof(zoo_op_result_t));
+
+    for (ntwsCnt = 0; ntwsCnt < request->nodesToWriteSize && rc == ZOK;
+            ++ntwsCnt) {
+        if (response->results[ntwsCnt] != UA_STATUSCODE_GOOD)
+            continue;
+        /* replicate each node once even if several of its attributes were written */
+        const UA_NodeId *nodeId = &request->nodesToWrite[ntwsCnt].nodeId;
+        UA_Boolean duplicate = false;
+        for (size_t prevCnt = 0; prevCnt < ntwsCnt; ++prevCnt) {
+            if (response->results[prevCnt] == UA_STATUSCODE_GOOD
+                    && UA_NodeId_equal(&request->nodesToWrite[prevCnt].nodeId,
+                            nodeId)) {
+                duplicate = true;
+                break;
+            }
+        }
+        if (duplicate)
+            continue;
+        zkUA_transactionOp *tOp = &tOps[opsCnt];
+        if (zkUA_prepareReplication(server, *nodeId, NULL, NULL, NULL,
+                &tOp->payload, &tOp->payloadLen) != UA_STATUSCODE_GOOD) {
+            rc = ZMARSHALLINGERROR;
+            break;
+        }
+        tOp->nodeId = nodeId;
+        tOp->nodePath = zkUA_encodeZnodePath(nodeId);
+        if (tOp->nodePath == NULL) {
+            free(tOp->payload);
+            rc = ZMARSHALLINGERROR;
+            break;
+        }
+        tOp->pathBuffer = calloc(strlen(tOp->nodePath) + 1, sizeof(char));
+        /* Nodes with a known version exist on zk, all others have to be created */
+        tOp->create = !zkUA_lookupZnodeVersion(tOp->nodePath, &tOp->version);
+        zkUA_transactionOp_init(tOp, &ops[opsCnt]);
+        opsCnt++;
+    }
+
+    if (rc == ZOK && opsCnt > 0) {
+        rc = zoo_multi(zkHandle, (int) opsCnt, ops, results);
+        /* If a znode was deleted behind our back the failing op reports it - create it.
+         If another server created or modified it, merge the request's writes of that
+         node into the znode and try again. */
+        for (int attempt = 1; rc != ZOK && attempt < ZKUA_MAX_WRITE_ATTEMPTS;
+                attempt++) {
+            UA_Boolean retry = false, merged = true;
+            for (size_t opCnt = 0; opCnt < opsCnt && merged; opCnt++) {
+                int err = results[opCnt].err;
+                if (err == ZNONODE) {
+                    tOps[opCnt].create = true;
+                } else if (err == ZNODEEXISTS || err == ZBADVERSION) {
+                    fprintf(stderr,
+                            "zkUA_atomicWrite_replicateTransaction: Conflict on %s (rc = %d)\n",
+                            tOps[opCnt].nodePath, err);
+                    merged = (zkUA_atomicWrite_mergeConflict(server,
+                            tOps[opCnt].nodeId, tOps[opCnt].nodePath,
+                            request->nodesToWrite, v, response->results,
+                            request->nodesToWriteSize, &tOps[opCnt].payload,
+                            &tOps[opCnt].payloadLen) == UA_STATUSCODE_GOOD);
+                    if (!merged)
+                        break;
+                    tOps[opCnt].create = !zkUA_lookupZnodeVersion(
+                            tOps[opCnt].nodePath, &tOps[opCnt].version);
+                } else
+                    continue;
+                zkUA_transactionOp_init(&tOps[opCnt], &ops[opCnt]);
+                retry = true;
+            }
+            if (!retry || !merged)
+                break;
+            memset(results, 0, opsCnt * sizeof(zoo_op_result_t));
+            rc = zoo_multi(zkHandle, (int) opsCnt, ops, results);
+        }
+    }
+
+    if (rc == ZOK && opsCnt > 0) {
+        /* All ops of a multi share its zxid: take the mzxid from a set op or,
+         if there was none, from the stat of a created znode */
+        struct Stat stat;
+        int src = -1;
+        for (size_t opCnt = 0; opCnt < opsCnt && src < 0; opCnt++) {
+            if (!tOps[opCnt].create)
+                src = (int) opCnt;
+        }
+        if (src >= 0)
+            stat = tOps[src].stat;
+        if (src >= 0
+                || zoo_exists(zkHandle, tOps[0].nodePath, 0, &stat) == ZOK) {
+            for (size_t opCnt = 0; opCnt < opsCnt; opCnt++) {
+                struct Stat opStat = stat;
+                /* created znodes start at version 0 */
+                opStat.version = tOps[opCnt].create ? 0 : tOps[opCnt].stat.version;
+                zkUA_insertZnodeStat(tOps[opCnt].nodePath, &opStat);
+            }
+        }
+    } else if (rc != ZOK) {
+        fprintf(stderr,
+                "zkUA_atomicWrite_replicateTransaction: Replication to zk failed with %d - rolling back %lu local cache changes\n",
+                rc, request->nodesToWriteSize);
+        zkUA_error2String(rc);
+        for (ntwsCnt = 0; ntwsCnt < request->nodesToWriteSize; ++ntwsCnt) {
+            if (response->results[ntwsCnt] != UA_STATUSCODE_GOOD)
+                continue;
+            zkUA_atomicWrite_initiateRollback(server,
+                    &request->nodesToWrite[ntwsCnt], &v[ntwsCnt]);
+            response->results[ntwsCnt] = UA_STATUSCODE_BADUNEXPECTEDERROR;
+        }
+    }
+
+    for (size_t opCnt = 0; opCnt <= opsCnt; opCnt++) {
+        free(tOps[opCnt].nodePath);
+        free(tOps[opCnt].payload);
+        free(tOps[opCnt].pathBuffer);
+    }
+    free(tOps);
+    free(ops);
+    free(results);
+}
+
 /* If a UA Server edits a node's attribute, UA_Server_write is called - since when replicating we
  add the whole node or delete and readd the node which calls Service_AddNodes_single
  when this function is called - always replicate to zk */
@@ -629,14 +1147,34 @@ UA_StatusCode zkUA_UA_Server_write(UA_Server *server,
     UA_StatusCode sCode = _UA_Server_write(server, value);
     /* If write succeeds */
     if (replicateNode == true && sCode == UA_STATUSCODE_GOOD) {
-        sCode = zkUA_UA_Server_writeAttribute_prepareReplication(server,
-                value->nodeId);
-        if (sCode != UA_STATUSCODE_GOOD) { /* rollback changes to local cache */
-            fprintf(stderr,
-                    "zkUA_Service_Write: Replication to zk failed - rolling back local cache change\n");
-            sCode = zkUA_atomicWrite_initiateRollback(server, value, &v);
+        /* A write of the value only replicates the value znode or the written range */
+        UA_StatusCode dCode = zkUA_replicateValue(server, value, &v);
+        if (dCode == UA_STATUSCODE_BADNOTSUPPORTED)
+            dCode = zkUA_replicateDelta(server, value);
+        if (dCode != UA_STATUSCODE_BADNOTSUPPORTED) {
+            if (dCode != UA_STATUSCODE_GOOD) {
+                zkUA_atomicWrite_initiateRollback(server, value, &v);
+                sCode = dCode;
+            }
+        } else if (zkUA_onCompletionThread() == true) {
+            /* completions can't be awaited on the completion thread - replicate synchronously */
+            zkUA_writeRollback rollback = { server, value, &v, &sCode, false };
+            zkUA_atomicWrite_replicateNode(&rollback);
+        } else {
+            zkUA_ReplicationBatch batch;
+            zkUA_ReplicationBatch_init(&batch);
+            zkUA_writeRollback rollback = { server, value, &v, &sCode, false };
+            zkUA_UA_Server_writeAttribute_prepareReplicationAsync(server,
+                    value->nodeId, &batch, zkUA_atomicWrite_rollbackCompletion,
+                    &rollback);
+            /* the write completes once zk acknowledged it (or it was rolled back) */
+            zkUA_ReplicationBatch_wait(&batch);
+            zkUA_ReplicationBatch_deleteMembers(&batch);
+            if (rollback.conflict == true)
+                zkUA_atomicWrite_replicateNode(&rollback);
         }
     }
+    UA_DataValue_deleteMembers(&v);
     return sCode;
 }
 
@@ -646,7 +1184,6 @@ void zkUA_Service_Write(UA_Server *server, UA_Session *session,
     fprintf(stderr, "zkUA_Service_Write: Intercepted call to Service_write\n");
     uaServer = server;
     size_t ntwsCnt = 0;
-    UA_StatusCode sCode = 0;
     /* Initialize an array of pointers to hold the copies of the attributes to be written */
     UA_DataValue v[request->nodesToWriteSize];
     /* Make copies of the nodes to be modified before modifying them */
@@ -657,25 +1194,57 @@ void zkUA_Service_Write(UA_Server *server, UA_Session *session,
 
     /* Apply the write requests to the local cache */
     _Service_Write(server, session, request, response);
+    if (transactionalWrites == true
+            && response->resultsSize == request->nodesToWriteSize) {
+        /* All or nothing: one zoo_multi for the whole request */
+        zkUA_atomicWrite_replicateTransaction(server, request, response, v);
+        for (ntwsCnt = 0; ntwsCnt < request->nodesToWriteSize; ++ntwsCnt)
+            UA_DataValue_deleteMembers(&v[ntwsCnt]);
+        return;
+    }
     /* For every successful write to the local cache attempt to replicate
-     to zk ensemble */
+     to zk ensemble. All nodes are pipelined within the replication window and the
+     response is complete once zk acknowledged every one of them. */
+    zkUA_ReplicationBatch batch;
+    zkUA_ReplicationBatch_init(&batch);
+    zkUA_writeRollback rollback[request->nodesToWriteSize];
+    memset(rollback, 0, sizeof(rollback));
     for (ntwsCnt = 0; ntwsCnt < request->nodesToWriteSize; ++ntwsCnt) {
         if (response->results[ntwsCnt] == UA_STATUSCODE_GOOD) {
-            /* only replicate the node to zk if its modification to the local cache succeeded */
-            sCode = zkUA_UA_Server_writeAttribute_prepareReplication(server,
-                    request->nodesToWrite[ntwsCnt].nodeId);
-            /* If the replication failed, rollback the modification done
-             to the local cache for that node only */
-            if (sCode != UA_STATUSCODE_GOOD) {
-                fprintf(stderr,
-                        "zkUA_Service_Write: Replication to zk failed - rolling back local cache change for node %lu\n",
-                        ntwsCnt);
-                UA_WriteValue nodeToWrite = request->nodesToWrite[ntwsCnt];
-                sCode = zkUA_atomicWrite_initiateRollback(server, &nodeToWrite,
-                        &v[ntwsCnt]);
+            UA_StatusCode dCode = zkUA_replicateValue(server,
+                    &request->nodesToWrite[ntwsCnt], &v[ntwsCnt]);
+            if (dCode == UA_STATUSCODE_BADNOTSUPPORTED)
+                dCode = zkUA_replicateDelta(server,
+                        &request->nodesToWrite[ntwsCnt]);
+            if (dCode != UA_STATUSCODE_BADNOTSUPPORTED) {
+                /* the value znode was written or the range logged as a delta of the node */
+                if (dCode != UA_STATUSCODE_GOOD) {
+                    zkUA_atomicWrite_initiateRollback(server,
+                            &request->nodesToWrite[ntwsCnt], &v[ntwsCnt]);
+                    response->results[ntwsCnt] = dCode;
+                }
+                continue;
             }
+            /* only replicate the node to zk if its modification to the local cache succeeded.
+             If the replication fails, the completion rolls back the modification done
+             to the local cache for that node only */
+            rollback[ntwsCnt] = (zkUA_writeRollback ) { server,
+                            &request->nodesToWrite[ntwsCnt], &v[ntwsCnt],
+                            &response->results[ntwsCnt], false };
+            zkUA_UA_Server_writeAttribute_prepareReplicationAsync(server,
+                    request->nodesToWrite[ntwsCnt].nodeId, &batch,
+                    zkUA_atomicWrite_rollbackCompletion, &rollback[ntwsCnt]);
         }
     }
+    zkUA_ReplicationBatch_wait(&batch);
+    zkUA_ReplicationBatch_deleteMembers(&batch);
+    /* Merge the writes that conflicted with another server's update into its znode */
+    for (ntwsCnt = 0; ntwsCnt < request->nodesToWriteSize; ++ntwsCnt) {
+        if (rollback[ntwsCnt].conflict == true)
+            zkUA_atomicWrite_replicateNode(&rollback[ntwsCnt]);
+    }
+    for (ntwsCnt = 0; ntwsCnt < request->nodesToWriteSize; ++ntwsCnt)
+        UA_DataValue_deleteMembers(&v[ntwsCnt]);
 }
 
 /* Intercepting addnodeinternal */
@@ -686,6 +1255,7 @@ UA_AddNodesResult zkUA_addNodeInternal(UA_Server *server, UA_Node *node,
             parentNodeId, referenceTypeId);
     UA_StatusCode sCode = addNodeResult.statusCode;
     if (sCode == UA_STATUSCODE_GOOD) { /* If the node was added successfully*/
+        zkUA_insertParent(&node->nodeId, &parentNodeId, &referenceTypeId);
         /* If this is a ns0 node that exists on zk or is a NS0ID_SERVER node or its child
          - don't add because for the former we'll replicate
          for the latter we don't replicate */
@@ -694,31 +1264,25 @@ UA_AddNodesResult zkUA_addNodeInternal(UA_Server *server, UA_Node *node,
             /* check if this ns0 node already exists on zk */
             /*TODO: deduplicate mzxid lookups across the different c files */
             /* Get the  mzxid of the node and see if we have something new(er) */
-            char *buffer = calloc(65535, sizeof(char));
-            size_t buffer_len = 65535;
             struct Stat stat;
-            char *nodeZkPath = zkUA_encodeZnodePath(
-                    (const UA_NodeId *) &node->nodeId);
-            int rc = zoo_get(zkHandle, nodeZkPath, 1 /* non-zero sets watch */,
-                    buffer, (int *) &buffer_len, &stat);
-            free(buffer);
-            if (rc != ZNONODE && rc != ZOK) { /* We weren't returned stat (i.e.,rc!=ZOK) but we got an error other than no znode exists for that path */
-                free(nodeZkPath);
+            char nodeZkPath[ZKUA_ZNODE_PATH_MAX];
+            zkUA_formatZnodePath(&node->nodeId, nodeZkPath, sizeof(nodeZkPath));
+            /* only the stat is needed - zoo_exists sets the same data watch as zoo_get */
+            int rc = zoo_exists(zkHandle, nodeZkPath, 1 /* non-zero sets watch */,
+                    &stat);
+            if (rc != ZNONODE && rc != ZOK) /* We weren't returned stat (i.e.,rc!=ZOK) but we got an error other than no znode exists for that path */
                 return addNodeResult;
-            }
 
             /* Prepare values for the hashtable */
             if (rc == ZOK) { /* If the node exists and therefore has an mzxid */
                 int mzxidFresher = zkUA_checkMzxidAge(nodeZkPath,
                         ((long long int *) &stat.mzxid));
-                free(nodeZkPath);
                 /* Let's see if the mzxid for this node path exists in our hashtable or if the retrieved data is fresher */
                 if (mzxidFresher <= 0) { /* I have something as old or older than what's on zk */
                     return addNodeResult;
                 }
             } /* Otherwise the node doesn't exist or we have something fresher */
             /* Check if this is the NS0ID_SERVER node or part of its subtree */
-            free(nodeZkPath);
             if (node->nodeId.identifier.numeric == UA_NS0ID_SERVER)
                 return addNodeResult;
             /* check if NS0ID_SERVER node exists */
@@ -734,19 +1298,24 @@ UA_AddNodesResult zkUA_addNodeInternal(UA_Server *server, UA_Node *node,
                 /* the Server node exists, check if the node to be added is part of its subtree */
                 zkUA_checkNs0 *searchedForNode = calloc(1,
                         sizeof(zkUA_checkNs0));
+                zkUA_NodeIdSet visited;
+                zkUA_NodeIdSet_init(&visited);
                 searchedForNode->searchedForNode = &node->nodeId;
                 searchedForNode->result = false;
+                searchedForNode->visited = &visited;
                 UA_Server_forEachChildNodeCall(uaServer,
                         UA_NODEID_NUMERIC(0, UA_NS0ID_SERVER),
                         zkUA_jsonDecode_checkChildOfNS0ServerNode,
                         (void *) searchedForNode);
-                if (searchedForNode->result == true) {
+                zkUA_NodeIdSet_deleteMembers(&visited);
+                UA_Boolean result = searchedForNode->result;
+                free(searchedForNode);
+                if (result == true) {
                     /* If this is a server object node's (sub-)child */
                     fprintf(stderr,
                             "zkUA_addNodeInternal: Node ns=%d;i=%d is part of the Server Node's subtree\n",
                             node->nodeId.namespaceIndex,
                             node->nodeId.identifier.numeric);
-                    free(searchedForNode);
                     return addNodeResult;
                 }
             }
@@ -773,14 +1342,18 @@ void zkUA_Service_AddNodes_single(UA_Server *server, UA_Session *session,
     uaServer = server;
     _Service_AddNodes_single(server, session, item, result,
             instantiationCallback);
+    if (result->statusCode == UA_STATUSCODE_GOOD)
+        zkUA_insertParent(&result->addedNodeId, &item->parentNodeId.nodeId,
+                &item->referenceTypeId);
     /* Get the  mzxid of the node and see if we have something new(er) */
-    char *buffer = calloc(65535, sizeof(char));
-    size_t buffer_len = 65535;
     struct Stat stat;
-    char *nodeZkPath = zkUA_encodeZnodePath(&item->requestedNewNodeId.nodeId);
-    int rc = zoo_get(zkHandle, nodeZkPath, 1 /* non-zero sets watch */, buffer,
-            (int *) &buffer_len, &stat);
-    free(buffer);
+    char nodeZkPath[ZKUA_ZNODE_PATH_MAX];
+    if (!zkUA_formatZnodePath(&item->requestedNewNodeId.nodeId, nodeZkPath,
+            sizeof(nodeZkPath)))
+        return;
+    /* only the stat is needed - zoo_exists sets the same data watch as zoo_get */
+    int rc = zoo_exists(zkHandle, nodeZkPath, 1 /* non-zero sets watch */,
+            &stat);
     if (rc != ZNONODE && rc != ZOK) /* We weren't returned stat (i.e.,rc!=ZOK) but we got an error other than no znode exists for that path */
         return;
 
@@ -788,13 +1361,11 @@ void zkUA_Service_AddNodes_single(UA_Server *server, UA_Session *session,
     if (rc == ZOK) { /* If the node exists and therefore has an mzxid */
         int mzxidFresher = zkUA_checkMzxidAge(nodeZkPath,
                 ((long long int *) &stat.mzxid));
-        free(nodeZkPath);
         /* Let's see if the mzxid for this node path exists in our hashtable or if the retrieved data is fresher */
         if (mzxidFresher <= 0) { /* I have something as old or older than what's on zk */
             return;
         }
     }
-    free(nodeZkPath);
     /* Otherwise the node doesn't exist or we have something fresher
      replicate the node to zookeeper*/
     void *data = item->nodeAttributes.content.decoded.data;
@@ -20,6 +20,12 @@
 /* For debugging purposes */
 #include <simple_parse.h>
 #include <zk_global.h>
+#include <zk_urlEncode.h>
+#include <zk_nodeIdSet.h>
+
+/* Binary decoding function of the embedded open62541 (declared in its private headers) */
+UA_StatusCode UA_decodeBinary(const UA_ByteString *src, size_t *offset,
+        void *dst, const UA_DataType *type);
 /* Declare variables */
 UA_Server *uaServer = NULL;
 /** JSON Decoding Functions **/
@@ -65,9 +71,42 @@ UA_StatusCode zkUA_jsonDecode_UA_LocalizedText(json_t *localizedText,
 
 char *zkUA_jsonDecode_UA_String(json_t *string) {
 
-    char *dataString = calloc(65535, sizeof(char));
-    snprintf(dataString, 65535, "%s", json_string_value(string));
-    return dataString;
+    /* strings are written up to their first zero byte, see zkUA_jsonEncode_UA_String */
+    const char *value = json_string_value(string);
+    return strdup(value ? value : "");
+}
+
+UA_StatusCode zkUA_jsonDecode_UA_ByteString(json_t *jsonObject,
+        UA_ByteString *byteString) {
+
+    UA_ByteString_init(byteString);
+    const char *data;
+    size_t length;
+    UA_Boolean base64 = json_is_object(jsonObject);
+    if (base64)
+        jsonObject = json_object_get(jsonObject, "base64");
+    if (!json_is_string(jsonObject))
+        return UA_STATUSCODE_BADDECODINGERROR;
+    data = json_string_value(jsonObject);
+    length = json_string_length(jsonObject);
+    if (length == 0)
+        return UA_STATUSCODE_GOOD;
+    if (UA_ByteString_allocBuffer(byteString, base64 ? length / 4 * 3 : length)
+            != UA_STATUSCODE_GOOD)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    if (!base64) {
+        /* text was written before payload version 3 */
+        memcpy(byteString->data, data, length);
+        return UA_STATUSCODE_GOOD;
+    }
+    size_t decoded = zkUA_base64_decode(data, length,
+            byteString->data);
+    if (decoded == (size_t) -1) {
+        UA_ByteString_deleteMembers(byteString);
+        return UA_STATUSCODE_BADDECODINGERROR;
+    }
+    byteString->length = decoded;
+    return UA_STATUSCODE_GOOD;
 }
 
 UA_StatusCode zkUA_jsonDecode_UA_Guid(json_t *guid, UA_Guid *g) {
@@ -78,12 +117,13 @@ UA_StatusCode zkUA_jsonDecode_UA_Guid(json_t *guid, UA_Guid *g) {
 
     json_object_foreach(guid, key, value)
     {
+        /* "i" stores an int, which overflows data2 and data3 */
         if (strcmp(key, "data1") == 0)
-            json_unpack(value, "i", &g->data1);
+            g->data1 = (UA_UInt32) json_integer_value(value);
         if (strcmp(key, "data2") == 0)
-            json_unpack(value, "i", &g->data2);
+            g->data2 = (UA_UInt16) json_integer_value(value);
         if (strcmp(key, "data3") == 0)
-            json_unpack(value, "i", &g->data3);
+            g->data3 = (UA_UInt16) json_integer_value(value);
         if (strcmp(key, "data4") == 0) {
             /* unpack the byte array */
             size_t size = json_array_size(value);
@@ -113,18 +153,20 @@ UA_StatusCode zkUA_jsonDecode_UA_NodeId(json_t *nodeId, UA_NodeId *uaNodeId) {
 
     /* Note, we're not checking if NodeType String and NodeType ByteString are successful */
     UA_StatusCode sCode = UA_STATUSCODE_GOOD;
-    int ns, idType, sInt;
     json_t *namespaceIndex = json_object_get(nodeId, "namespaceIndex");
     json_t *identifierType = json_object_get(nodeId, "identifierType");
     json_t *identifier = json_object_get(nodeId, "identifier");
-    json_unpack(namespaceIndex, "I", &ns);
-    json_unpack(identifierType, "I", &idType);
+    /* "I" stores a json_int_t, which overflows the int and UInt32 fields */
+    int ns = (int) json_integer_value(namespaceIndex);
+    int idType = json_is_integer(identifierType) ?
+            (int) json_integer_value(identifierType) : -1;
     switch (idType) {
     case UA_NODEIDTYPE_NUMERIC: {
-        sInt = json_unpack(identifier, "I", &uaNodeId->identifier.numeric);
-        if (sInt != 0) {
+        if (json_is_integer(identifier))
+            uaNodeId->identifier.numeric = (UA_UInt32) json_integer_value(
+                    identifier);
+        else
             sCode = UA_STATUSCODE_BADUNEXPECTEDERROR;
-        }
         break;
     }
     case UA_NODEIDTYPE_STRING: {
@@ -140,8 +182,8 @@ UA_StatusCode zkUA_jsonDecode_UA_NodeId(json_t *nodeId, UA_NodeId *uaNodeId) {
         break;
     }
     case UA_NODEIDTYPE_BYTESTRING: {
-        uaNodeId->identifier.byteString = UA_STRING(
-                zkUA_jsonDecode_UA_String(identifier));
+        sCode = zkUA_jsonDecode_UA_ByteString(identifier,
+                &uaNodeId->identifier.byteString);
         break;
     }
     default:
@@ -196,11 +238,13 @@ UA_StatusCode zkUA_jsonDecode_UA_QualifiedName(json_t *jsonObject,
     json_object_foreach(jsonObject, key, value)
     {
         if (strcmp(key, "namespaceIndex") == 0) {
-            if (json_unpack(value, "i", &qName->namespaceIndex) == -1) {
+            /* "i" stores an int, which overflows the UInt16 */
+            if (!json_is_integer(value)) {
                 fprintf(stderr,
                         "zkUA_jsonDecode_UA_QualifiedName: Failed to unpack the namespace Index\n");
                 return UA_STATUSCODE_BADUNEXPECTEDERROR;
             }
+            qName->namespaceIndex = (UA_UInt16) json_integer_value(value);
         } else if (strcmp(key, "name") == 0) {
             UA_String tmpStore = UA_STRING(zkUA_jsonDecode_UA_String(value));
             qName->name.length = tmpStore.length;
@@ -274,9 +318,9 @@ UA_StatusCode zkUA_jsonDecode_UA_ExtensionObject_decodeString(
         return UA_STATUSCODE_BADUNEXPECTEDERROR;
     }
     json_t *body = json_object_get(encoded, "body");
-    if (!json_is_object(body)) {
+    if (!json_is_string(body) && !json_is_object(body)) {
         fprintf(stderr,
-                "zkUA_jsonDecode_UA_ExtensionObject_Decoded: Could not retrieve the body object\n");
+                "zkUA_jsonDecode_UA_ExtensionObject_Decoded: Could not retrieve the body\n");
         return UA_STATUSCODE_BADUNEXPECTEDERROR;
     }
     json_t *typeId = json_object_get(encoded, "typeId");
@@ -285,7 +329,13 @@ UA_StatusCode zkUA_jsonDecode_UA_ExtensionObject_decodeString(
                 "zkUA_jsonDecode_UA_ExtensionObject_Decoded: Could not retrieve the typeId object\n");
         return UA_STATUSCODE_BADUNEXPECTEDERROR;
     }
-    eObject->content.encoded.body = UA_STRING(zkUA_jsonDecode_UA_String(body));
+    /* XML bodies and the ByteString bodies of payload versions before 3 are text */
+    sCode = zkUA_jsonDecode_UA_ByteString(body, &eObject->content.encoded.body);
+    if (sCode != UA_STATUSCODE_GOOD) {
+        fprintf(stderr,
+                "zkUA_jsonDecode_UA_ExtensionObject_decodeString: Could not decode the body\n");
+        return sCode;
+    }
     sCode = zkUA_jsonDecode_UA_NodeId(typeId, &eObject->content.encoded.typeId);
     if (sCode != UA_STATUSCODE_GOOD) {
         fprintf(stderr,
@@ -401,7 +451,7 @@ UA_StatusCode zkUA_jsonDecode_UA_DataValue(json_t *jsonObject,
     }
     if (dValue->hasStatus) {
         json_t *status = json_object_get(jsonObject, "status");
-        if (!json_is_object(status))
+        if (!json_is_integer(status))
             return UA_STATUSCODE_BADUNEXPECTEDERROR;
         sInt = json_unpack(status, "i", &dValue->status);
         if (sInt != 0)
@@ -410,7 +460,7 @@ UA_StatusCode zkUA_jsonDecode_UA_DataValue(json_t *jsonObject,
     if (dValue->hasSourceTimestamp) {
         json_t *sourceTimestamp = json_object_get(jsonObject,
                 "sourceTimestamp");
-        if (!json_is_object(sourceTimestamp))
+        if (!json_is_integer(sourceTimestamp))
             return UA_STATUSCODE_BADUNEXPECTEDERROR;
         sInt = json_unpack(sourceTimestamp, "I", &dValue->sourceTimestamp);
         if (sInt != 0)
@@ -419,7 +469,7 @@ UA_StatusCode zkUA_jsonDecode_UA_DataValue(json_t *jsonObject,
     if (dValue->hasServerTimestamp) {
         json_t *serverTimestamp = json_object_get(jsonObject,
                 "serverTimestamp");
-        if (!json_is_object(serverTimestamp))
+        if (!json_is_integer(serverTimestamp))
             return UA_STATUSCODE_BADUNEXPECTEDERROR;
         sInt = json_unpack(serverTimestamp, "I", &dValue->serverTimestamp);
         if (sInt != 0)
@@ -428,474 +478,256 @@ UA_StatusCode zkUA_jsonDecode_UA_DataValue(json_t *jsonObject,
     if (dValue->hasSourcePicoseconds) {
         json_t *sourcePicoseconds = json_object_get(jsonObject,
                 "sourcePicoseconds");
-        if (!json_is_object(sourcePicoseconds))
+        if (!json_is_integer(sourcePicoseconds))
             return UA_STATUSCODE_BADUNEXPECTEDERROR;
-        sInt = json_unpack(sourcePicoseconds, "i", &dValue->sourcePicoseconds);
+        int picoseconds;
+        sInt = json_unpack(sourcePicoseconds, "i", &picoseconds);
         if (sInt != 0)
             return UA_STATUSCODE_BADUNEXPECTEDERROR;
+        dValue->sourcePicoseconds = (UA_UInt16) picoseconds;
     }
     if (dValue->hasServerPicoseconds) {
         json_t *serverPicoseconds = json_object_get(jsonObject,
                 "serverPicoseconds");
-        if (!json_is_object(serverPicoseconds))
+        if (!json_is_integer(serverPicoseconds))
             return UA_STATUSCODE_BADUNEXPECTEDERROR;
-        sInt = json_unpack(serverPicoseconds, "i", &dValue->serverPicoseconds);
+        int picoseconds;
+        sInt = json_unpack(serverPicoseconds, "i", &picoseconds);
         if (sInt != 0)
             return UA_STATUSCODE_BADUNEXPECTEDERROR;
+        dValue->serverPicoseconds = (UA_UInt16) picoseconds;
     }
     return sCode;
 }
 
-UA_StatusCode zkUA_jsonDecode_UA_Variant_setData(void *data,
-        const UA_DataType *type, json_t *dataValue) {
+/* Decoders of the 23 possible types for a Variant (see page 6 of Part 6 of the
+ OPC UA Spec. R1.03), one per UA_TYPES_ index. data is initialized (zeroed). */
+typedef UA_StatusCode (*zkUA_jsonDecode_valueCodec)(json_t *dataValue,
+        void *data);
 
-    UA_StatusCode sCode = UA_STATUSCODE_GOOD;
-    int sInt = 0;
-
-    if (type == &UA_TYPES[UA_TYPES_BOOLEAN]) {
-        ;
-        UA_Boolean_init((UA_Boolean *) data);
-        int dataInt;
-        sInt = json_unpack(dataValue, "b", &dataInt);
-        if (sInt != 0) {
-            fprintf(stderr,
-                    "zkUA_jsonDecode_UA_Variant_setData: Failed to unpack Boolean\n");
-            sCode = UA_STATUSCODE_BADUNEXPECTEDERROR;
-        } else if (dataInt == 0)
-            *(UA_Boolean *) data = UA_FALSE;
-        else
-            *(UA_Boolean *) data = UA_TRUE;
-    } else if (type == &UA_TYPES[UA_TYPES_SBYTE]) {
-        UA_SByte_init(data);
-        int dataInt;
-        sInt = json_unpack(dataValue, "i", &dataInt);
-        if (sInt != 0) {
-            fprintf(stderr,
-                    "zkUA_jsonDecode_UA_Variant_setData: Failed to unpack SByte\n");
-            sCode = UA_STATUSCODE_BADUNEXPECTEDERROR;
-        } else
-            *(UA_SByte *) data = dataInt;
-    } else if (type == &UA_TYPES[UA_TYPES_BYTE]) {
-        UA_Byte_init(data);
-        int dataInt;
-        sInt = json_unpack(dataValue, "i", &dataInt);
-        if (sInt != 0) {
-            fprintf(stderr,
-                    "zkUA_jsonDecode_UA_Variant_setData: Failed to unpack Byte\n");
-            sCode = UA_STATUSCODE_BADUNEXPECTEDERROR;
-        } else
-            *(UA_Byte *) data = dataInt;
-    } else if (type == &UA_TYPES[UA_TYPES_INT16]) {
-        UA_Int16_init(data);
-        int dataInt;
-        sInt = json_unpack(dataValue, "i", &dataInt);
-        if (sInt != 0) {
-            fprintf(stderr,
-                    "zkUA_jsonDecode_UA_Variant_setData: Failed to unpack Int16\n");
-            sCode = UA_STATUSCODE_BADUNEXPECTEDERROR;
-        } else
-            *(UA_Int16 *) data = dataInt;
-    } else if (type == &UA_TYPES[UA_TYPES_UINT16]) {
-        UA_UInt16_init(data);
-        int dataInt;
-        sInt = json_unpack(dataValue, "i", &dataInt);
-        if (sInt != 0) {
-            fprintf(stderr,
-                    "zkUA_jsonDecode_UA_Variant_setData: Failed to unpack UInt16\n");
-            sCode = UA_STATUSCODE_BADUNEXPECTEDERROR;
-        } else
-            *(UA_UInt16 *) data = dataInt;
-    } else if (type == &UA_TYPES[UA_TYPES_INT32]) {
-        UA_Int32_init((UA_Int32 *) data);
-        UA_Int32 dataInt;
-        sInt = json_unpack(dataValue, "i", &dataInt);
-        if (sInt != 0) {
-            fprintf(stderr,
-                    "zkUA_jsonDecode_UA_Variant_setData: Failed to unpack Int32\n");
-            sCode = UA_STATUSCODE_BADUNEXPECTEDERROR;
-        } else
-            *(UA_Int32 *) data = dataInt;
-    } else if (type == &UA_TYPES[UA_TYPES_UINT32]) {
-        UA_UInt32_init(data);
-        sInt = json_unpack(dataValue, "i", data);
-        if (sInt != 0) {
-            fprintf(stderr,
-                    "zkUA_jsonDecode_UA_Variant_setData: Failed to unpack UInt32\n");
-            sCode = UA_STATUSCODE_BADUNEXPECTEDERROR;
-        }
-    } else if (type == &UA_TYPES[UA_TYPES_INT64]) {
-        UA_Int64_init(data);
-        sInt = json_unpack(dataValue, "I", data);
-        if (sInt != 0) {
-            fprintf(stderr,
-                    "zkUA_jsonDecode_UA_Variant_setData: Failed to unpack Int64\n");
-            sCode = UA_STATUSCODE_BADUNEXPECTEDERROR;
-        }
-    } else if (type == &UA_TYPES[UA_TYPES_UINT64]) {
-        UA_UInt64_init(data);
-        sInt = json_unpack(dataValue, "I", data);
-        if (sInt != 0) {
-            fprintf(stderr,
-                    "zkUA_jsonDecode_UA_Variant_setData: Failed to unpack UInt64\n");
-            sCode = UA_STATUSCODE_BADUNEXPECTEDERROR;
-        }
-    } else if (type == &UA_TYPES[UA_TYPES_FLOAT]) {
-        UA_Float_init(data);
-        long long int dataInt;
-        sInt = json_unpack(dataValue, "f", &dataInt);
-        if (sInt != 0) {
-            fprintf(stderr,
-                    "zkUA_jsonDecode_UA_Variant_setData: Failed to unpack Float\n");
-            sCode = UA_STATUSCODE_BADUNEXPECTEDERROR;
-        } else
-            *(UA_Float *) data = dataInt;
-    } else if (type == &UA_TYPES[UA_TYPES_DOUBLE]) {
-        UA_Double_init(data);
-        long long int dataInt;
-        sInt = json_unpack(dataValue, "f", &dataInt);
-        if (sInt != 0) {
-            fprintf(stderr,
-                    "zkUA_jsonDecode_UA_Variant_setData: Failed to unpack Double\n");
-            sCode = UA_STATUSCODE_BADUNEXPECTEDERROR;
-        } else
-            *(UA_Double *) data = dataInt;
-    } else if (type == &UA_TYPES[UA_TYPES_STRING]) {
-        UA_String *tmpData = (UA_String *) data;
-        UA_String tmpStore = UA_STRING(zkUA_jsonDecode_UA_String(dataValue));
-        tmpData->length = tmpStore.length;
-        if (tmpStore.length != 0) {
-            tmpData->data = malloc(tmpStore.length);
-            memcpy(tmpData->data, tmpStore.data, tmpStore.length);
-        }
-        UA_String_deleteMembers(&tmpStore);
-    } else if (type == &UA_TYPES[UA_TYPES_DATETIME]) {
-        UA_DateTime_init(data);
-        sInt = json_unpack(dataValue, "I", data);
-        if (sInt != 0) {
-            fprintf(stderr,
-                    "zkUA_jsonDecode_UA_Variant_setData: Failed to unpack DateTime\n");
-            sCode = UA_STATUSCODE_BADUNEXPECTEDERROR;
-        }
-    } else if (type == &UA_TYPES[UA_TYPES_GUID]) {
-        UA_Guid_init(data);
-        sCode = zkUA_jsonDecode_UA_Guid(dataValue, data);
-        if (sCode != UA_STATUSCODE_GOOD)
-            fprintf(stderr,
-                    "zkUA_jsonDecode_UA_Variant_setData: Failed to decode Guid\n");
-    } else if (type == &UA_TYPES[UA_TYPES_BYTESTRING]) {
-        UA_ByteString_init(data);
-        UA_ByteString *tmpData = (UA_ByteString *) data;
-        UA_String tmpStore = UA_STRING(zkUA_jsonDecode_UA_String(dataValue));
-        tmpData->length = tmpStore.length;
-        if (tmpStore.length != 0) {
-            tmpData->data = malloc(tmpStore.length);
-            memcpy(tmpData->data, tmpStore.data, tmpStore.length);
-        }
-        UA_String_deleteMembers(&tmpStore);
-    } else if (type == &UA_TYPES[UA_TYPES_XMLELEMENT]) {
-        UA_XmlElement_init(data);
-        UA_XmlElement *tmpData = (UA_XmlElement *) data;
-        UA_String tmpStore = UA_STRING(zkUA_jsonDecode_UA_String(dataValue));
-        tmpData->length = tmpStore.length;
-        if (tmpStore.length != 0) {
-            tmpData->data = malloc(tmpStore.length);
-            memcpy(tmpData->data, tmpStore.data, tmpStore.length);
-        }
-        UA_String_deleteMembers(&tmpStore);
-    } else if (type == &UA_TYPES[UA_TYPES_NODEID]) {
-        UA_NodeId_init(data);
-        sCode = zkUA_jsonDecode_UA_NodeId(dataValue, data);
-        if (sCode != UA_STATUSCODE_GOOD)
-            fprintf(stderr,
-                    "zkUA_jsonDecode_UA_Variant_setData: Failed to decode NodeId\n");
-    } else if (type == &UA_TYPES[UA_TYPES_EXPANDEDNODEID]) {
-        UA_ExpandedNodeId_init(data);
-        sCode = zkUA_jsonDecode_UA_ExpandedNodeId(dataValue, data);
-        if (sCode != UA_STATUSCODE_GOOD)
-            fprintf(stderr,
-                    "zkUA_jsonDecode_UA_Variant_setData: Failed to decode ExpandedNodeId\n");
-    } else if (type == &UA_TYPES[UA_TYPES_STATUSCODE]) {
-        UA_StatusCode_init(data);
-        sInt = json_unpack(dataValue, "i", data);
-        if (sInt != 0) {
-            fprintf(stderr,
-                    "zkUA_jsonDecode_UA_Variant_setData: Failed to unpack StatusCode\n");
-            sCode = UA_STATUSCODE_BADUNEXPECTEDERROR;
-        }
-    } else if (type == &UA_TYPES[UA_TYPES_QUALIFIEDNAME]) {
-        UA_QualifiedName_init(data);
-        sCode = zkUA_jsonDecode_UA_QualifiedName(dataValue, data);
-        if (sCode != UA_STATUSCODE_GOOD)
-            fprintf(stderr,
-                    "zkUA_jsonDecode_UA_Variant_setData: Failed to decode QualifiedName\n");
-    } else if (type == &UA_TYPES[UA_TYPES_LOCALIZEDTEXT]) {
-        UA_LocalizedText_init(data);
-        sCode = zkUA_jsonDecode_UA_LocalizedText(dataValue, data);
-        if (sCode != UA_STATUSCODE_GOOD)
-            fprintf(stderr,
-                    "zkUA_jsonDecode_UA_Variant_setData: Failed to decode LocalizedText\n");
-    } else if (type == &UA_TYPES[UA_TYPES_EXTENSIONOBJECT]) {
-        UA_ExtensionObject_init(data);
-        sCode = zkUA_jsonDecode_UA_ExtensionObject(dataValue, data);
-        if (sCode != UA_STATUSCODE_GOOD)
-            fprintf(stderr,
-                    "zkUA_jsonDecode_UA_Variant_setData: Failed to decode ExtensionObject\n");
-    } else if (type == &UA_TYPES[UA_TYPES_DATAVALUE]) {
-        UA_DataValue_init(data);
-        sCode = zkUA_jsonDecode_UA_DataValue(dataValue, data);
-        if (sCode != UA_STATUSCODE_GOOD)
-            fprintf(stderr,
-                    "zkUA_jsonDecode_UA_Variant_setData: Failed to decode DataValue\n");
+static UA_StatusCode zkUA_jsonDecode_Boolean(json_t *dataValue, void *data) {
+    int dataInt;
+    if (json_unpack(dataValue, "b", &dataInt) != 0)
+        return UA_STATUSCODE_BADUNEXPECTEDERROR;
+    *(UA_Boolean *) data = (dataInt == 0) ? UA_FALSE : UA_TRUE;
+    return UA_STATUSCODE_GOOD;
+}
+
+/* The integer types up to 32 bits are unpacked as int and truncated */
+#define ZKUA_JSONDECODE_INTEGER(NAME, TYPE)                                    \
+    static UA_StatusCode zkUA_jsonDecode_##NAME(json_t *dataValue,             \
+            void *data) {                                                      \
+        int dataInt;                                                           \
+        if (json_unpack(dataValue, "i", &dataInt) != 0)                        \
+            return UA_STATUSCODE_BADUNEXPECTEDERROR;                           \
+        *(TYPE *) data = (TYPE) dataInt;                                       \
+        return UA_STATUSCODE_GOOD;                                             \
+    }
+ZKUA_JSONDECODE_INTEGER(SByte, UA_SByte)
+ZKUA_JSONDECODE_INTEGER(Byte, UA_Byte)
+ZKUA_JSONDECODE_INTEGER(Int16, UA_Int16)
+ZKUA_JSONDECODE_INTEGER(UInt16, UA_UInt16)
+ZKUA_JSONDECODE_INTEGER(Int32, UA_Int32)
+ZKUA_JSONDECODE_INTEGER(UInt32, UA_UInt32)
+ZKUA_JSONDECODE_INTEGER(StatusCode, UA_StatusCode)
+#undef ZKUA_JSONDECODE_INTEGER
+
+/* also UInt64 (encoded as the json_int_t of the same bits) and DateTime */
+static UA_StatusCode zkUA_jsonDecode_Int64(json_t *dataValue, void *data) {
+    json_int_t dataInt;
+    if (json_unpack(dataValue, "I", &dataInt) != 0)
+        return UA_STATUSCODE_BADUNEXPECTEDERROR;
+    *(UA_Int64 *) data = dataInt;
+    return UA_STATUSCODE_GOOD;
+}
+
+static UA_StatusCode zkUA_jsonDecode_Float(json_t *dataValue, void *data) {
+    double dataReal;
+    if (json_unpack(dataValue, "F", &dataReal) != 0)
+        return UA_STATUSCODE_BADUNEXPECTEDERROR;
+    *(UA_Float *) data = (UA_Float) dataReal;
+    return UA_STATUSCODE_GOOD;
+}
+
+static UA_StatusCode zkUA_jsonDecode_Double(json_t *dataValue, void *data) {
+    if (json_unpack(dataValue, "F", (double *) data) != 0)
+        return UA_STATUSCODE_BADUNEXPECTEDERROR;
+    return UA_STATUSCODE_GOOD;
+}
+
+/* also XmlElement */
+static UA_StatusCode zkUA_jsonDecode_String(json_t *dataValue, void *data) {
+    UA_String *tmpData = (UA_String *) data;
+    UA_String tmpStore = UA_STRING(zkUA_jsonDecode_UA_String(dataValue));
+    tmpData->length = tmpStore.length;
+    if (tmpStore.length != 0) {
+        tmpData->data = malloc(tmpStore.length);
+        memcpy(tmpData->data, tmpStore.data, tmpStore.length);
     }
+    UA_String_deleteMembers(&tmpStore);
+    return UA_STATUSCODE_GOOD;
+}
+
+static UA_StatusCode zkUA_jsonDecode_ByteString(json_t *dataValue,
+        void *data) {
+    return zkUA_jsonDecode_UA_ByteString(dataValue, (UA_ByteString *) data);
+}
+
+static UA_StatusCode zkUA_jsonDecode_Guid(json_t *dataValue, void *data) {
+    return zkUA_jsonDecode_UA_Guid(dataValue, (UA_Guid *) data);
+}
+static UA_StatusCode zkUA_jsonDecode_NodeId(json_t *dataValue, void *data) {
+    return zkUA_jsonDecode_UA_NodeId(dataValue, (UA_NodeId *) data);
+}
+static UA_StatusCode zkUA_jsonDecode_ExpandedNodeId(json_t *dataValue,
+        void *data) {
+    return zkUA_jsonDecode_UA_ExpandedNodeId(dataValue,
+            (UA_ExpandedNodeId *) data);
+}
+static UA_StatusCode zkUA_jsonDecode_QualifiedName(json_t *dataValue,
+        void *data) {
+    return zkUA_jsonDecode_UA_QualifiedName(dataValue,
+            (UA_QualifiedName *) data);
+}
+static UA_StatusCode zkUA_jsonDecode_LocalizedText(json_t *dataValue,
+        void *data) {
+    return zkUA_jsonDecode_UA_LocalizedText(dataValue,
+            (UA_LocalizedText *) data);
+}
+static UA_StatusCode zkUA_jsonDecode_ExtensionObject(json_t *dataValue,
+        void *data) {
+    return zkUA_jsonDecode_UA_ExtensionObject(dataValue,
+            (UA_ExtensionObject *) data);
+}
+static UA_StatusCode zkUA_jsonDecode_DataValue(json_t *dataValue, void *data) {
+    return zkUA_jsonDecode_UA_DataValue(dataValue, (UA_DataValue *) data);
+}
 
+static const zkUA_jsonDecode_valueCodec valueCodecs[UA_TYPES_DATAVALUE + 1] = {
+        [UA_TYPES_BOOLEAN] = zkUA_jsonDecode_Boolean,
+        [UA_TYPES_SBYTE] = zkUA_jsonDecode_SByte,
+        [UA_TYPES_BYTE] = zkUA_jsonDecode_Byte,
+        [UA_TYPES_INT16] = zkUA_jsonDecode_Int16,
+        [UA_TYPES_UINT16] = zkUA_jsonDecode_UInt16,
+        [UA_TYPES_INT32] = zkUA_jsonDecode_Int32,
+        [UA_TYPES_UINT32] = zkUA_jsonDecode_UInt32,
+        [UA_TYPES_INT64] = zkUA_jsonDecode_Int64,
+        [UA_TYPES_UINT64] = zkUA_jsonDecode_Int64,
+        [UA_TYPES_FLOAT] = zkUA_jsonDecode_Float,
+        [UA_TYPES_DOUBLE] = zkUA_jsonDecode_Double,
+        [UA_TYPES_STRING] = zkUA_jsonDecode_String,
+        [UA_TYPES_DATETIME] = zkUA_jsonDecode_Int64,
+        [UA_TYPES_GUID] = zkUA_jsonDecode_Guid,
+        [UA_TYPES_BYTESTRING] = zkUA_jsonDecode_ByteString,
+        [UA_TYPES_XMLELEMENT] = zkUA_jsonDecode_String,
+        [UA_TYPES_NODEID] = zkUA_jsonDecode_NodeId,
+        [UA_TYPES_EXPANDEDNODEID] = zkUA_jsonDecode_ExpandedNodeId,
+        [UA_TYPES_STATUSCODE] = zkUA_jsonDecode_StatusCode,
+        [UA_TYPES_QUALIFIEDNAME] = zkUA_jsonDecode_QualifiedName,
+        [UA_TYPES_LOCALIZEDTEXT] = zkUA_jsonDecode_LocalizedText,
+        [UA_TYPES_EXTENSIONOBJECT] = zkUA_jsonDecode_ExtensionObject,
+        [UA_TYPES_DATAVALUE] = zkUA_jsonDecode_DataValue };
+
+/* The decoder of a Variant value type, NULL if it can't be decoded */
+static zkUA_jsonDecode_valueCodec zkUA_jsonDecode_valueCodecOf(
+        const UA_DataType *type) {
+    if (!type || type->typeIndex > UA_TYPES_DATAVALUE
+            || type != &UA_TYPES[type->typeIndex])
+        return NULL;
+    return valueCodecs[type->typeIndex];
+}
+
+UA_StatusCode zkUA_jsonDecode_UA_Variant_setData(void *data,
+        const UA_DataType *type, json_t *dataValue) {
+
+    zkUA_jsonDecode_valueCodec codec = zkUA_jsonDecode_valueCodecOf(type);
+    if (!codec)
+        return UA_STATUSCODE_GOOD;
+    memset(data, 0, type->memSize);
+    UA_StatusCode sCode = codec(dataValue, data);
+    if (sCode != UA_STATUSCODE_GOOD)
+        fprintf(stderr,
+                "zkUA_jsonDecode_UA_Variant_setData: Failed to decode %s\n",
+                type->typeName);
     return sCode;
 }
 
 UA_StatusCode zkUA_jsonDecode_UA_Variant_callSetDataByType(UA_Variant *variant,
         UA_DataType *type, json_t *dataValue, int dataIndex) {
 
-    int i = -1;
+    if (!zkUA_jsonDecode_valueCodecOf(type))
+        return UA_STATUSCODE_BADUNEXPECTEDERROR;
     if (dataIndex != -1)
-        i = dataIndex;
-    UA_StatusCode sCode = UA_STATUSCODE_BADUNEXPECTEDERROR;
-    void *data = variant->data;
-    if (!data)
-        fprintf(stderr, " ");
+        return zkUA_jsonDecode_UA_Variant_setData(
+                (char *) variant->data + (size_t) dataIndex * type->memSize,
+                type, dataValue);
+    UA_Variant_setScalar(variant, UA_new(type), type);
+    return zkUA_jsonDecode_UA_Variant_setData(variant->data, type, dataValue);
+}
 
-    if (type == &UA_TYPES[UA_TYPES_BOOLEAN]) {
-        if (dataIndex != -1)
-            sCode = zkUA_jsonDecode_UA_Variant_setData(
-                    &((UA_Boolean *) variant->data)[i], type, dataValue);
-        else {
-            UA_Variant_setScalar(variant, UA_Boolean_new(),
-                    &UA_TYPES[UA_TYPES_BOOLEAN]);
-            sCode = zkUA_jsonDecode_UA_Variant_setData(
-                    (UA_Boolean *) variant->data, type, dataValue);
-        }
-    } else if (type == &UA_TYPES[UA_TYPES_SBYTE]) {
-        if (dataIndex != -1)
-            sCode = zkUA_jsonDecode_UA_Variant_setData(
-                    &((UA_SByte *) variant->data)[i], type, dataValue);
-        else {
-            UA_Variant_setScalar(variant, UA_SByte_new(),
-                    &UA_TYPES[UA_TYPES_SBYTE]);
-            sCode = zkUA_jsonDecode_UA_Variant_setData(
-                    (UA_SByte *) variant->data, type, dataValue);
-        }
-    } else if (type == &UA_TYPES[UA_TYPES_BYTE]) {
-        if (dataIndex != -1)
-            sCode = zkUA_jsonDecode_UA_Variant_setData(
-                    &((UA_Byte *) variant->data)[i], type, dataValue);
-        else {
-            UA_Variant_setScalar(variant, UA_Byte_new(),
-                    &UA_TYPES[UA_TYPES_BYTE]);
-            sCode = zkUA_jsonDecode_UA_Variant_setData(
-                    (UA_Byte *) variant->data, type, dataValue);
-        }
-    } else if (type == &UA_TYPES[UA_TYPES_INT16]) {
-        if (dataIndex != -1)
-            sCode = zkUA_jsonDecode_UA_Variant_setData(
-                    &((UA_Int16 *) variant->data)[i], type, dataValue);
-        else {
-            UA_Variant_setScalar(variant, UA_Int16_new(),
-                    &UA_TYPES[UA_TYPES_INT16]);
-            sCode = zkUA_jsonDecode_UA_Variant_setData(
-                    (UA_Int16 *) variant->data, type, dataValue);
-        }
-    } else if (type == &UA_TYPES[UA_TYPES_UINT16]) {
-        if (dataIndex != -1)
-            sCode = zkUA_jsonDecode_UA_Variant_setData(
-                    &((UA_UInt16 *) variant->data)[i], type, dataValue);
-        else {
-            UA_Variant_setScalar(variant, UA_UInt16_new(),
-                    &UA_TYPES[UA_TYPES_UINT16]);
-            sCode = zkUA_jsonDecode_UA_Variant_setData(
-                    (UA_UInt16 *) variant->data, type, dataValue);
-        }
-    } else if (type == &UA_TYPES[UA_TYPES_INT32]) {
-        if (dataIndex != -1)
-            sCode = zkUA_jsonDecode_UA_Variant_setData(
-                    &((UA_Int32 *) variant->data)[i], type, dataValue);
-        else {
-            UA_Variant_setScalar(variant, UA_Int32_new(),
-                    &UA_TYPES[UA_TYPES_INT32]);
-            sCode = zkUA_jsonDecode_UA_Variant_setData(
-                    (UA_Int32 *) variant->data, type, dataValue);
-        }
-    } else if (type == &UA_TYPES[UA_TYPES_UINT32]) {
-        if (dataIndex != -1)
-            sCode = zkUA_jsonDecode_UA_Variant_setData(
-                    &((UA_UInt32 *) variant->data)[i], type, dataValue);
-        else {
-            UA_Variant_setScalar(variant, UA_UInt32_new(),
-                    &UA_TYPES[UA_TYPES_UINT32]);
-            sCode = zkUA_jsonDecode_UA_Variant_setData(
-                    (UA_UInt32 *) variant->data, type, dataValue);
-        }
-    } else if (type == &UA_TYPES[UA_TYPES_INT64]) {
-        if (dataIndex != -1)
-            sCode = zkUA_jsonDecode_UA_Variant_setData(
-                    &((UA_Int64 *) variant->data)[i], type, dataValue);
-        else {
-            UA_Variant_setScalar(variant, UA_Int64_new(),
-                    &UA_TYPES[UA_TYPES_INT64]);
-            sCode = zkUA_jsonDecode_UA_Variant_setData(
-                    (UA_Int64 *) variant->data, type, dataValue);
-        }
-    } else if (type == &UA_TYPES[UA_TYPES_UINT64]) {
-        if (dataIndex != -1)
-            sCode = zkUA_jsonDecode_UA_Variant_setData(
-                    &((UA_UInt64 *) variant->data)[i], type, dataValue);
-        else {
-            UA_Variant_setScalar(variant, UA_UInt64_new(),
-                    &UA_TYPES[UA_TYPES_INT64]);
-            sCode = zkUA_jsonDecode_UA_Variant_setData(
-                    (UA_UInt64 *) variant->data, type, dataValue);
-        }
-    } else if (type == &UA_TYPES[UA_TYPES_FLOAT]) {
-        if (dataIndex != -1)
-            sCode = zkUA_jsonDecode_UA_Variant_setData(
-                    &((UA_Float *) variant->data)[i], type, dataValue);
-        else {
-            UA_Variant_setScalar(variant, UA_Float_new(),
-                    &UA_TYPES[UA_TYPES_FLOAT]);
-            sCode = zkUA_jsonDecode_UA_Variant_setData(
-                    (UA_Float *) variant->data, type, dataValue);
-        }
-    } else if (type == &UA_TYPES[UA_TYPES_DOUBLE]) {
-        if (dataIndex != -1)
-            sCode = zkUA_jsonDecode_UA_Variant_setData(
-                    &((UA_Double *) variant->data)[i], type, dataValue);
-        else {
-            UA_Variant_setScalar(variant, UA_Double_new(),
-                    &UA_TYPES[UA_TYPES_DOUBLE]);
-            sCode = zkUA_jsonDecode_UA_Variant_setData(
-                    (UA_Double *) variant->data, type, dataValue);
-        }
-    } else if (type == &UA_TYPES[UA_TYPES_STRING]) {
-        if (dataIndex != -1)
-            sCode = zkUA_jsonDecode_UA_Variant_setData(
-                    &((UA_String *) variant->data)[i], type, dataValue);
-        else {
-            UA_Variant_setScalar(variant, UA_String_new(),
-                    &UA_TYPES[UA_TYPES_STRING]);
-            sCode = zkUA_jsonDecode_UA_Variant_setData(
-                    (UA_String *) variant->data, type, dataValue);
-        }
-    } else if (type == &UA_TYPES[UA_TYPES_DATETIME]) {
-        if (dataIndex != -1)
-            sCode = zkUA_jsonDecode_UA_Variant_setData(
-                    &((UA_DateTime *) variant->data)[i], type, dataValue);
-        else {
-            UA_Variant_setScalar(variant, UA_DateTime_new(),
-                    &UA_TYPES[UA_TYPES_DATETIME]);
-            sCode = zkUA_jsonDecode_UA_Variant_setData(
-                    (UA_DateTime *) variant->data, type, dataValue);
-        }
-    } else if (type == &UA_TYPES[UA_TYPES_GUID]) {
-        if (dataIndex != -1)
-            sCode = zkUA_jsonDecode_UA_Variant_setData(
-                    &((UA_Guid *) variant->data)[i], type, dataValue);
-        else {
-            UA_Variant_setScalar(variant, UA_Guid_new(),
-                    &UA_TYPES[UA_TYPES_GUID]);
-            sCode = zkUA_jsonDecode_UA_Variant_setData(
-                    (UA_Guid *) variant->data, type, dataValue);
-        }
-    } else if (type == &UA_TYPES[UA_TYPES_BYTESTRING]) {
-        if (dataIndex != -1)
-            sCode = zkUA_jsonDecode_UA_Variant_setData(
-                    &((UA_ByteString *) variant->data)[i], type, dataValue);
-        else {
-            UA_Variant_setScalar(variant, UA_ByteString_new(),
-                    &UA_TYPES[UA_TYPES_BYTESTRING]);
-            sCode = zkUA_jsonDecode_UA_Variant_setData(
-                    (UA_ByteString *) variant->data, type, dataValue);
-        }
-    } else if (type == &UA_TYPES[UA_TYPES_XMLELEMENT]) {
-        if (dataIndex != -1)
-            sCode = zkUA_jsonDecode_UA_Variant_setData(
-                    &((UA_XmlElement *) variant->data)[i], type, dataValue);
-        else {
-            UA_Variant_setScalar(variant, UA_XmlElement_new(),
-                    &UA_TYPES[UA_TYPES_XMLELEMENT]);
-            sCode = zkUA_jsonDecode_UA_Variant_setData(
-                    (UA_XmlElement *) variant->data, type, dataValue);
-        }
-    } else if (type == &UA_TYPES[UA_TYPES_NODEID]) {
-        if (dataIndex != -1)
-            sCode = zkUA_jsonDecode_UA_Variant_setData(
-                    &((UA_NodeId *) variant->data)[i], type, dataValue);
-        else {
-            UA_Variant_setScalar(variant, UA_NodeId_new(),
-                    &UA_TYPES[UA_TYPES_NODEID]);
-            sCode = zkUA_jsonDecode_UA_Variant_setData(
-                    (UA_NodeId *) variant->data, type, dataValue);
-        }
-    } else if (type == &UA_TYPES[UA_TYPES_EXPANDEDNODEID]) {
-        if (dataIndex != -1)
-            sCode = zkUA_jsonDecode_UA_Variant_setData(
-                    &((UA_ExpandedNodeId *) variant->data)[i], type, dataValue);
-        else {
-            UA_Variant_setScalar(variant, UA_ExpandedNodeId_new(),
-                    &UA_TYPES[UA_TYPES_EXPANDEDNODEID]);
-            sCode = zkUA_jsonDecode_UA_Variant_setData(
-                    (UA_ExpandedNodeId *) variant->data, type, dataValue);
-        }
-    } else if (type == &UA_TYPES[UA_TYPES_STATUSCODE]) {
-        if (dataIndex != -1)
-            sCode = zkUA_jsonDecode_UA_Variant_setData(
-                    &((UA_StatusCode *) variant->data)[i], type, dataValue);
-        else {
-            UA_Variant_setScalar(variant, UA_StatusCode_new(),
-                    &UA_TYPES[UA_TYPES_STATUSCODE]);
-            sCode = zkUA_jsonDecode_UA_Variant_setData(
-                    (UA_StatusCode *) variant->data, type, dataValue);
-        }
-    } else if (type == &UA_TYPES[UA_TYPES_QUALIFIEDNAME]) {
-        if (dataIndex != -1)
-            sCode = zkUA_jsonDecode_UA_Variant_setData(
-                    &((UA_QualifiedName *) variant->data)[i], type, dataValue);
-        else {
-            UA_Variant_setScalar(variant, UA_QualifiedName_new(),
-                    &UA_TYPES[UA_TYPES_QUALIFIEDNAME]);
-            sCode = zkUA_jsonDecode_UA_Variant_setData(
-                    (UA_QualifiedName *) variant->data, type, dataValue);
-        }
-    } else if (type == &UA_TYPES[UA_TYPES_LOCALIZEDTEXT]) {
-        if (dataIndex != -1)
-            sCode = zkUA_jsonDecode_UA_Variant_setData(
-                    &((UA_LocalizedText *) variant->data)[i], type, dataValue);
-        else {
-            UA_Variant_setScalar(variant, UA_LocalizedText_new(),
-                    &UA_TYPES[UA_TYPES_LOCALIZEDTEXT]);
-            sCode = zkUA_jsonDecode_UA_Variant_setData(
-                    (UA_LocalizedText *) variant->data, type, dataValue);
-        }
-    } else if (type == &UA_TYPES[UA_TYPES_EXTENSIONOBJECT]) {
-        if (dataIndex != -1)
-            sCode = zkUA_jsonDecode_UA_Variant_setData(
-                    &((UA_ExtensionObject *) variant->data)[i], type,
-                    dataValue);
-        else {
-            UA_Variant_setScalar(variant, UA_ExtensionObject_new(),
-                    &UA_TYPES[UA_TYPES_EXTENSIONOBJECT]);
-            sCode = zkUA_jsonDecode_UA_Variant_setData(
-                    (UA_ExtensionObject *) variant->data, type, dataValue);
+/*
+ * zkUA_jsonDecode_UA_Variant_arrayData:
+ * Decodes the values and dimensions of an array variant that were encoded as JSON
+ *  arrays, or as the base64 of the packed array, into the allocated variant array
+ */
+static UA_StatusCode zkUA_jsonDecode_UA_Variant_arrayData(json_t *value,
+        const char *dataEncoding, UA_Variant *variant) {
+
+    const UA_DataType *type = variant->type;
+    json_t *data = json_object_get(value, "data");
+    UA_StatusCode sCode = UA_STATUSCODE_GOOD;
+    if (strcmp(dataEncoding, "base64") == 0 && json_is_string(data)) {
+        size_t length = json_string_length(data);
+        UA_ByteString packed;
+        packed.data = malloc(length / 4 * 3 + 1);
+        packed.length = zkUA_base64_decode(json_string_value(data), length,
+                packed.data);
+        if (packed.length == (size_t) -1) {
+            sCode = UA_STATUSCODE_BADDECODINGERROR;
+        } else if (type->overlayable
+                && packed.length == variant->arrayLength * type->memSize) {
+            memcpy(variant->data, packed.data, packed.length);
+        } else {
+            /* this build lays the type out differently: decode element by element */
+            size_t offset = 0;
+            for (size_t i = 0; i < variant->arrayLength && sCode == UA_STATUSCODE_GOOD;
+                    i++)
+                sCode = UA_decodeBinary(&packed, &offset,
+                        (char *) variant->data + i * type->memSize, type);
         }
-    } else if (type == &UA_TYPES[UA_TYPES_DATAVALUE]) {
-        if (dataIndex != -1)
-            sCode = zkUA_jsonDecode_UA_Variant_setData(
-                    &((UA_DataValue *) variant->data)[i], type, dataValue);
-        else {
-            UA_Variant_setScalar(variant, UA_DataValue_new(),
-                    &UA_TYPES[UA_TYPES_DATAVALUE]);
+        free(packed.data);
+    } else if (strcmp(dataEncoding, "array") == 0 && json_is_array(data)
+            && json_array_size(data) == variant->arrayLength) {
+        for (size_t i = 0; i < variant->arrayLength && sCode == UA_STATUSCODE_GOOD;
+                i++)
             sCode = zkUA_jsonDecode_UA_Variant_setData(
-                    (UA_DataValue *) variant->data, type, dataValue);
-        }
+                    (char *) variant->data + i * type->memSize, type,
+                    json_array_get(data, i));
+    } else {
+        fprintf(stderr,
+                "zkUA_jsonDecode_UA_Variant_arrayData: Unknown dataEncoding %s or malformed data\n",
+                dataEncoding);
+        return UA_STATUSCODE_BADDECODINGERROR;
+    }
+    if (sCode != UA_STATUSCODE_GOOD) {
+        fprintf(stderr,
+                "zkUA_jsonDecode_UA_Variant_arrayData: Could not decode the array values - arrayLength %lu\n",
+                variant->arrayLength);
+        return sCode;
     }
 
-    return sCode;
+    json_t *arrayDimensions = json_object_get(value, "arrayDimensions");
+    if (variant->arrayDimensionsSize > 0) {
+        if (!json_is_array(arrayDimensions) || json_array_size(arrayDimensions)
+                != variant->arrayDimensionsSize)
+            return UA_STATUSCODE_BADDECODINGERROR;
+        variant->arrayDimensions = UA_Array_new(variant->arrayDimensionsSize,
+                &UA_TYPES[UA_TYPES_UINT32]);
+        for (size_t i = 0; i < variant->arrayDimensionsSize; i++)
+            variant->arrayDimensions[i] = (UA_UInt32) json_integer_value(
+                    json_array_get(arrayDimensions, i));
+    }
+    return UA_STATUSCODE_GOOD;
 }
 
 UA_StatusCode zkUA_jsonDecode_UA_Variant(json_t *value, UA_Variant *variant) {
@@ -1003,6 +835,16 @@ UA_StatusCode zkUA_jsonDecode_UA_Variant(json_t *value, UA_Variant *variant) {
     UA_Variant_setArray(variant, arrayHolder, variant->arrayLength,
             variant->type);
 
+    /* Payload version 2 encodes the values as JSON arrays or base64 */
+    const char *dataEncoding = json_string_value(
+            json_object_get(value, "dataEncoding"));
+    if (dataEncoding) {
+        variant->arrayDimensionsSize = aDimS;
+        variant->arrayDimensions = NULL;
+        return zkUA_jsonDecode_UA_Variant_arrayData(value, dataEncoding,
+                variant);
+    }
+
     /* extract the array of values */
     for (size_t i = 0; i < (variant->arrayLength); i++) {
         char *dataIndex = (char *) calloc(65535, sizeof(char));
@@ -1054,6 +896,13 @@ UA_StatusCode zkUA_jsonDecode_UA_Variant(json_t *value, UA_Variant *variant) {
     return UA_STATUSCODE_GOOD;
 }
 
+/* json_unpack's "b" stores an int, which overflows a UA_Boolean */
+static UA_Boolean zkUA_jsonDecode_boolean(json_t *boolean) {
+    if (json_is_integer(boolean))
+        return json_integer_value(boolean) != 0;
+    return json_is_true(boolean);
+}
+
 /**
  * zkUA_jsonDecode_zkNodeToUa_commonAttributes:
  * Decodes the following common attributes from a JSON object and places it in a given attributes struct:
@@ -1091,6 +940,14 @@ UA_StatusCode zkUA_jsonDecode_zkNodeToUa_commonAttributes(json_t *attributes,
         return UA_STATUSCODE_BADUNEXPECTEDERROR;
     }
 
+    json_t *writeMask = json_object_get(attributes, "writeMask");
+    json_t *userWriteMask = json_object_get(attributes, "userWriteMask");
+    if (json_is_integer(writeMask))
+        objectAttributes->writeMask = (UA_UInt32) json_integer_value(writeMask);
+    if (json_is_integer(userWriteMask))
+        objectAttributes->userWriteMask = (UA_UInt32) json_integer_value(
+                userWriteMask);
+
     return UA_STATUSCODE_GOOD;
 }
 
@@ -1158,23 +1015,119 @@ UA_StatusCode zkUA_jsonDecode_zkNodeToUa_Variable(json_t *attributes,
             attributes, variableAttributes);
 
     /* Decode the nodeClass specific attributes */
-    size_t tmpAL, tmpUAL;
+    int tmpAL = 0, tmpUAL = 0;
     json_t *accessLevel = json_object_get(attributes, "accessLevel");
     json_t *userAccessLevel = json_object_get(attributes, "userAccessLevel");
     json_unpack(accessLevel, "i", &tmpAL);
-    json_unpack(userAccessLevel, "u", &tmpUAL);
+    json_unpack(userAccessLevel, "i", &tmpUAL);
     variableAttributes->accessLevel = (UA_Byte) tmpAL;
     variableAttributes->userAccessLevel = (UA_Byte) tmpUAL;
 
     json_t *minimumSamplingInterval = json_object_get(attributes,
             "minimumSamplingInterval");
     json_t *historizing = json_object_get(attributes, "historizing");
-    json_unpack(minimumSamplingInterval, "f",
-            &variableAttributes->minimumSamplingInterval);
-    json_unpack(historizing, "b", &variableAttributes->historizing);
+    /* written as an integer before it was a real */
+    if (json_is_number(minimumSamplingInterval))
+        variableAttributes->minimumSamplingInterval = json_number_value(
+                minimumSamplingInterval);
+    variableAttributes->historizing = zkUA_jsonDecode_boolean(historizing);
     return sCode;
 }
 
+UA_StatusCode zkUA_jsonDecode_zkNodeToUa_attributes(json_t *attributes,
+        int nodeClass, void *opcuaAttributes) {
+
+    UA_StatusCode sCode;
+    switch (nodeClass) {
+    case UA_NODECLASS_OBJECT: {
+        UA_ObjectAttributes *objectAttributes =
+                (UA_ObjectAttributes *) opcuaAttributes;
+        sCode = zkUA_jsonDecode_zkNodeToUa_commonAttributes(attributes,
+                objectAttributes);
+        int tmpEventNotifier = 0;
+        json_t *eventNotifier = json_object_get(attributes, "eventNotifier");
+        json_unpack(eventNotifier, "i", &tmpEventNotifier);
+        objectAttributes->eventNotifier = (UA_Byte) tmpEventNotifier;
+        return sCode;
+    }
+    case UA_NODECLASS_VIEW: {
+        UA_ViewAttributes *viewAttributes =
+                (UA_ViewAttributes *) opcuaAttributes;
+        sCode = zkUA_jsonDecode_zkNodeToUa_commonAttributes(attributes,
+                viewAttributes);
+        int tmpEventNotifier = 0;
+        json_t *eventNotifier = json_object_get(attributes, "eventNotifier");
+        json_unpack(eventNotifier, "i", &tmpEventNotifier);
+        viewAttributes->eventNotifier = (UA_Byte) tmpEventNotifier;
+        /* written as an integer before it was a boolean */
+        json_t *containsNoLoops = json_object_get(attributes,
+                "containsNoLoops");
+        viewAttributes->containsNoLoops = zkUA_jsonDecode_boolean(
+                containsNoLoops);
+        return sCode;
+    }
+    case UA_NODECLASS_VARIABLE:
+        return zkUA_jsonDecode_zkNodeToUa_Variable(attributes,
+                (UA_VariableAttributes *) opcuaAttributes);
+    case UA_NODECLASS_VARIABLETYPE: {
+        UA_VariableTypeAttributes *variableTypeAttributes =
+                (UA_VariableTypeAttributes *) opcuaAttributes;
+        sCode = zkUA_jsonDecode_zkNodeToUa_commonAttributesVarVarType(
+                attributes, variableTypeAttributes);
+        json_t *isAbstract = json_object_get(attributes, "isAbstract");
+        variableTypeAttributes->isAbstract = zkUA_jsonDecode_boolean(
+                isAbstract);
+        return sCode;
+    }
+    case UA_NODECLASS_REFERENCETYPE: {
+        UA_ReferenceTypeAttributes *referenceTypeAttributes =
+                (UA_ReferenceTypeAttributes *) opcuaAttributes;
+        sCode = zkUA_jsonDecode_zkNodeToUa_commonAttributes(attributes,
+                referenceTypeAttributes);
+        json_t *isAbstract = json_object_get(attributes, "isAbstract");
+        referenceTypeAttributes->isAbstract = zkUA_jsonDecode_boolean(
+                isAbstract);
+        json_t *symmetric = json_object_get(attributes, "symmetric");
+        referenceTypeAttributes->symmetric = zkUA_jsonDecode_boolean(symmetric);
+        json_t *inverseName = json_object_get(attributes, "inverseName");
+        if (zkUA_jsonDecode_UA_LocalizedText(inverseName,
+                &referenceTypeAttributes->inverseName)
+                == UA_STATUSCODE_BADUNEXPECTEDERROR)
+            return UA_STATUSCODE_BADUNEXPECTEDERROR;
+        return sCode;
+    }
+    case UA_NODECLASS_OBJECTTYPE: {
+        UA_ObjectTypeAttributes *objectTypeAttributes =
+                (UA_ObjectTypeAttributes *) opcuaAttributes;
+        sCode = zkUA_jsonDecode_zkNodeToUa_commonAttributes(attributes,
+                objectTypeAttributes);
+        json_t *isAbstract = json_object_get(attributes, "isAbstract");
+        objectTypeAttributes->isAbstract = zkUA_jsonDecode_boolean(isAbstract);
+        return sCode;
+    }
+    case UA_NODECLASS_DATATYPE: {
+        UA_DataTypeAttributes *dataTypeAttributes =
+                (UA_DataTypeAttributes *) opcuaAttributes;
+        sCode = zkUA_jsonDecode_zkNodeToUa_commonAttributes(attributes,
+                dataTypeAttributes);
+        json_t *isAbstract = json_object_get(attributes, "isAbstract");
+        dataTypeAttributes->isAbstract = zkUA_jsonDecode_boolean(isAbstract);
+        return sCode;
+    }
+    case UA_NODECLASS_METHOD: {
+        UA_MethodAttributes *methodAttributes =
+                (UA_MethodAttributes *) opcuaAttributes;
+        sCode = zkUA_jsonDecode_zkNodeToUa_commonAttributes(attributes,
+                methodAttributes);
+        json_t *exec = json_object_get(attributes, "executable");
+        methodAttributes->executable = zkUA_jsonDecode_boolean(exec);
+        return sCode;
+    }
+    default:
+        return UA_STATUSCODE_BADUNEXPECTEDERROR;
+    }
+}
+
 UA_StatusCode zkUA_jsonDecode_writeVariableAttributes(UA_Server *server,
         UA_NodeId *uaNodeId, UA_VariableAttributes *vAtt) {
 
@@ -1364,7 +1317,8 @@ void zkUA_jsonDecode_zkNodeToUa(int rc, const char *value, int value_len,
 //    fprintf(stderr, "value %.*s\n", value_len, value);
 
     /* load the retrieved JSON into an object */
-    json_t *jsonRoot = json_loads(value, JSON_DISABLE_EOF_CHECK, &error);
+    json_t *jsonRoot = json_loadb(value, (size_t) value_len,
+            JSON_DISABLE_EOF_CHECK, &error);
     if (!jsonRoot) {
         fprintf(stderr,
                 "zkUA_jsonDecode_zkNodeToUa: Unable to load root object from retrieved JSON document - error: on line %d: %s\n",
@@ -1454,12 +1408,16 @@ void zkUA_jsonDecode_zkNodeToUa(int rc, const char *value, int value_len,
                  Server node sub-tree */
                 zkUA_checkNs0 *searchedForNode = calloc(1,
                         sizeof(zkUA_checkNs0));
+                zkUA_NodeIdSet visited;
+                zkUA_NodeIdSet_init(&visited);
                 searchedForNode->searchedForNode = &uaNodeId;
                 searchedForNode->result = false;
+                searchedForNode->visited = &visited;
                 UA_Server_forEachChildNodeCall(uaServer,
                         UA_NODEID_NUMERIC(0, UA_NS0ID_SERVER),
                         zkUA_jsonDecode_checkChildOfNS0ServerNode,
                         (void *) searchedForNode);
+                zkUA_NodeIdSet_deleteMembers(&visited);
                 if (searchedForNode->result == true) {
                     /* If this is a server object node */
                     fprintf(stderr,
@@ -1497,18 +1455,9 @@ void zkUA_jsonDecode_zkNodeToUa(int rc, const char *value, int value_len,
                  fprintf(stderr, "zkUA_jsonDecode_zkNodeToUa: Attributes object should still be valid: %s\n", s);
                  free(s);
                  */
-                /* Decode the common attributes */
-                sCode = zkUA_jsonDecode_zkNodeToUa_commonAttributes(attributes,
+                sCode = zkUA_jsonDecode_zkNodeToUa_attributes(attributes, nC,
                         &objectAttributes);
 
-                /* Decode the nodeClass specific attributes */
-                size_t tmpEventNotifier;
-                json_t *eventNotifier = json_object_get(attributes,
-                        "eventNotifier");
-                json_unpack(eventNotifier, "i", &tmpEventNotifier);
-
-                objectAttributes.eventNotifier = (UA_Byte) tmpEventNotifier;
-
                 char * qNameBrowseName = (char *) calloc(65535, sizeof(char));
                 snprintf(qNameBrowseName, 65535, "%.*s",
                         (int) objectAttributes.displayName.text.length,
@@ -1570,22 +1519,9 @@ void zkUA_jsonDecode_zkNodeToUa(int rc, const char *value, int value_len,
                 UA_ViewAttributes viewAttributes;
                 UA_ViewAttributes_init(&viewAttributes);
 
-                /* Decode the common attributes */
-                sCode = zkUA_jsonDecode_zkNodeToUa_commonAttributes(attributes,
+                sCode = zkUA_jsonDecode_zkNodeToUa_attributes(attributes, nC,
                         &viewAttributes);
 
-                /* Decode the nodeClass specific attributes */
-                size_t tmpEventNotifier;
-                json_t *eventNotifier = json_object_get(attributes,
-                        "eventNotifier");
-                json_unpack(eventNotifier, "i", &tmpEventNotifier);
-                viewAttributes.eventNotifier = (UA_Byte) tmpEventNotifier;
-
-                json_t *containsNoLoops = json_object_get(attributes,
-                        "containsNoLoops");
-                json_unpack(containsNoLoops, "b",
-                        &viewAttributes.containsNoLoops);
-
                 char * qNameBrowseName = (char *) calloc(65535, sizeof(char));
                 snprintf(qNameBrowseName, 65535, "%.*s",
                         (int) viewAttributes.displayName.text.length,
@@ -1644,7 +1580,7 @@ void zkUA_jsonDecode_zkNodeToUa(int rc, const char *value, int value_len,
             case UA_NODECLASS_VARIABLE: {
                 UA_VariableAttributes variableAttributes;
                 UA_VariableAttributes_init(&variableAttributes);
-                sCode = zkUA_jsonDecode_zkNodeToUa_Variable(attributes,
+                sCode = zkUA_jsonDecode_zkNodeToUa_attributes(attributes, nC,
                         &variableAttributes);
                 if (sCode != UA_STATUSCODE_GOOD)
                     fprintf(stderr,
@@ -1719,14 +1655,8 @@ void zkUA_jsonDecode_zkNodeToUa(int rc, const char *value, int value_len,
                 UA_VariableTypeAttributes variableTypeAttributes;
                 UA_VariableTypeAttributes_init(&variableTypeAttributes);
 
-                /* Decode the common attributes */
-                sCode = zkUA_jsonDecode_zkNodeToUa_commonAttributesVarVarType(
-                        attributes, &variableTypeAttributes);
-
-                /* Decode the nodeClass specific attributes */
-                json_t *isAbstract = json_object_get(attributes, "isAbstract");
-                json_unpack(isAbstract, "b",
-                        &variableTypeAttributes.isAbstract);
+                sCode = zkUA_jsonDecode_zkNodeToUa_attributes(attributes, nC,
+                        &variableTypeAttributes);
 
                 char * qNameBrowseName = (char *) calloc(65535, sizeof(char));
                 snprintf(qNameBrowseName, 65535, "%.*s",
@@ -1786,22 +1716,8 @@ void zkUA_jsonDecode_zkNodeToUa(int rc, const char *value, int value_len,
                 UA_ReferenceTypeAttributes referenceTypeAttributes;
                 UA_ReferenceTypeAttributes_init(&referenceTypeAttributes);
 
-                /* Decode the common attributes */
-                sCode = zkUA_jsonDecode_zkNodeToUa_commonAttributes(attributes,
+                sCode = zkUA_jsonDecode_zkNodeToUa_attributes(attributes, nC,
                         &referenceTypeAttributes);
-
-                /* Decode the nodeClass specific attributes */
-                json_t *isAbstract = json_object_get(attributes, "isAbstract");
-                json_unpack(isAbstract, "b",
-                        &referenceTypeAttributes.isAbstract);
-
-                json_t *symmetric = json_object_get(attributes, "symmetric");
-                json_unpack(symmetric, "b", &referenceTypeAttributes.symmetric);
-
-                json_t *inverseName = json_object_get(attributes,
-                        "inverseName");
-                sCode = zkUA_jsonDecode_UA_LocalizedText(inverseName,
-                        &referenceTypeAttributes.inverseName);
                 if (sCode == UA_STATUSCODE_BADUNEXPECTEDERROR) {
                     json_decref(jsonRoot);
                     UA_NodeId_deleteMembers(&uaNodeId);
@@ -1870,14 +1786,9 @@ void zkUA_jsonDecode_zkNodeToUa(int rc, const char *value, int value_len,
                 UA_ObjectTypeAttributes objectTypeAttributes;
                 UA_ObjectTypeAttributes_init(&objectTypeAttributes);
 
-                /* Decode the common attributes */
-                sCode = zkUA_jsonDecode_zkNodeToUa_commonAttributes(attributes,
+                sCode = zkUA_jsonDecode_zkNodeToUa_attributes(attributes, nC,
                         &objectTypeAttributes);
 
-                /* Decode the nodeClass specific attributes */
-                json_t *isAbstract = json_object_get(attributes, "isAbstract");
-                json_unpack(isAbstract, "b", &objectTypeAttributes.isAbstract);
-
                 char * qNameBrowseName = (char *) calloc(65535, sizeof(char));
                 snprintf(qNameBrowseName, 65535, "%.*s",
                         (int) objectTypeAttributes.displayName.text.length,
@@ -1939,14 +1850,9 @@ void zkUA_jsonDecode_zkNodeToUa(int rc, const char *value, int value_len,
                 UA_DataTypeAttributes dataTypeAttributes;
                 UA_DataTypeAttributes_init(&dataTypeAttributes);
 
-                /* Decode the common attributes */
-                sCode = zkUA_jsonDecode_zkNodeToUa_commonAttributes(attributes,
+                sCode = zkUA_jsonDecode_zkNodeToUa_attributes(attributes, nC,
                         &dataTypeAttributes);
 
-                /* Decode the nodeClass specific attributes */
-                json_t *isAbstract = json_object_get(attributes, "isAbstract");
-                json_unpack(isAbstract, "b", &dataTypeAttributes.isAbstract);
-
                 char * qNameBrowseName = (char *) calloc(65535, sizeof(char));
                 snprintf(qNameBrowseName, 65535, "%.*s",
                         (int) dataTypeAttributes.displayName.text.length,
@@ -2005,16 +1911,9 @@ void zkUA_jsonDecode_zkNodeToUa(int rc, const char *value, int value_len,
                 UA_MethodAttributes methodAttributes;
                 UA_MethodAttributes_init(&methodAttributes);
 
-                /* Decode the common attributes */
-                sCode = zkUA_jsonDecode_zkNodeToUa_commonAttributes(attributes,
+                sCode = zkUA_jsonDecode_zkNodeToUa_attributes(attributes, nC,
                         &methodAttributes);
 
-                /* Decode the nodeClass specific attributes */
-                json_t *exec = json_object_get(attributes, "executable");
-                //                json_t *userExec = json_object_get(attributes, "userExecutable");
-                json_unpack(exec, "b", &methodAttributes.executable);
-                //                json_unpack(userExec, "b", &methodAttributes.userExecutable);
-
                 /* todo: include support for method */
                 fprintf(stderr,
                         "zkUA_jsonDecode_zkNodeToUa: Replicating Method nodes currently unsupported\n");
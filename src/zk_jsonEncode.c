@@ -16,11 +16,34 @@
  ******************************************************************************/
 #include <zk_jsonEncode.h>
 #include <zk_intercept.h>
+#include <zk_urlEncode.h>
 /* for debugging */
 #include <simple_parse.h>
 
 /** JSON Encoding Functions **/
 
+/* Encode Variant arrays natively (payload version 2) instead of as data[i] keys */
+static UA_Boolean nativeArrays = true;
+
+void zkUA_jsonEncode_setNativeArrays(UA_Boolean native) {
+    nativeArrays = native;
+}
+
+UA_Boolean zkUA_jsonEncode_getNativeArrays(void) {
+    return nativeArrays;
+}
+
+/* Encode ByteStrings as base64 (payload version 3) instead of as text */
+static UA_Boolean base64ByteStrings = true;
+
+void zkUA_jsonEncode_setBase64ByteStrings(UA_Boolean base64) {
+    base64ByteStrings = base64;
+}
+
+UA_Boolean zkUA_jsonEncode_getBase64ByteStrings(void) {
+    return base64ByteStrings;
+}
+
 void zkUA_jsonEncode_UA_DataTypeMember(UA_DataType *type, json_t *jsonObject) {
     UA_UInt16 membersSize = type->membersSize;
     for (int i = 0; i < membersSize; i++) {
@@ -90,224 +113,193 @@ void zkUA_jsonEncode_UA_Variant_setObjectDataAndType(json_t *jsonObject,
 
 }
 
+/* Encoders of the 23 possible types for a Variant (see page 6 of Part 6 of the
+ OPC UA Spec. R1.03), one per UA_TYPES_ index */
+typedef json_t *(*zkUA_jsonEncode_valueCodec)(const void *value);
+
+static json_t *zkUA_jsonEncode_Boolean(const void *value) {
+    return json_boolean(*(const UA_Boolean *) value == UA_TRUE);
+}
+static json_t *zkUA_jsonEncode_SByte(const void *value) {
+    return json_integer(*(const UA_SByte *) value);
+}
+static json_t *zkUA_jsonEncode_Byte(const void *value) {
+    return json_integer(*(const UA_Byte *) value);
+}
+static json_t *zkUA_jsonEncode_Int16(const void *value) {
+    return json_integer(*(const UA_Int16 *) value);
+}
+static json_t *zkUA_jsonEncode_UInt16(const void *value) {
+    return json_integer(*(const UA_UInt16 *) value);
+}
+static json_t *zkUA_jsonEncode_Int32(const void *value) {
+    return json_integer(*(const UA_Int32 *) value);
+}
+static json_t *zkUA_jsonEncode_UInt32(const void *value) {
+    return json_integer(*(const UA_UInt32 *) value);
+}
+/* also DateTime */
+static json_t *zkUA_jsonEncode_Int64(const void *value) {
+    return json_integer(*(const UA_Int64 *) value);
+}
+static json_t *zkUA_jsonEncode_UInt64(const void *value) {
+    return json_integer((json_int_t) *(const UA_UInt64 *) value);
+}
+static json_t *zkUA_jsonEncode_Float(const void *value) {
+    return json_real(*(const UA_Float *) value);
+}
+static json_t *zkUA_jsonEncode_Double(const void *value) {
+    return json_real(*(const UA_Double *) value);
+}
+static json_t *zkUA_jsonEncode_StatusCode(const void *value) {
+    return json_integer(*(const UA_StatusCode *) value);
+}
+/* also XmlElement */
+static json_t *zkUA_jsonEncode_String(const void *value) {
+    return zkUA_jsonEncode_UA_String((UA_String *) value);
+}
+static json_t *zkUA_jsonEncode_ByteString(const void *value) {
+    return zkUA_jsonEncode_UA_ByteString((UA_ByteString *) value);
+}
+static json_t *zkUA_jsonEncode_Guid(const void *value) {
+    json_t *data = json_object();
+    zkUA_jsonEncode_UA_Guid((UA_Guid *) value, data);
+    return data;
+}
+static json_t *zkUA_jsonEncode_NodeId(const void *value) {
+    json_t *data = json_object();
+    zkUA_jsonEncode_UA_NodeId((UA_NodeId *) value, data);
+    return data;
+}
+static json_t *zkUA_jsonEncode_ExpandedNodeId(const void *value) {
+    json_t *data = json_object();
+    zkUA_jsonEncode_UA_ExpandedNodeId((UA_ExpandedNodeId *) value, data);
+    return data;
+}
+static json_t *zkUA_jsonEncode_QualifiedName(const void *value) {
+    json_t *data = json_object();
+    zkUA_jsonEncode_UA_QualifiedName((UA_QualifiedName *) value, data);
+    return data;
+}
+static json_t *zkUA_jsonEncode_LocalizedText(const void *value) {
+    json_t *data = json_object();
+    zkUA_jsonEncode_UA_LocalizedText((UA_LocalizedText *) value, data);
+    return data;
+}
+static json_t *zkUA_jsonEncode_ExtensionObject(const void *value) {
+    json_t *data = json_object();
+    zkUA_jsonEncode_UA_ExtensionObject((UA_ExtensionObject *) value, data);
+    return data;
+}
+static json_t *zkUA_jsonEncode_DataValue(const void *value) {
+    json_t *data = json_object();
+    zkUA_jsonEncode_UA_DataValue((UA_DataValue *) value, data);
+    return data;
+}
+
+static const zkUA_jsonEncode_valueCodec valueCodecs[UA_TYPES_DATAVALUE + 1] = {
+        [UA_TYPES_BOOLEAN] = zkUA_jsonEncode_Boolean,
+        [UA_TYPES_SBYTE] = zkUA_jsonEncode_SByte,
+        [UA_TYPES_BYTE] = zkUA_jsonEncode_Byte,
+        [UA_TYPES_INT16] = zkUA_jsonEncode_Int16,
+        [UA_TYPES_UINT16] = zkUA_jsonEncode_UInt16,
+        [UA_TYPES_INT32] = zkUA_jsonEncode_Int32,
+        [UA_TYPES_UINT32] = zkUA_jsonEncode_UInt32,
+        [UA_TYPES_INT64] = zkUA_jsonEncode_Int64,
+        [UA_TYPES_UINT64] = zkUA_jsonEncode_UInt64,
+        [UA_TYPES_FLOAT] = zkUA_jsonEncode_Float,
+        [UA_TYPES_DOUBLE] = zkUA_jsonEncode_Double,
+        [UA_TYPES_STRING] = zkUA_jsonEncode_String,
+        [UA_TYPES_DATETIME] = zkUA_jsonEncode_Int64,
+        [UA_TYPES_GUID] = zkUA_jsonEncode_Guid,
+        [UA_TYPES_BYTESTRING] = zkUA_jsonEncode_ByteString,
+        [UA_TYPES_XMLELEMENT] = zkUA_jsonEncode_String,
+        [UA_TYPES_NODEID] = zkUA_jsonEncode_NodeId,
+        [UA_TYPES_EXPANDEDNODEID] = zkUA_jsonEncode_ExpandedNodeId,
+        [UA_TYPES_STATUSCODE] = zkUA_jsonEncode_StatusCode,
+        [UA_TYPES_QUALIFIEDNAME] = zkUA_jsonEncode_QualifiedName,
+        [UA_TYPES_LOCALIZEDTEXT] = zkUA_jsonEncode_LocalizedText,
+        [UA_TYPES_EXTENSIONOBJECT] = zkUA_jsonEncode_ExtensionObject,
+        [UA_TYPES_DATAVALUE] = zkUA_jsonEncode_DataValue };
+
+int zkUA_jsonEncode_dataType(const UA_DataType *type) {
+    if (type && type->typeIndex <= UA_TYPES_DATAVALUE
+            && type == &UA_TYPES[type->typeIndex]
+            && valueCodecs[type->typeIndex])
+        return type->typeIndex;
+    return 999;
+}
+
+json_t *zkUA_jsonEncode_UA_Variant_value(const UA_DataType *type,
+        void *variantValue, int *dataType) {
+
+    *dataType = zkUA_jsonEncode_dataType(type);
+    if (*dataType == 999)
+        return json_string("UNKNOWN_OR_UNSUPPORTED");
+    return valueCodecs[*dataType](variantValue);
+}
+
 void zkUA_jsonEncode_UA_Variant_setValue(const UA_DataType *type,
         void *variantValue, json_t *jsonObject, char *dataIndex) {
-
-    json_t *data;
-    /* See page 6 of Part 6 of the OPC UA Spec. R1.03
-     for the 23 possible types for a Variant */
-    if (type == &UA_TYPES[UA_TYPES_BOOLEAN]) {
-        ;
-        int vValueInt;
-        if (*(UA_Boolean *) variantValue == UA_TRUE)
-            vValueInt = 1;
-        else
-            vValueInt = 0;
-        data = json_boolean(vValueInt);
-        zkUA_jsonEncode_UA_Variant_setObjectDataAndType(jsonObject, data,
-                UA_TYPES_BOOLEAN, dataIndex);
-    } else if (type == &UA_TYPES[UA_TYPES_SBYTE]) {
-        data = json_integer(*(UA_SByte*) variantValue);
-        zkUA_jsonEncode_UA_Variant_setObjectDataAndType(jsonObject, data,
-                UA_TYPES_SBYTE, dataIndex);
-    } else if (type == &UA_TYPES[UA_TYPES_BYTE]) {
-        data = json_integer(*(UA_Byte*) variantValue);
-        zkUA_jsonEncode_UA_Variant_setObjectDataAndType(jsonObject, data,
-                UA_TYPES_BYTE, dataIndex);
-    } else if (type == &UA_TYPES[UA_TYPES_INT16]) {
-        data = json_integer(*(UA_Int16*) variantValue);
-        zkUA_jsonEncode_UA_Variant_setObjectDataAndType(jsonObject, data,
-                UA_TYPES_INT16, dataIndex);
-    } else if (type == &UA_TYPES[UA_TYPES_UINT16]) {
-        data = json_integer(*(UA_UInt16 *) variantValue);
-        zkUA_jsonEncode_UA_Variant_setObjectDataAndType(jsonObject, data,
-                UA_TYPES_UINT16, dataIndex);
-    } else if (type == &UA_TYPES[UA_TYPES_INT32]) {
-        data = json_integer(*(UA_Int32*) variantValue);
-        zkUA_jsonEncode_UA_Variant_setObjectDataAndType(jsonObject, data,
-                UA_TYPES_INT32, dataIndex);
-    } else if (type == &UA_TYPES[UA_TYPES_UINT32]) {
-        data = json_integer(*(UA_UInt32*) variantValue);
-        zkUA_jsonEncode_UA_Variant_setObjectDataAndType(jsonObject, data,
-                UA_TYPES_UINT32, dataIndex);
-    } else if (type == &UA_TYPES[UA_TYPES_INT64]) {
-        json_int_t iHandle = *(UA_Int64*) variantValue;
-        data = json_integer(iHandle);
-        zkUA_jsonEncode_UA_Variant_setObjectDataAndType(jsonObject, data,
-                UA_TYPES_INT64, dataIndex);
-    } else if (type == &UA_TYPES[UA_TYPES_UINT64]) {
-        json_int_t iHandle = *(UA_UInt64*) variantValue;
-        data = json_integer(iHandle);
-        zkUA_jsonEncode_UA_Variant_setObjectDataAndType(jsonObject, data,
-                UA_TYPES_UINT64, dataIndex);
-    } else if (type == &UA_TYPES[UA_TYPES_FLOAT]) {
-        data = json_real(*(UA_Float*) variantValue);
-        zkUA_jsonEncode_UA_Variant_setObjectDataAndType(jsonObject, data,
-                UA_TYPES_FLOAT, dataIndex);
-    } else if (type == &UA_TYPES[UA_TYPES_DOUBLE]) {
-        json_int_t iHandle = *(UA_Double*) variantValue;
-        data = json_real(iHandle);
-        zkUA_jsonEncode_UA_Variant_setObjectDataAndType(jsonObject, data,
-                UA_TYPES_DOUBLE, dataIndex);
-    } else if (type == &UA_TYPES[UA_TYPES_STRING]) {
-        json_t *data = zkUA_jsonEncode_UA_String((UA_String *) variantValue);
-        zkUA_jsonEncode_UA_Variant_setObjectDataAndType(jsonObject, data,
-                UA_TYPES_STRING, dataIndex);
-    } else if (type == &UA_TYPES[UA_TYPES_DATETIME]) {
-        json_int_t iHandle = *(UA_DateTime*) variantValue;
-        data = json_integer(iHandle);
-        zkUA_jsonEncode_UA_Variant_setObjectDataAndType(jsonObject, data,
-                UA_TYPES_DATETIME, dataIndex);
-    } else if (type == &UA_TYPES[UA_TYPES_GUID]) {
-        json_t *data = json_object();
-        zkUA_jsonEncode_UA_Guid((UA_Guid *) variantValue, data);
-        zkUA_jsonEncode_UA_Variant_setObjectDataAndType(jsonObject, data,
-                UA_TYPES_GUID, dataIndex);
-    } else if (type == &UA_TYPES[UA_TYPES_BYTESTRING]) {
-        json_t *data = zkUA_jsonEncode_UA_String((UA_String *) variantValue);
-        zkUA_jsonEncode_UA_Variant_setObjectDataAndType(jsonObject, data,
-                UA_TYPES_BYTESTRING, dataIndex);
-    } else if (type == &UA_TYPES[UA_TYPES_XMLELEMENT]) {
-        json_t *data = zkUA_jsonEncode_UA_String((UA_String *) variantValue);
-        zkUA_jsonEncode_UA_Variant_setObjectDataAndType(jsonObject, data,
-                UA_TYPES_XMLELEMENT, dataIndex);
-    } else if (type == &UA_TYPES[UA_TYPES_NODEID]) {
-        json_t *data = json_object();
-        zkUA_jsonEncode_UA_NodeId((UA_NodeId *) variantValue, data);
-        zkUA_jsonEncode_UA_Variant_setObjectDataAndType(jsonObject, data,
-                UA_TYPES_NODEID, dataIndex);
-    } else if (type == &UA_TYPES[UA_TYPES_EXPANDEDNODEID]) {
-        json_t *data = json_object();
-        zkUA_jsonEncode_UA_ExpandedNodeId((UA_ExpandedNodeId *) variantValue,
-                data);
-        zkUA_jsonEncode_UA_Variant_setObjectDataAndType(jsonObject, data,
-                UA_TYPES_EXPANDEDNODEID, dataIndex);
-    } else if (type == &UA_TYPES[UA_TYPES_STATUSCODE]) {
-        data = json_integer(*(UA_StatusCode*) variantValue);
-        zkUA_jsonEncode_UA_Variant_setObjectDataAndType(jsonObject, data,
-                UA_TYPES_STATUSCODE, dataIndex);
-    } else if (type == &UA_TYPES[UA_TYPES_QUALIFIEDNAME]) {
-        json_t *data = json_object();
-        zkUA_jsonEncode_UA_QualifiedName((UA_QualifiedName *) variantValue,
-                data);
-        zkUA_jsonEncode_UA_Variant_setObjectDataAndType(jsonObject, data,
-                UA_TYPES_QUALIFIEDNAME, dataIndex);
-    } else if (type == &UA_TYPES[UA_TYPES_LOCALIZEDTEXT]) {
-        json_t *data = json_object();
-        zkUA_jsonEncode_UA_LocalizedText((UA_LocalizedText *) variantValue,
-                data);
-        zkUA_jsonEncode_UA_Variant_setObjectDataAndType(jsonObject, data,
-                UA_TYPES_LOCALIZEDTEXT, dataIndex);
-    } else if (type == &UA_TYPES[UA_TYPES_EXTENSIONOBJECT]) {
-        json_t *data = json_object();
-        zkUA_jsonEncode_UA_ExtensionObject((UA_ExtensionObject *) variantValue,
-                data);
-        zkUA_jsonEncode_UA_Variant_setObjectDataAndType(jsonObject, data,
-                UA_TYPES_EXTENSIONOBJECT, dataIndex);
-    } else if (type == &UA_TYPES[UA_TYPES_DATAVALUE]) {
-        json_t *data = json_object();
-        zkUA_jsonEncode_UA_DataValue((UA_DataValue *) variantValue, data);
-        zkUA_jsonEncode_UA_Variant_setObjectDataAndType(jsonObject, data,
-                UA_TYPES_DATAVALUE, dataIndex);
-    } else {
-        json_t *data = json_string("UNKNOWN_OR_UNSUPPORTED");
-        zkUA_jsonEncode_UA_Variant_setObjectDataAndType(jsonObject, data, 999,
-                dataIndex);
-    }
+    int dataType;
+    json_t *data = zkUA_jsonEncode_UA_Variant_value(type, variantValue,
+            &dataType);
+    zkUA_jsonEncode_UA_Variant_setObjectDataAndType(jsonObject, data, dataType,
+            dataIndex);
 }
 
 /*
  * zkUA_jsonEncode_UA_Variant_callSetValueByType:
- * Used to cast the variant data before calling zkUA_jsonEncode_UA_Variant_setValue for 
- *  array variant values
+ * Encodes the value at dataIndexInt of an array variant as its "data[i]" member
  */
 void zkUA_jsonEncode_UA_Variant_callSetValueByType(UA_Variant *variant,
         json_t *jsonObject, int dataIndexInt) {
 
     const UA_DataType *type = variant->type;
-    int j = dataIndexInt;
-    char *dataIndex = (char *) calloc(65535, sizeof(char));
-    snprintf(dataIndex, 65535, "data[%i]", dataIndexInt);
-
-    if (type == &UA_TYPES[UA_TYPES_BOOLEAN]) {
-        ;
-        zkUA_jsonEncode_UA_Variant_setValue((UA_DataType *) variant->type,
-                &((UA_Boolean *) variant->data)[j], jsonObject, dataIndex);
-    } else if (type == &UA_TYPES[UA_TYPES_SBYTE]) {
-        zkUA_jsonEncode_UA_Variant_setValue((UA_DataType *) variant->type,
-                &((UA_SByte *) variant->data)[j], jsonObject, dataIndex);
-    } else if (type == &UA_TYPES[UA_TYPES_BYTE]) {
-        zkUA_jsonEncode_UA_Variant_setValue((UA_DataType *) variant->type,
-                &((UA_Byte *) variant->data)[j], jsonObject, dataIndex);
-    } else if (type == &UA_TYPES[UA_TYPES_INT16]) {
-        zkUA_jsonEncode_UA_Variant_setValue((UA_DataType *) variant->type,
-                &((UA_Int16 *) variant->data)[j], jsonObject, dataIndex);
-    } else if (type == &UA_TYPES[UA_TYPES_UINT16]) {
-        zkUA_jsonEncode_UA_Variant_setValue((UA_DataType *) variant->type,
-                &((UA_UInt16 *) variant->data)[j], jsonObject, dataIndex);
-    } else if (type == &UA_TYPES[UA_TYPES_INT32]) {
-        zkUA_jsonEncode_UA_Variant_setValue((UA_DataType *) variant->type,
-                &((UA_Int32 *) variant->data)[j], jsonObject, dataIndex);
-    } else if (type == &UA_TYPES[UA_TYPES_UINT32]) {
-        zkUA_jsonEncode_UA_Variant_setValue((UA_DataType *) variant->type,
-                &((UA_UInt32 *) variant->data)[j], jsonObject, dataIndex);
-    } else if (type == &UA_TYPES[UA_TYPES_INT64]) {
-        zkUA_jsonEncode_UA_Variant_setValue((UA_DataType *) variant->type,
-                &((UA_Int64 *) variant->data)[j], jsonObject, dataIndex);
-    } else if (type == &UA_TYPES[UA_TYPES_UINT64]) {
-        zkUA_jsonEncode_UA_Variant_setValue((UA_DataType *) variant->type,
-                &((UA_UInt64 *) variant->data)[j], jsonObject, dataIndex);
-    } else if (type == &UA_TYPES[UA_TYPES_FLOAT]) {
-        zkUA_jsonEncode_UA_Variant_setValue((UA_DataType *) variant->type,
-                &((UA_Float *) variant->data)[j], jsonObject, dataIndex);
-    } else if (type == &UA_TYPES[UA_TYPES_DOUBLE]) {
-        zkUA_jsonEncode_UA_Variant_setValue((UA_DataType *) variant->type,
-                &((UA_Double *) variant->data)[j], jsonObject, dataIndex);
-    } else if (type == &UA_TYPES[UA_TYPES_STRING]) {
-        zkUA_jsonEncode_UA_Variant_setValue((UA_DataType *) variant->type,
-                &((UA_String *) variant->data)[j], jsonObject, dataIndex);
-    } else if (type == &UA_TYPES[UA_TYPES_DATETIME]) {
-        zkUA_jsonEncode_UA_Variant_setValue((UA_DataType *) variant->type,
-                &((UA_DateTime *) variant->data)[j], jsonObject, dataIndex);
-    } else if (type == &UA_TYPES[UA_TYPES_GUID]) {
-        zkUA_jsonEncode_UA_Variant_setValue((UA_DataType *) variant->type,
-                &((UA_Guid *) variant->data)[j], jsonObject, dataIndex);
-    } else if (type == &UA_TYPES[UA_TYPES_BYTESTRING]) {
-        zkUA_jsonEncode_UA_Variant_setValue((UA_DataType *) variant->type,
-                &((UA_ByteString *) variant->data)[j], jsonObject, dataIndex);
-    } else if (type == &UA_TYPES[UA_TYPES_XMLELEMENT]) {
-        zkUA_jsonEncode_UA_Variant_setValue((UA_DataType *) variant->type,
-                &((UA_XmlElement *) variant->data)[j], jsonObject, dataIndex);
-    } else if (type == &UA_TYPES[UA_TYPES_NODEID]) {
-        zkUA_jsonEncode_UA_Variant_setValue((UA_DataType *) variant->type,
-                &((UA_NodeId *) variant->data)[j], jsonObject, dataIndex);
-    } else if (type == &UA_TYPES[UA_TYPES_EXPANDEDNODEID]) {
-        zkUA_jsonEncode_UA_Variant_setValue((UA_DataType *) variant->type,
-                &((UA_ExpandedNodeId *) variant->data)[j], jsonObject,
-                dataIndex);
-    } else if (type == &UA_TYPES[UA_TYPES_STATUSCODE]) {
-        zkUA_jsonEncode_UA_Variant_setValue((UA_DataType *) variant->type,
-                &((UA_StatusCode *) variant->data)[j], jsonObject, dataIndex);
-    } else if (type == &UA_TYPES[UA_TYPES_QUALIFIEDNAME]) {
-        zkUA_jsonEncode_UA_Variant_setValue((UA_DataType *) variant->type,
-                &((UA_QualifiedName *) variant->data)[j], jsonObject,
-                dataIndex);
-    } else if (type == &UA_TYPES[UA_TYPES_LOCALIZEDTEXT]) {
-        zkUA_jsonEncode_UA_Variant_setValue((UA_DataType *) variant->type,
-                &((UA_LocalizedText *) variant->data)[j], jsonObject,
-                dataIndex);
-    } else if (type == &UA_TYPES[UA_TYPES_EXTENSIONOBJECT]) {
-        zkUA_jsonEncode_UA_Variant_setValue((UA_DataType *) variant->type,
-                &((UA_ExtensionObject *) variant->data)[j], jsonObject,
-                dataIndex);
-    } else if (type == &UA_TYPES[UA_TYPES_DATAVALUE]) {
-        zkUA_jsonEncode_UA_Variant_setValue((UA_DataType *) variant->type,
-                &((UA_DataValue *) variant->data)[j], jsonObject, dataIndex);
-    } else {
-        fprintf(stderr,
-                "zkUA_jsonEncode_UA_Variant_callSetValueByType: Uknown type\n");
+    char dataIndex[32];
+    snprintf(dataIndex, sizeof(dataIndex), "data[%i]", dataIndexInt);
+    zkUA_jsonEncode_UA_Variant_setValue(type,
+            (char *) variant->data + (size_t) dataIndexInt * type->memSize,
+            jsonObject, dataIndex);
+}
+
+/*
+ * zkUA_jsonEncode_UA_Variant_arrayData:
+ * Encodes the values and dimensions of an array variant as JSON arrays. The values of
+ *  overlayable types are packed into a single base64 string instead.
+ */
+static void zkUA_jsonEncode_UA_Variant_arrayData(UA_Variant *variant,
+        json_t *jsonObject) {
+
+    const UA_DataType *type = variant->type;
+    if (variant->arrayDimensionsSize > 0) {
+        json_t *arrayDimensions = json_array();
+        for (size_t i = 0; i < variant->arrayDimensionsSize; i++)
+            json_array_append_new(arrayDimensions,
+                    json_integer(variant->arrayDimensions[i]));
+        json_object_set_new(jsonObject, "arrayDimensions", arrayDimensions);
     }
-    free(dataIndex);
+
+    json_t *data;
+    int dataType = type->typeIndex;
+    if (type->overlayable && type == &UA_TYPES[type->typeIndex]) {
+        /* the memory layout is the UA Binary encoding: copy the array as is */
+        char *packed = zkUA_base64_encode((const unsigned char *) variant->data,
+                variant->arrayLength * type->memSize);
+        data = json_string(packed);
+        free(packed);
+        json_object_set_new(jsonObject, "dataEncoding", json_string("base64"));
+    } else {
+        data = json_array();
+        for (size_t j = 0; j < variant->arrayLength; j++)
+            json_array_append_new(data,
+                    zkUA_jsonEncode_UA_Variant_value(type,
+                            (char *) variant->data + j * type->memSize,
+                            &dataType));
+        json_object_set_new(jsonObject, "dataEncoding", json_string("array"));
+    }
+    zkUA_jsonEncode_UA_Variant_setObjectDataAndType(jsonObject, data, dataType,
+            NULL);
 }
 
 /**
@@ -351,6 +343,11 @@ void zkUA_jsonEncode_UA_Variant(UA_Variant *variant, json_t *jsonObject) {
         json_object_set_new(jsonObject, "arrayDimensionsSize",
                 arrayDimensionsSize);
 
+        if (nativeArrays) {
+            zkUA_jsonEncode_UA_Variant_arrayData(variant, jsonObject);
+            return;
+        }
+
         size_t dims;
         /* If there is only one dimension */
         if (variant->arrayDimensionsSize == 0) {
@@ -374,15 +371,9 @@ void zkUA_jsonEncode_UA_Variant(UA_Variant *variant, json_t *jsonObject) {
         /* since, in reality, all of the values are stored in an array, just copy all the data
          sequentially */
         int aLength = variant->arrayLength;
-        char *dataIndex = (char *) calloc(65535, sizeof(char));
-        for (int j = 0; j < aLength; j++) {
-            /* Initialize the JSON Object "key" (data index) string */
-            snprintf(dataIndex, 65535, "data[%i]", j);
+        for (int j = 0; j < aLength; j++)
             zkUA_jsonEncode_UA_Variant_callSetValueByType(variant, jsonObject,
                     j);
-            memset(dataIndex, 0, 65535);
-        }
-        free(dataIndex);
     }
 }
 
@@ -408,9 +399,13 @@ void zkUA_jsonEncode_UA_ExtensionObject(UA_ExtensionObject *eObject,
 
         zkUA_jsonEncode_UA_NodeId(&eObject->content.encoded.typeId, typeId);
 
-        /* encode the bytestring */
-        json_t *body = zkUA_jsonEncode_UA_String(
-                &eObject->content.encoded.body);
+        /* encode the bytestring, XML bodies are text */
+        json_t *body =
+                eObject->encoding == UA_EXTENSIONOBJECT_ENCODED_XML ?
+                        zkUA_jsonEncode_UA_String(
+                                &eObject->content.encoded.body) :
+                        zkUA_jsonEncode_UA_ByteString(
+                                &eObject->content.encoded.body);
         /* place everything inside their respective objects */
         json_object_set_new(jsonObject, "encoding", encoding);
         json_object_set_new(encoded, "typeId", typeId);
@@ -475,7 +470,7 @@ void zkUA_jsonEncode_UA_DataValue(UA_DataValue *dataValue, json_t *jsonObject) {
         json_object_set_new(jsonObject, "value", value);
     }
     if (dataValue->hasStatus) {
-        json_t *status = json_integer(dataValue->hasStatus);
+        json_t *status = json_integer(dataValue->status);
         json_object_set_new(jsonObject, "status", status);
     }
     if (dataValue->hasSourceTimestamp) {
@@ -663,6 +658,23 @@ json_t *zkUA_jsonEncode_UA_String(UA_String *uaString) {
     free(buffer);
     return jsonString;
 }
+
+/**
+ * zkUA_jsonEncode_UA_ByteString:
+ * Encodes UA_ByteString into a {"base64": "..."} JSON object and returns the object
+ */
+json_t *zkUA_jsonEncode_UA_ByteString(UA_ByteString *byteString) {
+
+    if (!base64ByteStrings)
+        return zkUA_jsonEncode_UA_String(byteString);
+    char *base64 = zkUA_base64_encode(byteString->data, byteString->length);
+    if (!base64)
+        return NULL;
+    json_t *jsonObject = json_object();
+    json_object_set_new(jsonObject, "base64", json_string(base64));
+    free(base64);
+    return jsonObject;
+}
 /**
  * zkUA_jsonEncode_UA_LocalizedText:
  * Encodes a UA_LocalizedText into the provided JSON object
@@ -730,7 +742,7 @@ UA_StatusCode zkUA_jsonEncode_UA_NodeId(UA_NodeId *nodeId, json_t *jsonObject) {
         json_object_set_new(jsonObject, "identifierTypeString",
                 identifierTypeString);
     } else if (nodeId->identifierType == UA_NODEIDTYPE_BYTESTRING) {
-        json_t *nodeId_id = zkUA_jsonEncode_UA_String(
+        json_t *nodeId_id = zkUA_jsonEncode_UA_ByteString(
                 &nodeId->identifier.byteString);
         json_object_set_new(jsonObject, "identifier", nodeId_id);
         identifierTypeString = json_string("UA_NODEIDTYPE_BYTESTRING");
@@ -835,7 +847,7 @@ void zkUA_jsonEncodeAttributes(UA_ReferenceDescription *childRef,
     json_object_set_new(jsonAttributes, "writeMask", writeMask);
 
     /* only the object and view classes have the eventNotifier attribute */
-    if (nodeClass == (UA_NODECLASS_OBJECT || UA_NODECLASS_VIEW)) {
+    if (nodeClass == UA_NODECLASS_OBJECT) {
         json_t *eventNotifier = json_integer(attributes->eventNotifier);
         json_object_set_new(jsonAttributes, "eventNotifier", eventNotifier);
     }
@@ -845,7 +857,9 @@ void zkUA_jsonEncodeAttributes(UA_ReferenceDescription *childRef,
     case UA_NODECLASS_VIEW: {
         /* attributes specific to view */
         UA_ViewAttributes *viewAttributes = (UA_ViewAttributes *) nodeAttributes;
-        json_t *containsNoLoops = json_integer(viewAttributes->containsNoLoops);
+        json_t *eventNotifier = json_integer(viewAttributes->eventNotifier);
+        json_object_set_new(jsonAttributes, "eventNotifier", eventNotifier);
+        json_t *containsNoLoops = json_boolean(viewAttributes->containsNoLoops);
         json_object_set_new(jsonAttributes, "containsNoLoops", containsNoLoops);
         break;
     }
@@ -883,7 +897,7 @@ void zkUA_jsonEncodeAttributes(UA_ReferenceDescription *childRef,
             json_t *accessLevel = json_integer(varAttributes->accessLevel);
             json_t *userAccessLevel = json_integer(
                     varAttributes->userAccessLevel);
-            json_t *minimumSamplingInterval = json_integer(
+            json_t *minimumSamplingInterval = json_real(
                     varAttributes->minimumSamplingInterval);
 
             json_object_set_new(jsonAttributes, "accessLevel", accessLevel);
@@ -0,0 +1,1064 @@
+/*******************************************************************************
+ * Copyright (C) 2018 Ahmed Ismail <aismail [at] protonmail.com>
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <zk_payload.h>
+#include <zk_jsonScan.h>
+#include <zk_urlEncode.h>
+
+/* Single-pass decoder of the node documents written by zkUA_jsonStream_encodeNode and
+ zkUA_addNodeJsonPack. Members are decoded into the attributes structs as they are
+ scanned. Strings without escapes point into the document, everything else that has
+ to be stored (unescaped strings, variant values and arrays) goes to a scratch buffer
+ of the thread that is reset by every call, so decoding a node allocates nothing once
+ the buffer is large enough. */
+
+#define ZKUA_JSONSCAN_BLOCK_SIZE 16384
+#define ZKUA_JSONSCAN_ALIGNMENT 8
+
+typedef struct zkUA_jsonScanBlock {
+    struct zkUA_jsonScanBlock *next;
+    size_t size;
+    size_t used;
+    char data[];
+} zkUA_jsonScanBlock;
+
+/* The scratch buffer of each thread, kept between calls */
+static __thread zkUA_jsonScanBlock *scratch;
+
+typedef struct zkUA_jsonScanner {
+    const char *pos;
+    const char *end;
+    UA_StatusCode status;
+} zkUA_jsonScanner;
+
+/***** Scratch buffer *****/
+static zkUA_jsonScanBlock *zkUA_jsonScan_newBlock(size_t size,
+        zkUA_jsonScanBlock *next) {
+    zkUA_jsonScanBlock *block = malloc(sizeof(zkUA_jsonScanBlock) + size);
+    if (!block)
+        return NULL;
+    block->next = next;
+    block->size = size;
+    block->used = 0;
+    return block;
+}
+
+/* Empties the scratch buffer. If the last document needed more than one block, they
+ are merged into one that is large enough for it. */
+static void zkUA_jsonScan_resetScratch(void) {
+    if (scratch && !scratch->next) {
+        scratch->used = 0;
+        return;
+    }
+    size_t size = 0;
+    while (scratch) {
+        zkUA_jsonScanBlock *next = scratch->next;
+        size += scratch->size;
+        free(scratch);
+        scratch = next;
+    }
+    if (size < ZKUA_JSONSCAN_BLOCK_SIZE)
+        size = ZKUA_JSONSCAN_BLOCK_SIZE;
+    scratch = zkUA_jsonScan_newBlock(size, NULL);
+}
+
+static void zkUA_jsonScan_fail(zkUA_jsonScanner *s, UA_StatusCode sCode) {
+    if (s->status == UA_STATUSCODE_GOOD)
+        s->status = sCode;
+    s->pos = s->end;
+}
+
+/* Returns size zeroed bytes of the scratch buffer */
+static void *zkUA_jsonScan_alloc(zkUA_jsonScanner *s, size_t size) {
+    size_t used = 0;
+    if (scratch) {
+        used = scratch->used;
+        uintptr_t address = (uintptr_t) (scratch->data + used);
+        used += (ZKUA_JSONSCAN_ALIGNMENT - address % ZKUA_JSONSCAN_ALIGNMENT)
+                % ZKUA_JSONSCAN_ALIGNMENT;
+    }
+    if (!scratch || used + size > scratch->size) {
+        size_t blockSize = ZKUA_JSONSCAN_BLOCK_SIZE;
+        if (blockSize < size)
+            blockSize = size;
+        zkUA_jsonScanBlock *block = zkUA_jsonScan_newBlock(blockSize, scratch);
+        if (!block) {
+            zkUA_jsonScan_fail(s, UA_STATUSCODE_BADOUTOFMEMORY);
+            return NULL;
+        }
+        scratch = block;
+        used = 0;
+    }
+    void *p = scratch->data + used;
+    scratch->used = used + size;
+    memset(p, 0, size);
+    return p;
+}
+
+/***** Tokens *****/
+static void zkUA_jsonScan_whitespace(zkUA_jsonScanner *s) {
+    while (s->pos < s->end
+            && (*s->pos == ' ' || *s->pos == '\n' || *s->pos == '\r'
+                    || *s->pos == '\t'))
+        s->pos++;
+}
+
+/* The next character after whitespace, 0 at the end of the document */
+static char zkUA_jsonScan_peek(zkUA_jsonScanner *s) {
+    zkUA_jsonScan_whitespace(s);
+    return (s->pos < s->end) ? *s->pos : 0;
+}
+
+static UA_Boolean zkUA_jsonScan_consume(zkUA_jsonScanner *s, char c) {
+    if (zkUA_jsonScan_peek(s) != c)
+        return false;
+    s->pos++;
+    return true;
+}
+
+static void zkUA_jsonScan_expect(zkUA_jsonScanner *s, char c) {
+    if (!zkUA_jsonScan_consume(s, c))
+        zkUA_jsonScan_fail(s, UA_STATUSCODE_BADDECODINGERROR);
+}
+
+static UA_Boolean zkUA_jsonScan_literal(zkUA_jsonScanner *s,
+        const char *literal) {
+    size_t length = strlen(literal);
+    if (zkUA_jsonScan_peek(s) != literal[0]
+            || (size_t) (s->end - s->pos) < length
+            || memcmp(s->pos, literal, length) != 0)
+        return false;
+    s->pos += length;
+    return true;
+}
+
+/* The characters between the quotes of a string and whether they contain escapes */
+static void zkUA_jsonScan_rawString(zkUA_jsonScanner *s, const char **start,
+        size_t *length, UA_Boolean *escaped) {
+    *start = NULL;
+    *length = 0;
+    *escaped = false;
+    if (!zkUA_jsonScan_consume(s, '"')) {
+        zkUA_jsonScan_fail(s, UA_STATUSCODE_BADDECODINGERROR);
+        return;
+    }
+    const char *p = s->pos;
+    while (p < s->end && *p != '"') {
+        if (*p == '\\') {
+            *escaped = true;
+            p++;
+        }
+        p++;
+    }
+    if (p >= s->end) {
+        zkUA_jsonScan_fail(s, UA_STATUSCODE_BADDECODINGERROR);
+        return;
+    }
+    *start = s->pos;
+    *length = (size_t) (p - s->pos);
+    s->pos = p + 1;
+}
+
+static int zkUA_jsonScan_hex(const char *p) {
+    int value = 0;
+    for (int i = 0; i < 4; i++) {
+        char c = p[i];
+        value <<= 4;
+        if (c >= '0' && c <= '9')
+            value |= c - '0';
+        else if (c >= 'a' && c <= 'f')
+            value |= c - 'a' + 10;
+        else if (c >= 'A' && c <= 'F')
+            value |= c - 'A' + 10;
+        else
+            return -1;
+    }
+    return value;
+}
+
+/* Unescapes a string into the scratch buffer, it never grows */
+static void zkUA_jsonScan_unescape(zkUA_jsonScanner *s, const char *raw,
+        size_t length, UA_String *out) {
+    UA_Byte *dst = zkUA_jsonScan_alloc(s, length);
+    if (!dst)
+        return;
+    const char *p = raw, *end = raw + length;
+    size_t n = 0;
+    while (p < end) {
+        if (*p != '\\') {
+            dst[n++] = (UA_Byte) *p++;
+            continue;
+        }
+        if (++p >= end)
+            break;
+        char c = *p++;
+        int codepoint;
+        switch (c) {
+        case 'b':
+            dst[n++] = '\b';
+            continue;
+        case 'f':
+            dst[n++] = '\f';
+            continue;
+        case 'n':
+            dst[n++] = '\n';
+            continue;
+        case 'r':
+            dst[n++] = '\r';
+            continue;
+        case 't':
+            dst[n++] = '\t';
+            continue;
+        case 'u':
+            if (end - p < 4 || (codepoint = zkUA_jsonScan_hex(p)) < 0) {
+                zkUA_jsonScan_fail(s, UA_STATUSCODE_BADDECODINGERROR);
+                return;
+            }
+            p += 4;
+            if (codepoint >= 0xD800 && codepoint <= 0xDBFF) {
+                /* a surrogate pair */
+                int low;
+                if (end - p < 6 || p[0] != '\\' || p[1] != 'u'
+                        || (low = zkUA_jsonScan_hex(p + 2)) < 0xDC00
+                        || low > 0xDFFF) {
+                    zkUA_jsonScan_fail(s, UA_STATUSCODE_BADDECODINGERROR);
+                    return;
+                }
+                p += 6;
+                codepoint = 0x10000 + ((codepoint - 0xD800) << 10)
+                        + (low - 0xDC00);
+            }
+            if (codepoint < 0x80) {
+                dst[n++] = (UA_Byte) codepoint;
+            } else if (codepoint < 0x800) {
+                dst[n++] = (UA_Byte) (0xC0 | codepoint >> 6);
+                dst[n++] = (UA_Byte) (0x80 | (codepoint & 0x3F));
+            } else if (codepoint < 0x10000) {
+                dst[n++] = (UA_Byte) (0xE0 | codepoint >> 12);
+                dst[n++] = (UA_Byte) (0x80 | (codepoint >> 6 & 0x3F));
+                dst[n++] = (UA_Byte) (0x80 | (codepoint & 0x3F));
+            } else {
+                dst[n++] = (UA_Byte) (0xF0 | codepoint >> 18);
+                dst[n++] = (UA_Byte) (0x80 | (codepoint >> 12 & 0x3F));
+                dst[n++] = (UA_Byte) (0x80 | (codepoint >> 6 & 0x3F));
+                dst[n++] = (UA_Byte) (0x80 | (codepoint & 0x3F));
+            }
+            continue;
+        default: /* '"', '\\' and '/' */
+            dst[n++] = (UA_Byte) c;
+            continue;
+        }
+    }
+    out->length = n;
+    out->data = n ? dst : NULL;
+}
+
+/* A string value; null decodes to the empty string */
+static void zkUA_jsonScan_string(zkUA_jsonScanner *s, UA_String *out) {
+    out->length = 0;
+    out->data = NULL;
+    if (zkUA_jsonScan_literal(s, "null"))
+        return;
+    const char *raw;
+    size_t length;
+    UA_Boolean escaped;
+    zkUA_jsonScan_rawString(s, &raw, &length, &escaped);
+    if (length == 0)
+        return;
+    if (escaped) {
+        zkUA_jsonScan_unescape(s, raw, length, out);
+    } else {
+        out->length = length;
+        out->data = (UA_Byte *) (uintptr_t) raw;
+    }
+}
+
+static UA_Boolean zkUA_jsonScan_number(zkUA_jsonScanner *s, UA_Int64 *integer,
+        double *real) {
+    zkUA_jsonScan_whitespace(s);
+    const char *start = s->pos, *p = s->pos;
+    UA_Boolean negative = false;
+    if (p < s->end && *p == '-') {
+        negative = true;
+        p++;
+    }
+    if (p >= s->end || *p < '0' || *p > '9') {
+        zkUA_jsonScan_fail(s, UA_STATUSCODE_BADDECODINGERROR);
+        return false;
+    }
+    UA_UInt64 value = 0;
+    while (p < s->end && *p >= '0' && *p <= '9')
+        value = value * 10 + (UA_UInt64) (*p++ - '0');
+    if (p < s->end && (*p == '.' || *p == 'e' || *p == 'E')) {
+        while (p < s->end
+                && ((*p >= '0' && *p <= '9') || *p == '.' || *p == 'e'
+                        || *p == 'E' || *p == '+' || *p == '-'))
+            p++;
+        char buffer[64];
+        size_t length = (size_t) (p - start);
+        if (length >= sizeof(buffer)) {
+            zkUA_jsonScan_fail(s, UA_STATUSCODE_BADDECODINGERROR);
+            return false;
+        }
+        memcpy(buffer, start, length);
+        buffer[length] = '\0';
+        *real = strtod(buffer, NULL);
+        s->pos = p;
+        return true;
+    }
+    *integer = negative ? (UA_Int64) (0 - value) : (UA_Int64) value;
+    *real = (double) *integer;
+    s->pos = p;
+    return false;
+}
+
+static UA_Int64 zkUA_jsonScan_integer(zkUA_jsonScanner *s) {
+    UA_Int64 integer = 0;
+    double real = 0;
+    if (zkUA_jsonScan_number(s, &integer, &real))
+        integer = (UA_Int64) real;
+    return integer;
+}
+
+static double zkUA_jsonScan_real(zkUA_jsonScanner *s) {
+    UA_Int64 integer = 0;
+    double real = 0;
+    zkUA_jsonScan_number(s, &integer, &real);
+    return real;
+}
+
+/* Booleans are written as true/false or as integers */
+static UA_Boolean zkUA_jsonScan_boolean(zkUA_jsonScanner *s) {
+    if (zkUA_jsonScan_literal(s, "true"))
+        return true;
+    if (zkUA_jsonScan_literal(s, "false"))
+        return false;
+    return zkUA_jsonScan_integer(s) != 0;
+}
+
+static void zkUA_jsonScan_skip(zkUA_jsonScanner *s) {
+    char c = zkUA_jsonScan_peek(s);
+    if (c == '"') {
+        const char *raw;
+        size_t length;
+        UA_Boolean escaped;
+        zkUA_jsonScan_rawString(s, &raw, &length, &escaped);
+        return;
+    }
+    if (c != '{' && c != '[') {
+        while (s->pos < s->end && *s->pos != ',' && *s->pos != '}'
+                && *s->pos != ']' && *s->pos != ' ' && *s->pos != '\n'
+                && *s->pos != '\r' && *s->pos != '\t')
+            s->pos++;
+        return;
+    }
+    int depth = 0;
+    while (s->pos < s->end) {
+        c = *s->pos;
+        if (c == '"') {
+            const char *raw;
+            size_t length;
+            UA_Boolean escaped;
+            zkUA_jsonScan_rawString(s, &raw, &length, &escaped);
+            continue;
+        }
+        s->pos++;
+        if (c == '{' || c == '[') {
+            depth++;
+        } else if (c == '}' || c == ']') {
+            if (--depth == 0)
+                return;
+        }
+    }
+    zkUA_jsonScan_fail(s, UA_STATUSCODE_BADDECODINGERROR);
+}
+
+/* Moves to the next member of an object whose '{' was consumed. Returns false at the
+ end of the object or on error. */
+static UA_Boolean zkUA_jsonScan_member(zkUA_jsonScanner *s, int *members,
+        const char **key, size_t *keyLength) {
+    if (s->status != UA_STATUSCODE_GOOD || zkUA_jsonScan_consume(s, '}'))
+        return false;
+    if ((*members)++ > 0)
+        zkUA_jsonScan_expect(s, ',');
+    UA_Boolean escaped;
+    zkUA_jsonScan_rawString(s, key, keyLength, &escaped);
+    if (escaped) /* none of the keys needs escaping */
+        zkUA_jsonScan_fail(s, UA_STATUSCODE_BADNOTSUPPORTED);
+    zkUA_jsonScan_expect(s, ':');
+    return s->status == UA_STATUSCODE_GOOD;
+}
+
+/* Moves to the next element of an array whose '[' was consumed */
+static UA_Boolean zkUA_jsonScan_element(zkUA_jsonScanner *s, size_t *elements) {
+    if (s->status != UA_STATUSCODE_GOOD || zkUA_jsonScan_consume(s, ']'))
+        return false;
+    if ((*elements)++ > 0)
+        zkUA_jsonScan_expect(s, ',');
+    return s->status == UA_STATUSCODE_GOOD;
+}
+
+static UA_Boolean zkUA_jsonScan_isKey(const char *key, size_t keyLength,
+        const char *name) {
+    return strlen(name) == keyLength && memcmp(key, name, keyLength) == 0;
+}
+
+/* Parses the index of a key like "data[3]" that starts with prefix, -1 otherwise */
+static long zkUA_jsonScan_keyIndex(const char *key, size_t keyLength,
+        const char *prefix) {
+    size_t prefixLength = strlen(prefix);
+    if (keyLength < prefixLength + 2 || memcmp(key, prefix, prefixLength) != 0
+            || key[keyLength - 1] != ']')
+        return -1;
+    long index = 0;
+    for (size_t i = prefixLength; i < keyLength - 1; i++) {
+        if (key[i] < '0' || key[i] > '9')
+            return -1;
+        index = index * 10 + (key[i] - '0');
+    }
+    return index;
+}
+
+/***** Values *****/
+/* A ByteString: a {"base64": "..."} object, or the text written before payload
+ version 3 */
+static void zkUA_jsonScan_byteString(zkUA_jsonScanner *s, UA_ByteString *out) {
+    if (zkUA_jsonScan_peek(s) != '{') {
+        zkUA_jsonScan_string(s, out);
+        return;
+    }
+    out->length = 0;
+    out->data = NULL;
+    const char *key;
+    size_t keyLength;
+    int members = 0;
+    zkUA_jsonScan_expect(s, '{');
+    while (zkUA_jsonScan_member(s, &members, &key, &keyLength)) {
+        if (!zkUA_jsonScan_isKey(key, keyLength, "base64")) {
+            zkUA_jsonScan_skip(s);
+            continue;
+        }
+        const char *raw;
+        size_t length;
+        UA_Boolean escaped;
+        zkUA_jsonScan_rawString(s, &raw, &length, &escaped);
+        if (escaped) {
+            zkUA_jsonScan_fail(s, UA_STATUSCODE_BADNOTSUPPORTED);
+            return;
+        }
+        if (length == 0)
+            continue;
+        UA_Byte *data = zkUA_jsonScan_alloc(s, length / 4 * 3);
+        if (!data)
+            return;
+        size_t decoded = zkUA_base64_decode(raw, length, data);
+        if (decoded == (size_t) -1) {
+            zkUA_jsonScan_fail(s, UA_STATUSCODE_BADDECODINGERROR);
+            return;
+        }
+        out->length = decoded;
+        out->data = decoded ? data : NULL;
+    }
+}
+
+/* A number; integers are returned in *integer, others in *real */
+static void zkUA_jsonScan_UA_Guid(zkUA_jsonScanner *s, UA_Guid *guid) {
+    const char *key;
+    size_t keyLength;
+    int members = 0;
+    zkUA_jsonScan_expect(s, '{');
+    while (zkUA_jsonScan_member(s, &members, &key, &keyLength)) {
+        if (zkUA_jsonScan_isKey(key, keyLength, "data1")) {
+            guid->data1 = (UA_UInt32) zkUA_jsonScan_integer(s);
+        } else if (zkUA_jsonScan_isKey(key, keyLength, "data2")) {
+            guid->data2 = (UA_UInt16) zkUA_jsonScan_integer(s);
+        } else if (zkUA_jsonScan_isKey(key, keyLength, "data3")) {
+            guid->data3 = (UA_UInt16) zkUA_jsonScan_integer(s);
+        } else if (zkUA_jsonScan_isKey(key, keyLength, "data4")) {
+            size_t elements = 0;
+            zkUA_jsonScan_expect(s, '[');
+            while (zkUA_jsonScan_element(s, &elements)) {
+                if (elements > 8) {
+                    zkUA_jsonScan_fail(s, UA_STATUSCODE_BADDECODINGERROR);
+                    return;
+                }
+                guid->data4[elements - 1] = (UA_Byte) zkUA_jsonScan_integer(s);
+            }
+        } else {
+            zkUA_jsonScan_skip(s);
+        }
+    }
+}
+
+/* The identifier is decoded by its JSON type, so it may precede the identifierType */
+static void zkUA_jsonScan_UA_NodeId(zkUA_jsonScanner *s, UA_NodeId *nodeId) {
+    const char *key;
+    size_t keyLength;
+    int members = 0;
+    char identifier = 0;
+    UA_Int64 idType = -1;
+    UA_NodeId_init(nodeId);
+    zkUA_jsonScan_expect(s, '{');
+    while (zkUA_jsonScan_member(s, &members, &key, &keyLength)) {
+        if (zkUA_jsonScan_isKey(key, keyLength, "namespaceIndex")) {
+            nodeId->namespaceIndex = (UA_UInt16) zkUA_jsonScan_integer(s);
+        } else if (zkUA_jsonScan_isKey(key, keyLength, "identifierType")) {
+            idType = zkUA_jsonScan_integer(s);
+        } else if (zkUA_jsonScan_isKey(key, keyLength, "identifier")) {
+            identifier = zkUA_jsonScan_peek(s);
+            if (identifier == '{' && idType == UA_NODEIDTYPE_BYTESTRING) {
+                /* base64, which has to follow the identifierType to be told
+                 apart from a Guid */
+                identifier = 'b';
+                zkUA_jsonScan_byteString(s, &nodeId->identifier.byteString);
+            } else if (identifier == '{')
+                zkUA_jsonScan_UA_Guid(s, &nodeId->identifier.guid);
+            else if (identifier == '"')
+                zkUA_jsonScan_string(s, &nodeId->identifier.string);
+            else
+                nodeId->identifier.numeric = (UA_UInt32) zkUA_jsonScan_integer(
+                        s);
+        } else {
+            zkUA_jsonScan_skip(s);
+        }
+    }
+    switch (idType) {
+    case UA_NODEIDTYPE_NUMERIC:
+        if (identifier == '{' || identifier == '"' || identifier == 'b')
+            zkUA_jsonScan_fail(s, UA_STATUSCODE_BADDECODINGERROR);
+        break;
+    case UA_NODEIDTYPE_STRING:
+        /* a string the encoder could not write is left out */
+        if (identifier != '"')
+            zkUA_jsonScan_fail(s, UA_STATUSCODE_BADNOTSUPPORTED);
+        break;
+    case UA_NODEIDTYPE_BYTESTRING:
+        if (identifier != '"' && identifier != 'b')
+            zkUA_jsonScan_fail(s, UA_STATUSCODE_BADNOTSUPPORTED);
+        break;
+    case UA_NODEIDTYPE_GUID:
+        if (identifier != '{')
+            zkUA_jsonScan_fail(s, UA_STATUSCODE_BADDECODINGERROR);
+        break;
+    default:
+        zkUA_jsonScan_fail(s, UA_STATUSCODE_BADDECODINGERROR);
+        return;
+    }
+    nodeId->identifierType = (enum UA_NodeIdType) idType;
+}
+
+static void zkUA_jsonScan_UA_ExpandedNodeId(zkUA_jsonScanner *s,
+        UA_ExpandedNodeId *expId) {
+    const char *key;
+    size_t keyLength;
+    int members = 0;
+    zkUA_jsonScan_expect(s, '{');
+    while (zkUA_jsonScan_member(s, &members, &key, &keyLength)) {
+        if (zkUA_jsonScan_isKey(key, keyLength, "nodeId"))
+            zkUA_jsonScan_UA_NodeId(s, &expId->nodeId);
+        else if (zkUA_jsonScan_isKey(key, keyLength, "namespaceUri"))
+            zkUA_jsonScan_string(s, &expId->namespaceUri);
+        else if (zkUA_jsonScan_isKey(key, keyLength, "serverIndex"))
+            expId->serverIndex = (UA_UInt32) zkUA_jsonScan_integer(s);
+        else
+            zkUA_jsonScan_skip(s);
+    }
+}
+
+static void zkUA_jsonScan_UA_QualifiedName(zkUA_jsonScanner *s,
+        UA_QualifiedName *qualName) {
+    const char *key;
+    size_t keyLength;
+    int members = 0;
+    zkUA_jsonScan_expect(s, '{');
+    while (zkUA_jsonScan_member(s, &members, &key, &keyLength)) {
+        if (zkUA_jsonScan_isKey(key, keyLength, "namespaceIndex"))
+            qualName->namespaceIndex = (UA_UInt16) zkUA_jsonScan_integer(s);
+        else if (zkUA_jsonScan_isKey(key, keyLength, "name"))
+            zkUA_jsonScan_string(s, &qualName->name);
+        else
+            zkUA_jsonScan_skip(s);
+    }
+}
+
+/* The {"length": n, "data": "..."} objects of a LocalizedText */
+static void zkUA_jsonScan_lengthAndData(zkUA_jsonScanner *s, UA_String *out) {
+    const char *key;
+    size_t keyLength;
+    int members = 0;
+    zkUA_jsonScan_expect(s, '{');
+    while (zkUA_jsonScan_member(s, &members, &key, &keyLength)) {
+        if (zkUA_jsonScan_isKey(key, keyLength, "data"))
+            zkUA_jsonScan_string(s, out);
+        else
+            zkUA_jsonScan_skip(s);
+    }
+}
+
+static void zkUA_jsonScan_UA_LocalizedText(zkUA_jsonScanner *s,
+        UA_LocalizedText *lText) {
+    const char *key;
+    size_t keyLength;
+    int members = 0;
+    zkUA_jsonScan_expect(s, '{');
+    while (zkUA_jsonScan_member(s, &members, &key, &keyLength)) {
+        if (zkUA_jsonScan_isKey(key, keyLength, "locale"))
+            zkUA_jsonScan_lengthAndData(s, &lText->locale);
+        else if (zkUA_jsonScan_isKey(key, keyLength, "text"))
+            zkUA_jsonScan_lengthAndData(s, &lText->text);
+        else
+            zkUA_jsonScan_skip(s);
+    }
+}
+
+/* Decodes a value of a Variant into dst (zeroed) */
+static void zkUA_jsonScan_value(zkUA_jsonScanner *s, const UA_DataType *type,
+        void *dst) {
+    switch (type->typeIndex) {
+    case UA_TYPES_BOOLEAN:
+        *(UA_Boolean *) dst = zkUA_jsonScan_boolean(s);
+        break;
+    case UA_TYPES_SBYTE:
+        *(UA_SByte *) dst = (UA_SByte) zkUA_jsonScan_integer(s);
+        break;
+    case UA_TYPES_BYTE:
+        *(UA_Byte *) dst = (UA_Byte) zkUA_jsonScan_integer(s);
+        break;
+    case UA_TYPES_INT16:
+        *(UA_Int16 *) dst = (UA_Int16) zkUA_jsonScan_integer(s);
+        break;
+    case UA_TYPES_UINT16:
+        *(UA_UInt16 *) dst = (UA_UInt16) zkUA_jsonScan_integer(s);
+        break;
+    case UA_TYPES_INT32:
+        *(UA_Int32 *) dst = (UA_Int32) zkUA_jsonScan_integer(s);
+        break;
+    case UA_TYPES_UINT32:
+        *(UA_UInt32 *) dst = (UA_UInt32) zkUA_jsonScan_integer(s);
+        break;
+    case UA_TYPES_INT64:
+    case UA_TYPES_DATETIME:
+        *(UA_Int64 *) dst = zkUA_jsonScan_integer(s);
+        break;
+    case UA_TYPES_UINT64:
+        /* written as the json_int_t of the same bits */
+        *(UA_UInt64 *) dst = (UA_UInt64) zkUA_jsonScan_integer(s);
+        break;
+    case UA_TYPES_FLOAT:
+        *(UA_Float *) dst = (UA_Float) zkUA_jsonScan_real(s);
+        break;
+    case UA_TYPES_DOUBLE:
+        *(UA_Double *) dst = zkUA_jsonScan_real(s);
+        break;
+    case UA_TYPES_STATUSCODE:
+        *(UA_StatusCode *) dst = (UA_StatusCode) zkUA_jsonScan_integer(s);
+        break;
+    case UA_TYPES_STRING:
+    case UA_TYPES_XMLELEMENT:
+        zkUA_jsonScan_string(s, (UA_String *) dst);
+        break;
+    case UA_TYPES_BYTESTRING:
+        zkUA_jsonScan_byteString(s, (UA_ByteString *) dst);
+        break;
+    case UA_TYPES_GUID:
+        zkUA_jsonScan_UA_Guid(s, (UA_Guid *) dst);
+        break;
+    case UA_TYPES_NODEID:
+        zkUA_jsonScan_UA_NodeId(s, (UA_NodeId *) dst);
+        break;
+    case UA_TYPES_EXPANDEDNODEID:
+        zkUA_jsonScan_UA_ExpandedNodeId(s, (UA_ExpandedNodeId *) dst);
+        break;
+    case UA_TYPES_QUALIFIEDNAME:
+        zkUA_jsonScan_UA_QualifiedName(s, (UA_QualifiedName *) dst);
+        break;
+    case UA_TYPES_LOCALIZEDTEXT:
+        zkUA_jsonScan_UA_LocalizedText(s, (UA_LocalizedText *) dst);
+        break;
+    default: /* ExtensionObject, DataValue */
+        zkUA_jsonScan_fail(s, UA_STATUSCODE_BADNOTSUPPORTED);
+        break;
+    }
+}
+
+static UA_Boolean zkUA_jsonScan_isSupportedType(UA_Int64 typeIndex) {
+    switch (typeIndex) {
+    case UA_TYPES_BOOLEAN:
+    case UA_TYPES_SBYTE:
+    case UA_TYPES_BYTE:
+    case UA_TYPES_INT16:
+    case UA_TYPES_UINT16:
+    case UA_TYPES_INT32:
+    case UA_TYPES_UINT32:
+    case UA_TYPES_INT64:
+    case UA_TYPES_UINT64:
+    case UA_TYPES_FLOAT:
+    case UA_TYPES_DOUBLE:
+    case UA_TYPES_STRING:
+    case UA_TYPES_DATETIME:
+    case UA_TYPES_GUID:
+    case UA_TYPES_BYTESTRING:
+    case UA_TYPES_XMLELEMENT:
+    case UA_TYPES_NODEID:
+    case UA_TYPES_EXPANDEDNODEID:
+    case UA_TYPES_STATUSCODE:
+    case UA_TYPES_QUALIFIEDNAME:
+    case UA_TYPES_LOCALIZEDTEXT:
+        return true;
+    default:
+        return false;
+    }
+}
+
+/* Decodes the "data" member of a Variant. Scalars, JSON arrays and base64 arrays are
+ told apart by the JSON type of the data, which makes "dataEncoding" redundant. */
+static void zkUA_jsonScan_variantData(zkUA_jsonScanner *s, UA_Variant *variant,
+        size_t arrayLength) {
+    const UA_DataType *type = variant->type;
+    char c = zkUA_jsonScan_peek(s);
+    UA_Boolean stringType = type->typeIndex == UA_TYPES_STRING
+            || type->typeIndex == UA_TYPES_BYTESTRING
+            || type->typeIndex == UA_TYPES_XMLELEMENT;
+    if (arrayLength == 0 && c != '[' && (c != '"' || stringType)) {
+        variant->data = zkUA_jsonScan_alloc(s, type->memSize);
+        if (variant->data)
+            zkUA_jsonScan_value(s, type, variant->data);
+        variant->arrayLength = 0;
+        return;
+    }
+
+    size_t size = arrayLength * type->memSize;
+    if (c == '"') {
+        const char *raw;
+        size_t length;
+        UA_Boolean escaped;
+        zkUA_jsonScan_rawString(s, &raw, &length, &escaped);
+        if (escaped || !type->overlayable) {
+            zkUA_jsonScan_fail(s, UA_STATUSCODE_BADNOTSUPPORTED);
+            return;
+        }
+        /* decode the packed array in place, the padding may need a few more bytes */
+        size_t packedSize = length / 4 * 3;
+        UA_Byte *data = zkUA_jsonScan_alloc(s,
+                packedSize > size ? packedSize : size);
+        if (!data)
+            return;
+        size_t decoded = zkUA_base64_decode(raw, length, data);
+        if (decoded == (size_t) -1) {
+            zkUA_jsonScan_fail(s, UA_STATUSCODE_BADDECODINGERROR);
+            return;
+        }
+        /* this build lays the type out differently, leave it to the JSON tree */
+        if (decoded != size) {
+            zkUA_jsonScan_fail(s, UA_STATUSCODE_BADNOTSUPPORTED);
+            return;
+        }
+        variant->data = arrayLength ? (void *) data : UA_EMPTY_ARRAY_SENTINEL;
+    } else if (c == '[') {
+        char *data = UA_EMPTY_ARRAY_SENTINEL;
+        if (arrayLength > 0 && !(data = zkUA_jsonScan_alloc(s, size)))
+            return;
+        size_t elements = 0;
+        zkUA_jsonScan_expect(s, '[');
+        while (zkUA_jsonScan_element(s, &elements)) {
+            if (elements > arrayLength) {
+                zkUA_jsonScan_fail(s, UA_STATUSCODE_BADDECODINGERROR);
+                return;
+            }
+            zkUA_jsonScan_value(s, type, data + (elements - 1) * type->memSize);
+        }
+        /* the encoder leaves out the values jansson refuses */
+        if (elements != arrayLength) {
+            zkUA_jsonScan_fail(s, UA_STATUSCODE_BADNOTSUPPORTED);
+            return;
+        }
+        variant->data = data;
+    } else {
+        zkUA_jsonScan_fail(s, UA_STATUSCODE_BADDECODINGERROR);
+        return;
+    }
+    variant->arrayLength = arrayLength;
+}
+
+/* The type and the length have to precede the values, as the encoders write them */
+static void zkUA_jsonScan_UA_Variant(zkUA_jsonScanner *s, UA_Variant *variant) {
+    UA_Variant_init(variant);
+    if (zkUA_jsonScan_peek(s) == '"') {
+        UA_String empty;
+        zkUA_jsonScan_string(s, &empty);
+        if (empty.length != 5 || memcmp(empty.data, "empty", 5) != 0)
+            zkUA_jsonScan_fail(s, UA_STATUSCODE_BADDECODINGERROR);
+        return;
+    }
+
+    const char *key;
+    size_t keyLength;
+    int members = 0;
+    long index;
+    UA_Boolean hasLength = false, hasData = false;
+    size_t arrayLength = 0, legacyValues = 0;
+    zkUA_jsonScan_expect(s, '{');
+    while (zkUA_jsonScan_member(s, &members, &key, &keyLength)) {
+        if (zkUA_jsonScan_isKey(key, keyLength, "arrayLength")) {
+            arrayLength = (size_t) zkUA_jsonScan_integer(s);
+            hasLength = true;
+        } else if (zkUA_jsonScan_isKey(key, keyLength, "type")) {
+            /* the DataType object of legacy empty arrays, or an unknown type */
+            if (zkUA_jsonScan_peek(s) == '{') {
+                zkUA_jsonScan_fail(s, UA_STATUSCODE_BADNOTSUPPORTED);
+                break;
+            }
+            UA_Int64 typeIndex = zkUA_jsonScan_integer(s);
+            if (!zkUA_jsonScan_isSupportedType(typeIndex)) {
+                zkUA_jsonScan_fail(s, UA_STATUSCODE_BADNOTSUPPORTED);
+                break;
+            }
+            variant->type = &UA_TYPES[typeIndex];
+        } else if (zkUA_jsonScan_isKey(key, keyLength, "arrayDimensionsSize")) {
+            size_t size = (size_t) zkUA_jsonScan_integer(s);
+            if (size > 0) {
+                variant->arrayDimensions = zkUA_jsonScan_alloc(s,
+                        size * sizeof(UA_UInt32));
+                variant->arrayDimensionsSize = size;
+            }
+        } else if (zkUA_jsonScan_isKey(key, keyLength, "arrayDimensions")) {
+            /* payload version 1 writes a placeholder integer without dimensions */
+            if (zkUA_jsonScan_peek(s) != '[') {
+                zkUA_jsonScan_skip(s);
+                continue;
+            }
+            size_t elements = 0;
+            zkUA_jsonScan_expect(s, '[');
+            while (zkUA_jsonScan_element(s, &elements)) {
+                if (elements > variant->arrayDimensionsSize) {
+                    zkUA_jsonScan_fail(s, UA_STATUSCODE_BADNOTSUPPORTED);
+                    break;
+                }
+                variant->arrayDimensions[elements - 1] =
+                        (UA_UInt32) zkUA_jsonScan_integer(s);
+            }
+        } else if (zkUA_jsonScan_isKey(key, keyLength, "data")) {
+            if (!variant->type || !hasLength || hasData) {
+                zkUA_jsonScan_fail(s, UA_STATUSCODE_BADNOTSUPPORTED);
+                break;
+            }
+            zkUA_jsonScan_variantData(s, variant, arrayLength);
+            hasData = true;
+        } else if ((index = zkUA_jsonScan_keyIndex(key, keyLength, "data["))
+                >= 0) {
+            /* payload version 1: one data[i] member per value */
+            if (!variant->type || arrayLength == 0
+                    || (size_t) index >= arrayLength) {
+                zkUA_jsonScan_fail(s, UA_STATUSCODE_BADNOTSUPPORTED);
+                break;
+            }
+            if (!variant->data) {
+                variant->data = zkUA_jsonScan_alloc(s,
+                        arrayLength * variant->type->memSize);
+                variant->arrayLength = arrayLength;
+                hasData = true;
+                if (!variant->data)
+                    break;
+            }
+            zkUA_jsonScan_value(s, variant->type,
+                    (char *) variant->data
+                            + (size_t) index * variant->type->memSize);
+            legacyValues++;
+        } else if ((index = zkUA_jsonScan_keyIndex(key, keyLength,
+                "arrayDimensions[")) >= 0) {
+            if ((size_t) index >= variant->arrayDimensionsSize) {
+                zkUA_jsonScan_fail(s, UA_STATUSCODE_BADNOTSUPPORTED);
+                break;
+            }
+            variant->arrayDimensions[index] = (UA_UInt32) zkUA_jsonScan_integer(
+                    s);
+        } else { /* storageType, dataEncoding */
+            zkUA_jsonScan_skip(s);
+        }
+    }
+    /* scalars whose value the encoder left out and incomplete legacy arrays */
+    if (!hasData || (legacyValues > 0 && legacyValues != arrayLength))
+        zkUA_jsonScan_fail(s, UA_STATUSCODE_BADNOTSUPPORTED);
+    /* the values live in the document and the scratch buffer */
+    variant->storageType = UA_VARIANT_DATA_NODELETE;
+}
+
+/***** Node documents *****/
+static UA_Boolean zkUA_jsonScan_isNodeClass(UA_Int64 nodeClass) {
+    switch (nodeClass) {
+    case UA_NODECLASS_OBJECT:
+    case UA_NODECLASS_VARIABLE:
+    case UA_NODECLASS_METHOD:
+    case UA_NODECLASS_OBJECTTYPE:
+    case UA_NODECLASS_VARIABLETYPE:
+    case UA_NODECLASS_REFERENCETYPE:
+    case UA_NODECLASS_DATATYPE:
+    case UA_NODECLASS_VIEW:
+        return true;
+    default:
+        return false;
+    }
+}
+
+static void zkUA_jsonScan_attributes(zkUA_jsonScanner *s,
+        UA_NodeClass nodeClass, zkUA_jsonScanAttributes *attr) {
+    const char *key;
+    size_t keyLength;
+    int members = 0;
+    UA_Boolean variable = nodeClass == UA_NODECLASS_VARIABLE;
+    UA_Boolean variableType = nodeClass == UA_NODECLASS_VARIABLETYPE;
+    memset(attr, 0, sizeof(zkUA_jsonScanAttributes));
+    zkUA_jsonScan_expect(s, '{');
+    while (zkUA_jsonScan_member(s, &members, &key, &keyLength)) {
+        if (zkUA_jsonScan_isKey(key, keyLength, "displayName")) {
+            zkUA_jsonScan_UA_LocalizedText(s, &attr->node.displayName);
+        } else if (zkUA_jsonScan_isKey(key, keyLength, "description")) {
+            zkUA_jsonScan_UA_LocalizedText(s, &attr->node.description);
+        } else if (zkUA_jsonScan_isKey(key, keyLength, "writeMask")) {
+            attr->node.writeMask = (UA_UInt32) zkUA_jsonScan_integer(s);
+        } else if (zkUA_jsonScan_isKey(key, keyLength, "userWriteMask")) {
+            attr->node.userWriteMask = (UA_UInt32) zkUA_jsonScan_integer(s);
+        } else if (zkUA_jsonScan_isKey(key, keyLength, "eventNotifier")
+                && nodeClass == UA_NODECLASS_OBJECT) {
+            attr->object.eventNotifier = (UA_Byte) zkUA_jsonScan_integer(s);
+        } else if (zkUA_jsonScan_isKey(key, keyLength, "eventNotifier")
+                && nodeClass == UA_NODECLASS_VIEW) {
+            attr->view.eventNotifier = (UA_Byte) zkUA_jsonScan_integer(s);
+        } else if (zkUA_jsonScan_isKey(key, keyLength, "containsNoLoops")
+                && nodeClass == UA_NODECLASS_VIEW) {
+            attr->view.containsNoLoops = zkUA_jsonScan_boolean(s);
+        } else if (zkUA_jsonScan_isKey(key, keyLength, "value") && variable) {
+            zkUA_jsonScan_UA_Variant(s, &attr->variable.value);
+        } else if (zkUA_jsonScan_isKey(key, keyLength, "value")
+                && variableType) {
+            zkUA_jsonScan_UA_Variant(s, &attr->variableType.value);
+        } else if (zkUA_jsonScan_isKey(key, keyLength, "dataType") && variable) {
+            zkUA_jsonScan_UA_NodeId(s, &attr->variable.dataType);
+        } else if (zkUA_jsonScan_isKey(key, keyLength, "dataType")
+                && variableType) {
+            zkUA_jsonScan_UA_NodeId(s, &attr->variableType.dataType);
+        } else if (zkUA_jsonScan_isKey(key, keyLength, "valueRank")
+                && variable) {
+            attr->variable.valueRank = (UA_Int32) zkUA_jsonScan_integer(s);
+        } else if (zkUA_jsonScan_isKey(key, keyLength, "valueRank")
+                && variableType) {
+            attr->variableType.valueRank = (UA_Int32) zkUA_jsonScan_integer(s);
+        } else if (zkUA_jsonScan_isKey(key, keyLength, "accessLevel")
+                && variable) {
+            attr->variable.accessLevel = (UA_Byte) zkUA_jsonScan_integer(s);
+        } else if (zkUA_jsonScan_isKey(key, keyLength, "userAccessLevel")
+                && variable) {
+            attr->variable.userAccessLevel = (UA_Byte) zkUA_jsonScan_integer(s);
+        } else if (zkUA_jsonScan_isKey(key, keyLength,
+                "minimumSamplingInterval") && variable) {
+            attr->variable.minimumSamplingInterval = zkUA_jsonScan_real(s);
+        } else if (zkUA_jsonScan_isKey(key, keyLength, "historizing")
+                && variable) {
+            attr->variable.historizing = zkUA_jsonScan_boolean(s);
+        } else if (zkUA_jsonScan_isKey(key, keyLength, "isAbstract")) {
+            UA_Boolean isAbstract = zkUA_jsonScan_boolean(s);
+            if (variableType)
+                attr->variableType.isAbstract = isAbstract;
+            else if (nodeClass == UA_NODECLASS_REFERENCETYPE)
+                attr->referenceType.isAbstract = isAbstract;
+            else if (nodeClass == UA_NODECLASS_OBJECTTYPE)
+                attr->objectType.isAbstract = isAbstract;
+            else if (nodeClass == UA_NODECLASS_DATATYPE)
+                attr->dataType.isAbstract = isAbstract;
+        } else if (zkUA_jsonScan_isKey(key, keyLength, "symmetric")
+                && nodeClass == UA_NODECLASS_REFERENCETYPE) {
+            attr->referenceType.symmetric = zkUA_jsonScan_boolean(s);
+        } else if (zkUA_jsonScan_isKey(key, keyLength, "inverseName")
+                && nodeClass == UA_NODECLASS_REFERENCETYPE) {
+            zkUA_jsonScan_UA_LocalizedText(s, &attr->referenceType.inverseName);
+        } else if (zkUA_jsonScan_isKey(key, keyLength, "executable")
+                && nodeClass == UA_NODECLASS_METHOD) {
+            attr->method.executable = zkUA_jsonScan_boolean(s);
+        } else if (zkUA_jsonScan_isKey(key, keyLength, "userExecutable")
+                && nodeClass == UA_NODECLASS_METHOD) {
+            attr->method.userExecutable = zkUA_jsonScan_boolean(s);
+        } else {
+            /* The arrayDimensionsSize is written without the arrayDimensions, so it is
+             left at 0 like the arrayDimensions */
+            zkUA_jsonScan_skip(s);
+        }
+    }
+}
+
+UA_StatusCode zkUA_jsonScan_decodeNode(const char *document, size_t length,
+        zkUA_NodeInfo *info, zkUA_jsonScanAttributes *attr) {
+
+    zkUA_jsonScanner scanner = { document, document + length,
+            UA_STATUSCODE_GOOD };
+    zkUA_jsonScanner *s = &scanner;
+    zkUA_jsonScan_resetScratch();
+    if (!scratch)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+
+    const char *key;
+    size_t keyLength;
+    int members = 0, infoMembers = 0;
+    UA_Boolean hasNodeClass = false, hasAttributes = false;
+    int hasNodeIds = 0;
+    memset(info, 0, sizeof(zkUA_NodeInfo));
+    zkUA_jsonScan_expect(s, '{');
+    while (zkUA_jsonScan_member(s, &members, &key, &keyLength)) {
+        if (zkUA_jsonScan_isKey(key, keyLength, "NodeInfo")) {
+            zkUA_jsonScan_expect(s, '{');
+            while (zkUA_jsonScan_member(s, &infoMembers, &key, &keyLength)) {
+                if (zkUA_jsonScan_isKey(key, keyLength, "NodeId")) {
+                    zkUA_jsonScan_UA_NodeId(s, &info->nodeId);
+                    hasNodeIds |= 1;
+                } else if (zkUA_jsonScan_isKey(key, keyLength, "NodeClass")) {
+                    UA_Int64 nodeClass = zkUA_jsonScan_integer(s);
+                    if (!zkUA_jsonScan_isNodeClass(nodeClass))
+                        zkUA_jsonScan_fail(s, UA_STATUSCODE_BADNOTSUPPORTED);
+                    info->nodeClass = (UA_NodeClass) nodeClass;
+                    hasNodeClass = true;
+                } else if (zkUA_jsonScan_isKey(key, keyLength, "parentNodeId")) {
+                    zkUA_jsonScan_UA_NodeId(s, &info->parentNodeId);
+                    hasNodeIds |= 2;
+                } else if (zkUA_jsonScan_isKey(key, keyLength,
+                        "parentReferenceNodeId")) {
+                    zkUA_jsonScan_UA_NodeId(s, &info->parentReferenceNodeId);
+                    hasNodeIds |= 4;
+                } else {
+                    zkUA_jsonScan_skip(s);
+                }
+            }
+            if (!attr && s->status == UA_STATUSCODE_GOOD)
+                break; /* no need to scan the attributes */
+        } else if (zkUA_jsonScan_isKey(key, keyLength, "Attributes") && attr) {
+            /* the node class has to be known, as the encoders write it first */
+            if (!hasNodeClass) {
+                zkUA_jsonScan_fail(s, UA_STATUSCODE_BADNOTSUPPORTED);
+                break;
+            }
+            zkUA_jsonScan_attributes(s, info->nodeClass, attr);
+            hasAttributes = true;
+        } else {
+            zkUA_jsonScan_skip(s);
+        }
+    }
+    if (s->status == UA_STATUSCODE_GOOD
+            && (!hasNodeClass || hasNodeIds != 7 || (attr && !hasAttributes)))
+        s->status = UA_STATUSCODE_BADNOTSUPPORTED;
+    return s->status;
+}
@@ -0,0 +1,730 @@
+/*******************************************************************************
+ * Copyright (C) 2018 Ahmed Ismail <aismail [at] protonmail.com>
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <jansson.h>
+#include <zk_jsonStream.h>
+#include <zk_jsonEncode.h>
+#include <zk_urlEncode.h>
+
+/* Streaming JSON writer. Every function mirrors its zkUA_jsonEncode_* counterpart
+ member by member so the output matches the one of the JSON tree as dumped by
+ jansson: members in insertion order, values jansson refuses (invalid UTF-8
+ strings, non-finite reals) left out. Rarely replicated values (ExtensionObject,
+ DataValue) are still encoded as a JSON tree and dumped into the stream. */
+
+#define ZKUA_JSONSTREAM_INITIAL_CAPACITY 4096
+/* zkUA_jsonEncode_UA_String truncates strings to its scratch buffer */
+#define ZKUA_JSONSTREAM_MAX_STRING 65534
+
+typedef struct zkUA_jsonWriter {
+    char *data;
+    size_t length;
+    size_t capacity;
+    UA_Boolean failed;
+} zkUA_jsonWriter;
+
+/* The buffer of each thread, kept between calls */
+static __thread zkUA_jsonWriter threadWriter;
+
+static UA_Boolean zkUA_jsonWriter_reserve(zkUA_jsonWriter *w, size_t n) {
+    if (w->length + n <= w->capacity)
+        return true;
+    size_t capacity = w->capacity ? w->capacity : ZKUA_JSONSTREAM_INITIAL_CAPACITY;
+    while (capacity < w->length + n)
+        capacity *= 2;
+    char *data = realloc(w->data, capacity);
+    if (!data) {
+        w->failed = true;
+        return false;
+    }
+    w->data = data;
+    w->capacity = capacity;
+    return true;
+}
+
+static void zkUA_jsonWriter_raw(zkUA_jsonWriter *w, const char *s, size_t n) {
+    if (!zkUA_jsonWriter_reserve(w, n))
+        return;
+    memcpy(w->data + w->length, s, n);
+    w->length += n;
+}
+
+static void zkUA_jsonWriter_char(zkUA_jsonWriter *w, char c) {
+    if (!zkUA_jsonWriter_reserve(w, 1))
+        return;
+    w->data[w->length++] = c;
+}
+
+/* Starts a member of the current object; *members counts the members written so far */
+static void zkUA_jsonWriter_key(zkUA_jsonWriter *w, int *members,
+        const char *key) {
+    if ((*members)++ > 0)
+        zkUA_jsonWriter_char(w, ',');
+    zkUA_jsonWriter_char(w, '"');
+    zkUA_jsonWriter_raw(w, key, strlen(key));
+    zkUA_jsonWriter_raw(w, "\":", 2);
+}
+
+/* Drops a member whose value jansson would not have accepted */
+static void zkUA_jsonWriter_rollback(zkUA_jsonWriter *w, int *members,
+        size_t length) {
+    w->length = length;
+    (*members)--;
+}
+
+static void zkUA_jsonWriter_integer(zkUA_jsonWriter *w, json_int_t value) {
+    char buffer[32];
+    int n = snprintf(buffer, sizeof(buffer), "%" JSON_INTEGER_FORMAT, value);
+    zkUA_jsonWriter_raw(w, buffer, (size_t) n);
+}
+
+static void zkUA_jsonWriter_boolean(zkUA_jsonWriter *w, int value) {
+    if (value)
+        zkUA_jsonWriter_raw(w, "true", 4);
+    else
+        zkUA_jsonWriter_raw(w, "false", 5);
+}
+
+/* Same format as jansson's jsonp_dtostr with the default precision */
+static UA_Boolean zkUA_jsonWriter_real(zkUA_jsonWriter *w, double value) {
+    if (!isfinite(value))
+        return false;
+    char buffer[64];
+    int n = snprintf(buffer, sizeof(buffer), "%.17g", value);
+    if (!strchr(buffer, '.') && !strchr(buffer, 'e')) {
+        memcpy(buffer + n, ".0", 3);
+        n += 2;
+    }
+    /* no '+' and no leading zeros in the exponent */
+    char *start = strchr(buffer, 'e');
+    if (start) {
+        start++;
+        char *end = start + 1;
+        if (*start == '-')
+            start++;
+        while (*end == '0')
+            end++;
+        if (end != start) {
+            memmove(start, end, (size_t) (buffer + n - end) + 1);
+            n -= (int) (end - start);
+        }
+    }
+    zkUA_jsonWriter_raw(w, buffer, (size_t) n);
+    return true;
+}
+
+/* Length of the UTF-8 sequence starting at s (at most length bytes), 0 if invalid.
+ Follows jansson's utf8_check_first/utf8_check_full. */
+static size_t zkUA_jsonWriter_utf8Length(const unsigned char *s, size_t length,
+        int *codepoint) {
+    unsigned char u = s[0];
+    size_t size;
+    int value;
+    if (u < 0x80) {
+        *codepoint = u;
+        return 1;
+    } else if (u >= 0xC2 && u <= 0xDF) {
+        size = 2;
+        value = u & 0x1F;
+    } else if (u >= 0xE0 && u <= 0xEF) {
+        size = 3;
+        value = u & 0xF;
+    } else if (u >= 0xF0 && u <= 0xF4) {
+        size = 4;
+        value = u & 0x7;
+    } else
+        return 0;
+    if (size > length)
+        return 0;
+    for (size_t i = 1; i < size; i++) {
+        if (s[i] < 0x80 || s[i] > 0xBF)
+            return 0;
+        value = (value << 6) + (s[i] & 0x3F);
+    }
+    if (value > 0x10FFFF || (value >= 0xD800 && value <= 0xDFFF)
+            || (size == 3 && value < 0x800) || (size == 4 && value < 0x10000))
+        return 0;
+    *codepoint = value;
+    return size;
+}
+
+/* Writes a string value escaped like jansson's dump_string. Returns false (after
+ writing a partial string) if it is not valid UTF-8. */
+static UA_Boolean zkUA_jsonWriter_string(zkUA_jsonWriter *w, const char *s,
+        size_t length) {
+    const unsigned char *pos = (const unsigned char *) s;
+    const unsigned char *end = pos + length;
+    zkUA_jsonWriter_char(w, '"');
+    while (pos < end) {
+        const unsigned char *run = pos;
+        int codepoint = 0;
+        size_t size = 0;
+        /* copy everything that needs no escaping in one go */
+        while (pos < end) {
+            size = zkUA_jsonWriter_utf8Length(pos, (size_t) (end - pos),
+                    &codepoint);
+            if (size == 0)
+                return false;
+            if (codepoint == '\\' || codepoint == '"' || codepoint < 0x20)
+                break;
+            pos += size;
+        }
+        zkUA_jsonWriter_raw(w, (const char *) run, (size_t) (pos - run));
+        if (pos == end)
+            break;
+        switch (codepoint) {
+        case '\\':
+            zkUA_jsonWriter_raw(w, "\\\\", 2);
+            break;
+        case '"':
+            zkUA_jsonWriter_raw(w, "\\\"", 2);
+            break;
+        case '\b':
+            zkUA_jsonWriter_raw(w, "\\b", 2);
+            break;
+        case '\f':
+            zkUA_jsonWriter_raw(w, "\\f", 2);
+            break;
+        case '\n':
+            zkUA_jsonWriter_raw(w, "\\n", 2);
+            break;
+        case '\r':
+            zkUA_jsonWriter_raw(w, "\\r", 2);
+            break;
+        case '\t':
+            zkUA_jsonWriter_raw(w, "\\t", 2);
+            break;
+        default: {
+            char seq[8];
+            snprintf(seq, sizeof(seq), "\\u%04X", codepoint);
+            zkUA_jsonWriter_raw(w, seq, 6);
+            break;
+        }
+        }
+        pos += size;
+    }
+    zkUA_jsonWriter_char(w, '"');
+    return true;
+}
+
+/* A UA_String as zkUA_jsonEncode_UA_String prints it: up to the first NUL and
+ truncated to the scratch buffer */
+static UA_Boolean zkUA_jsonWriter_uaString(zkUA_jsonWriter *w,
+        const UA_String *uaString) {
+    size_t length = 0;
+    if (uaString->length > 0 && uaString->data) {
+        length = uaString->length;
+        if (length > ZKUA_JSONSTREAM_MAX_STRING)
+            length = ZKUA_JSONSTREAM_MAX_STRING;
+        const void *nul = memchr(uaString->data, '\0', length);
+        if (nul)
+            length = (size_t) ((const UA_Byte *) nul - uaString->data);
+    }
+    return zkUA_jsonWriter_string(w, (const char *) uaString->data, length);
+}
+
+/* A UA_ByteString as zkUA_jsonEncode_UA_ByteString encodes it */
+static UA_Boolean zkUA_jsonWriter_uaByteString(zkUA_jsonWriter *w,
+        const UA_ByteString *byteString) {
+    if (!zkUA_jsonEncode_getBase64ByteStrings())
+        return zkUA_jsonWriter_uaString(w, byteString);
+    char *base64 = zkUA_base64_encode(byteString->data, byteString->length);
+    if (!base64)
+        return false;
+    zkUA_jsonWriter_raw(w, "{\"base64\":", 10);
+    zkUA_jsonWriter_string(w, base64, strlen(base64));
+    zkUA_jsonWriter_char(w, '}');
+    free(base64);
+    return true;
+}
+
+/* Members whose value may be left out */
+static void zkUA_jsonWriter_memberUaString(zkUA_jsonWriter *w, int *members,
+        const char *key, const UA_String *value) {
+    size_t length = w->length;
+    zkUA_jsonWriter_key(w, members, key);
+    if (!zkUA_jsonWriter_uaString(w, value))
+        zkUA_jsonWriter_rollback(w, members, length);
+}
+
+static void zkUA_jsonWriter_memberUaByteString(zkUA_jsonWriter *w,
+        int *members, const char *key, const UA_ByteString *value) {
+    size_t length = w->length;
+    zkUA_jsonWriter_key(w, members, key);
+    if (!zkUA_jsonWriter_uaByteString(w, value))
+        zkUA_jsonWriter_rollback(w, members, length);
+}
+
+static void zkUA_jsonWriter_memberReal(zkUA_jsonWriter *w, int *members,
+        const char *key, double value) {
+    size_t length = w->length;
+    zkUA_jsonWriter_key(w, members, key);
+    if (!zkUA_jsonWriter_real(w, value))
+        zkUA_jsonWriter_rollback(w, members, length);
+}
+
+static void zkUA_jsonWriter_memberInteger(zkUA_jsonWriter *w, int *members,
+        const char *key, json_int_t value) {
+    zkUA_jsonWriter_key(w, members, key);
+    zkUA_jsonWriter_integer(w, value);
+}
+
+static void zkUA_jsonWriter_memberBoolean(zkUA_jsonWriter *w, int *members,
+        const char *key, int value) {
+    zkUA_jsonWriter_key(w, members, key);
+    zkUA_jsonWriter_boolean(w, value);
+}
+
+/* Dumps a JSON tree into the stream, the tree is decref'd */
+static void zkUA_jsonWriter_tree(zkUA_jsonWriter *w, json_t *tree) {
+    char *s = json_dumps(tree, JSON_COMPACT | JSON_PRESERVE_ORDER);
+    json_decref(tree);
+    if (!s) {
+        w->failed = true;
+        return;
+    }
+    zkUA_jsonWriter_raw(w, s, strlen(s));
+    free(s);
+}
+
+/***** Mirrors of the zkUA_jsonEncode_* functions *****/
+static void zkUA_jsonStream_UA_Guid(zkUA_jsonWriter *w, const UA_Guid *guid) {
+    int members = 0;
+    zkUA_jsonWriter_char(w, '{');
+    zkUA_jsonWriter_memberInteger(w, &members, "data1", guid->data1);
+    zkUA_jsonWriter_memberInteger(w, &members, "data2", guid->data2);
+    zkUA_jsonWriter_memberInteger(w, &members, "data3", guid->data3);
+    zkUA_jsonWriter_key(w, &members, "data4");
+    zkUA_jsonWriter_char(w, '[');
+    for (int i = 0; i < 8; i++) {
+        if (i > 0)
+            zkUA_jsonWriter_char(w, ',');
+        zkUA_jsonWriter_integer(w, guid->data4[i]);
+    }
+    zkUA_jsonWriter_char(w, ']');
+    char guidString[64];
+    int n = snprintf(guidString, sizeof(guidString), UA_PRINTF_GUID_FORMAT,
+            UA_PRINTF_GUID_DATA(*guid));
+    zkUA_jsonWriter_key(w, &members, "guidString");
+    zkUA_jsonWriter_string(w, guidString, (size_t) n);
+    zkUA_jsonWriter_char(w, '}');
+}
+
+static void zkUA_jsonStream_UA_NodeId(zkUA_jsonWriter *w,
+        const UA_NodeId *nodeId) {
+    int members = 0;
+    zkUA_jsonWriter_char(w, '{');
+    zkUA_jsonWriter_memberInteger(w, &members, "namespaceIndex",
+            nodeId->namespaceIndex);
+    zkUA_jsonWriter_memberInteger(w, &members, "identifierType",
+            nodeId->identifierType);
+    switch (nodeId->identifierType) {
+    case UA_NODEIDTYPE_NUMERIC:
+        zkUA_jsonWriter_memberInteger(w, &members, "identifier",
+                nodeId->identifier.numeric);
+        zkUA_jsonWriter_key(w, &members, "identifierTypeString");
+        zkUA_jsonWriter_raw(w, "\"UA_NODEIDTYPE_NUMERIC\"", 23);
+        break;
+    case UA_NODEIDTYPE_STRING:
+        zkUA_jsonWriter_memberUaString(w, &members, "identifier",
+                &nodeId->identifier.string);
+        zkUA_jsonWriter_key(w, &members, "identifierTypeString");
+        zkUA_jsonWriter_raw(w, "\"UA_NODEIDTYPE_STRING\"", 22);
+        break;
+    case UA_NODEIDTYPE_GUID:
+        zkUA_jsonWriter_key(w, &members, "identifier");
+        zkUA_jsonStream_UA_Guid(w, &nodeId->identifier.guid);
+        zkUA_jsonWriter_key(w, &members, "identifierTypeString");
+        zkUA_jsonWriter_raw(w, "\"UA_NODEIDTYPE_GUID\"", 20);
+        break;
+    case UA_NODEIDTYPE_BYTESTRING:
+        zkUA_jsonWriter_memberUaByteString(w, &members, "identifier",
+                &nodeId->identifier.byteString);
+        zkUA_jsonWriter_key(w, &members, "identifierTypeString");
+        zkUA_jsonWriter_raw(w, "\"UA_NODEIDTYPE_BYTESTRING\"", 26);
+        break;
+    default:
+        break;
+    }
+    zkUA_jsonWriter_char(w, '}');
+}
+
+static void zkUA_jsonStream_UA_ExpandedNodeId(zkUA_jsonWriter *w,
+        const UA_ExpandedNodeId *expId) {
+    int members = 0;
+    zkUA_jsonWriter_char(w, '{');
+    zkUA_jsonWriter_key(w, &members, "nodeId");
+    zkUA_jsonStream_UA_NodeId(w, &expId->nodeId);
+    zkUA_jsonWriter_memberUaString(w, &members, "namespaceUri",
+            &expId->namespaceUri);
+    zkUA_jsonWriter_memberInteger(w, &members, "serverIndex",
+            expId->serverIndex);
+    zkUA_jsonWriter_char(w, '}');
+}
+
+static void zkUA_jsonStream_UA_QualifiedName(zkUA_jsonWriter *w,
+        const UA_QualifiedName *qualName) {
+    int members = 0;
+    zkUA_jsonWriter_char(w, '{');
+    zkUA_jsonWriter_memberInteger(w, &members, "namespaceIndex",
+            qualName->namespaceIndex);
+    zkUA_jsonWriter_memberUaString(w, &members, "name", &qualName->name);
+    zkUA_jsonWriter_char(w, '}');
+}
+
+static void zkUA_jsonStream_lengthAndData(zkUA_jsonWriter *w,
+        const UA_String *uaString) {
+    int members = 0;
+    zkUA_jsonWriter_char(w, '{');
+    zkUA_jsonWriter_memberInteger(w, &members, "length",
+            (json_int_t) uaString->length);
+    zkUA_jsonWriter_memberUaString(w, &members, "data", uaString);
+    zkUA_jsonWriter_char(w, '}');
+}
+
+static void zkUA_jsonStream_UA_LocalizedText(zkUA_jsonWriter *w,
+        const UA_LocalizedText *lText) {
+    int members = 0;
+    zkUA_jsonWriter_char(w, '{');
+    zkUA_jsonWriter_key(w, &members, "locale");
+    zkUA_jsonStream_lengthAndData(w, &lText->locale);
+    zkUA_jsonWriter_key(w, &members, "text");
+    zkUA_jsonStream_lengthAndData(w, &lText->text);
+    zkUA_jsonWriter_char(w, '}');
+}
+
+/* Writes a Variant value, returns false if jansson would have left it out */
+static UA_Boolean zkUA_jsonStream_value(zkUA_jsonWriter *w,
+        const UA_DataType *type, const void *value) {
+    switch (zkUA_jsonEncode_dataType(type)) {
+    case UA_TYPES_BOOLEAN:
+        zkUA_jsonWriter_boolean(w, *(const UA_Boolean *) value == UA_TRUE);
+        return true;
+    case UA_TYPES_SBYTE:
+        zkUA_jsonWriter_integer(w, *(const UA_SByte *) value);
+        return true;
+    case UA_TYPES_BYTE:
+        zkUA_jsonWriter_integer(w, *(const UA_Byte *) value);
+        return true;
+    case UA_TYPES_INT16:
+        zkUA_jsonWriter_integer(w, *(const UA_Int16 *) value);
+        return true;
+    case UA_TYPES_UINT16:
+        zkUA_jsonWriter_integer(w, *(const UA_UInt16 *) value);
+        return true;
+    case UA_TYPES_INT32:
+        zkUA_jsonWriter_integer(w, *(const UA_Int32 *) value);
+        return true;
+    case UA_TYPES_UINT32:
+        zkUA_jsonWriter_integer(w, *(const UA_UInt32 *) value);
+        return true;
+    case UA_TYPES_INT64:
+        zkUA_jsonWriter_integer(w, *(const UA_Int64 *) value);
+        return true;
+    case UA_TYPES_UINT64:
+        zkUA_jsonWriter_integer(w, (json_int_t) *(const UA_UInt64 *) value);
+        return true;
+    case UA_TYPES_FLOAT:
+        return zkUA_jsonWriter_real(w, *(const UA_Float *) value);
+    case UA_TYPES_DOUBLE:
+        return zkUA_jsonWriter_real(w, *(const UA_Double *) value);
+    case UA_TYPES_DATETIME:
+        zkUA_jsonWriter_integer(w, *(const UA_DateTime *) value);
+        return true;
+    case UA_TYPES_STATUSCODE:
+        zkUA_jsonWriter_integer(w, *(const UA_StatusCode *) value);
+        return true;
+    case UA_TYPES_STRING:
+    case UA_TYPES_XMLELEMENT:
+        return zkUA_jsonWriter_uaString(w, (const UA_String *) value);
+    case UA_TYPES_BYTESTRING:
+        return zkUA_jsonWriter_uaByteString(w, (const UA_ByteString *) value);
+    case UA_TYPES_GUID:
+        zkUA_jsonStream_UA_Guid(w, (const UA_Guid *) value);
+        return true;
+    case UA_TYPES_NODEID:
+        zkUA_jsonStream_UA_NodeId(w, (const UA_NodeId *) value);
+        return true;
+    case UA_TYPES_EXPANDEDNODEID:
+        zkUA_jsonStream_UA_ExpandedNodeId(w, (const UA_ExpandedNodeId *) value);
+        return true;
+    case UA_TYPES_QUALIFIEDNAME:
+        zkUA_jsonStream_UA_QualifiedName(w, (const UA_QualifiedName *) value);
+        return true;
+    case UA_TYPES_LOCALIZEDTEXT:
+        zkUA_jsonStream_UA_LocalizedText(w, (const UA_LocalizedText *) value);
+        return true;
+    case UA_TYPES_EXTENSIONOBJECT: {
+        json_t *tree = json_object();
+        zkUA_jsonEncode_UA_ExtensionObject((UA_ExtensionObject *) value, tree);
+        zkUA_jsonWriter_tree(w, tree);
+        return true;
+    }
+    case UA_TYPES_DATAVALUE: {
+        json_t *tree = json_object();
+        zkUA_jsonEncode_UA_DataValue((UA_DataValue *) value, tree);
+        zkUA_jsonWriter_tree(w, tree);
+        return true;
+    }
+    default:
+        zkUA_jsonWriter_raw(w, "\"UNKNOWN_OR_UNSUPPORTED\"", 24);
+        return true;
+    }
+}
+
+static void zkUA_jsonStream_UA_Variant(zkUA_jsonWriter *w,
+        const UA_Variant *variant) {
+
+    const UA_DataType *type = variant->type;
+    int dataType = zkUA_jsonEncode_dataType(type);
+    UA_Boolean native = zkUA_jsonEncode_getNativeArrays();
+    UA_Boolean scalar = UA_Variant_isScalar(variant);
+    if (!scalar && !native && (variant->arrayLength == 0 || dataType == 999)) {
+        /* the tree keeps the DataType object as "type" here, write that one */
+        json_t *tree = json_object();
+        zkUA_jsonEncode_UA_Variant((UA_Variant *) variant, tree);
+        zkUA_jsonWriter_tree(w, tree);
+        return;
+    }
+    UA_Boolean packed = !scalar && native && type->overlayable
+            && type == &UA_TYPES[type->typeIndex];
+    if (packed || (native && !scalar && variant->arrayLength == 0))
+        dataType = type->typeIndex;
+
+    int members = 0;
+    zkUA_jsonWriter_char(w, '{');
+    zkUA_jsonWriter_key(w, &members, "storageType");
+    if (variant->storageType == UA_VARIANT_DATA)
+        zkUA_jsonWriter_raw(w, "\"UA_VARIANT_DATA\"", 17);
+    else
+        zkUA_jsonWriter_raw(w, "\"UA_VARIANT_DATA_NODELETE\"", 26);
+    zkUA_jsonWriter_memberInteger(w, &members, "arrayLength",
+            (json_int_t) variant->arrayLength);
+    /* the DataType object first set as "type" is replaced by the type index */
+    zkUA_jsonWriter_memberInteger(w, &members, "type", dataType);
+
+    if (scalar) {
+        size_t length = w->length;
+        zkUA_jsonWriter_key(w, &members, "data");
+        if (!zkUA_jsonStream_value(w, type, variant->data))
+            zkUA_jsonWriter_rollback(w, &members, length);
+        zkUA_jsonWriter_char(w, '}');
+        return;
+    }
+
+    zkUA_jsonWriter_memberInteger(w, &members, "arrayDimensionsSize",
+            (json_int_t) variant->arrayDimensionsSize);
+    if (native) {
+        if (variant->arrayDimensionsSize > 0) {
+            zkUA_jsonWriter_key(w, &members, "arrayDimensions");
+            zkUA_jsonWriter_char(w, '[');
+            for (size_t i = 0; i < variant->arrayDimensionsSize; i++) {
+                if (i > 0)
+                    zkUA_jsonWriter_char(w, ',');
+                zkUA_jsonWriter_integer(w, variant->arrayDimensions[i]);
+            }
+            zkUA_jsonWriter_char(w, ']');
+        }
+        zkUA_jsonWriter_key(w, &members, "dataEncoding");
+        if (packed) {
+            zkUA_jsonWriter_raw(w, "\"base64\"", 8);
+            zkUA_jsonWriter_key(w, &members, "data");
+            char *base64 = zkUA_base64_encode(
+                    (const unsigned char *) variant->data,
+                    variant->arrayLength * type->memSize);
+            if (base64)
+                zkUA_jsonWriter_string(w, base64, strlen(base64));
+            else
+                w->failed = true;
+            free(base64);
+        } else {
+            zkUA_jsonWriter_raw(w, "\"array\"", 7);
+            zkUA_jsonWriter_key(w, &members, "data");
+            zkUA_jsonWriter_char(w, '[');
+            size_t elements = 0;
+            for (size_t j = 0; j < variant->arrayLength; j++) {
+                size_t length = w->length;
+                if (elements > 0)
+                    zkUA_jsonWriter_char(w, ',');
+                if (zkUA_jsonStream_value(w, type,
+                        (const char *) variant->data + j * type->memSize))
+                    elements++;
+                else
+                    w->length = length;
+            }
+            zkUA_jsonWriter_char(w, ']');
+        }
+    } else {
+        char key[64];
+        if (variant->arrayDimensionsSize == 0) {
+            UA_UInt32 aD = (UA_UInt32) (uintptr_t) variant->arrayDimensions;
+            zkUA_jsonWriter_memberInteger(w, &members, "arrayDimensions", aD);
+        } else {
+            for (size_t i = 0; i < variant->arrayDimensionsSize; i++) {
+                snprintf(key, sizeof(key), "arrayDimensions[%lu]", i);
+                zkUA_jsonWriter_memberInteger(w, &members, key,
+                        variant->arrayDimensions[i]);
+            }
+        }
+        for (size_t j = 0; j < variant->arrayLength; j++) {
+            size_t length = w->length;
+            snprintf(key, sizeof(key), "data[%i]", (int) j);
+            zkUA_jsonWriter_key(w, &members, key);
+            if (!zkUA_jsonStream_value(w, type,
+                    (const char *) variant->data + j * type->memSize))
+                zkUA_jsonWriter_rollback(w, &members, length);
+        }
+    }
+    zkUA_jsonWriter_char(w, '}');
+}
+
+static void zkUA_jsonStream_attributes(zkUA_jsonWriter *w, int nodeClassInt,
+        void *nodeAttributes) {
+
+    UA_NodeClass nodeClass = (UA_NodeClass) nodeClassInt;
+    int members = 0;
+    zkUA_jsonWriter_char(w, '{');
+    if (nodeClass == UA_NODECLASS_UNSPECIFIED) {
+        zkUA_jsonWriter_char(w, '}');
+        return;
+    }
+    UA_ObjectAttributes *attributes = (UA_ObjectAttributes *) nodeAttributes;
+    zkUA_jsonWriter_key(w, &members, "displayName");
+    zkUA_jsonStream_UA_LocalizedText(w, &attributes->displayName);
+    zkUA_jsonWriter_key(w, &members, "description");
+    zkUA_jsonStream_UA_LocalizedText(w, &attributes->description);
+    zkUA_jsonWriter_memberInteger(w, &members, "writeMask",
+            attributes->writeMask);
+    /* only the object and view classes have the eventNotifier attribute */
+    if (nodeClass == UA_NODECLASS_OBJECT)
+        zkUA_jsonWriter_memberInteger(w, &members, "eventNotifier",
+                attributes->eventNotifier);
+
+    switch (nodeClass) {
+    case UA_NODECLASS_VIEW: {
+        UA_ViewAttributes *viewAttributes = (UA_ViewAttributes *) nodeAttributes;
+        zkUA_jsonWriter_memberInteger(w, &members, "eventNotifier",
+                viewAttributes->eventNotifier);
+        zkUA_jsonWriter_memberBoolean(w, &members, "containsNoLoops",
+                viewAttributes->containsNoLoops);
+        break;
+    }
+    case UA_NODECLASS_VARIABLE:
+    case UA_NODECLASS_VARIABLETYPE: {
+        UA_VariableAttributes *varAttributes =
+                (UA_VariableAttributes *) nodeAttributes;
+        zkUA_jsonWriter_key(w, &members, "value");
+        if (UA_Variant_isEmpty(&varAttributes->value))
+            zkUA_jsonWriter_raw(w, "\"empty\"", 7);
+        else
+            zkUA_jsonStream_UA_Variant(w, &varAttributes->value);
+        zkUA_jsonWriter_key(w, &members, "dataType");
+        zkUA_jsonStream_UA_NodeId(w, &varAttributes->dataType);
+        zkUA_jsonWriter_memberInteger(w, &members, "valueRank",
+                varAttributes->valueRank);
+        zkUA_jsonWriter_memberInteger(w, &members, "arrayDimensionsSize",
+                (json_int_t) varAttributes->arrayDimensionsSize);
+        if (nodeClass == UA_NODECLASS_VARIABLE) {
+            zkUA_jsonWriter_memberInteger(w, &members, "accessLevel",
+                    varAttributes->accessLevel);
+            zkUA_jsonWriter_memberInteger(w, &members, "userAccessLevel",
+                    varAttributes->userAccessLevel);
+            zkUA_jsonWriter_memberReal(w, &members, "minimumSamplingInterval",
+                    varAttributes->minimumSamplingInterval);
+            zkUA_jsonWriter_memberBoolean(w, &members, "historizing",
+                    varAttributes->historizing);
+        } else {
+            UA_VariableTypeAttributes *varTAttributes =
+                    (UA_VariableTypeAttributes *) nodeAttributes;
+            zkUA_jsonWriter_memberBoolean(w, &members, "isAbstract",
+                    varTAttributes->isAbstract);
+        }
+        break;
+    }
+    case UA_NODECLASS_REFERENCETYPE: {
+        UA_ReferenceTypeAttributes *refAttributes =
+                (UA_ReferenceTypeAttributes *) nodeAttributes;
+        zkUA_jsonWriter_memberBoolean(w, &members, "isAbstract",
+                refAttributes->isAbstract);
+        zkUA_jsonWriter_memberBoolean(w, &members, "symmetric",
+                refAttributes->symmetric);
+        zkUA_jsonWriter_key(w, &members, "inverseName");
+        zkUA_jsonStream_UA_LocalizedText(w, &refAttributes->inverseName);
+        break;
+    }
+    case UA_NODECLASS_OBJECTTYPE:
+        zkUA_jsonWriter_memberBoolean(w, &members, "isAbstract",
+                ((UA_ObjectTypeAttributes *) nodeAttributes)->isAbstract);
+        break;
+    case UA_NODECLASS_DATATYPE:
+        zkUA_jsonWriter_memberBoolean(w, &members, "isAbstract",
+                ((UA_DataTypeAttributes *) nodeAttributes)->isAbstract);
+        break;
+    case UA_NODECLASS_METHOD:
+        zkUA_jsonWriter_memberBoolean(w, &members, "executable",
+                ((UA_MethodAttributes *) nodeAttributes)->executable);
+        break;
+    default:
+        break;
+    }
+    zkUA_jsonWriter_char(w, '}');
+}
+
+char *zkUA_jsonStream_encodeNode(const char *nodePath, int nodeClass,
+        const UA_NodeId *nodeId, const UA_NodeId *parentNodeId,
+        const UA_NodeId *referenceTypeId, void *attr, size_t headerSize,
+        size_t *length) {
+
+    zkUA_jsonWriter *w = &threadWriter;
+    w->length = 0;
+    w->failed = false;
+    if (!zkUA_jsonWriter_reserve(w, headerSize))
+        return NULL;
+    w->length = headerSize;
+
+    int members = 0, infoMembers = 0;
+    zkUA_jsonWriter_char(w, '{');
+    zkUA_jsonWriter_key(w, &members, "NodeInfo");
+    zkUA_jsonWriter_char(w, '{');
+    zkUA_jsonWriter_key(w, &infoMembers, "NodeId");
+    zkUA_jsonStream_UA_NodeId(w, nodeId);
+    zkUA_jsonWriter_memberInteger(w, &infoMembers, "NodeClass", nodeClass);
+    zkUA_jsonWriter_key(w, &infoMembers, "parentNodeId");
+    zkUA_jsonStream_UA_NodeId(w, parentNodeId);
+    zkUA_jsonWriter_key(w, &infoMembers, "parentReferenceNodeId");
+    zkUA_jsonStream_UA_NodeId(w, referenceTypeId);
+    size_t pathLength = w->length;
+    zkUA_jsonWriter_key(w, &infoMembers, "restPath");
+    if (!zkUA_jsonWriter_string(w, nodePath, strlen(nodePath)))
+        zkUA_jsonWriter_rollback(w, &infoMembers, pathLength);
+    zkUA_jsonWriter_char(w, '}');
+    zkUA_jsonWriter_key(w, &members, "Attributes");
+    zkUA_jsonStream_attributes(w, nodeClass, attr);
+    zkUA_jsonWriter_char(w, '}');
+    /* keep the document NUL-terminated for debugging output */
+    zkUA_jsonWriter_char(w, '\0');
+    if (w->failed) {
+        fprintf(stderr,
+                "zkUA_jsonStream_encodeNode: Could not encode %s\n", nodePath);
+        return NULL;
+    }
+    *length = w->length - 1;
+    return w->data;
+}
@@ -0,0 +1,226 @@
+/*******************************************************************************
+ * Copyright (C) 2018 Ahmed Ismail <aismail [at] protonmail.com>
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <zk_mzxidTable.h>
+#include <zk_znodePath.h>
+
+/* A slot of the table. Values are stored inline so that inserts do not allocate. */
+typedef struct zkUA_mzxidSlot {
+    UA_UInt64 key;
+    long long mzxid;
+    int version;
+    UA_Boolean used;
+} zkUA_mzxidSlot;
+
+static zkUA_mzxidSlot *slots = NULL;
+static size_t capacity = 0; /* power of two */
+static size_t count = 0;
+static pthread_rwlock_t tableLock = PTHREAD_RWLOCK_INITIALIZER;
+
+UA_UInt64 zkUA_mzxidTableKey(UA_UInt16 nsIndex, UA_UInt32 identifier) {
+    return ((UA_UInt64) nsIndex << 32) | (UA_UInt64) identifier;
+}
+
+/* Parses an unsigned decimal number, advancing *str past it */
+static UA_Boolean zkUA_parseDecimal(const char **str, UA_UInt64 max,
+        UA_UInt64 *value) {
+    const char *c = *str;
+    UA_UInt64 v = 0;
+    if (*c < '0' || *c > '9')
+        return false;
+    for (; *c >= '0' && *c <= '9'; c++) {
+        v = v * 10 + (UA_UInt64) (*c - '0');
+        if (v > max)
+            return false;
+    }
+    *str = c;
+    *value = v;
+    return true;
+}
+
+UA_Boolean zkUA_mzxidTableKeyFromPath(const char *nodeZkPath, UA_UInt64 *key) {
+    const char *nodeId = strrchr(nodeZkPath, '/');
+    nodeId = nodeId ? nodeId + 1 : nodeZkPath;
+    UA_UInt64 ns, id;
+    if (strncmp(nodeId, "ns=", 3) != 0)
+        return false;
+    nodeId += 3;
+    if (!zkUA_parseDecimal(&nodeId, UA_UINT16_MAX, &ns))
+        return false;
+    if (nodeId[0] != ';' || nodeId[1] == '\0' || nodeId[2] != '=')
+        return false;
+    if (nodeId[1] == 'i') {
+        nodeId += 3;
+        if (!zkUA_parseDecimal(&nodeId, UA_UINT32_MAX, &id) || *nodeId != '\0')
+            return false;
+        *key = zkUA_mzxidTableKey((UA_UInt16) ns, (UA_UInt32) id);
+        return true;
+    }
+    if (!strchr("sgbh", nodeId[1]))
+        return false;
+    /* other identifier types: hash of the znode name, kept apart from the
+     numeric keys (which never have bit 63 set) */
+    const char *name = strrchr(nodeZkPath, '/');
+    name = name ? name + 1 : nodeZkPath;
+    *key = zkUA_znodeNameHash(name, strlen(name)) | (1ULL << 63);
+    return true;
+}
+
+/* Home slot of a key. The finalizer of splitmix64 spreads the dense identifiers
+ of a namespace over the whole table. */
+static size_t zkUA_mzxidTableHome(UA_UInt64 key, size_t cap) {
+    key ^= key >> 30;
+    key *= 0xbf58476d1ce4e5b9ULL;
+    key ^= key >> 27;
+    key *= 0x94d049bb133111ebULL;
+    key ^= key >> 31;
+    return (size_t) key & (cap - 1);
+}
+
+/* Returns the slot holding key or the empty slot ending its probe sequence */
+static size_t zkUA_mzxidTableProbe(const zkUA_mzxidSlot *table, size_t cap,
+        UA_UInt64 key) {
+    size_t i = zkUA_mzxidTableHome(key, cap);
+    while (table[i].used && table[i].key != key)
+        i = (i + 1) & (cap - 1);
+    return i;
+}
+
+/* Moves all entries to a table with newCapacity slots. Exclusive lock must be held. */
+static UA_StatusCode zkUA_mzxidTableResize(size_t newCapacity) {
+    zkUA_mzxidSlot *newSlots = calloc(newCapacity, sizeof(zkUA_mzxidSlot));
+    if (!newSlots)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    for (size_t i = 0; i < capacity; i++) {
+        if (slots[i].used)
+            newSlots[zkUA_mzxidTableProbe(newSlots, newCapacity, slots[i].key)] =
+                    slots[i];
+    }
+    free(slots);
+    slots = newSlots;
+    capacity = newCapacity;
+    return UA_STATUSCODE_GOOD;
+}
+
+void zkUA_initializeMzxidTable(size_t initialCapacity) {
+    size_t cap = ZKUA_MZXIDTABLE_MIN_CAPACITY;
+    while (cap < initialCapacity)
+        cap <<= 1;
+    pthread_rwlock_wrlock(&tableLock);
+    free(slots);
+    slots = calloc(cap, sizeof(zkUA_mzxidSlot));
+    capacity = cap;
+    count = 0;
+    pthread_rwlock_unlock(&tableLock);
+    if (NULL == slots)
+        exit(-1);
+}
+
+void zkUA_destroyMzxidTable() {
+    pthread_rwlock_wrlock(&tableLock);
+    free(slots);
+    slots = NULL;
+    capacity = 0;
+    count = 0;
+    pthread_rwlock_unlock(&tableLock);
+}
+
+UA_Boolean zkUA_mzxidTableSearch(UA_UInt64 key, long long *mzxid, int *version) {
+    UA_Boolean found = false;
+    pthread_rwlock_rdlock(&tableLock);
+    if (slots) {
+        zkUA_mzxidSlot *slot = &slots[zkUA_mzxidTableProbe(slots, capacity, key)];
+        if (slot->used) {
+            if (mzxid)
+                *mzxid = slot->mzxid;
+            if (version)
+                *version = slot->version;
+            found = true;
+        }
+    }
+    pthread_rwlock_unlock(&tableLock);
+    return found;
+}
+
+UA_StatusCode zkUA_mzxidTableInsert(UA_UInt64 key, long long mzxid, int version) {
+    UA_StatusCode retval = UA_STATUSCODE_GOOD;
+    pthread_rwlock_wrlock(&tableLock);
+    if (!slots) {
+        pthread_rwlock_unlock(&tableLock);
+        return UA_STATUSCODE_BADINTERNALERROR;
+    }
+    size_t i = zkUA_mzxidTableProbe(slots, capacity, key);
+    if (!slots[i].used) {
+        /* keep the load factor below 0.7 so that probe sequences stay short */
+        if ((count + 1) * 10 > capacity * 7) {
+            retval = zkUA_mzxidTableResize(capacity << 1);
+            if (retval != UA_STATUSCODE_GOOD) {
+                pthread_rwlock_unlock(&tableLock);
+                return retval;
+            }
+            i = zkUA_mzxidTableProbe(slots, capacity, key);
+        }
+        slots[i].used = true;
+        slots[i].key = key;
+        count++;
+    }
+    slots[i].mzxid = mzxid;
+    slots[i].version = version;
+    pthread_rwlock_unlock(&tableLock);
+    return retval;
+}
+
+UA_Boolean zkUA_mzxidTableRemove(UA_UInt64 key) {
+    pthread_rwlock_wrlock(&tableLock);
+    if (!slots) {
+        pthread_rwlock_unlock(&tableLock);
+        return false;
+    }
+    size_t mask = capacity - 1;
+    size_t i = zkUA_mzxidTableProbe(slots, capacity, key);
+    if (!slots[i].used) {
+        pthread_rwlock_unlock(&tableLock);
+        return false;
+    }
+    /* Backward shift deletion: move later entries of the cluster into the hole unless
+     their home slot lies cyclically between the hole and their current slot */
+    size_t j = i;
+    for (;;) {
+        j = (j + 1) & mask;
+        if (!slots[j].used)
+            break;
+        size_t home = zkUA_mzxidTableHome(slots[j].key, capacity);
+        if (((j - home) & mask) >= ((j - i) & mask)) {
+            slots[i] = slots[j];
+            i = j;
+        }
+    }
+    slots[i].used = false;
+    count--;
+    pthread_rwlock_unlock(&tableLock);
+    return true;
+}
+
+size_t zkUA_mzxidTableCount() {
+    pthread_rwlock_rdlock(&tableLock);
+    size_t c = count;
+    pthread_rwlock_unlock(&tableLock);
+    return c;
+}
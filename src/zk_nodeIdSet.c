@@ -0,0 +1,109 @@
+/*******************************************************************************
+ * Copyright (C) 2018 Ahmed Ismail <aismail [at] protonmail.com>
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <zk_nodeIdSet.h>
+
+/* Hash of a NodeId. The multiplicative hash of numeric identifiers is finalized
+ so that the low bits used for the home slot depend on all bits. */
+static UA_UInt32 zkUA_NodeIdSet_hash(const UA_NodeId *nodeId) {
+    UA_UInt32 h = UA_NodeId_hash(nodeId);
+    h ^= h >> 16;
+    h *= 0x85ebca6bU;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35U;
+    h ^= h >> 16;
+    return h;
+}
+
+/* Returns the slot holding nodeId or the empty slot ending its probe sequence */
+static size_t zkUA_NodeIdSet_probe(const zkUA_NodeIdSetSlot *slots, size_t cap,
+        const UA_NodeId *nodeId, UA_UInt32 hash) {
+    size_t i = hash & (cap - 1);
+    while (slots[i].used
+            && (slots[i].hash != hash
+                    || !UA_NodeId_equal(&slots[i].nodeId, nodeId)))
+        i = (i + 1) & (cap - 1);
+    return i;
+}
+
+/* Moves all NodeIds to a table with newCapacity slots */
+static UA_StatusCode zkUA_NodeIdSet_resize(zkUA_NodeIdSet *set,
+        size_t newCapacity) {
+    zkUA_NodeIdSetSlot *newSlots = calloc(newCapacity,
+            sizeof(zkUA_NodeIdSetSlot));
+    if (!newSlots)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    for (size_t i = 0; i < set->capacity; i++) {
+        if (set->slots[i].used)
+            newSlots[zkUA_NodeIdSet_probe(newSlots, newCapacity,
+                    &set->slots[i].nodeId, set->slots[i].hash)] = set->slots[i];
+    }
+    free(set->slots);
+    set->slots = newSlots;
+    set->capacity = newCapacity;
+    return UA_STATUSCODE_GOOD;
+}
+
+void zkUA_NodeIdSet_init(zkUA_NodeIdSet *set) {
+    set->slots = NULL;
+    set->capacity = 0;
+    set->count = 0;
+}
+
+void zkUA_NodeIdSet_deleteMembers(zkUA_NodeIdSet *set) {
+    for (size_t i = 0; i < set->capacity; i++) {
+        if (set->slots[i].used)
+            UA_NodeId_deleteMembers(&set->slots[i].nodeId);
+    }
+    free(set->slots);
+    zkUA_NodeIdSet_init(set);
+}
+
+UA_Boolean zkUA_NodeIdSet_contains(const zkUA_NodeIdSet *set,
+        const UA_NodeId *nodeId) {
+    if (set->count == 0)
+        return false;
+    UA_UInt32 hash = zkUA_NodeIdSet_hash(nodeId);
+    return set->slots[zkUA_NodeIdSet_probe(set->slots, set->capacity, nodeId,
+            hash)].used;
+}
+
+UA_Boolean zkUA_NodeIdSet_insert(zkUA_NodeIdSet *set, const UA_NodeId *nodeId) {
+    UA_UInt32 hash = zkUA_NodeIdSet_hash(nodeId);
+    /* keep the load factor below 0.7 so that probe sequences stay short */
+    if ((set->count + 1) * 10 > set->capacity * 7
+            && zkUA_NodeIdSet_resize(set,
+                    set->capacity ?
+                            set->capacity << 1 : ZKUA_NODEIDSET_MIN_CAPACITY)
+                    != UA_STATUSCODE_GOOD) {
+        fprintf(stderr, "zkUA_NodeIdSet_insert: Out of memory\n");
+        return false;
+    }
+    zkUA_NodeIdSetSlot *slot = &set->slots[zkUA_NodeIdSet_probe(set->slots,
+            set->capacity, nodeId, hash)];
+    if (slot->used)
+        return false;
+    if (UA_NodeId_copy(nodeId, &slot->nodeId) != UA_STATUSCODE_GOOD) {
+        fprintf(stderr, "zkUA_NodeIdSet_insert: Out of memory\n");
+        return false;
+    }
+    slot->hash = hash;
+    slot->used = true;
+    set->count++;
+    return true;
+}
@@ -0,0 +1,526 @@
+/*******************************************************************************
+ * Copyright (C) 2018 Ahmed Ismail <aismail [at] protonmail.com>
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <jansson.h>
+#include <lz4.h>
+#include <zk_payload.h>
+#include <zk_jsonEncode.h>
+#include <zk_jsonStream.h>
+#include <zk_jsonScan.h>
+#include <zk_jsonDecode.h>
+#include <zk_intercept.h>
+
+/* Binary encoding functions of the embedded open62541 (declared in its private headers) */
+typedef UA_StatusCode (*UA_exchangeEncodeBuffer)(void *handle,
+        UA_ByteString *buf, size_t offset);
+UA_StatusCode UA_encodeBinary(const void *src, const UA_DataType *type,
+        UA_exchangeEncodeBuffer exchangeCallback, void *exchangeHandle,
+        UA_ByteString *dst, size_t *offset);
+UA_StatusCode UA_decodeBinary(const UA_ByteString *src, size_t *offset,
+        void *dst, const UA_DataType *type);
+size_t UA_calcSizeBinary(void *p, const UA_DataType *type);
+
+static int payloadFormat = ZKUA_PAYLOAD_JSON;
+static int payloadVersion = ZKUA_PAYLOAD_VERSION;
+static int payloadCompression = ZKUA_COMPRESSION_NONE;
+static size_t compressionThreshold = ZKUA_DEFAULT_COMPRESSION_THRESHOLD;
+
+/***** Decoded nodes *****/
+static const UA_DataType *zkUA_payload_attributesType(int nodeClass) {
+    switch (nodeClass) {
+    case UA_NODECLASS_OBJECT:
+        return &UA_TYPES[UA_TYPES_OBJECTATTRIBUTES];
+    case UA_NODECLASS_VARIABLE:
+        return &UA_TYPES[UA_TYPES_VARIABLEATTRIBUTES];
+    case UA_NODECLASS_METHOD:
+        return &UA_TYPES[UA_TYPES_METHODATTRIBUTES];
+    case UA_NODECLASS_OBJECTTYPE:
+        return &UA_TYPES[UA_TYPES_OBJECTTYPEATTRIBUTES];
+    case UA_NODECLASS_VARIABLETYPE:
+        return &UA_TYPES[UA_TYPES_VARIABLETYPEATTRIBUTES];
+    case UA_NODECLASS_REFERENCETYPE:
+        return &UA_TYPES[UA_TYPES_REFERENCETYPEATTRIBUTES];
+    case UA_NODECLASS_DATATYPE:
+        return &UA_TYPES[UA_TYPES_DATATYPEATTRIBUTES];
+    case UA_NODECLASS_VIEW:
+        return &UA_TYPES[UA_TYPES_VIEWATTRIBUTES];
+    default:
+        return NULL;
+    }
+}
+
+/* Adds the namespaces of a replicated NamespaceArray that are unknown locally */
+static void zkUA_payload_addNamespaces(UA_Server *server,
+        const UA_VariableAttributes *attr) {
+    if (attr->value.type != &UA_TYPES[UA_TYPES_STRING])
+        return;
+    const UA_String *namespaces = (const UA_String *) attr->value.data;
+    char *nsString = calloc(65535, sizeof(char));
+    for (size_t i = 2; i < attr->value.arrayLength; i++) {
+        snprintf(nsString, 65535, "%.*s", (int) namespaces[i].length,
+                namespaces[i].data);
+        UA_UInt16 newNsIndex = UA_Server_addNamespace(server, nsString);
+        fprintf(stderr,
+                "zkUA_payload_addNamespaces: Added a new namespace %s Index %d\n",
+                nsString, newNsIndex);
+    }
+    free(nsString);
+}
+
+/* Adds a decoded node to the UA server, replacing a node with the same NodeId */
+static void zkUA_payload_addNode(UA_Server *server, const zkUA_NodeInfo *info,
+        const UA_NodeAttributes *attr, const UA_DataType *attrType) {
+
+    /* Only the NamespaceArray is replicated from NS0, see zkUA_jsonDecode_zkNodeToUa */
+    if (info->nodeId.namespaceIndex == 0) {
+        if (info->nodeClass == UA_NODECLASS_VARIABLE
+                && info->nodeId.identifier.numeric
+                        == UA_NS0ID_SERVER_NAMESPACEARRAY)
+            zkUA_payload_addNamespaces(server,
+                    (const UA_VariableAttributes *) attr);
+        else
+            fprintf(stderr,
+                    "zkUA_payload_addNode: Not replicating NS0 node ns=%d;i=%d\n",
+                    info->nodeId.namespaceIndex, info->nodeId.identifier.numeric);
+    } else if (info->nodeClass == UA_NODECLASS_METHOD) {
+        fprintf(stderr,
+                "zkUA_payload_addNode: Replicating Method nodes currently unsupported\n");
+    } else {
+        /* the browseName is not replicated, use the displayName like the JSON decoder */
+        UA_QualifiedName browseName;
+        browseName.namespaceIndex = info->nodeId.namespaceIndex;
+        browseName.name = attr->displayName.text;
+        UA_StatusCode sCode = __UA_Server_addNode(server, info->nodeClass,
+                info->nodeId, info->parentNodeId, info->parentReferenceNodeId,
+                browseName, UA_NODEID_NULL, attr, attrType, NULL, NULL);
+        if (sCode == UA_STATUSCODE_BADNODEIDEXISTS) {
+            /* Replace the node that exists locally */
+            sCode = zkUA_UA_Server_deleteNode_dontReplicate(server, info->nodeId,
+                    false /* delete references */);
+            if (sCode != UA_STATUSCODE_GOOD)
+                fprintf(stderr,
+                        "zkUA_payload_addNode: Could not delete node ns = %d nId = %d\n",
+                        info->nodeId.namespaceIndex,
+                        info->nodeId.identifier.numeric);
+            sCode = __UA_Server_addNode(server, info->nodeClass, info->nodeId,
+                    info->parentNodeId, info->parentReferenceNodeId, browseName,
+                    UA_NODEID_NULL, attr, attrType, NULL, NULL);
+        }
+        if (sCode == UA_STATUSCODE_GOOD)
+            fprintf(stderr,
+                    "zkUA_payload_addNode: Added node ns = %d nId = %d\n",
+                    info->nodeId.namespaceIndex, info->nodeId.identifier.numeric);
+        else
+            fprintf(stderr,
+                    "zkUA_payload_addNode: Could not add node ns = %d nId = %d - sCode %s\n",
+                    info->nodeId.namespaceIndex, info->nodeId.identifier.numeric,
+                    UA_StatusCode_name(sCode));
+    }
+}
+
+/***** JSON codec *****/
+static char *zkUA_jsonCodec_encode(char *nodePath, int nodeClass,
+        const UA_NodeId *nodeId, const UA_NodeId *parentNodeId,
+        const UA_NodeId *referenceTypeId, void *attr, size_t headerSize,
+        size_t *length) {
+
+    /* Stream the compact document into the thread's buffer. The payload is handed
+     over to the (asynchronous) replication, so it is the only allocation. */
+    size_t streamLength;
+    char *s = zkUA_jsonStream_encodeNode(nodePath, nodeClass, nodeId,
+            parentNodeId, referenceTypeId, attr, headerSize, &streamLength);
+    if (s == NULL)
+        return NULL;
+    char *payload = malloc(streamLength + 1);
+    if (payload) {
+        memcpy(payload, s, streamLength + 1);
+        *length = streamLength;
+    }
+    return payload;
+}
+
+static void zkUA_jsonCodec_decode(const char *body, size_t length,
+        const struct Stat *stat, UA_Server *server) {
+
+    /* Decode straight into the attributes, documents the single-pass decoder does not
+     handle go through the JSON tree */
+    zkUA_NodeInfo info;
+    zkUA_jsonScanAttributes attr;
+    if (zkUA_jsonScan_decodeNode(body, length, &info, &attr)
+            == UA_STATUSCODE_GOOD)
+        zkUA_payload_addNode(server, &info, &attr.node,
+                zkUA_payload_attributesType(info.nodeClass));
+    else
+        zkUA_jsonDecode_zkNodeToUa(ZOK, body, (int) length, stat, server);
+}
+
+static UA_StatusCode zkUA_jsonCodec_decodeNodeInfo(const char *body,
+        size_t length, zkUA_NodeInfo *info) {
+
+    /* the decoded NodeIds point into the document, so copy them */
+    zkUA_NodeInfo scanned;
+    if (zkUA_jsonScan_decodeNode(body, length, &scanned, NULL)
+            == UA_STATUSCODE_GOOD) {
+        info->nodeClass = scanned.nodeClass;
+        UA_StatusCode sCode = UA_NodeId_copy(&scanned.nodeId, &info->nodeId);
+        sCode |= UA_NodeId_copy(&scanned.parentNodeId, &info->parentNodeId);
+        sCode |= UA_NodeId_copy(&scanned.parentReferenceNodeId,
+                &info->parentReferenceNodeId);
+        return sCode;
+    }
+
+    json_error_t error;
+    json_t *jsonRoot = json_loadb(body, length, JSON_DISABLE_EOF_CHECK, &error);
+    json_t *nodeInfo = json_object_get(jsonRoot, "NodeInfo");
+    if (!json_is_object(nodeInfo)) {
+        json_decref(jsonRoot);
+        return UA_STATUSCODE_BADDECODINGERROR;
+    }
+    /* the decoded string identifiers point into the JSON document, so copy them */
+    UA_NodeId nodeId, parentNodeId, parentReferenceNodeId;
+    UA_StatusCode sCode = zkUA_jsonDecode_UA_NodeId(
+            json_object_get(nodeInfo, "NodeId"), &nodeId);
+    sCode |= zkUA_jsonDecode_UA_NodeId(json_object_get(nodeInfo, "parentNodeId"),
+            &parentNodeId);
+    sCode |= zkUA_jsonDecode_UA_NodeId(
+            json_object_get(nodeInfo, "parentReferenceNodeId"),
+            &parentReferenceNodeId);
+    json_t *nodeClass = json_object_get(nodeInfo, "NodeClass");
+    if (sCode == UA_STATUSCODE_GOOD && json_is_integer(nodeClass)) {
+        info->nodeClass = (UA_NodeClass) json_integer_value(nodeClass);
+        sCode = UA_NodeId_copy(&nodeId, &info->nodeId);
+        sCode |= UA_NodeId_copy(&parentNodeId, &info->parentNodeId);
+        sCode |= UA_NodeId_copy(&parentReferenceNodeId,
+                &info->parentReferenceNodeId);
+    } else
+        sCode = UA_STATUSCODE_BADDECODINGERROR;
+    json_decref(jsonRoot);
+    return sCode;
+}
+
+/***** UA Binary codec *****/
+/* The body is the UA Binary encoding of the zkUA_NodeInfo members (the NodeClass as
+ UInt32) followed by the attributes struct of the node's class */
+static char *zkUA_binaryCodec_encode(char *nodePath, int nodeClass,
+        const UA_NodeId *nodeId, const UA_NodeId *parentNodeId,
+        const UA_NodeId *referenceTypeId, void *attr, size_t headerSize,
+        size_t *length) {
+
+    const UA_DataType *attrType = zkUA_payload_attributesType(nodeClass);
+    if (!attrType) {
+        fprintf(stderr, "zkUA_binaryCodec_encode: Unknown NodeClass %d\n",
+                nodeClass);
+        return NULL;
+    }
+    UA_UInt32 nodeClassUInt = (UA_UInt32) nodeClass;
+    const UA_DataType *nodeIdType = &UA_TYPES[UA_TYPES_NODEID];
+    size_t bodySize = UA_calcSizeBinary((void *) nodeId, nodeIdType)
+            + UA_calcSizeBinary(&nodeClassUInt, &UA_TYPES[UA_TYPES_UINT32])
+            + UA_calcSizeBinary((void *) parentNodeId, nodeIdType)
+            + UA_calcSizeBinary((void *) referenceTypeId, nodeIdType)
+            + UA_calcSizeBinary(attr, attrType);
+
+    UA_ByteString buf;
+    if (UA_ByteString_allocBuffer(&buf, headerSize + bodySize)
+            != UA_STATUSCODE_GOOD)
+        return NULL;
+    size_t offset = headerSize;
+    UA_StatusCode sCode = UA_encodeBinary(nodeId, nodeIdType, NULL, NULL, &buf,
+            &offset);
+    sCode |= UA_encodeBinary(&nodeClassUInt, &UA_TYPES[UA_TYPES_UINT32], NULL,
+            NULL, &buf, &offset);
+    sCode |= UA_encodeBinary(parentNodeId, nodeIdType, NULL, NULL, &buf,
+            &offset);
+    sCode |= UA_encodeBinary(referenceTypeId, nodeIdType, NULL, NULL, &buf,
+            &offset);
+    sCode |= UA_encodeBinary(attr, attrType, NULL, NULL, &buf, &offset);
+    if (sCode != UA_STATUSCODE_GOOD) {
+        fprintf(stderr,
+                "zkUA_binaryCodec_encode: Could not encode ns=%d;i=%d - sCode %s\n",
+                nodeId->namespaceIndex, nodeId->identifier.numeric,
+                UA_StatusCode_name(sCode));
+        UA_ByteString_deleteMembers(&buf);
+        return NULL;
+    }
+    *length = offset;
+    return (char *) buf.data;
+}
+
+static UA_StatusCode zkUA_binaryCodec_decodeInfo(const UA_ByteString *src,
+        size_t *offset, zkUA_NodeInfo *info) {
+    const UA_DataType *nodeIdType = &UA_TYPES[UA_TYPES_NODEID];
+    UA_UInt32 nodeClassUInt = 0;
+    UA_NodeId_init(&info->nodeId);
+    UA_NodeId_init(&info->parentNodeId);
+    UA_NodeId_init(&info->parentReferenceNodeId);
+    UA_StatusCode sCode = UA_decodeBinary(src, offset, &info->nodeId,
+            nodeIdType);
+    sCode |= UA_decodeBinary(src, offset, &nodeClassUInt,
+            &UA_TYPES[UA_TYPES_UINT32]);
+    sCode |= UA_decodeBinary(src, offset, &info->parentNodeId, nodeIdType);
+    sCode |= UA_decodeBinary(src, offset, &info->parentReferenceNodeId,
+            nodeIdType);
+    info->nodeClass = (UA_NodeClass) nodeClassUInt;
+    if (sCode != UA_STATUSCODE_GOOD)
+        zkUA_NodeInfo_deleteMembers(info);
+    return sCode;
+}
+
+static UA_StatusCode zkUA_binaryCodec_decodeNodeInfo(const char *body,
+        size_t length, zkUA_NodeInfo *info) {
+    UA_ByteString src = { length, (UA_Byte *) body };
+    size_t offset = 0;
+    return zkUA_binaryCodec_decodeInfo(&src, &offset, info);
+}
+
+static void zkUA_binaryCodec_decode(const char *body, size_t length,
+        const struct Stat *stat, UA_Server *server) {
+
+    UA_ByteString src = { length, (UA_Byte *) body };
+    size_t offset = 0;
+    zkUA_NodeInfo info;
+    if (zkUA_binaryCodec_decodeInfo(&src, &offset, &info)
+            != UA_STATUSCODE_GOOD) {
+        fprintf(stderr, "zkUA_binaryCodec_decode: Could not decode the NodeInfo\n");
+        return;
+    }
+    const UA_DataType *attrType = zkUA_payload_attributesType(
+            info.nodeClass);
+    void *attr = attrType ? UA_new(attrType) : NULL;
+    if (!attr || UA_decodeBinary(&src, &offset, attr, attrType)
+            != UA_STATUSCODE_GOOD) {
+        fprintf(stderr,
+                "zkUA_binaryCodec_decode: Could not decode the attributes of ns=%d;i=%d\n",
+                info.nodeId.namespaceIndex, info.nodeId.identifier.numeric);
+        if (attr)
+            UA_delete(attr, attrType);
+        zkUA_NodeInfo_deleteMembers(&info);
+        return;
+    }
+
+    zkUA_payload_addNode(server, &info, attr, attrType);
+    UA_delete(attr, attrType);
+    zkUA_NodeInfo_deleteMembers(&info);
+}
+
+/* The codecs, indexed by payload format */
+static const zkUA_PayloadCodec payloadCodecs[ZKUA_PAYLOAD_FORMATS] = {
+        { "json", zkUA_jsonCodec_encode, zkUA_jsonCodec_decode,
+                zkUA_jsonCodec_decodeNodeInfo },
+        { "binary", zkUA_binaryCodec_encode, zkUA_binaryCodec_decode,
+                zkUA_binaryCodec_decodeNodeInfo } };
+
+/***** Compression *****/
+#define ZKUA_LZ4_SIZE_LENGTH 4
+
+/* Compresses the body of an encoded payload. Returns the payload unchanged if
+ compressing does not make it smaller. */
+static char *zkUA_payload_compress(char *payload, size_t *length) {
+    size_t bodyLength = *length - ZKUA_PAYLOAD_HEADER_SIZE;
+    if (bodyLength > (size_t) LZ4_MAX_INPUT_SIZE)
+        return payload;
+    int bound = LZ4_compressBound((int) bodyLength);
+    char *compressed = malloc(
+            ZKUA_PAYLOAD_HEADER_SIZE + ZKUA_LZ4_SIZE_LENGTH + (size_t) bound);
+    if (!compressed)
+        return payload;
+    int compressedLength = LZ4_compress_default(
+            payload + ZKUA_PAYLOAD_HEADER_SIZE,
+            compressed + ZKUA_PAYLOAD_HEADER_SIZE + ZKUA_LZ4_SIZE_LENGTH,
+            (int) bodyLength, bound);
+    if (compressedLength <= 0
+            || (size_t) compressedLength + ZKUA_LZ4_SIZE_LENGTH >= bodyLength) {
+        free(compressed);
+        return payload;
+    }
+    UA_Byte *size = (UA_Byte *) compressed + ZKUA_PAYLOAD_HEADER_SIZE;
+    size[0] = (UA_Byte) (bodyLength >> 24);
+    size[1] = (UA_Byte) (bodyLength >> 16);
+    size[2] = (UA_Byte) (bodyLength >> 8);
+    size[3] = (UA_Byte) bodyLength;
+    compressed[3] = (char) (payload[3] | ZKUA_PAYLOAD_LZ4);
+    memcpy(compressed, payload, 3);
+    *length = ZKUA_PAYLOAD_HEADER_SIZE + ZKUA_LZ4_SIZE_LENGTH
+            + (size_t) compressedLength;
+    free(payload);
+    return compressed;
+}
+
+/* Decompresses an LZ4 body into a malloc'd buffer */
+static char *zkUA_payload_decompress(const char *body, size_t length,
+        size_t *bodyLength) {
+    if (length < ZKUA_LZ4_SIZE_LENGTH)
+        return NULL;
+    const UA_Byte *size = (const UA_Byte *) body;
+    size_t decompressedLength = ((size_t) size[0] << 24)
+            | ((size_t) size[1] << 16) | ((size_t) size[2] << 8) | size[3];
+    if (decompressedLength > (size_t) LZ4_MAX_INPUT_SIZE)
+        return NULL;
+    /* one more byte keeps the body NUL-terminated like the buffers zk returns */
+    char *decompressed = malloc(decompressedLength + 1);
+    if (!decompressed)
+        return NULL;
+    int rc = LZ4_decompress_safe(body + ZKUA_LZ4_SIZE_LENGTH, decompressed,
+            (int) (length - ZKUA_LZ4_SIZE_LENGTH), (int) decompressedLength);
+    if (rc < 0 || (size_t) rc != decompressedLength) {
+        free(decompressed);
+        return NULL;
+    }
+    decompressed[decompressedLength] = '\0';
+    *bodyLength = decompressedLength;
+    return decompressed;
+}
+
+/* Finds the codec of a payload and the start of its body. Compressed bodies are
+ decompressed into *decompressed, which the caller has to free. */
+static const zkUA_PayloadCodec *zkUA_payloadCodec(const char *value,
+        int length, const char **body, size_t *bodyLength,
+        char **decompressed) {
+    *decompressed = NULL;
+    if (!value || length <= 0)
+        return NULL;
+    if (value[0] == '{') { /* written before the payload header existed */
+        *body = value;
+        *bodyLength = (size_t) length;
+        return &payloadCodecs[ZKUA_PAYLOAD_JSON];
+    }
+    UA_Byte format = 0, flags = 0;
+    if (length >= ZKUA_PAYLOAD_HEADER_SIZE) {
+        format = (UA_Byte) value[3] & ZKUA_PAYLOAD_FORMAT_MASK;
+        flags = (UA_Byte) value[3] & ~ZKUA_PAYLOAD_FORMAT_MASK;
+    }
+    if (length < ZKUA_PAYLOAD_HEADER_SIZE || value[0] != ZKUA_PAYLOAD_MAGIC0
+            || value[1] != ZKUA_PAYLOAD_MAGIC1
+            || (UA_Byte) value[2] > ZKUA_PAYLOAD_VERSION
+            || format >= ZKUA_PAYLOAD_FORMATS
+            || (flags & ~(ZKUA_PAYLOAD_LZ4 | ZKUA_PAYLOAD_CHUNKED))) {
+        fprintf(stderr, "zkUA_payloadCodec: Unknown payload header\n");
+        return NULL;
+    }
+    if (flags & ZKUA_PAYLOAD_CHUNKED) {
+        fprintf(stderr,
+                "zkUA_payloadCodec: The chunks of the payload have not been loaded\n");
+        return NULL;
+    }
+    *body = value + ZKUA_PAYLOAD_HEADER_SIZE;
+    *bodyLength = (size_t) length - ZKUA_PAYLOAD_HEADER_SIZE;
+    if (flags & ZKUA_PAYLOAD_LZ4) {
+        *decompressed = zkUA_payload_decompress(*body, *bodyLength, bodyLength);
+        if (!*decompressed) {
+            fprintf(stderr,
+                    "zkUA_payloadCodec: Could not decompress the payload\n");
+            return NULL;
+        }
+        *body = *decompressed;
+    }
+    return &payloadCodecs[format];
+}
+
+void zkUA_initializePayloadFormat(int format) {
+    if (format >= 0 && format < ZKUA_PAYLOAD_FORMATS)
+        payloadFormat = format;
+}
+
+void zkUA_initializePayloadVersion(int version) {
+    if (version < 1 || version > ZKUA_PAYLOAD_VERSION)
+        return;
+    payloadVersion = version;
+    zkUA_jsonEncode_setNativeArrays(version >= 2);
+    zkUA_jsonEncode_setBase64ByteStrings(version >= 3);
+}
+
+void zkUA_initializePayloadCompression(int compression, size_t threshold) {
+    if (compression == ZKUA_COMPRESSION_NONE
+            || compression == ZKUA_COMPRESSION_LZ4)
+        payloadCompression = compression;
+    compressionThreshold = threshold;
+}
+
+int zkUA_payloadFormatFromString(const char *format) {
+    for (int i = 0; i < ZKUA_PAYLOAD_FORMATS; i++) {
+        size_t nameLength = strlen(payloadCodecs[i].name);
+        if (strncmp(format, payloadCodecs[i].name, nameLength) == 0)
+            return i;
+    }
+    return -1;
+}
+
+int zkUA_payloadCompressionFromString(const char *compression) {
+    if (strncmp(compression, "none", strlen("none")) == 0)
+        return ZKUA_COMPRESSION_NONE;
+    if (strncmp(compression, "lz4", strlen("lz4")) == 0)
+        return ZKUA_COMPRESSION_LZ4;
+    return -1;
+}
+
+char *zkUA_encodeNodePayload(char *nodePath, int nodeClass,
+        const UA_NodeId nodeId, const UA_NodeId parentNodeId,
+        const UA_NodeId referenceTypeId, void *attr, int *length) {
+
+    size_t payloadLength = 0;
+    char *payload = payloadCodecs[payloadFormat].encode(nodePath, nodeClass,
+            &nodeId, &parentNodeId, &referenceTypeId, attr,
+            ZKUA_PAYLOAD_HEADER_SIZE, &payloadLength);
+    if (payload == NULL) {
+        fprintf(stderr, "zkUA_encodeNodePayload: Could not encode %s\n",
+                nodePath);
+        return NULL;
+    }
+    payload[0] = ZKUA_PAYLOAD_MAGIC0;
+    payload[1] = ZKUA_PAYLOAD_MAGIC1;
+    payload[2] = (char) payloadVersion;
+    payload[3] = (char) payloadFormat;
+    if (payloadCompression == ZKUA_COMPRESSION_LZ4
+            && payloadLength - ZKUA_PAYLOAD_HEADER_SIZE > compressionThreshold)
+        payload = zkUA_payload_compress(payload, &payloadLength);
+    *length = (int) payloadLength;
+    return payload;
+}
+
+void zkUA_decodeNodePayload(const char *value, int length,
+        const struct Stat *stat, UA_Server *server) {
+    const char *body;
+    size_t bodyLength;
+    char *decompressed;
+    const zkUA_PayloadCodec *codec = zkUA_payloadCodec(value, length, &body,
+            &bodyLength, &decompressed);
+    if (codec)
+        codec->decode(body, bodyLength, stat, server);
+    free(decompressed);
+}
+
+UA_StatusCode zkUA_decodeNodePayloadInfo(const char *value, int length,
+        zkUA_NodeInfo *info) {
+    const char *body;
+    size_t bodyLength;
+    char *decompressed;
+    const zkUA_PayloadCodec *codec = zkUA_payloadCodec(value, length, &body,
+            &bodyLength, &decompressed);
+    if (!codec)
+        return UA_STATUSCODE_BADDECODINGERROR;
+    UA_StatusCode sCode = codec->decodeNodeInfo(body, bodyLength, info);
+    free(decompressed);
+    return sCode;
+}
+
+void zkUA_NodeInfo_deleteMembers(zkUA_NodeInfo *info) {
+    UA_NodeId_deleteMembers(&info->nodeId);
+    UA_NodeId_deleteMembers(&info->parentNodeId);
+    UA_NodeId_deleteMembers(&info->parentReferenceNodeId);
+}
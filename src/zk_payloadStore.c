@@ -0,0 +1,333 @@
+/*******************************************************************************
+ * Copyright (C) 2018 Ahmed Ismail <aismail [at] protonmail.com>
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <zk_payload.h>
+#include <zk_payloadStore.h>
+#include <zk_serverReplicate.h>
+#include <zk_global.h>
+
+/* Manifest body: payload length, number of chunks, generation name */
+#define ZKUA_MANIFEST_SIZE (ZKUA_PAYLOAD_HEADER_SIZE + 8)
+
+static size_t chunkSize = ZKUA_DEFAULT_CHUNK_SIZE;
+
+void zkUA_initializeChunkSize(size_t size) {
+    if (size > 0)
+        chunkSize = size;
+}
+
+static void zkUA_payloadStore_putUInt32(char *dst, size_t value) {
+    UA_Byte *bytes = (UA_Byte *) dst;
+    bytes[0] = (UA_Byte) (value >> 24);
+    bytes[1] = (UA_Byte) (value >> 16);
+    bytes[2] = (UA_Byte) (value >> 8);
+    bytes[3] = (UA_Byte) value;
+}
+
+static size_t zkUA_payloadStore_getUInt32(const char *src) {
+    const UA_Byte *bytes = (const UA_Byte *) src;
+    return ((size_t) bytes[0] << 24) | ((size_t) bytes[1] << 16)
+            | ((size_t) bytes[2] << 8) | bytes[3];
+}
+
+/* Builds the manifest of a payload (malloc'd) */
+static char *zkUA_payloadStore_manifest(const char *payload, size_t length,
+        size_t chunks, const char *generation, int *manifestLength) {
+    size_t generationLength = strlen(generation);
+    char *manifest = malloc(ZKUA_MANIFEST_SIZE + generationLength);
+    if (!manifest)
+        return NULL;
+    memcpy(manifest, payload, ZKUA_PAYLOAD_HEADER_SIZE);
+    manifest[3] = (char) (payload[3] | ZKUA_PAYLOAD_CHUNKED);
+    zkUA_payloadStore_putUInt32(manifest + ZKUA_PAYLOAD_HEADER_SIZE, length);
+    zkUA_payloadStore_putUInt32(manifest + ZKUA_PAYLOAD_HEADER_SIZE + 4,
+            chunks);
+    memcpy(manifest + ZKUA_MANIFEST_SIZE, generation, generationLength);
+    *manifestLength = (int) (ZKUA_MANIFEST_SIZE + generationLength);
+    return manifest;
+}
+
+/* Deletes a generation znode and its chunks */
+static int zkUA_payloadStore_deleteGeneration(const char *generationPath) {
+    struct String_vector chunks;
+    int rc = zoo_get_children(zkHandle, generationPath, 0, &chunks);
+    if (rc == ZNONODE)
+        return ZOK;
+    if (rc != ZOK)
+        return rc;
+    size_t pathLength = strlen(generationPath);
+    for (int i = 0; i < chunks.count && rc == ZOK; i++) {
+        char *chunkPath = malloc(pathLength + strlen(chunks.data[i]) + 2);
+        sprintf(chunkPath, "%s/%s", generationPath, chunks.data[i]);
+        rc = zoo_delete(zkHandle, chunkPath, -1);
+        if (rc == ZNONODE)
+            rc = ZOK;
+        free(chunkPath);
+    }
+    deallocate_String_vector(&chunks);
+    if (rc == ZOK)
+        rc = zoo_delete(zkHandle, generationPath, -1);
+    return (rc == ZNONODE) ? ZOK : rc;
+}
+
+/* Deletes the chunk generations of a node's znode except the newest one if keepNewest,
+ otherwise every child of the node's znode */
+static int zkUA_payloadStore_deleteGenerations(const char *nodePath,
+        UA_Boolean keepNewest) {
+    struct String_vector generations;
+    int rc = zoo_get_children(zkHandle, nodePath, 0, &generations);
+    if (rc == ZNONODE)
+        return ZOK;
+    if (rc != ZOK)
+        return rc;
+    /* sequence numbers are zero-padded, so the newest generation sorts last */
+    const char *newest = NULL;
+    size_t prefixLength = strlen(ZKUA_CHUNK_GENERATION_PREFIX);
+    for (int i = 0; keepNewest && i < generations.count; i++) {
+        if (strncmp(generations.data[i], ZKUA_CHUNK_GENERATION_PREFIX,
+                prefixLength) != 0)
+            continue;
+        if (!newest || strcmp(generations.data[i], newest) > 0)
+            newest = generations.data[i];
+    }
+    size_t pathLength = strlen(nodePath);
+    for (int i = 0; i < generations.count && rc == ZOK; i++) {
+        /* other children of the node's znode are only deleted with the node */
+        if (generations.data[i] == newest
+                || (keepNewest
+                        && strncmp(generations.data[i],
+                                ZKUA_CHUNK_GENERATION_PREFIX, prefixLength)
+                                != 0))
+            continue;
+        char *generationPath = malloc(
+                pathLength + strlen(generations.data[i]) + 2);
+        sprintf(generationPath, "%s/%s", nodePath, generations.data[i]);
+        rc = zkUA_payloadStore_deleteGeneration(generationPath);
+        free(generationPath);
+    }
+    deallocate_String_vector(&generations);
+    return rc;
+}
+
+/* Creates the znode of a new node with a manifest without chunks */
+static int zkUA_payloadStore_createPending(char *nodePath, const char *payload,
+        size_t length) {
+    int pendingLength;
+    char *pending = zkUA_payloadStore_manifest(payload, length, 0, "",
+            &pendingLength);
+    if (!pending)
+        return ZSYSTEMERROR;
+    int rc = zoo_create(zkHandle, nodePath, pending, pendingLength,
+            &ZOO_OPEN_ACL_UNSAFE, 0, NULL, 0);
+    free(pending);
+    if (rc == ZOK) {
+        /* record the version so that the manifest is set on the new znode */
+        struct Stat stat;
+        rc = zoo_exists(zkHandle, nodePath, 0, &stat);
+        if (rc == ZOK)
+            zkUA_insertZnodeStat(nodePath, &stat);
+    } else if (rc == ZNODEEXISTS)
+        rc = ZOK;
+    return rc;
+}
+
+UA_StatusCode zkUA_storeNodePayload(char *nodePath, char **payload,
+        int *length) {
+
+    if (*length < 0 || (size_t) *length <= chunkSize)
+        return UA_STATUSCODE_GOOD;
+    if (!zkHandle)
+        return UA_STATUSCODE_BADUNEXPECTEDERROR;
+    size_t payloadLength = (size_t) *length;
+    size_t chunks = (payloadLength + chunkSize - 1) / chunkSize;
+
+    /* the chunks are children of the node's znode */
+    int rc = zkUA_payloadStore_createPending(nodePath, *payload, payloadLength);
+    if (rc == ZOK)
+        rc = zkUA_payloadStore_deleteGenerations(nodePath, true);
+    /* the generation's sequence number is appended to its path */
+    size_t pathLength = strlen(nodePath);
+    size_t generationPathLength = pathLength
+            + sizeof(ZKUA_CHUNK_GENERATION_PREFIX) + 12;
+    char *generationPath = calloc(generationPathLength, sizeof(char));
+    char *chunkPath = malloc(generationPathLength + 12);
+    if (rc == ZOK) {
+        sprintf(chunkPath, "%s/" ZKUA_CHUNK_GENERATION_PREFIX, nodePath);
+        rc = zoo_create(zkHandle, chunkPath, NULL, -1, &ZOO_OPEN_ACL_UNSAFE,
+                ZOO_SEQUENCE, generationPath, (int) generationPathLength);
+    }
+    for (size_t i = 0; i < chunks && rc == ZOK; i++) {
+        size_t offset = i * chunkSize;
+        size_t size =
+                (payloadLength - offset < chunkSize) ?
+                        payloadLength - offset : chunkSize;
+        sprintf(chunkPath, "%s/%lu", generationPath, i);
+        rc = zoo_create(zkHandle, chunkPath, *payload + offset, (int) size,
+                &ZOO_OPEN_ACL_UNSAFE, 0, NULL, 0);
+        if (rc != ZOK)
+            zkUA_payloadStore_deleteGeneration(generationPath);
+    }
+    free(chunkPath);
+    if (rc != ZOK) {
+        fprintf(stderr,
+                "zkUA_storeNodePayload: Could not write the chunks of %s - rc = %d\n",
+                nodePath, rc);
+        free(generationPath);
+        return UA_STATUSCODE_BADUNEXPECTEDERROR;
+    }
+
+    int manifestLength;
+    char *manifest = zkUA_payloadStore_manifest(*payload, payloadLength,
+            chunks, generationPath + pathLength + 1, &manifestLength);
+    free(generationPath);
+    if (!manifest)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    fprintf(stderr,
+            "zkUA_storeNodePayload: Stored %lu bytes of %s in %lu chunks\n",
+            payloadLength, nodePath, chunks);
+    free(*payload);
+    *payload = manifest;
+    *length = manifestLength;
+    return UA_STATUSCODE_GOOD;
+}
+
+UA_Boolean zkUA_isChunkManifest(const char *value, int length) {
+    return (value && length >= ZKUA_MANIFEST_SIZE
+            && value[0] == ZKUA_PAYLOAD_MAGIC0 && value[1] == ZKUA_PAYLOAD_MAGIC1
+            && ((UA_Byte) value[3] & ZKUA_PAYLOAD_CHUNKED)) ? true : false;
+}
+
+int zkUA_getZnodeData(const char *path, int watch, char **value, int *length,
+        struct Stat *stat) {
+
+    int bufferLength = ZKUA_GET_BUFFER_SIZE;
+    char *buffer = NULL;
+    for (;;) {
+        char *grown = realloc(buffer, (size_t) bufferLength + 1);
+        if (!grown) {
+            free(buffer);
+            return ZSYSTEMERROR;
+        }
+        buffer = grown;
+        int dataLength = bufferLength;
+        int rc = zoo_get(zkHandle, path, watch, buffer, &dataLength, stat);
+        if (rc != ZOK) {
+            free(buffer);
+            return rc;
+        }
+        if (stat->dataLength <= bufferLength) {
+            if (dataLength < 0) /* the znode has no data */
+                dataLength = 0;
+            buffer[dataLength] = '\0';
+            *value = buffer;
+            *length = dataLength;
+            return ZOK;
+        }
+        /* the data was truncated - read it again into a buffer of its size */
+        bufferLength = stat->dataLength;
+    }
+}
+
+int zkUA_loadPayloadChunks(const char *nodePath, const char *manifest,
+        int manifestLength, char **payload, int *length) {
+
+    size_t payloadLength = zkUA_payloadStore_getUInt32(
+            manifest + ZKUA_PAYLOAD_HEADER_SIZE);
+    size_t chunks = zkUA_payloadStore_getUInt32(
+            manifest + ZKUA_PAYLOAD_HEADER_SIZE + 4);
+    int generationLength = manifestLength - ZKUA_MANIFEST_SIZE;
+    if (chunks == 0 || generationLength == 0) /* the chunks are being written */
+        return ZNONODE;
+    char *assembled = malloc(payloadLength + 1);
+    char *chunkPath = malloc(strlen(nodePath) + (size_t) generationLength + 24);
+    if (!assembled || !chunkPath) {
+        free(assembled);
+        free(chunkPath);
+        return ZSYSTEMERROR;
+    }
+    int rc = ZOK;
+    size_t offset = 0;
+    for (size_t i = 0; i < chunks && rc == ZOK; i++) {
+        sprintf(chunkPath, "%s/%.*s/%lu", nodePath, generationLength,
+                manifest + ZKUA_MANIFEST_SIZE, i);
+        char *chunk;
+        int chunkLength;
+        struct Stat stat;
+        rc = zkUA_getZnodeData(chunkPath, 0, &chunk, &chunkLength, &stat);
+        if (rc != ZOK)
+            break;
+        if ((size_t) chunkLength > payloadLength - offset) {
+            rc = ZDATAINCONSISTENCY;
+        } else {
+            memcpy(assembled + offset, chunk, (size_t) chunkLength);
+            offset += (size_t) chunkLength;
+        }
+        free(chunk);
+    }
+    free(chunkPath);
+    if (rc == ZOK && offset != payloadLength)
+        rc = ZDATAINCONSISTENCY;
+    if (rc != ZOK) {
+        free(assembled);
+        return rc;
+    }
+    assembled[payloadLength] = '\0';
+    *payload = assembled;
+    *length = (int) payloadLength;
+    return ZOK;
+}
+
+int zkUA_getNodePayload(const char *nodePath, int watch, char **value,
+        int *length, struct Stat *stat) {
+
+    int rc = ZOK;
+    for (int attempt = 0; attempt < ZKUA_MAX_READ_ATTEMPTS; attempt++) {
+        rc = zkUA_getZnodeData(nodePath, watch, value, length, stat);
+        if (rc != ZOK || !zkUA_isChunkManifest(*value, *length))
+            return rc;
+        char *payload;
+        int payloadLength;
+        rc = zkUA_loadPayloadChunks(nodePath, *value, *length, &payload,
+                &payloadLength);
+        free(*value);
+        *value = NULL;
+        if (rc == ZOK) {
+            *value = payload;
+            *length = payloadLength;
+            return ZOK;
+        }
+        if (rc != ZNONODE)
+            break;
+        /* a newer manifest replaced the chunks - read it again */
+    }
+    fprintf(stderr,
+            "zkUA_getNodePayload: Could not load the chunks of %s - rc = %d\n",
+            nodePath, rc);
+    return rc;
+}
+
+int zkUA_deleteNodeZnode(const char *nodePath) {
+    int rc = zoo_delete(zkHandle, nodePath, -1);
+    if (rc == ZNOTEMPTY) { /* chunks or other children of the node's znode */
+        rc = zkUA_payloadStore_deleteGenerations(nodePath, false);
+        if (rc == ZOK)
+            rc = zoo_delete(zkHandle, nodePath, -1);
+    }
+    return rc;
+}
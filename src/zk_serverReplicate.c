@@ -16,18 +16,34 @@
  ******************************************************************************/
 #include <stdio.h>
 #include <assert.h>
+#include <pthread.h>
 #include <simple_parse.h>
 #include <stdlib.h>
 #include <zk_serverReplicate.h>
 #include <zk_intercept.h>
 #include <zk_cli.h>
 #include <zk_global.h>
+#include <zk_mzxidTable.h>
+#include <zk_payload.h>
+#include <zk_payloadStore.h>
+#include <zk_deltaReplicate.h>
+#include <zk_valueReplicate.h>
+#include <zk_znodePath.h>
+#include <zk_nodeIdSet.h>
 #include "hashtable/hashtable.h"
 UA_Server *server = NULL;
 /* The server path on zk */
 char *zkServerPath;
 UA_Boolean replicateNode = true; /* Flag - replicate any node add/delete/update operations to ZooKeeper */
 UA_Boolean availabilityPriority = false;
+UA_Boolean transactionalWrites = false; /* Flag - replicate a WriteRequest as a single zk transaction */
+int readConsistency = ZKUA_READ_SESSION;
+/* Number of znodes the bootstrap requests from zk at once, 0 fetches them one at a time */
+static size_t bootstrapPipelineDepth = 0;
+/* Per-namespace read consistency overrides, -1 if the namespace uses readConsistency */
+static int nsReadConsistency[ZKUA_MAX_NSREADCONSISTENCY];
+static UA_UInt16 nsReadConsistencyIndex[ZKUA_MAX_NSREADCONSISTENCY];
+static size_t nsReadConsistencySize = 0;
 /**
  * zkUA_initializeRedundancy:
  * Initializes the ServerUriArray variale to hold the URI of all redundant servers of the OPC UA Server.
@@ -70,6 +86,45 @@ void zkUA_initializeRedundancy(/* should probably take an array length as a vari
 void zkUA_initializeAvailabilityPriority(UA_Boolean aPriority) {
     availabilityPriority = aPriority;
 }
+
+void zkUA_initializeTransactionalWrites(UA_Boolean transactional) {
+    transactionalWrites = transactional;
+}
+
+void zkUA_initializeBootstrapPipeline(size_t depth) {
+    bootstrapPipelineDepth = depth;
+}
+
+void zkUA_initializeReadConsistency(int level) {
+    readConsistency = level;
+}
+
+UA_StatusCode zkUA_setNamespaceReadConsistency(UA_UInt16 nsIndex, int level) {
+    for (size_t i = 0; i < nsReadConsistencySize; i++) {
+        if (nsReadConsistencyIndex[i] == nsIndex) {
+            nsReadConsistency[i] = level;
+            return UA_STATUSCODE_GOOD;
+        }
+    }
+    if (nsReadConsistencySize >= ZKUA_MAX_NSREADCONSISTENCY) {
+        fprintf(stderr,
+                "zkUA_setNamespaceReadConsistency: Too many namespace overrides, ignoring ns=%d\n",
+                nsIndex);
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    }
+    nsReadConsistencyIndex[nsReadConsistencySize] = nsIndex;
+    nsReadConsistency[nsReadConsistencySize] = level;
+    nsReadConsistencySize++;
+    return UA_STATUSCODE_GOOD;
+}
+
+int zkUA_readConsistencyForNode(const UA_NodeId *nodeId) {
+    for (size_t i = 0; i < nsReadConsistencySize; i++) {
+        if (nsReadConsistencyIndex[i] == nodeId->namespaceIndex)
+            return nsReadConsistency[i];
+    }
+    return readConsistency;
+}
 /**
  * zkUA_UA_Server_replicateZk:
  * Replicates the address space stored on zk locally
@@ -87,73 +142,72 @@ void zkUA_UA_Server_replicateZk(zhandle_t *zh, char *zkServerPath,
             zkUA_UA_Server_replicateZk_getNodes, strdup(zkServerPath));
 }
 
-void zkUA_extractNsIndexNodeId(const void *nId, char *storeNs, char *storeId) {
-
-    const char *nsStr = "ns=";
-    const char *iStr = ";i=";
+/* Children of the address space znode that are replicated locally, sorted with strcmp.
+ Only accessed from the child list completions, which all run on the zk completion thread. */
+static char **knownChildren = NULL;
+static size_t knownChildrenSize = 0;
 
-    /* locate the namespace substring and node ID substring in both strings */
-    char *cmpNs = strstr(*(char * const *) nId, nsStr);
-    char *cmpId = strstr(*(char * const *) nId, iStr);
+/* A child that appeared since the last child list */
+typedef struct zkUA_addedChild {
+    char *name;
+    UA_UInt64 key; /* mzxid table key parsed from the name */
+} zkUA_addedChild;
 
-    /* allocate memory for the namespace index substring */
-    size_t sizeofNs = strlen(cmpNs) - strlen(nsStr) - strlen(cmpId);
-    /* copy the namspace index into a temporary string */
-    strncpy(storeNs, cmpNs + strlen(nsStr), sizeofNs);
+static void zkUA_UA_Server_replicateZk_bootstrap(const char *zkServerPath,
+        const zkUA_addedChild *added, size_t addedSize);
+static void zkUA_dropOrphan(const char *child);
 
-    /* allocate memory for the nodeId substring */
-    size_t sizeofId = strlen(cmpId) - strlen(iStr);
-
-    /* copy the nodeId into a temporary string */
-    strncpy(storeId, cmpId + strlen(iStr), sizeofId);
+static int zkUA_childNameCmp(const void *c1, const void *c2) {
+    return strcmp(*(char * const *) c1, *(char * const *) c2);
+}
 
+/* Parses a child znode name into its table key. Numeric NodeIds are ordered first,
+ names that do not hold a NodeId last. */
+static UA_UInt64 zkUA_childKey(const char *child) {
+    UA_UInt64 key;
+    if (!zkUA_mzxidTableKeyFromPath(child, &key))
+        key = ~(UA_UInt64) 0;
+    return key;
 }
 
-static int nodeIdCmp(const void *nId1, const void *nId2) {
-    char *storeNs1 = calloc(65535, sizeof(char));
-    char *storeNs2 = calloc(65535, sizeof(char));
-    char *storeId1 = calloc(65535, sizeof(char));
-    char *storeId2 = calloc(65535, sizeof(char));
+static int zkUA_addedChildCmp(const void *c1, const void *c2) {
+    const zkUA_addedChild *a1 = (const zkUA_addedChild *) c1;
+    const zkUA_addedChild *a2 = (const zkUA_addedChild *) c2;
+    if (a1->key != a2->key)
+        return (a1->key < a2->key) ? -1 : 1;
+    return strcmp(a1->name, a2->name);
+}
 
-    zkUA_extractNsIndexNodeId(nId1, storeNs1, storeId1);
-    zkUA_extractNsIndexNodeId(nId2, storeNs2, storeId2);
-    /* convert the namespace Ids from string to long long int */
-    long long Ns1, Ns2;
-    Ns1 = strtoll(storeNs1, NULL, 10);
-    Ns2 = strtoll(storeNs2, NULL, 10);
+/* Removes a child from the known children so that the next child list fetches it again */
+static void zkUA_forgetKnownChild(const char *child) {
+    char **known = bsearch(&child, knownChildren, knownChildrenSize,
+            sizeof(char *), zkUA_childNameCmp);
+    if (!known)
+        return;
+    free(*known);
+    size_t pos = (size_t) (known - knownChildren);
+    memmove(known, known + 1, (knownChildrenSize - pos - 1) * sizeof(char *));
+    knownChildrenSize--;
+}
 
-    /* compare the namespace Ids */
-    if (Ns1 != Ns2) {
-        free(storeNs1);
-        free(storeNs2);
-        free(storeId1);
-        free(storeId2);
-        if (Ns1 < Ns2)
-            return -1;
-        if (Ns1 > Ns2)
-            return 1;
+/* Deletes the local node of a child znode that no longer exists on zk */
+static void zkUA_UA_Server_replicateZk_removeNode(const char *zkServerPath,
+        const char *child) {
+    zkUA_dropOrphan(child);
+    char zkNodePath[ZKUA_ZNODE_PATH_MAX];
+    UA_Byte identifier[ZKUA_ZNODE_NAME_MAX];
+    UA_NodeId nodeId;
+    if ((size_t) snprintf(zkNodePath, sizeof(zkNodePath), "%s/%s", zkServerPath,
+            child) >= sizeof(zkNodePath))
+        return;
+    if (zkUA_parseZnodeName(child, &nodeId, identifier, sizeof(identifier))) {
+        fprintf(stderr, "zkUA_UA_Server_replicateZk_getNodes: Removed %s\n",
+                child);
+        /* the node may already have been deleted by its ZOO_DELETED_EVENT */
+        zkUA_UA_Server_deleteNode_dontReplicate(server, nodeId,
+                true /* delete references */);
+        zkUA_deleteMzxidAge(zkNodePath);
     }
-
-    /* allocate memory for the nodeId substring */
-    /* convert the node Ids from string to long long int */
-    long long Id1, Id2;
-    Id1 = strtoll(storeId1, NULL, 10);
-    Id2 = strtoll(storeId2, NULL, 10);
-
-    /* free memory */
-    free(storeNs1);
-    free(storeNs2);
-    free(storeId1);
-    free(storeId2);
-
-    /* compare the node Ids */
-    if (Id1 < Id2)
-        return -1;
-    if (Id1 > Id2)
-        return 1;
-    /* otherwise they are equal */
-    return 0;
-
 }
 
 void zkUA_UA_Server_replicateZk_getNodes(int rc,
@@ -161,24 +215,59 @@ void zkUA_UA_Server_replicateZk_getNodes(int rc,
 
     fprintf(stderr, "Data completion %s rc = %d\n", (char*) data, rc);
 
-    /* loop through all of the returned zk children */
-    if (strings) {
-        /* Sort array of returned children so that we add the nodes in ascending order of
-         node IDs (assuming of course that a child will never have a smaller NodeId than a parent) */
-        qsort(strings->data, strings->count, sizeof(char *), nodeIdCmp);
-        for (int i = 0; i < (strings->count); i++) {
-            fprintf(stderr, "zkUA_UA_Server_replicateZk_getNodes\t%s\n",
-                    strings->data[i]);
-            /* should we be passing server to the function even though it's set globally?
-             could stop using the global one if we decode the server address from the
-             data string. */
-            char *zkNodePath = (char *) calloc(65535, sizeof(char));
-            snprintf(zkNodePath, 65535, "%s/%s", (char *) data,
-                    strings->data[i]);
-            zkUA_jsonDecode_zkNode(zkNodePath, server);
-            free(zkNodePath);
+    if (rc != ZOK || !strings) {
+        free((void *) data);
+        return;
+    }
+    /* Diff the children against the known children so that only the znodes that
+     were added or removed since the last child list are fetched or deleted */
+    size_t count = (size_t) strings->count;
+    char **current = malloc((count + 1) * sizeof(char *));
+    char **updated = malloc((count + 1) * sizeof(char *));
+    zkUA_addedChild *added = malloc((count + 1) * sizeof(zkUA_addedChild));
+    if (count > 0)
+        memcpy(current, strings->data, count * sizeof(char *));
+    qsort(current, count, sizeof(char *), zkUA_childNameCmp);
+
+    size_t i = 0, j = 0, updatedSize = 0, addedSize = 0;
+    while (i < count || j < knownChildrenSize) {
+        int cmp;
+        if (i == count)
+            cmp = 1;
+        else if (j == knownChildrenSize)
+            cmp = -1;
+        else
+            cmp = strcmp(current[i], knownChildren[j]);
+        if (cmp == 0) { /* unchanged */
+            updated[updatedSize++] = knownChildren[j];
+            i++;
+            j++;
+        } else if (cmp < 0) { /* added */
+            added[addedSize].name = current[i];
+            added[addedSize++].key = zkUA_childKey(current[i]);
+            updated[updatedSize++] = strdup(current[i]);
+            i++;
+        } else { /* removed */
+            zkUA_UA_Server_replicateZk_removeNode((char *) data,
+                    knownChildren[j]);
+            free(knownChildren[j]);
+            j++;
         }
     }
+    free(knownChildren);
+    knownChildren = updated;
+    knownChildrenSize = updatedSize;
+
+    if (addedSize > 0) {
+        /* Request the added children in NodeId order. Parents usually have smaller
+         NodeIds than their children so they tend to arrive first, but the loader adds
+         the nodes in dependency order either way. The children that cannot be fetched
+         are forgotten once their request completes. */
+        qsort(added, addedSize, sizeof(zkUA_addedChild), zkUA_addedChildCmp);
+        zkUA_UA_Server_replicateZk_bootstrap((char *) data, added, addedSize);
+    }
+    free(current);
+    free(added);
     free((void *) data);
 }
 
@@ -187,96 +276,562 @@ int zkUA_checkMzxidAge(char *nodeZkPath, long long *mzxid) {
     fprintf(stderr, "zkUA_jsonDecode_zkNode: nodeZkPath %s - mzxid = %lld\n",
             nodeZkPath, *mzxid);
     /* Let's see if the mzxid for this node path exists or if the retrieved data is fresher */
-    long long *val = hashtable_search(nodeMzxid, (void *) nodeZkPath);
-    if (val != NULL) { /* a value for this path is stored in the hashtable */
+    UA_UInt64 key;
+    long long val;
+    if (zkUA_mzxidTableKeyFromPath(nodeZkPath, &key)
+            && zkUA_mzxidTableSearch(key, &val, NULL)) { /* a value for this path is stored in the table */
         fprintf(stderr,
                 "zkUA_jsonDecode_zkNode: nodeZkPath %s - mzxid = %lld - val = %lld\n",
-                nodeZkPath, *mzxid, *val);
-        if (*val > *mzxid)
+                nodeZkPath, *mzxid, val);
+        if (val > *mzxid)
             return 1; /* we have something fresher than what's on zk */
-        if (*val == *mzxid)
+        if (val == *mzxid)
             return 0; /* we have something as fresh as what's on zk */
     }
     return -1; /* we have something in the local cache that's older than what's on zk */
 }
 
+/* Stores the mzxid and version of a znode, replacing what was stored before */
+static UA_StatusCode zkUA_insertZnodeAge(char *nodeZkPath, long long mzxid,
+        int version) {
+
+    UA_UInt64 key;
+    if (!zkUA_mzxidTableKeyFromPath(nodeZkPath, &key)) {
+        fprintf(stderr, "zkUA_insertZnodeAge: Unsupported node path %s\n",
+                nodeZkPath);
+        return UA_STATUSCODE_BADNODEIDINVALID;
+    }
+    return zkUA_mzxidTableInsert(key, mzxid, version);
+}
+
 UA_StatusCode zkUA_insertMzxidAge(char *nodeZkPath, long long *nodeMzxidLL) {
+    /* the version is unknown */
+    return zkUA_insertZnodeAge(nodeZkPath, *nodeMzxidLL, -1);
+}
 
-    char *hashNodeZkPath = strdup(nodeZkPath);
-    long long *mzxid = calloc(1, sizeof(long long));
-    *mzxid = *nodeMzxidLL;
-    if (hashtable_insert(nodeMzxid, (void *) hashNodeZkPath, (void *) mzxid)
-            != 0) { /* successfully inserted */
-        return UA_STATUSCODE_GOOD;
-    } else
-        return UA_STATUSCODE_BADUNEXPECTEDERROR;
+UA_StatusCode zkUA_insertZnodeStat(char *nodeZkPath, const struct Stat *stat) {
+    return zkUA_insertZnodeAge(nodeZkPath, (long long) stat->mzxid,
+            stat->version);
+}
+
+UA_Boolean zkUA_lookupZnodeVersion(char *nodeZkPath, int *version) {
+    UA_UInt64 key;
+    int val;
+    if (!zkUA_mzxidTableKeyFromPath(nodeZkPath, &key)
+            || !zkUA_mzxidTableSearch(key, NULL, &val) || val < 0)
+        return false;
+    *version = val;
+    return true;
 }
 
-/* Delete a node's key-value pair from the local hashtable */
+/* Delete a node's entry from the local mzxid table */
 UA_StatusCode zkUA_deleteMzxidAge(char *nodeZkPath) {
 
-    char *hashNodeZkPath = strdup(nodeZkPath);
-    if (hashtable_remove(nodeMzxid, (void *) hashNodeZkPath) != NULL)
+    UA_UInt64 key;
+    if (!zkUA_mzxidTableKeyFromPath(nodeZkPath, &key))
+        return UA_STATUSCODE_BADUNEXPECTEDERROR;
+    /* the node's value znode goes with it */
+    zkUA_mzxidTableRemove(key ^ ZKUA_MZXIDTABLE_VALUE_KEY);
+    if (zkUA_mzxidTableRemove(key))
         return UA_STATUSCODE_GOOD;
     else
         return UA_STATUSCODE_BADUNEXPECTEDERROR;
 }
 
-UA_StatusCode zkUA_jsonDecode_zkNode(char * nodeZkPath, UA_Server *serverDecode) {
-    /* get the node from zk and send it to my_silent_data_completion */
-    char *buffer = calloc(65535, sizeof(char));
-    size_t buffer_len = 65535;
-    struct Stat stat;
-    int rc = zoo_get(zkHandle, nodeZkPath, 1 /* non-zero sets watch */, buffer,
-            (int *) &buffer_len, &stat);
-    if (rc) {
-        fprintf(stderr, "\t Error %d for %s\n", rc, nodeZkPath);
-        free(buffer);
+/* Functions for manipulating the parent index (child NodeId -> parent NodeId + referenceTypeId).
+ * Keys and values are single allocations holding any string/bytestring identifier data
+ * inline, so the hashtable can free them with free(). */
+static struct hashtable *nodeParents = NULL;
+static pthread_mutex_t nodeParentsMutex = PTHREAD_MUTEX_INITIALIZER;
+
+typedef struct zkUA_parentEntry {
+    UA_NodeId parentNodeId;
+    UA_NodeId referenceTypeId;
+} zkUA_parentEntry;
+
+static unsigned int zkUA_parentHash(void *key) {
+    return (unsigned int) UA_NodeId_hash((const UA_NodeId *) key);
+}
+
+static int zkUA_parentEqualKeys(void *k1, void *k2) {
+    return UA_NodeId_equal((const UA_NodeId *) k1, (const UA_NodeId *) k2);
+}
+
+/* Size of the identifier data that has to be stored outside the UA_NodeId struct */
+static size_t zkUA_nodeIdDataLength(const UA_NodeId *nodeId) {
+    if (nodeId->identifierType == UA_NODEIDTYPE_STRING
+            || nodeId->identifierType == UA_NODEIDTYPE_BYTESTRING)
+        return nodeId->identifier.string.length;
+    return 0;
+}
+
+/* Shallow copies src into dst and moves its identifier data to *data */
+static void zkUA_nodeIdCopyInline(const UA_NodeId *src, UA_NodeId *dst,
+        UA_Byte **data) {
+    *dst = *src;
+    size_t length = zkUA_nodeIdDataLength(src);
+    if (length > 0) {
+        memcpy(*data, src->identifier.string.data, length);
+        dst->identifier.string.data = *data;
+        *data += length;
+    }
+}
+
+void zkUA_initializeParentIndex() {
+    nodeParents = create_hashtable(16, zkUA_parentHash, zkUA_parentEqualKeys);
+    if (NULL == nodeParents)
+        exit(-1);
+}
+
+void zkUA_destroyParentIndex() {
+    pthread_mutex_lock(&nodeParentsMutex);
+    if (nodeParents)
+        hashtable_destroy(nodeParents, 1);
+    nodeParents = NULL;
+    pthread_mutex_unlock(&nodeParentsMutex);
+}
+
+UA_StatusCode zkUA_insertParent(const UA_NodeId *nodeId,
+        const UA_NodeId *parentNodeId, const UA_NodeId *referenceTypeId) {
+
+    if (nodeParents == NULL || UA_NodeId_isNull(parentNodeId))
         return UA_STATUSCODE_BADUNEXPECTEDERROR;
+    UA_NodeId *key = malloc(sizeof(UA_NodeId) + zkUA_nodeIdDataLength(nodeId));
+    zkUA_parentEntry *entry = malloc(
+            sizeof(zkUA_parentEntry) + zkUA_nodeIdDataLength(parentNodeId)
+                    + zkUA_nodeIdDataLength(referenceTypeId));
+    if (!key || !entry) {
+        free(key);
+        free(entry);
+        return UA_STATUSCODE_BADOUTOFMEMORY;
     }
-    /* Prepare values for the hashtable */
-    int mzxidFresher = zkUA_checkMzxidAge(nodeZkPath,
-            ((long long int *) &stat.mzxid));
-    if (mzxidFresher >= 0) { /* we have something fresher or as fresh as what's on zk */
-        free(buffer);
+    UA_Byte *data = (UA_Byte *) (key + 1);
+    zkUA_nodeIdCopyInline(nodeId, key, &data);
+    data = (UA_Byte *) (entry + 1);
+    zkUA_nodeIdCopyInline(parentNodeId, &entry->parentNodeId, &data);
+    zkUA_nodeIdCopyInline(referenceTypeId, &entry->referenceTypeId, &data);
+
+    pthread_mutex_lock(&nodeParentsMutex);
+    /* a node has a single hierarchical parent, replace any stale entry */
+    free(hashtable_remove(nodeParents, (void *) nodeId));
+    int inserted = hashtable_insert(nodeParents, (void *) key, (void *) entry);
+    pthread_mutex_unlock(&nodeParentsMutex);
+    if (inserted != 0) /* successfully inserted */
         return UA_STATUSCODE_GOOD;
+    free(key);
+    free(entry);
+    return UA_STATUSCODE_BADUNEXPECTEDERROR;
+}
+
+UA_Boolean zkUA_lookupParent(const UA_NodeId *nodeId, UA_NodeId *parentNodeId,
+        UA_NodeId *referenceTypeId) {
+
+    UA_Boolean found = false;
+    if (nodeParents == NULL)
+        return false;
+    pthread_mutex_lock(&nodeParentsMutex);
+    zkUA_parentEntry *entry = hashtable_search(nodeParents, (void *) nodeId);
+    if (entry != NULL) {
+        UA_NodeId_copy(&entry->parentNodeId, parentNodeId);
+        UA_NodeId_copy(&entry->referenceTypeId, referenceTypeId);
+        found = true;
     }
+    pthread_mutex_unlock(&nodeParentsMutex);
+    return found;
+}
+
+void zkUA_deleteParent(const UA_NodeId *nodeId) {
+    if (nodeParents == NULL)
+        return;
+    pthread_mutex_lock(&nodeParentsMutex);
+    free(hashtable_remove(nodeParents, (void *) nodeId));
+    pthread_mutex_unlock(&nodeParentsMutex);
+}
+
+/* Adds or updates the node stored in a znode unless the local node is as fresh */
+static void zkUA_jsonDecode_zkNodeData(char *nodeZkPath, const char *buffer,
+        int buffer_len, const struct Stat *stat) {
+    /* Prepare values for the hashtable */
+    long long mzxid = stat->mzxid;
+    int mzxidFresher = zkUA_checkMzxidAge(nodeZkPath, &mzxid);
+    if (mzxidFresher >= 0) /* we have something fresher or as fresh as what's on zk */
+        return;
     /* otherwise what we just got is fresher */
-    /* Let's add the path and mzxid to the hashtable */
-    zkUA_insertMzxidAge(nodeZkPath, ((long long int *) &stat.mzxid));
+    /* Let's add the path, mzxid and version to the hashtable */
+    zkUA_insertZnodeStat(nodeZkPath, stat);
     /* decode and add the node */
-    zkUA_jsonDecode_zkNodeToUa(rc, buffer, buffer_len, &stat, server);
+    zkUA_decodeNodePayload(buffer, buffer_len, stat, server);
+    /* apply and watch a Variable's value znode and the deltas logged since this version */
+    zkUA_NodeInfo info;
+    if (zkUA_decodeNodePayloadInfo(buffer, buffer_len, &info)
+            == UA_STATUSCODE_GOOD) {
+        if (info.nodeClass == UA_NODECLASS_VARIABLE) {
+            /* the document may hold an older value than the value znode applied
+             last, forget its mzxid so that the value znode is applied again */
+            UA_UInt64 key;
+            if (zkUA_mzxidTableKeyFromPath(nodeZkPath, &key))
+                zkUA_mzxidTableRemove(key ^ ZKUA_MZXIDTABLE_VALUE_KEY);
+            zkUA_watchNodeValue(nodeZkPath);
+            zkUA_watchNodeDeltas(nodeZkPath);
+        }
+        zkUA_NodeInfo_deleteMembers(&info);
+    }
+}
+
+UA_StatusCode zkUA_jsonDecode_zkNode(char * nodeZkPath, UA_Server *serverDecode) {
+    /* get the node from zk (in a buffer of its size, reassembled if it is chunked) */
+    char *buffer;
+    int buffer_len;
+    struct Stat stat;
+    int rc = zkUA_getNodePayload(nodeZkPath, 1 /* non-zero sets watch */,
+            &buffer, &buffer_len, &stat);
+    if (rc) {
+        fprintf(stderr, "\t Error %d for %s\n", rc, nodeZkPath);
+        return UA_STATUSCODE_BADUNEXPECTEDERROR;
+    }
+    zkUA_jsonDecode_zkNodeData(nodeZkPath, buffer, buffer_len, &stat);
     free(buffer);
     return UA_STATUSCODE_GOOD;
 }
 
+/* Loader of added children: the znodes are requested with up to bootstrapPipelineDepth
+ zoo_aget's in flight and decoded as the responses arrive. The NodeInfo.parentNodeId of
+ each znode gives the parent graph: a node whose parent is not in the local address space
+ yet waits in a queue keyed on its parentNodeId until the parent has been added, so nodes
+ are added in dependency order whatever their NodeIds are. All of it runs on the zk
+ completion thread. */
+typedef struct zkUA_bootstrapNode {
+    struct zkUA_bootstrapNode *next; /* next node waiting for the same parent */
+    struct zkUA_bootstrapLoader *loader;
+    char *nodePath;
+    const char *name; /* child name within nodePath */
+    UA_UInt64 key;
+    char *value;
+    int valueLen;
+    struct Stat stat;
+    UA_NodeId *nodeId; /* NULL if the NodeInfo could not be decoded */
+    UA_NodeId *parentNodeId; /* NULL if the parent does not have to be waited for */
+} zkUA_bootstrapNode;
+
+typedef struct zkUA_bootstrapLoader {
+    char *zkServerPath;
+    zkUA_bootstrapNode *nodes;
+    size_t nodesSize;
+    size_t next; /* next node to request */
+    size_t inFlight;
+    size_t completed;
+    struct hashtable *waiting; /* parent NodeId -> nodes of this loader waiting for it */
+    zkUA_addedChild *released; /* orphans of earlier loaders whose parent was added */
+    size_t releasedSize;
+    size_t releasedCapacity;
+} zkUA_bootstrapLoader;
+
+/* Orphans: children whose parent was missing when their loader finished. Only their names
+ are kept - they are fetched again once the parent is added, as their data may have
+ changed in the meantime. */
+typedef struct zkUA_orphan {
+    struct zkUA_orphan *next;
+    char *name;
+} zkUA_orphan;
+
+typedef struct zkUA_orphanList {
+    zkUA_orphan *first;
+} zkUA_orphanList;
+
+static struct hashtable *orphans = NULL; /* parent NodeId -> zkUA_orphanList */
+
+/* Copies a NodeId into a single allocation that can be free'd with free() */
+static UA_NodeId *zkUA_nodeIdNewInline(const UA_NodeId *nodeId) {
+    UA_NodeId *copy = malloc(sizeof(UA_NodeId) + zkUA_nodeIdDataLength(nodeId));
+    if (copy) {
+        UA_Byte *data = (UA_Byte *) (copy + 1);
+        zkUA_nodeIdCopyInline(nodeId, copy, &data);
+    }
+    return copy;
+}
+
+/* Removes a child that was deleted on zk from the orphans */
+static void zkUA_dropOrphan(const char *child) {
+    if (!orphans || hashtable_count(orphans) == 0)
+        return;
+    struct hashtable_itr *itr = hashtable_iterator(orphans);
+    int more = 1;
+    while (more) {
+        zkUA_orphanList *list = hashtable_iterator_value(itr);
+        zkUA_orphan **link = &list->first;
+        while (*link) {
+            if (strcmp((*link)->name, child) == 0) {
+                zkUA_orphan *orphan = *link;
+                *link = orphan->next;
+                free(orphan->name);
+                free(orphan);
+            } else
+                link = &(*link)->next;
+        }
+        if (!list->first) {
+            free(list);
+            more = hashtable_iterator_remove(itr);
+        } else
+            more = hashtable_iterator_advance(itr);
+    }
+    free(itr);
+}
+
+/* Keeps a node whose parent is missing until the parent is added */
+static void zkUA_holdOrphan(zkUA_bootstrapNode *node) {
+    if (!orphans) {
+        orphans = create_hashtable(16, zkUA_parentHash, zkUA_parentEqualKeys);
+        if (!orphans)
+            return;
+    }
+    zkUA_orphan *orphan = malloc(sizeof(zkUA_orphan));
+    orphan->name = strdup(node->name);
+    zkUA_orphanList *list = hashtable_search(orphans,
+            (void *) node->parentNodeId);
+    if (!list) {
+        list = calloc(1, sizeof(zkUA_orphanList));
+        if (hashtable_insert(orphans, (void *) node->parentNodeId,
+                (void *) list) == 0) { /* not inserted */
+            free(list);
+            free(orphan->name);
+            free(orphan);
+            return;
+        }
+        node->parentNodeId = NULL; /* now owned by the orphans */
+    }
+    orphan->next = list->first;
+    list->first = orphan;
+}
+
+/* Moves the orphans waiting for a node that was just added to the loader */
+static void zkUA_releaseOrphans(zkUA_bootstrapLoader *loader,
+        const UA_NodeId *nodeId) {
+    if (!orphans || hashtable_count(orphans) == 0)
+        return;
+    zkUA_orphanList *list = hashtable_remove(orphans, (void *) nodeId);
+    if (!list)
+        return;
+    while (list->first) {
+        zkUA_orphan *orphan = list->first;
+        list->first = orphan->next;
+        if (loader->releasedSize == loader->releasedCapacity) {
+            loader->releasedCapacity = 2 * loader->releasedCapacity + 16;
+            loader->released = realloc(loader->released,
+                    loader->releasedCapacity * sizeof(zkUA_addedChild));
+        }
+        loader->released[loader->releasedSize].name = orphan->name;
+        loader->released[loader->releasedSize++].key = zkUA_childKey(
+                orphan->name);
+        free(orphan);
+    }
+    free(list);
+}
+
+/* Adds a node and then every node that was waiting for it */
+static void zkUA_bootstrap_apply(zkUA_bootstrapLoader *loader,
+        zkUA_bootstrapNode *node) {
+    node->next = NULL;
+    while (node) {
+        zkUA_bootstrapNode *current = node;
+        node = current->next;
+        zkUA_jsonDecode_zkNodeData(current->nodePath, current->value,
+                current->valueLen, &current->stat);
+        free(current->value);
+        current->value = NULL;
+        if (!current->nodeId)
+            continue;
+        zkUA_releaseOrphans(loader, current->nodeId);
+        zkUA_bootstrapNode *children = hashtable_remove(loader->waiting,
+                (void *) current->nodeId);
+        if (children) {
+            zkUA_bootstrapNode *last = children;
+            while (last->next)
+                last = last->next;
+            last->next = node;
+            node = children;
+        }
+    }
+}
+
+/* Holds the nodes whose parent never appeared, fetches released orphans and frees the loader */
+static void zkUA_bootstrap_finish(zkUA_bootstrapLoader *loader) {
+    if (hashtable_count(loader->waiting) > 0) {
+        struct hashtable_itr *itr = hashtable_iterator(loader->waiting);
+        do {
+            for (zkUA_bootstrapNode *node = hashtable_iterator_value(itr); node;
+                    node = node->next) {
+                fprintf(stderr,
+                        "zkUA_UA_Server_replicateZk_bootstrap: Holding %s until its parent is added\n",
+                        node->name);
+                zkUA_holdOrphan(node);
+            }
+        } while (hashtable_iterator_advance(itr));
+        free(itr);
+    }
+    hashtable_destroy(loader->waiting, 0);
+    for (size_t i = 0; i < loader->nodesSize; i++) {
+        free(loader->nodes[i].nodePath);
+        free(loader->nodes[i].value);
+        free(loader->nodes[i].nodeId);
+        free(loader->nodes[i].parentNodeId);
+    }
+    fprintf(stderr, "zkUA_UA_Server_replicateZk_bootstrap: Replicated %lu nodes\n",
+            loader->nodesSize);
+    if (loader->releasedSize > 0) {
+        /* the orphans' mzxid may have been stored while their add failed */
+        char zkNodePath[ZKUA_ZNODE_PATH_MAX];
+        for (size_t i = 0; i < loader->releasedSize; i++) {
+            /* a truncated path would name another node */
+            if ((size_t) snprintf(zkNodePath, sizeof(zkNodePath), "%s/%s",
+                    loader->zkServerPath, loader->released[i].name)
+                    >= sizeof(zkNodePath))
+                continue;
+            zkUA_deleteMzxidAge(zkNodePath);
+        }
+        qsort(loader->released, loader->releasedSize, sizeof(zkUA_addedChild),
+                zkUA_addedChildCmp);
+        zkUA_UA_Server_replicateZk_bootstrap(loader->zkServerPath,
+                loader->released, loader->releasedSize);
+        for (size_t i = 0; i < loader->releasedSize; i++)
+            free(loader->released[i].name);
+    }
+    free(loader->released);
+    free(loader->zkServerPath);
+    free(loader->nodes);
+    free(loader);
+}
+
+static void zkUA_bootstrap_getCompletion(int rc, const char *value,
+        int value_len, const struct Stat *stat, const void *data);
+
+/* Keeps up to bootstrapPipelineDepth requests in flight */
+static void zkUA_bootstrap_issue(zkUA_bootstrapLoader *loader) {
+    size_t depth = (bootstrapPipelineDepth > 0) ? bootstrapPipelineDepth : 1;
+    while (loader->inFlight < depth && loader->next < loader->nodesSize) {
+        zkUA_bootstrapNode *node = &loader->nodes[loader->next++];
+        int rc = zoo_aget(zkHandle, node->nodePath, 1 /* non-zero sets watch */,
+                zkUA_bootstrap_getCompletion, node);
+        if (rc == ZOK) {
+            loader->inFlight++;
+        } else {
+            fprintf(stderr, "\t Error %d for %s\n", rc, node->nodePath);
+            zkUA_forgetKnownChild(node->name);
+            loader->completed++;
+        }
+    }
+    if (loader->completed == loader->nodesSize)
+        zkUA_bootstrap_finish(loader);
+}
+
+static void zkUA_bootstrap_getCompletion(int rc, const char *value,
+        int value_len, const struct Stat *stat, const void *data) {
+    zkUA_bootstrapNode *node = (zkUA_bootstrapNode *) data;
+    zkUA_bootstrapLoader *loader = node->loader;
+    loader->inFlight--;
+    loader->completed++;
+    if (rc != ZOK || !value) {
+        fprintf(stderr, "\t Error %d for %s\n", rc, node->nodePath);
+        zkUA_forgetKnownChild(node->name);
+        zkUA_bootstrap_issue(loader);
+        return;
+    }
+    if (zkUA_isChunkManifest(value, value_len)) {
+        /* the watch is already set - read and reassemble the chunked payload */
+        rc = zkUA_getNodePayload(node->nodePath, 0, &node->value,
+                &node->valueLen, &node->stat);
+        if (rc != ZOK) {
+            fprintf(stderr, "\t Error %d for %s\n", rc, node->nodePath);
+            node->value = NULL;
+            zkUA_forgetKnownChild(node->name);
+            zkUA_bootstrap_issue(loader);
+            return;
+        }
+        value_len = node->valueLen;
+    } else {
+        node->value = malloc((size_t) value_len + 1);
+        memcpy(node->value, value, (size_t) value_len);
+        node->value[value_len] = '\0';
+        node->valueLen = value_len;
+        node->stat = *stat;
+    }
+
+    /* Find the node and its parent in the NodeInfo */
+    zkUA_NodeInfo info;
+    if (zkUA_decodeNodePayloadInfo(node->value, value_len, &info)
+            == UA_STATUSCODE_GOOD) {
+        node->nodeId = zkUA_nodeIdNewInline(&info.nodeId);
+        if (!UA_NodeId_isNull(&info.parentNodeId))
+            node->parentNodeId = zkUA_nodeIdNewInline(&info.parentNodeId);
+        zkUA_NodeInfo_deleteMembers(&info);
+    }
+
+    UA_NodeClass parentClass;
+    if (node->nodeId && node->parentNodeId
+            && UA_Server_readNodeClass(server, *node->parentNodeId,
+                    &parentClass) != UA_STATUSCODE_GOOD) {
+        /* wait for the parent */
+        zkUA_bootstrapNode *siblings = hashtable_search(loader->waiting,
+                (void *) node->parentNodeId);
+        if (siblings) {
+            node->next = siblings->next;
+            siblings->next = node;
+        } else {
+            node->next = NULL;
+            UA_NodeId *key = zkUA_nodeIdNewInline(node->parentNodeId);
+            if (!key || hashtable_insert(loader->waiting, (void *) key,
+                    (void *) node) == 0) { /* not inserted */
+                free(key);
+                zkUA_bootstrap_apply(loader, node);
+            }
+        }
+    } else {
+        /* the parent already exists locally (or decoding will report the error) */
+        zkUA_bootstrap_apply(loader, node);
+    }
+    zkUA_bootstrap_issue(loader);
+}
+
+static void zkUA_UA_Server_replicateZk_bootstrap(const char *zkServerPath,
+        const zkUA_addedChild *added, size_t addedSize) {
+
+    zkUA_bootstrapLoader *loader = calloc(1, sizeof(zkUA_bootstrapLoader));
+    loader->zkServerPath = strdup(zkServerPath);
+    loader->nodes = calloc(addedSize, sizeof(zkUA_bootstrapNode));
+    loader->nodesSize = addedSize;
+    loader->waiting = create_hashtable(16, zkUA_parentHash,
+            zkUA_parentEqualKeys);
+    size_t pathLen = strlen(zkServerPath);
+    for (size_t i = 0; i < addedSize; i++) {
+        zkUA_bootstrapNode *node = &loader->nodes[i];
+        node->loader = loader;
+        node->nodePath = malloc(pathLen + strlen(added[i].name) + 2);
+        sprintf(node->nodePath, "%s/%s", zkServerPath, added[i].name);
+        node->name = node->nodePath + pathLen + 1;
+        node->key = added[i].key;
+    }
+    fprintf(stderr,
+            "zkUA_UA_Server_replicateZk_bootstrap: Fetching %lu nodes, %lu at a time\n",
+            addedSize, (bootstrapPipelineDepth > 0) ? bootstrapPipelineDepth : 1);
+    zkUA_bootstrap_issue(loader);
+}
+
 /*
  * Search through the entire namespace starting from the NS0 Server Node looking for a specific child.
  * Return true if it is found as a sub-child of NS0
  */
-int cntrNS0 = 0, nServerNS0 = 3000, visitedNodeIDServerNS0[3000];
-
 UA_StatusCode zkUA_jsonDecode_checkChildOfNS0ServerNode(UA_NodeId childId,
         UA_Boolean isInverse, UA_NodeId referenceTypeId,
         void *searchedForNodeId) {
 
     if (isInverse)
         return UA_STATUSCODE_GOOD;
-    for (size_t j = 0; j < nServerNS0; j++) {
-        if (visitedNodeIDServerNS0[j] == childId.identifier.numeric) {
-            return UA_STATUSCODE_GOOD;
-        }
-    }
+    zkUA_checkNs0 *check = (zkUA_checkNs0 *) searchedForNodeId;
+    /* insert returns false if this search has already been here */
+    if (!zkUA_NodeIdSet_insert(check->visited, &childId))
+        return UA_STATUSCODE_GOOD;
 
-    UA_NodeId *searchedForNode =
-            ((zkUA_checkNs0 *) searchedForNodeId)->searchedForNode;
-    bool *result = &((zkUA_checkNs0 *) searchedForNodeId)->result;
-    if (childId.namespaceIndex == searchedForNode->namespaceIndex
-            && childId.identifier.numeric
-                    == searchedForNode->identifier.numeric) {
-        *result = true;
-    }
-    visitedNodeIDServerNS0[cntrNS0++] = childId.identifier.numeric;
+    if (UA_NodeId_equal(&childId, check->searchedForNode))
+        check->result = true;
     UA_Server_forEachChildNodeCall(server, childId,
             zkUA_jsonDecode_checkChildOfNS0ServerNode,
             (void *) searchedForNodeId);
@@ -73,3 +73,79 @@ char *zkUA_url_decode(char *str) {
     *pbuf = '\0';
     return buf;
 }
+
+/**
+ * Code for Encoding/Decoding base64 (RFC 4648, padded)
+ */
+static const char base64Chars[] =
+        "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+/* Returns the 6-bit value of a base64 character or -1 */
+static int from_base64(char ch) {
+    if (ch >= 'A' && ch <= 'Z')
+        return ch - 'A';
+    if (ch >= 'a' && ch <= 'z')
+        return ch - 'a' + 26;
+    if (ch >= '0' && ch <= '9')
+        return ch - '0' + 52;
+    if (ch == '+')
+        return 62;
+    if (ch == '/')
+        return 63;
+    return -1;
+}
+
+/* Returns a base64-encoded version of data */
+/* IMPORTANT: be sure to free() the returned string after use */
+char *zkUA_base64_encode(const unsigned char *data, size_t length) {
+    char *buf = malloc((length + 2) / 3 * 4 + 1), *pbuf = buf;
+    if (!buf)
+        return NULL;
+    size_t i;
+    for (i = 0; i + 2 < length; i += 3) {
+        *pbuf++ = base64Chars[data[i] >> 2];
+        *pbuf++ = base64Chars[(data[i] & 3) << 4 | data[i + 1] >> 4];
+        *pbuf++ = base64Chars[(data[i + 1] & 15) << 2 | data[i + 2] >> 6];
+        *pbuf++ = base64Chars[data[i + 2] & 63];
+    }
+    if (i < length) {
+        *pbuf++ = base64Chars[data[i] >> 2];
+        if (i + 1 < length) {
+            *pbuf++ = base64Chars[(data[i] & 3) << 4 | data[i + 1] >> 4];
+            *pbuf++ = base64Chars[(data[i + 1] & 15) << 2];
+        } else {
+            *pbuf++ = base64Chars[(data[i] & 3) << 4];
+            *pbuf++ = '=';
+        }
+        *pbuf++ = '=';
+    }
+    *pbuf = '\0';
+    return buf;
+}
+
+size_t zkUA_base64_decode(const char *str, size_t length, unsigned char *dst) {
+    if (length % 4 != 0)
+        return (size_t) -1;
+    size_t written = 0;
+    for (size_t i = 0; i < length; i += 4) {
+        int a = from_base64(str[i]), b = from_base64(str[i + 1]);
+        int c = from_base64(str[i + 2]), d = from_base64(str[i + 3]);
+        int last = (i + 4 == length);
+        if (a < 0 || b < 0)
+            return (size_t) -1;
+        dst[written++] = (unsigned char) (a << 2 | b >> 4);
+        if (c < 0) {
+            if (!last || str[i + 2] != '=' || str[i + 3] != '=')
+                return (size_t) -1;
+            break;
+        }
+        dst[written++] = (unsigned char) ((b & 15) << 4 | c >> 2);
+        if (d < 0) {
+            if (!last || str[i + 3] != '=')
+                return (size_t) -1;
+            break;
+        }
+        dst[written++] = (unsigned char) ((c & 3) << 6 | d);
+    }
+    return written;
+}
@@ -0,0 +1,286 @@
+/*******************************************************************************
+ * Copyright (C) 2018 Ahmed Ismail <aismail [at] protonmail.com>
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <zk_valueReplicate.h>
+#include <zk_payload.h>
+#include <zk_payloadStore.h>
+#include <zk_intercept.h>
+#include <zk_serverReplicate.h>
+#include <zk_cli.h>
+#include <zk_global.h>
+#include <zk_znodePath.h>
+#include <zk_mzxidTable.h>
+
+/* Binary encoding functions of the embedded open62541 (declared in its private headers) */
+typedef UA_StatusCode (*UA_exchangeEncodeBuffer)(void *handle,
+        UA_ByteString *buf, size_t offset);
+UA_StatusCode UA_encodeBinary(const void *src, const UA_DataType *type,
+        UA_exchangeEncodeBuffer exchangeCallback, void *exchangeHandle,
+        UA_ByteString *dst, size_t *offset);
+UA_StatusCode UA_decodeBinary(const UA_ByteString *src, size_t *offset,
+        void *dst, const UA_DataType *type);
+size_t UA_calcSizeBinary(void *p, const UA_DataType *type);
+
+static UA_Boolean valueZnodes = false;
+
+void zkUA_initializeValueZnodes(UA_Boolean enabled) {
+    valueZnodes = enabled;
+}
+
+UA_Boolean zkUA_isValueZnodePath(const char *path) {
+    size_t length = strlen(path);
+    size_t nameLength = strlen("/" ZKUA_VALUE_ZNODE_NAME);
+    return (length > nameLength
+            && strcmp(path + length - nameLength, "/" ZKUA_VALUE_ZNODE_NAME)
+                    == 0) ? true : false;
+}
+
+static char *zkUA_value_znodePath(const char *nodePath) {
+    char *valuePath = malloc(
+            strlen(nodePath) + strlen(ZKUA_VALUE_ZNODE_NAME) + 2);
+    sprintf(valuePath, "%s/" ZKUA_VALUE_ZNODE_NAME, nodePath);
+    return valuePath;
+}
+
+/* Encodes the header, NodeId and DataValue of a value znode (malloc'd) */
+static char *zkUA_value_encode(const UA_NodeId *nodeId,
+        const UA_DataValue *dataValue, int *length) {
+    size_t size = ZKUA_PAYLOAD_HEADER_SIZE
+            + UA_calcSizeBinary((void *) (uintptr_t) nodeId,
+                    &UA_TYPES[UA_TYPES_NODEID])
+            + UA_calcSizeBinary((void *) (uintptr_t) dataValue,
+                    &UA_TYPES[UA_TYPES_DATAVALUE]);
+    UA_ByteString znode;
+    if (UA_ByteString_allocBuffer(&znode, size) != UA_STATUSCODE_GOOD)
+        return NULL;
+    znode.data[0] = ZKUA_PAYLOAD_MAGIC0;
+    znode.data[1] = ZKUA_PAYLOAD_MAGIC1;
+    znode.data[2] = ZKUA_PAYLOAD_VERSION;
+    znode.data[3] = ZKUA_PAYLOAD_BINARY | ZKUA_PAYLOAD_VALUE;
+    size_t offset = ZKUA_PAYLOAD_HEADER_SIZE;
+    UA_StatusCode sCode = UA_encodeBinary(nodeId, &UA_TYPES[UA_TYPES_NODEID],
+            NULL, NULL, &znode, &offset);
+    sCode |= UA_encodeBinary(dataValue, &UA_TYPES[UA_TYPES_DATAVALUE], NULL,
+            NULL, &znode, &offset);
+    if (sCode != UA_STATUSCODE_GOOD) {
+        UA_ByteString_deleteMembers(&znode);
+        return NULL;
+    }
+    *length = (int) offset;
+    return (char *) znode.data;
+}
+
+/* The mzxid table key of a value znode: the key of its node with
+ ZKUA_MZXIDTABLE_VALUE_KEY flipped */
+static UA_Boolean zkUA_value_tableKey(const char *valuePath, UA_UInt64 *key) {
+    char nodePath[ZKUA_ZNODE_PATH_MAX];
+    size_t length = strlen(valuePath) - strlen("/" ZKUA_VALUE_ZNODE_NAME);
+    if (length >= sizeof(nodePath))
+        return false;
+    memcpy(nodePath, valuePath, length);
+    nodePath[length] = '\0';
+    if (!zkUA_mzxidTableKeyFromPath(nodePath, key))
+        return false;
+    *key ^= ZKUA_MZXIDTABLE_VALUE_KEY;
+    return true;
+}
+
+/* Reads the whole value of a node back and encodes it for its value znode: the write
+ may have been to an IndexRange only */
+static char *zkUA_value_encodeNode(UA_Server *server, const UA_NodeId *nodeId,
+        int *length) {
+    UA_ReadValueId id;
+    UA_ReadValueId_init(&id);
+    id.nodeId = *nodeId;
+    id.attributeId = UA_ATTRIBUTEID_VALUE;
+    UA_DataValue dataValue = UA_Server_read(server, &id,
+            UA_TIMESTAMPSTORETURN_BOTH);
+    char *znode = zkUA_value_encode(nodeId, &dataValue, length);
+    UA_DataValue_deleteMembers(&dataValue);
+    return znode;
+}
+
+/* Merges a value write into a value znode another server wrote in the meantime:
+ applies the znode's value, writes the value again on top of it (it may have been to
+ an IndexRange only) and encodes the merged value. v is re-read so that a failed retry
+ rolls back to the znode's value. */
+static char *zkUA_value_merge(UA_Server *server, const char *valuePath,
+        const UA_WriteValue *value, UA_DataValue *v, int *length) {
+    fprintf(stderr,
+            "zkUA_replicateValue: Merging the value of ns=%d;i=%d into %s\n",
+            value->nodeId.namespaceIndex, value->nodeId.identifier.numeric,
+            valuePath);
+    if (zkUA_applyNodeValue(valuePath, server) != UA_STATUSCODE_GOOD)
+        return NULL;
+    UA_DataValue_deleteMembers(v);
+    zkUA_atomicWrite_prepareRollback(server, v, value);
+    if (_UA_Server_write(server, value) != UA_STATUSCODE_GOOD)
+        return NULL;
+    return zkUA_value_encodeNode(server, &value->nodeId, length);
+}
+
+UA_StatusCode zkUA_replicateValue(UA_Server *server,
+        const UA_WriteValue *value, UA_DataValue *v) {
+
+    if (valueZnodes == false || value->attributeId != UA_ATTRIBUTEID_VALUE
+            || !zkHandle)
+        return UA_STATUSCODE_BADNOTSUPPORTED;
+    int version;
+    UA_UInt64 key;
+    char nodePath[ZKUA_ZNODE_PATH_MAX];
+    if (!zkUA_formatZnodePath(&value->nodeId, nodePath, sizeof(nodePath))
+            || !zkUA_lookupZnodeVersion(nodePath, &version))
+        return UA_STATUSCODE_BADNOTSUPPORTED;
+    char *valuePath = zkUA_value_znodePath(nodePath);
+    int length;
+    char *znode = zkUA_value_tableKey(valuePath, &key) ?
+            zkUA_value_encodeNode(server, &value->nodeId, &length) : NULL;
+    if (!znode) {
+        free(valuePath);
+        return UA_STATUSCODE_BADUNEXPECTEDERROR;
+    }
+    int rc;
+    if ((size_t) length > ZKUA_DEFAULT_CHUNK_SIZE) {
+        /* Too large for a single znode: the node is written in full (and chunked)
+         instead, so its value znode must not override it */
+        rc = zoo_delete(zkHandle, valuePath, -1);
+        zkUA_mzxidTableRemove(key);
+        free(znode);
+        free(valuePath);
+        return (rc == ZOK || rc == ZNONODE) ?
+                UA_STATUSCODE_BADNOTSUPPORTED :
+                UA_STATUSCODE_BADUNEXPECTEDERROR;
+    }
+    /* Set the value expecting the version last seen for the value znode, like the
+     node's znode, or create the value znode with the first value write of the node */
+    struct Stat stat;
+    UA_Boolean exists = zkUA_mzxidTableSearch(key, NULL, &version)
+            && version >= 0;
+    for (int attempt = 0; attempt < ZKUA_MAX_WRITE_ATTEMPTS; attempt++) {
+        if (exists) {
+            rc = zoo_set2(zkHandle, valuePath, znode, length, version, &stat);
+        } else {
+            rc = zoo_create(zkHandle, valuePath, znode, length,
+                    &ZOO_OPEN_ACL_UNSAFE, 0, NULL, 0);
+            if (rc == ZOK)
+                rc = zoo_exists(zkHandle, valuePath, 0, &stat);
+        }
+        if (rc == ZNONODE) {
+            exists = false;
+            continue;
+        }
+        if (rc != ZBADVERSION && rc != ZNODEEXISTS)
+            break;
+        /* Another server wrote the value in the meantime */
+        free(znode);
+        znode = zkUA_value_merge(server, valuePath, value, v, &length);
+        if (!znode)
+            break;
+        exists = zkUA_mzxidTableSearch(key, NULL, &version) && version >= 0;
+    }
+    free(znode);
+    free(valuePath);
+    if (rc != ZOK) {
+        fprintf(stderr,
+                "zkUA_replicateValue: Could not write the value of ns=%d;i=%d - rc = %d\n",
+                value->nodeId.namespaceIndex, value->nodeId.identifier.numeric,
+                rc);
+        return UA_STATUSCODE_BADUNEXPECTEDERROR;
+    }
+    zkUA_mzxidTableInsert(key, (long long) stat.mzxid, stat.version);
+    return UA_STATUSCODE_GOOD;
+}
+
+/* Result of the watch on a value znode: the znode exists, apply it */
+static void zkUA_value_watchCompletion(int rc, const struct Stat *stat,
+        const void *data) {
+    char *valuePath = (char *) data;
+    if (rc == ZOK && uaServerGlobal)
+        zkUA_applyNodeValue(valuePath, uaServerGlobal);
+    free(valuePath);
+}
+
+void zkUA_watchNodeValue(const char *nodePath) {
+    if (valueZnodes == false || !zkHandle)
+        return;
+    char *valuePath = zkUA_value_znodePath(nodePath);
+    /* fires once the value znode is created if it does not exist yet */
+    if (zoo_aexists(zkHandle, valuePath, 1 /* non-zero sets watch */,
+            zkUA_value_watchCompletion, valuePath) != ZOK)
+        free(valuePath);
+}
+
+UA_StatusCode zkUA_applyNodeValue(const char *valuePath, UA_Server *server) {
+    char *znode;
+    int length;
+    struct Stat stat;
+    int rc = zkUA_getZnodeData(valuePath, 1 /* non-zero sets watch */, &znode,
+            &length, &stat);
+    if (rc != ZOK) {
+        if (rc != ZNONODE)
+            fprintf(stderr, "\t Error %d for %s\n", rc, valuePath);
+        return UA_STATUSCODE_BADUNEXPECTEDERROR;
+    }
+    /* Skip a value that is not fresher than the one written or applied last,
+     e.g. the change event of our own write */
+    UA_UInt64 key;
+    long long mzxid;
+    if (zkUA_value_tableKey(valuePath, &key)) {
+        if (zkUA_mzxidTableSearch(key, &mzxid, NULL)
+                && mzxid >= (long long) stat.mzxid) {
+            free(znode);
+            return UA_STATUSCODE_GOOD;
+        }
+        zkUA_mzxidTableInsert(key, (long long) stat.mzxid, stat.version);
+    }
+    if (length < ZKUA_PAYLOAD_HEADER_SIZE || znode[0] != ZKUA_PAYLOAD_MAGIC0
+            || znode[1] != ZKUA_PAYLOAD_MAGIC1
+            || (UA_Byte) znode[2] > ZKUA_PAYLOAD_VERSION
+            || (UA_Byte) znode[3] != (ZKUA_PAYLOAD_BINARY | ZKUA_PAYLOAD_VALUE)) {
+        fprintf(stderr, "zkUA_applyNodeValue: Unknown value znode header\n");
+        free(znode);
+        return UA_STATUSCODE_BADDECODINGERROR;
+    }
+    UA_ByteString src = { (size_t) length, (UA_Byte *) znode };
+    size_t offset = ZKUA_PAYLOAD_HEADER_SIZE;
+    UA_WriteValue value;
+    UA_WriteValue_init(&value);
+    value.attributeId = UA_ATTRIBUTEID_VALUE;
+    UA_StatusCode sCode = UA_decodeBinary(&src, &offset, &value.nodeId,
+            &UA_TYPES[UA_TYPES_NODEID]);
+    if (sCode == UA_STATUSCODE_GOOD)
+        sCode = UA_decodeBinary(&src, &offset, &value.value,
+                &UA_TYPES[UA_TYPES_DATAVALUE]);
+    free(znode);
+    if (sCode != UA_STATUSCODE_GOOD) {
+        fprintf(stderr, "zkUA_applyNodeValue: Could not decode %s\n",
+                valuePath);
+        UA_WriteValue_deleteMembers(&value);
+        return UA_STATUSCODE_BADDECODINGERROR;
+    }
+    /* write the value without replicating it */
+    sCode = _UA_Server_write(server, &value);
+    if (sCode != UA_STATUSCODE_GOOD)
+        fprintf(stderr,
+                "zkUA_applyNodeValue: Could not write the value of ns=%d;i=%d - %s\n",
+                value.nodeId.namespaceIndex, value.nodeId.identifier.numeric,
+                UA_StatusCode_name(sCode));
+    UA_WriteValue_deleteMembers(&value);
+    return sCode;
+}
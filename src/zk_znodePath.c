@@ -0,0 +1,302 @@
+/*******************************************************************************
+ * Copyright (C) 2018 Ahmed Ismail <aismail [at] protonmail.com>
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+#include <stdio.h>
+#include <string.h>
+#include <zk_znodePath.h>
+#include <zk_cli.h>
+
+static const char hexDigits[] = "0123456789abcdef";
+static const char base64url[] =
+        "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_";
+
+UA_UInt64 zkUA_znodeNameHash(const void *data, size_t length) {
+    const UA_Byte *bytes = (const UA_Byte *) data;
+    UA_UInt64 hash = 0xcbf29ce484222325ULL;
+    for (size_t i = 0; i < length; i++) {
+        hash ^= bytes[i];
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+/* Length of the %XX escaped form of a string identifier */
+static size_t zkUA_escapedLength(const UA_String *s) {
+    size_t length = 0;
+    for (size_t i = 0; i < s->length; i++) {
+        UA_Byte c = s->data[i];
+        length += (c < 0x21 || c > 0x7E || c == '%' || c == '/') ? 3 : 1;
+    }
+    return length;
+}
+
+/* Writes the identifier part (after "ns=<ns>;") of a name, which has room for it */
+static void zkUA_formatIdentifier(const UA_NodeId *nodeId, char *out) {
+    switch (nodeId->identifierType) {
+    case UA_NODEIDTYPE_STRING: {
+        *out++ = 's';
+        *out++ = '=';
+        for (size_t i = 0; i < nodeId->identifier.string.length; i++) {
+            UA_Byte c = nodeId->identifier.string.data[i];
+            if (c < 0x21 || c > 0x7E || c == '%' || c == '/') {
+                *out++ = '%';
+                *out++ = hexDigits[c >> 4];
+                *out++ = hexDigits[c & 0x0F];
+            } else
+                *out++ = (char) c;
+        }
+        break;
+    }
+    case UA_NODEIDTYPE_GUID: {
+        const UA_Guid *g = &nodeId->identifier.guid;
+        sprintf(out,
+                "g=%08x-%04x-%04x-%02x%02x-%02x%02x%02x%02x%02x%02x",
+                g->data1, g->data2, g->data3, g->data4[0], g->data4[1],
+                g->data4[2], g->data4[3], g->data4[4], g->data4[5],
+                g->data4[6], g->data4[7]);
+        return;
+    }
+    case UA_NODEIDTYPE_BYTESTRING: {
+        const UA_ByteString *b = &nodeId->identifier.byteString;
+        *out++ = 'b';
+        *out++ = '=';
+        size_t i = 0;
+        for (; i + 2 < b->length; i += 3) {
+            UA_UInt32 v = (UA_UInt32) b->data[i] << 16
+                    | (UA_UInt32) b->data[i + 1] << 8 | b->data[i + 2];
+            *out++ = base64url[v >> 18];
+            *out++ = base64url[(v >> 12) & 0x3F];
+            *out++ = base64url[(v >> 6) & 0x3F];
+            *out++ = base64url[v & 0x3F];
+        }
+        if (b->length - i == 1) {
+            *out++ = base64url[b->data[i] >> 2];
+            *out++ = base64url[(b->data[i] & 0x03) << 4];
+        } else if (b->length - i == 2) {
+            UA_UInt32 v = (UA_UInt32) b->data[i] << 8 | b->data[i + 1];
+            *out++ = base64url[v >> 10];
+            *out++ = base64url[(v >> 4) & 0x3F];
+            *out++ = base64url[(v & 0x0F) << 2];
+        }
+        break;
+    }
+    default:
+        sprintf(out, "i=%u", nodeId->identifier.numeric);
+        return;
+    }
+    *out = '\0';
+}
+
+size_t zkUA_formatZnodeName(const UA_NodeId *nodeId, char *name, size_t size) {
+    char prefix[16];
+    size_t prefixLength = (size_t) sprintf(prefix, "ns=%u;",
+            nodeId->namespaceIndex);
+    size_t identifierLength;
+    switch (nodeId->identifierType) {
+    case UA_NODEIDTYPE_STRING:
+        identifierLength = 2 + zkUA_escapedLength(&nodeId->identifier.string);
+        break;
+    case UA_NODEIDTYPE_GUID:
+        identifierLength = 2 + 36;
+        break;
+    case UA_NODEIDTYPE_BYTESTRING:
+        identifierLength = 2
+                + (nodeId->identifier.byteString.length * 4 + 2) / 3;
+        break;
+    default:
+        identifierLength = 2 + 10;
+        break;
+    }
+    if (prefixLength + identifierLength < ZKUA_ZNODE_NAME_MAX) {
+        if (prefixLength + identifierLength >= size)
+            return 0;
+        memcpy(name, prefix, prefixLength);
+        zkUA_formatIdentifier(nodeId, name + prefixLength);
+        return prefixLength + strlen(name + prefixLength);
+    }
+    /* too long for a znode name: hash the identifier type and bytes */
+    UA_Byte type = (UA_Byte) nodeId->identifierType;
+    UA_UInt64 hash = zkUA_znodeNameHash(&type, 1);
+    const UA_String *s = &nodeId->identifier.string; /* also the ByteString */
+    for (size_t i = 0; i < s->length; i++) {
+        hash ^= s->data[i];
+        hash *= 0x100000001b3ULL;
+    }
+    char hashed[48];
+    size_t length = (size_t) snprintf(hashed, sizeof(hashed), "%sh=%016llx",
+            prefix, (unsigned long long) hash);
+    if (length >= size)
+        return 0;
+    memcpy(name, hashed, length + 1);
+    return length;
+}
+
+size_t zkUA_formatZnodePath(const UA_NodeId *nodeId, char *path, size_t size) {
+    const char *addressSpacePath = zkUA_zkServAddSpacePath();
+    size_t length = strlen(addressSpacePath);
+    if (length + 1 >= size)
+        return 0;
+    memcpy(path, addressSpacePath, length);
+    path[length] = '/';
+    size_t nameLength = zkUA_formatZnodeName(nodeId, path + length + 1,
+            size - length - 1);
+    return nameLength ? length + 1 + nameLength : 0;
+}
+
+static int zkUA_hexValue(char c) {
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    if (c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F')
+        return c - 'A' + 10;
+    return -1;
+}
+
+static int zkUA_base64urlValue(char c) {
+    if (c >= 'A' && c <= 'Z')
+        return c - 'A';
+    if (c >= 'a' && c <= 'z')
+        return c - 'a' + 26;
+    if (c >= '0' && c <= '9')
+        return c - '0' + 52;
+    if (c == '-')
+        return 62;
+    if (c == '_')
+        return 63;
+    return -1;
+}
+
+/* Parses hex digits into an unsigned number of digits * 4 bits */
+static UA_Boolean zkUA_parseHex(const char **str, int digits, UA_UInt32 *value) {
+    UA_UInt32 v = 0;
+    for (int i = 0; i < digits; i++) {
+        int h = zkUA_hexValue((*str)[i]);
+        if (h < 0)
+            return false;
+        v = v << 4 | (UA_UInt32) h;
+    }
+    *str += digits;
+    *value = v;
+    return true;
+}
+
+UA_Boolean zkUA_parseZnodeName(const char *path, UA_NodeId *nodeId,
+        UA_Byte *identifier, size_t identifierSize) {
+    const char *c = strrchr(path, '/');
+    c = c ? c + 1 : path;
+    if (c[0] != 'n' || c[1] != 's' || c[2] != '=')
+        return false;
+    c += 3;
+    UA_UInt32 ns = 0;
+    if (*c < '0' || *c > '9')
+        return false;
+    for (; *c >= '0' && *c <= '9'; c++) {
+        ns = ns * 10 + (UA_UInt32) (*c - '0');
+        if (ns > UA_UINT16_MAX)
+            return false;
+    }
+    if (c[0] != ';' || c[1] == '\0' || c[2] != '=')
+        return false;
+    char type = c[1];
+    c += 3;
+    UA_NodeId_init(nodeId);
+    nodeId->namespaceIndex = (UA_UInt16) ns;
+    switch (type) {
+    case 'i': {
+        UA_UInt64 id = 0;
+        if (*c < '0' || *c > '9')
+            return false;
+        for (; *c >= '0' && *c <= '9'; c++) {
+            id = id * 10 + (UA_UInt64) (*c - '0');
+            if (id > UA_UINT32_MAX)
+                return false;
+        }
+        if (*c != '\0')
+            return false;
+        nodeId->identifierType = UA_NODEIDTYPE_NUMERIC;
+        nodeId->identifier.numeric = (UA_UInt32) id;
+        return true;
+    }
+    case 's': {
+        size_t length = 0;
+        for (; *c; c++) {
+            if (length >= identifierSize)
+                return false;
+            if (*c == '%') {
+                int h = zkUA_hexValue(c[1]), l = (h < 0) ? -1 : zkUA_hexValue(c[2]);
+                if (l < 0)
+                    return false;
+                identifier[length++] = (UA_Byte) (h << 4 | l);
+                c += 2;
+            } else
+                identifier[length++] = (UA_Byte) *c;
+        }
+        nodeId->identifierType = UA_NODEIDTYPE_STRING;
+        nodeId->identifier.string.length = length;
+        nodeId->identifier.string.data = length ? identifier : NULL;
+        return true;
+    }
+    case 'g': {
+        UA_Guid *g = &nodeId->identifier.guid;
+        UA_UInt32 v;
+        if (!zkUA_parseHex(&c, 8, &g->data1) || *c++ != '-')
+            return false;
+        if (!zkUA_parseHex(&c, 4, &v) || *c++ != '-')
+            return false;
+        g->data2 = (UA_UInt16) v;
+        if (!zkUA_parseHex(&c, 4, &v) || *c++ != '-')
+            return false;
+        g->data3 = (UA_UInt16) v;
+        for (int i = 0; i < 8; i++) {
+            if (i == 2 && *c++ != '-')
+                return false;
+            if (!zkUA_parseHex(&c, 2, &v))
+                return false;
+            g->data4[i] = (UA_Byte) v;
+        }
+        if (*c != '\0')
+            return false;
+        nodeId->identifierType = UA_NODEIDTYPE_GUID;
+        return true;
+    }
+    case 'b': {
+        size_t length = 0;
+        UA_UInt32 bits = 0;
+        int bitCount = 0;
+        for (; *c; c++) {
+            int v = zkUA_base64urlValue(*c);
+            if (v < 0)
+                return false;
+            bits = bits << 6 | (UA_UInt32) v;
+            bitCount += 6;
+            if (bitCount >= 8) {
+                if (length >= identifierSize)
+                    return false;
+                bitCount -= 8;
+                identifier[length++] = (UA_Byte) (bits >> bitCount);
+                bits &= (1u << bitCount) - 1;
+            }
+        }
+        nodeId->identifierType = UA_NODEIDTYPE_BYTESTRING;
+        nodeId->identifier.byteString.length = length;
+        nodeId->identifier.byteString.data = length ? identifier : NULL;
+        return true;
+    }
+    default: /* hashed names can't be parsed back */
+        return false;
+    }
+}
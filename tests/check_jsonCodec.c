@@ -0,0 +1,141 @@
+/*******************************************************************************
+ * Copyright (C) 2018 Ahmed Ismail <aismail [at] protonmail.com>
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <open62541.h>
+#include <zk_payload.h>
+#include <zk_jsonStream.h>
+#include <zk_jsonScan.h>
+#include <zk_testValues.h>
+#include <zk_testCodec.h>
+
+/* Round-trips the attributes of every node class, and Variables and VariableTypes
+ holding every builtin type, through both JSON node codecs: encode, dump, load and
+ decode of the jansson tree, and the streaming writer and scanner (which leaves some
+ values to the tree decoder). Both have to write the same document. */
+
+static const UA_NodeClass nodeClasses[] = { UA_NODECLASS_OBJECT,
+        UA_NODECLASS_VARIABLE, UA_NODECLASS_METHOD, UA_NODECLASS_OBJECTTYPE,
+        UA_NODECLASS_VARIABLETYPE, UA_NODECLASS_REFERENCETYPE,
+        UA_NODECLASS_DATATYPE, UA_NODECLASS_VIEW };
+
+static const size_t arrayLengths[] = { 0 /* scalar */, 1, 100, 10000 };
+
+static int failures;
+
+static void zkUA_checkJsonCodec_report(UA_Boolean ok, UA_NodeClass nodeClass,
+        const UA_DataType *type, size_t arrayLength, const char *pipeline,
+        const char *document, size_t length) {
+    if (type)
+        printf("%s %s %s %s[%zu] %s\n", ok ? "ok" : "FAIL",
+                zkUA_testValues_nodeClassName(nodeClass), type->typeName,
+                arrayLength ? "array" : "scalar", arrayLength, pipeline);
+    else
+        printf("%s %s %s\n", ok ? "ok" : "FAIL",
+                zkUA_testValues_nodeClassName(nodeClass), pipeline);
+    if (!ok) {
+        failures++;
+        if (document && length < 4096)
+            printf("\t%.*s\n", (int) length, document);
+    }
+}
+
+static void zkUA_checkJsonCodec_roundTrip(UA_NodeClass nodeClass,
+        const UA_DataType *type, size_t arrayLength, size_t i) {
+    const UA_DataType *attributesType = zkUA_testValues_attributesType(
+            nodeClass);
+    zkUA_jsonScanAttributes attr, decoded;
+    UA_NodeId nodeId, decodedNodeId;
+    if (!zkUA_testValues_attributes(nodeClass,
+            type ? type : &UA_TYPES[UA_TYPES_INT32], arrayLength, &attr)) {
+        zkUA_checkJsonCodec_report(false, nodeClass, type, arrayLength,
+                "no test values", NULL, 0);
+        return;
+    }
+    zkUA_testValues_fill(&UA_TYPES[UA_TYPES_NODEID], i, &nodeId);
+
+    /* jansson tree */
+    size_t treeLength = 0;
+    char *tree = zkUA_testCodec_encodeTree(nodeClass, &nodeId, &attr,
+            &treeLength);
+    UA_StatusCode sCode = tree ?
+            zkUA_testCodec_decodeTree(tree, treeLength, nodeClass,
+                    &decodedNodeId, &decoded) :
+            UA_STATUSCODE_BADENCODINGERROR;
+    if (tree) {
+        zkUA_checkJsonCodec_report(sCode == UA_STATUSCODE_GOOD
+                && zkUA_testValues_equal(&UA_TYPES[UA_TYPES_NODEID], &nodeId,
+                        &decodedNodeId)
+                && zkUA_testValues_equal(attributesType, &attr, &decoded),
+                nodeClass, type, arrayLength, "tree", tree, treeLength);
+        UA_NodeId_deleteMembers(&decodedNodeId);
+        UA_deleteMembers(&decoded, attributesType);
+    } else {
+        zkUA_checkJsonCodec_report(false, nodeClass, type, arrayLength, "tree",
+                NULL, 0);
+    }
+
+    /* streaming writer and scanner */
+    UA_NodeId parent = ZKUA_TESTCODEC_PARENT;
+    UA_NodeId reference = ZKUA_TESTCODEC_REFERENCE;
+    size_t length = 0;
+    char *document = zkUA_jsonStream_encodeNode(ZKUA_TESTCODEC_PATH, nodeClass,
+            &nodeId, &parent, &reference, &attr, 0, &length);
+    UA_Boolean identical = document && tree && length == treeLength
+            && memcmp(document, tree, length) == 0;
+    zkUA_NodeInfo info;
+    sCode = document ?
+            zkUA_jsonScan_decodeNode(document, length, &info, &decoded) :
+            UA_STATUSCODE_BADENCODINGERROR;
+    if (sCode == UA_STATUSCODE_BADNOTSUPPORTED) {
+        /* left to the tree, which decoded the same document above */
+        zkUA_checkJsonCodec_report(identical, nodeClass, type, arrayLength,
+                "stream (tree decoded)", document, length);
+    } else {
+        /* the scanned attributes point into the document and scratch buffer */
+        zkUA_checkJsonCodec_report(identical && sCode == UA_STATUSCODE_GOOD
+                && info.nodeClass == nodeClass
+                && zkUA_testValues_equal(&UA_TYPES[UA_TYPES_NODEID], &nodeId,
+                        &info.nodeId)
+                && zkUA_testValues_equal(attributesType, &attr, &decoded),
+                nodeClass, type, arrayLength, "stream", document, length);
+    }
+    free(tree);
+    UA_NodeId_deleteMembers(&nodeId);
+    UA_deleteMembers(&attr, attributesType);
+}
+
+int main(void) {
+    zkUA_initializePayloadVersion(ZKUA_PAYLOAD_VERSION);
+    size_t i = 0;
+    for (size_t c = 0; c < sizeof(nodeClasses) / sizeof(nodeClasses[0]); c++) {
+        if (nodeClasses[c] != UA_NODECLASS_VARIABLE
+                && nodeClasses[c] != UA_NODECLASS_VARIABLETYPE) {
+            zkUA_checkJsonCodec_roundTrip(nodeClasses[c], NULL, 0, i++);
+            continue;
+        }
+        for (size_t t = 0; t < ZKUA_TESTVALUES_BUILTIN_TYPES; t++)
+            for (size_t l = 0;
+                    l < sizeof(arrayLengths) / sizeof(arrayLengths[0]); l++)
+                zkUA_checkJsonCodec_roundTrip(nodeClasses[c], &UA_TYPES[t],
+                        arrayLengths[l], i++);
+    }
+    if (failures)
+        printf("%d round trips failed\n", failures);
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,97 @@
+/*******************************************************************************
+ * Copyright (C) 2018 Ahmed Ismail <aismail [at] protonmail.com>
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <jansson.h>
+#include <open62541.h>
+#include <zk_jsonEncode.h>
+#include <zk_jsonDecode.h>
+#include <zk_payload.h>
+#include <zk_testValues.h>
+
+/* Round-trips every builtin type through the JSON Variant codec, as a scalar and as
+ arrays, at every payload version: data[i] keys (version 1), native arrays (version 2)
+ and base64 ByteStrings (version 3) */
+
+static const size_t arrayLengths[] = { 0 /* scalar */, 1, 7, 100 };
+
+static int failures;
+
+/* Before version 3 ByteStrings are written as text, which loses the binary test
+ values of the types holding one */
+static UA_Boolean zkUA_checkJsonTypes_lossless(const UA_DataType *type,
+        int version) {
+    if (version >= 3)
+        return true;
+    return type->typeIndex != UA_TYPES_BYTESTRING
+            && type->typeIndex != UA_TYPES_NODEID
+            && type->typeIndex != UA_TYPES_EXPANDEDNODEID
+            && type->typeIndex != UA_TYPES_EXTENSIONOBJECT;
+}
+
+static void zkUA_checkJsonTypes_roundTrip(const UA_DataType *type,
+        size_t arrayLength, int version) {
+    UA_Variant variant, decoded;
+    UA_Variant_init(&decoded);
+    if (!zkUA_testValues_variant(type, arrayLength, &variant)) {
+        printf("FAIL %s: no test values\n", type->typeName);
+        failures++;
+        return;
+    }
+    zkUA_initializePayloadVersion(version);
+    /* encode, dump, load and decode */
+    json_t *encoded = json_object();
+    zkUA_jsonEncode_UA_Variant(&variant, encoded);
+    char *document = json_dumps(encoded, JSON_COMPACT);
+    json_decref(encoded);
+    json_error_t error;
+    json_t *loaded = document ? json_loads(document, 0, &error) : NULL;
+    UA_StatusCode sCode = loaded ?
+            zkUA_jsonDecode_UA_Variant(loaded, &decoded) :
+            UA_STATUSCODE_BADDECODINGERROR;
+    json_decref(loaded);
+
+    UA_Boolean ok = sCode == UA_STATUSCODE_GOOD
+            && zkUA_testValues_equal(&UA_TYPES[UA_TYPES_VARIANT], &variant,
+                    &decoded);
+    printf("%s %s %s[%zu] payload version %d\n", ok ? "ok" : "FAIL",
+            type->typeName, arrayLength ? "array" : "scalar", arrayLength,
+            version);
+    if (!ok) {
+        failures++;
+        if (document && strlen(document) < 4096)
+            printf("\t%s\n", document);
+    }
+    free(document);
+    UA_Variant_deleteMembers(&variant);
+    UA_Variant_deleteMembers(&decoded);
+}
+
+int main(void) {
+    for (size_t t = 0; t < ZKUA_TESTVALUES_BUILTIN_TYPES; t++)
+        for (size_t l = 0; l < sizeof(arrayLengths) / sizeof(arrayLengths[0]);
+                l++)
+            for (int v = 1; v <= ZKUA_PAYLOAD_VERSION; v++)
+                if (zkUA_checkJsonTypes_lossless(&UA_TYPES[t], v))
+                    zkUA_checkJsonTypes_roundTrip(&UA_TYPES[t], arrayLengths[l],
+                            v);
+    zkUA_initializePayloadVersion(ZKUA_PAYLOAD_VERSION);
+    if (failures)
+        printf("%d round trips failed\n", failures);
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,63 @@
+/*******************************************************************************
+ * Copyright (C) 2018 Ahmed Ismail <aismail [at] protonmail.com>
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+#include <stdlib.h>
+#include <string.h>
+#include <jansson.h>
+#include <zk_intercept.h>
+#include <zk_jsonDecode.h>
+#include <zk_testValues.h>
+#include <zk_testCodec.h>
+
+char *zkUA_testCodec_encodeTree(UA_NodeClass nodeClass, const UA_NodeId *nodeId,
+        void *attr, size_t *length) {
+    json_t *nodePack = json_object();
+    if (!nodePack)
+        return NULL;
+    zkUA_addNodeJsonPack(ZKUA_TESTCODEC_PATH, nodeClass, *nodeId,
+            ZKUA_TESTCODEC_PARENT, ZKUA_TESTCODEC_REFERENCE, attr, nodePack);
+    char *document = json_dumps(nodePack, JSON_COMPACT | JSON_PRESERVE_ORDER);
+    json_decref(nodePack);
+    if (document)
+        *length = strlen(document);
+    return document;
+}
+
+UA_StatusCode zkUA_testCodec_decodeTree(const char *document, size_t length,
+        UA_NodeClass nodeClass, UA_NodeId *nodeId, void *attr) {
+    UA_NodeId_init(nodeId);
+    UA_init(attr, zkUA_testValues_attributesType(nodeClass));
+    json_error_t error;
+    json_t *jsonRoot = json_loadb(document, length, 0, &error);
+    if (!jsonRoot)
+        return UA_STATUSCODE_BADDECODINGERROR;
+    json_t *nodeInfo = json_object_get(jsonRoot, "NodeInfo");
+    json_t *jsonNodeClass = json_object_get(nodeInfo, "NodeClass");
+    json_t *attributes = json_object_get(jsonRoot, "Attributes");
+    if (!json_is_integer(jsonNodeClass)
+            || json_integer_value(jsonNodeClass) != nodeClass
+            || !json_is_object(attributes)) {
+        json_decref(jsonRoot);
+        return UA_STATUSCODE_BADDECODINGERROR;
+    }
+    UA_StatusCode sCode = zkUA_jsonDecode_UA_NodeId(
+            json_object_get(nodeInfo, "NodeId"), nodeId);
+    if (sCode == UA_STATUSCODE_GOOD)
+        sCode = zkUA_jsonDecode_zkNodeToUa_attributes(attributes, nodeClass,
+                attr);
+    json_decref(jsonRoot);
+    return sCode;
+}
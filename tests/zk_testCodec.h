@@ -0,0 +1,44 @@
+/*******************************************************************************
+ * Copyright (C) 2018 Ahmed Ismail <aismail [at] protonmail.com>
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+#include <open62541.h>
+
+/***** Round trips of node documents through the JSON tree codec *****/
+
+/* The restPath, parent and reference of the test nodes */
+#define ZKUA_TESTCODEC_PATH "/zkUA/test/AddressSpace/node"
+#define ZKUA_TESTCODEC_PARENT UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER)
+#define ZKUA_TESTCODEC_REFERENCE UA_NODEID_NUMERIC(0, UA_NS0ID_ORGANIZES)
+
+/**
+ * zkUA_testCodec_encodeTree:
+ * Encodes a node with zkUA_addNodeJsonPack and dumps it compactly in member order, as
+ * zkUA_jsonStream_encodeNode writes it. Returns the document (to be free'd) and sets
+ * *length, or returns NULL.
+ */
+char *zkUA_testCodec_encodeTree(UA_NodeClass nodeClass, const UA_NodeId *nodeId,
+        void *attr, size_t *length);
+
+/**
+ * zkUA_testCodec_decodeTree:
+ * Loads a node document and decodes its NodeId and attributes as
+ * zkUA_jsonDecode_zkNodeToUa does, without adding the node to a UA server. Fails if
+ * the document holds a node of another class than nodeClass. attr has to hold the
+ * attributes type of nodeClass; nodeId and attr are to be free'd by the caller, also
+ * if decoding fails.
+ */
+UA_StatusCode zkUA_testCodec_decodeTree(const char *document, size_t length,
+        UA_NodeClass nodeClass, UA_NodeId *nodeId, void *attr);
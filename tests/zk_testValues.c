@@ -0,0 +1,400 @@
+/*******************************************************************************
+ * Copyright (C) 2018 Ahmed Ismail <aismail [at] protonmail.com>
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <float.h>
+#include <zk_testValues.h>
+
+/* Binary encoding functions of the embedded open62541 (declared in its private headers) */
+typedef UA_StatusCode (*UA_exchangeEncodeBuffer)(void *handle,
+        UA_ByteString *buf, size_t offset);
+UA_StatusCode UA_encodeBinary(const void *src, const UA_DataType *type,
+        UA_exchangeEncodeBuffer exchangeCallback, void *exchangeHandle,
+        UA_ByteString *dst, size_t *offset);
+size_t UA_calcSizeBinary(void *p, const UA_DataType *type);
+
+/* Strings with characters JSON has to escape, non-ASCII and empty ones */
+static const char *strings[] = { "zkUA", "", "quote \" backslash \\ slash /",
+        "tab\tnewline\ncontrol\x01", "\xc3\xbc\xe2\x82\xac\xf0\x9f\x98\x80",
+        "ns=1;s=a/b" };
+#define ZKUA_TESTVALUES_STRINGS (sizeof(strings) / sizeof(strings[0]))
+
+static const UA_Int64 int64s[] = { 0, 1, -1, INT64_MAX, INT64_MIN,
+        (UA_Int64) 1 << 53, ((UA_Int64) 1 << 53) + 1, 1234567890123LL };
+#define ZKUA_TESTVALUES_INT64S (sizeof(int64s) / sizeof(int64s[0]))
+
+static const UA_Double doubles[] = { 0.0, 1.0, -1.5, 0.1, 1.0 / 3.0, DBL_MAX,
+        DBL_MIN, -DBL_MAX, 6.02214076e23, 1e-300 };
+#define ZKUA_TESTVALUES_DOUBLES (sizeof(doubles) / sizeof(doubles[0]))
+
+static const UA_Float floats[] = { 0.0f, 1.0f, -1.5f, 0.1f, 1.0f / 3.0f, FLT_MAX,
+        FLT_MIN, -FLT_MAX, 16777217.0f, 3.14159265f };
+#define ZKUA_TESTVALUES_FLOATS (sizeof(floats) / sizeof(floats[0]))
+
+static UA_String zkUA_testValues_string(size_t i) {
+    if (i % 4 == 3) {
+        /* and numbered ones so that arrays are not all alike */
+        char s[32];
+        snprintf(s, sizeof(s), "value %zu", i);
+        return UA_STRING_ALLOC(s);
+    }
+    UA_String s = UA_STRING_NULL;
+    if (strings[i % ZKUA_TESTVALUES_STRINGS][0] != '\0')
+        s = UA_STRING_ALLOC(strings[i % ZKUA_TESTVALUES_STRINGS]);
+    return s;
+}
+
+static UA_ByteString zkUA_testValues_byteString(size_t i) {
+    UA_ByteString b = UA_BYTESTRING_NULL;
+    size_t length = i % 5 * 3;
+    if (length == 0 || UA_ByteString_allocBuffer(&b, length) != UA_STATUSCODE_GOOD)
+        return b;
+    /* all byte values, zero and 0xff included */
+    for (size_t j = 0; j < length; j++)
+        b.data[j] = (UA_Byte) (i * 31 + j * 97);
+    return b;
+}
+
+static UA_Guid zkUA_testValues_guid(size_t i) {
+    UA_Guid g;
+    g.data1 = (UA_UInt32) (0xdeadbeefu * (i + 1));
+    g.data2 = (UA_UInt16) (i * 7);
+    g.data3 = (UA_UInt16) (0xffff - i);
+    for (size_t j = 0; j < 8; j++)
+        g.data4[j] = (UA_Byte) (i + j * 33);
+    return g;
+}
+
+static UA_NodeId zkUA_testValues_nodeId(size_t i) {
+    UA_NodeId n;
+    UA_NodeId_init(&n);
+    n.namespaceIndex = (UA_UInt16) (i % 3 == 0 ? 0 : i * 11);
+    switch (i % 4) {
+    case 0:
+        n.identifierType = UA_NODEIDTYPE_NUMERIC;
+        n.identifier.numeric = (UA_UInt32) (i % 8 == 0 ? UA_UINT32_MAX : i);
+        break;
+    case 1:
+        n.identifierType = UA_NODEIDTYPE_STRING;
+        n.identifier.string = zkUA_testValues_string(i / 4);
+        break;
+    case 2:
+        n.identifierType = UA_NODEIDTYPE_GUID;
+        n.identifier.guid = zkUA_testValues_guid(i);
+        break;
+    default:
+        n.identifierType = UA_NODEIDTYPE_BYTESTRING;
+        n.identifier.byteString = zkUA_testValues_byteString(i);
+        break;
+    }
+    return n;
+}
+
+UA_Boolean zkUA_testValues_fill(const UA_DataType *type, size_t i, void *value) {
+    if (!type || type->typeIndex >= ZKUA_TESTVALUES_BUILTIN_TYPES
+            || type != &UA_TYPES[type->typeIndex])
+        return false;
+    UA_init(value, type);
+    /* wraps around past the extremes instead of overflowing */
+    UA_Int64 i64 = (UA_Int64) ((UA_UInt64) int64s[i % ZKUA_TESTVALUES_INT64S]
+            + i / ZKUA_TESTVALUES_INT64S);
+    switch (type->typeIndex) {
+    case UA_TYPES_BOOLEAN:
+        *(UA_Boolean *) value = (i % 3) != 1;
+        break;
+    case UA_TYPES_SBYTE:
+        *(UA_SByte *) value = (UA_SByte) (i % 2 ? UA_SBYTE_MIN + i : i);
+        break;
+    case UA_TYPES_BYTE:
+        *(UA_Byte *) value = (UA_Byte) (i % 2 ? UA_BYTE_MAX - i : i);
+        break;
+    case UA_TYPES_INT16:
+        *(UA_Int16 *) value = (UA_Int16) (i % 2 ? UA_INT16_MIN + i : i * 257);
+        break;
+    case UA_TYPES_UINT16:
+        *(UA_UInt16 *) value = (UA_UInt16) (i % 2 ? UA_UINT16_MAX - i : i * 257);
+        break;
+    case UA_TYPES_INT32:
+        *(UA_Int32 *) value = (UA_Int32) (i % 2 ? UA_INT32_MIN + i : i * 65537);
+        break;
+    case UA_TYPES_UINT32:
+    case UA_TYPES_STATUSCODE:
+        *(UA_UInt32 *) value = (UA_UInt32) (i % 2 ? UA_UINT32_MAX - i : i * 65537);
+        break;
+    case UA_TYPES_INT64:
+    case UA_TYPES_DATETIME:
+        *(UA_Int64 *) value = i64;
+        break;
+    case UA_TYPES_UINT64:
+        /* the values above INT64_MAX too */
+        *(UA_UInt64 *) value = (UA_UInt64) i64 ^ (i % 2 ? 0 : 1ULL << 63);
+        break;
+    case UA_TYPES_FLOAT:
+        *(UA_Float *) value = floats[i % ZKUA_TESTVALUES_FLOATS]
+                / (UA_Float) (1 + i / ZKUA_TESTVALUES_FLOATS % 7);
+        break;
+    case UA_TYPES_DOUBLE:
+        *(UA_Double *) value = doubles[i % ZKUA_TESTVALUES_DOUBLES]
+                / (UA_Double) (1 + i / ZKUA_TESTVALUES_DOUBLES % 7);
+        break;
+    case UA_TYPES_STRING:
+        *(UA_String *) value = zkUA_testValues_string(i);
+        break;
+    case UA_TYPES_GUID:
+        *(UA_Guid *) value = zkUA_testValues_guid(i);
+        break;
+    case UA_TYPES_BYTESTRING:
+        *(UA_ByteString *) value = zkUA_testValues_byteString(i);
+        break;
+    case UA_TYPES_XMLELEMENT: {
+        char s[64];
+        snprintf(s, sizeof(s), "<value index=\"%zu\">&amp;</value>", i);
+        *(UA_XmlElement *) value = UA_STRING_ALLOC(s);
+        break;
+    }
+    case UA_TYPES_NODEID:
+        *(UA_NodeId *) value = zkUA_testValues_nodeId(i);
+        break;
+    case UA_TYPES_EXPANDEDNODEID: {
+        UA_ExpandedNodeId *e = (UA_ExpandedNodeId *) value;
+        e->nodeId = zkUA_testValues_nodeId(i);
+        if (i % 2)
+            e->namespaceUri = zkUA_testValues_string(i);
+        e->serverIndex = (UA_UInt32) (i % 3);
+        break;
+    }
+    case UA_TYPES_QUALIFIEDNAME: {
+        UA_QualifiedName *q = (UA_QualifiedName *) value;
+        q->namespaceIndex = (UA_UInt16) i;
+        q->name = zkUA_testValues_string(i);
+        break;
+    }
+    case UA_TYPES_LOCALIZEDTEXT: {
+        UA_LocalizedText *t = (UA_LocalizedText *) value;
+        if (i % 3)
+            t->locale = UA_STRING_ALLOC(i % 3 == 1 ? "en-US" : "de");
+        t->text = zkUA_testValues_string(i);
+        break;
+    }
+    case UA_TYPES_EXTENSIONOBJECT: {
+        /* the JSON codec only carries encoded bodies */
+        UA_ExtensionObject *e = (UA_ExtensionObject *) value;
+        e->encoding = (UA_ExtensionObjectEncoding) (i % 3);
+        if (e->encoding == UA_EXTENSIONOBJECT_ENCODED_NOBODY)
+            break;
+        e->content.encoded.typeId = UA_NODEID_NUMERIC(0, (UA_UInt32) (300 + i));
+        if (e->encoding == UA_EXTENSIONOBJECT_ENCODED_BYTESTRING)
+            e->content.encoded.body = zkUA_testValues_byteString(i + 1);
+        else
+            zkUA_testValues_fill(&UA_TYPES[UA_TYPES_XMLELEMENT], i,
+                    &e->content.encoded.body);
+        break;
+    }
+    case UA_TYPES_DATAVALUE: {
+        /* every combination of the optional members in turn */
+        UA_DataValue *d = (UA_DataValue *) value;
+        d->hasValue = i % 2 == 0;
+        d->hasStatus = i % 3 != 1;
+        d->hasSourceTimestamp = i % 4 < 2;
+        d->hasServerTimestamp = i % 5 < 3;
+        d->hasSourcePicoseconds = d->hasSourceTimestamp && i % 3 == 0;
+        d->hasServerPicoseconds = d->hasServerTimestamp && i % 2 == 1;
+        if (d->hasValue)
+            zkUA_testValues_variant(&UA_TYPES[i / 2 % 3 == 0 ?
+                    UA_TYPES_DOUBLE : i / 2 % 3 == 1 ?
+                    UA_TYPES_STRING : UA_TYPES_INT32], i % 4, &d->value);
+        if (d->hasStatus)
+            d->status = (UA_StatusCode) (i % 2 ? UA_STATUSCODE_BADTIMEOUT : i);
+        if (d->hasSourceTimestamp)
+            d->sourceTimestamp = i64;
+        if (d->hasServerTimestamp)
+            d->serverTimestamp = i64 + 1;
+        if (d->hasSourcePicoseconds)
+            d->sourcePicoseconds = (UA_UInt16) (i % 10000);
+        if (d->hasServerPicoseconds)
+            d->serverPicoseconds = (UA_UInt16) (9999 - i % 10000);
+        break;
+    }
+    default:
+        return false;
+    }
+    return true;
+}
+
+UA_Boolean zkUA_testValues_variant(const UA_DataType *type, size_t arrayLength,
+        UA_Variant *variant) {
+    UA_Variant_init(variant);
+    if (arrayLength == 0) {
+        void *value = UA_new(type);
+        if (!value || !zkUA_testValues_fill(type, 0, value)) {
+            UA_delete(value, type);
+            return false;
+        }
+        UA_Variant_setScalar(variant, value, type);
+        return true;
+    }
+    void *array = UA_Array_new(arrayLength, type);
+    if (!array)
+        return false;
+    UA_Variant_setArray(variant, array, arrayLength, type);
+    for (size_t i = 0; i < arrayLength; i++) {
+        if (!zkUA_testValues_fill(type, i,
+                (char *) array + i * type->memSize)) {
+            UA_Variant_deleteMembers(variant);
+            return false;
+        }
+    }
+    return true;
+}
+
+UA_Boolean zkUA_testValues_equal(const UA_DataType *type, const void *a,
+        const void *b) {
+    size_t size = UA_calcSizeBinary((void *) (uintptr_t) a, type);
+    if (size != UA_calcSizeBinary((void *) (uintptr_t) b, type))
+        return false;
+    UA_ByteString ea, eb;
+    if (UA_ByteString_allocBuffer(&ea, size) != UA_STATUSCODE_GOOD)
+        return false;
+    if (UA_ByteString_allocBuffer(&eb, size) != UA_STATUSCODE_GOOD) {
+        UA_ByteString_deleteMembers(&ea);
+        return false;
+    }
+    size_t offsetA = 0, offsetB = 0;
+    UA_Boolean equal = UA_encodeBinary(a, type, NULL, NULL, &ea, &offsetA)
+            == UA_STATUSCODE_GOOD
+            && UA_encodeBinary(b, type, NULL, NULL, &eb, &offsetB)
+                    == UA_STATUSCODE_GOOD && offsetA == offsetB
+            && memcmp(ea.data, eb.data, offsetA) == 0;
+    UA_ByteString_deleteMembers(&ea);
+    UA_ByteString_deleteMembers(&eb);
+    return equal;
+}
+
+const char *zkUA_testValues_nodeClassName(UA_NodeClass nodeClass) {
+    switch (nodeClass) {
+    case UA_NODECLASS_OBJECT:
+        return "Object";
+    case UA_NODECLASS_VARIABLE:
+        return "Variable";
+    case UA_NODECLASS_METHOD:
+        return "Method";
+    case UA_NODECLASS_OBJECTTYPE:
+        return "ObjectType";
+    case UA_NODECLASS_VARIABLETYPE:
+        return "VariableType";
+    case UA_NODECLASS_REFERENCETYPE:
+        return "ReferenceType";
+    case UA_NODECLASS_DATATYPE:
+        return "DataType";
+    case UA_NODECLASS_VIEW:
+        return "View";
+    default:
+        return "Unspecified";
+    }
+}
+
+const UA_DataType *zkUA_testValues_attributesType(UA_NodeClass nodeClass) {
+    switch (nodeClass) {
+    case UA_NODECLASS_OBJECT:
+        return &UA_TYPES[UA_TYPES_OBJECTATTRIBUTES];
+    case UA_NODECLASS_VARIABLE:
+        return &UA_TYPES[UA_TYPES_VARIABLEATTRIBUTES];
+    case UA_NODECLASS_METHOD:
+        return &UA_TYPES[UA_TYPES_METHODATTRIBUTES];
+    case UA_NODECLASS_OBJECTTYPE:
+        return &UA_TYPES[UA_TYPES_OBJECTTYPEATTRIBUTES];
+    case UA_NODECLASS_VARIABLETYPE:
+        return &UA_TYPES[UA_TYPES_VARIABLETYPEATTRIBUTES];
+    case UA_NODECLASS_REFERENCETYPE:
+        return &UA_TYPES[UA_TYPES_REFERENCETYPEATTRIBUTES];
+    case UA_NODECLASS_DATATYPE:
+        return &UA_TYPES[UA_TYPES_DATATYPEATTRIBUTES];
+    case UA_NODECLASS_VIEW:
+        return &UA_TYPES[UA_TYPES_VIEWATTRIBUTES];
+    default:
+        return NULL;
+    }
+}
+
+UA_Boolean zkUA_testValues_attributes(UA_NodeClass nodeClass,
+        const UA_DataType *type, size_t arrayLength, void *attr) {
+    const UA_DataType *attributesType = zkUA_testValues_attributesType(
+            nodeClass);
+    if (!attributesType)
+        return false;
+    UA_init(attr, attributesType);
+    /* the attributes all node classes have */
+    UA_ObjectAttributes *node = (UA_ObjectAttributes *) attr;
+    zkUA_testValues_fill(&UA_TYPES[UA_TYPES_LOCALIZEDTEXT], 0,
+            &node->displayName);
+    zkUA_testValues_fill(&UA_TYPES[UA_TYPES_LOCALIZEDTEXT], 2,
+            &node->description);
+    node->writeMask = 0x5a5a5a5a;
+
+    switch (nodeClass) {
+    case UA_NODECLASS_OBJECT:
+        node->eventNotifier = 5;
+        break;
+    case UA_NODECLASS_VIEW: {
+        UA_ViewAttributes *view = (UA_ViewAttributes *) attr;
+        view->containsNoLoops = true;
+        view->eventNotifier = 1;
+        break;
+    }
+    case UA_NODECLASS_VARIABLE:
+    case UA_NODECLASS_VARIABLETYPE: {
+        /* UA_VariableTypeAttributes match UA_VariableAttributes up to isAbstract */
+        UA_VariableAttributes *variable = (UA_VariableAttributes *) attr;
+        if (!zkUA_testValues_variant(type, arrayLength, &variable->value)) {
+            UA_deleteMembers(attr, attributesType);
+            return false;
+        }
+        variable->dataType = type->typeId;
+        variable->valueRank = arrayLength ? 1 : -1;
+        if (nodeClass == UA_NODECLASS_VARIABLETYPE) {
+            ((UA_VariableTypeAttributes *) attr)->isAbstract = true;
+            break;
+        }
+        variable->accessLevel = 3;
+        variable->userAccessLevel = 1;
+        variable->minimumSamplingInterval = 12.5;
+        variable->historizing = true;
+        break;
+    }
+    case UA_NODECLASS_REFERENCETYPE: {
+        UA_ReferenceTypeAttributes *referenceType =
+                (UA_ReferenceTypeAttributes *) attr;
+        referenceType->symmetric = true;
+        zkUA_testValues_fill(&UA_TYPES[UA_TYPES_LOCALIZEDTEXT], 4,
+                &referenceType->inverseName);
+        break;
+    }
+    case UA_NODECLASS_OBJECTTYPE:
+        ((UA_ObjectTypeAttributes *) attr)->isAbstract = true;
+        break;
+    case UA_NODECLASS_DATATYPE:
+        ((UA_DataTypeAttributes *) attr)->isAbstract = true;
+        break;
+    case UA_NODECLASS_METHOD:
+        ((UA_MethodAttributes *) attr)->executable = true;
+        break;
+    default:
+        break;
+    }
+    return true;
+}
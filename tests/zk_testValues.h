@@ -0,0 +1,68 @@
+/*******************************************************************************
+ * Copyright (C) 2018 Ahmed Ismail <aismail [at] protonmail.com>
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+#include <open62541.h>
+
+/***** Test values of the builtin types *****/
+
+/* The builtin types a Variant of the JSON codec holds, Boolean to DataValue */
+#define ZKUA_TESTVALUES_BUILTIN_TYPES (UA_TYPES_DATAVALUE + 1)
+
+/**
+ * zkUA_testValues_fill:
+ * Initializes *value with the i-th test value of a builtin type. The values cycle
+ * through the edge cases of the type (extremes, empty and escaped strings, every
+ * NodeId identifier type, ...). Returns false for types other than the builtin ones.
+ */
+UA_Boolean zkUA_testValues_fill(const UA_DataType *type, size_t i, void *value);
+
+/**
+ * zkUA_testValues_variant:
+ * Initializes variant with the first test values of a builtin type: a scalar if
+ * arrayLength is 0, an array of arrayLength values otherwise.
+ */
+UA_Boolean zkUA_testValues_variant(const UA_DataType *type, size_t arrayLength,
+        UA_Variant *variant);
+
+/**
+ * zkUA_testValues_equal:
+ * Compares two values of a type by their UA Binary encoding.
+ */
+UA_Boolean zkUA_testValues_equal(const UA_DataType *type, const void *a,
+        const void *b);
+
+/***** Test attributes of the node classes *****/
+
+/**
+ * zkUA_testValues_nodeClassName:
+ * Returns the name of a node class, e.g. "Variable".
+ */
+const char *zkUA_testValues_nodeClassName(UA_NodeClass nodeClass);
+
+/**
+ * zkUA_testValues_attributesType:
+ * Returns the attributes type of a node class (UA_ObjectAttributes, ...) or NULL.
+ */
+const UA_DataType *zkUA_testValues_attributesType(UA_NodeClass nodeClass);
+
+/**
+ * zkUA_testValues_attributes:
+ * Initializes *attr, of the attributes type of nodeClass, with the attributes the JSON
+ * node documents hold. The value of Variables and VariableTypes holds the test values
+ * of type as in zkUA_testValues_variant, the other attributes are left at 0.
+ */
+UA_Boolean zkUA_testValues_attributes(UA_NodeClass nodeClass,
+        const UA_DataType *type, size_t arrayLength, void *attr);